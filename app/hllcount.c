@@ -0,0 +1,757 @@
+/**
+ * @file hllcount.c
+ *
+ * A command line tool, that estimates the number of distinct lines (or fields) of large files with HyperLogLog
+ * sketches.
+ *
+ * usage: hllcount [-t <threads>] [-r <register size>] [-b <index bits>] [-d <delimiter>] [-c <columns> | -a]
+ *                 [-g <key column>] [<file>...]
+ *
+ *  * `-t` number of worker threads (default: number of CPUs)
+ *  * `-r`, `-b` parameters of the sketches, see `hllInit()` (default: 6 and 14)
+ *  * `-d` field delimiter (default: tab)
+ *  * `-c` comma separated list of columns (starting at 1), that are counted separately instead of whole lines
+ *  * `-a` counts every column separately
+ *  * `-g` counts the distinct lines (or the distinct values of the column given with `-c`) per value of this column
+ *
+ * Files are memory-mapped and split into one chunk per thread. If no file is given (or the file is "-"), stdin is read
+ * in chunks. Every thread has its own sketches, which are merged at the end. The estimates are written to stdout, the
+ * throughput is written to stderr.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../inc/AvlTree.h"
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLog.h"
+#include "../inc/HyperLogLogStore.h"
+
+/**
+ * The maximum number of worker threads.
+ */
+#define MAX_THREADS 256
+
+/**
+ * The maximum number of columns, that can be counted separately.
+ */
+#define MAX_COLUMNS 64
+
+/**
+ * The size of the chunks stdin is read in (per thread).
+ */
+#define STREAM_CHUNK_SIZE ((size_t)8 << 20)
+
+/**
+ * The command line options.
+ */
+struct Options
+{
+	unsigned char r;
+	unsigned char b;
+	size_t n_threads;
+	char delimiter;
+
+	/**
+	 * `sketch_of_column[c]` is the index of the sketch of column `c` (starting at 1), or -1 if the column is not
+	 * counted. If no column is counted, whole lines are counted in sketch 0.
+	 */
+	int sketch_of_column[MAX_COLUMNS + 1];
+
+	/**
+	 * The number of sketches per thread.
+	 */
+	size_t n_sketches;
+
+	/**
+	 * Non-zero, if whole lines are counted instead of columns.
+	 */
+	int whole_lines;
+
+	/**
+	 * The key column for `-g` (starting at 1), or 0.
+	 */
+	size_t group_column;
+
+	/**
+	 * The column that is counted per key for `-g` (starting at 1), or 0 for whole lines.
+	 */
+	size_t value_column;
+};
+
+/**
+ * A distinct value of the key column.
+ */
+struct GroupKey
+{
+	uint64_t hash;
+	size_t length;
+	char name[];
+};
+
+/**
+ * The state of a worker thread.
+ */
+struct Worker
+{
+	pthread_t thread;
+	const struct Options *options;
+
+	/**
+	 * The chunk of the input, that is processed next.
+	 */
+	const char *data;
+	size_t length;
+
+	/**
+	 * The sketches of the counted columns (or of whole lines).
+	 */
+	struct HyperLogLog sketches[MAX_COLUMNS];
+
+	/**
+	 * The greatest column number, that was seen in the input.
+	 */
+	size_t n_columns_seen;
+
+	/**
+	 * One sketch per key (for `-g`), and the keys by name.
+	 */
+	struct HyperLogLogStore groups;
+	struct AvlTree keys;
+
+	/**
+	 * 0 on success, -1 on malloc error.
+	 */
+	int status;
+};
+
+static int compareGroupKeys(const void *a, const void *b)
+{
+	const struct GroupKey *x = a;
+	const struct GroupKey *y = b;
+	int result = memcmp(x->name, y->name, x->length < y->length ? x->length : y->length);
+
+	if (result != 0)
+		return result;
+
+	return (x->length > y->length) - (x->length < y->length);
+}
+
+/**
+ * Returns the node with the smallest value in the subtree of `node`.
+ */
+static struct AvlNode *leftmost(struct AvlNode *node)
+{
+	if (node != NULL)
+	{
+		while (node->left != NULL)
+			node = node->left;
+	}
+
+	return node;
+}
+
+/**
+ * Returns the in-order successor of `node`, or `NULL` if `node` has the greatest value of the tree.
+ */
+static struct AvlNode *successor(struct AvlNode *node)
+{
+	if (node->right != NULL)
+		return leftmost(node->right);
+
+	while (node->parent != NULL && node == node->parent->right)
+		node = node->parent;
+
+	return node->parent;
+}
+
+/**
+ * Finds a field of a line.
+ *
+ * @return 1 if the line has the field `column` (starting at 1), 0 otherwise
+ */
+static int findField(const char *line, size_t length, char delimiter, size_t column, const char **field,
+	size_t *field_length)
+{
+	const char *end = line + length;
+
+	for (size_t c = 1; c < column; c++)
+	{
+		line = memchr(line, delimiter, (size_t)(end - line));
+		if (line == NULL)
+			return 0;
+
+		line++;
+	}
+
+	const char *field_end = memchr(line, delimiter, (size_t)(end - line));
+
+	*field = line;
+	*field_length = (size_t)((field_end != NULL ? field_end : end) - line);
+
+	return 1;
+}
+
+/**
+ * Counts `item` for the key `key` (`-g`).
+ */
+static void addToGroup(struct Worker *worker, const char *key, size_t key_length, uint64_t item)
+{
+	uint64_t key_hash = hashBytes(key, key_length, 0);
+	struct HyperLogLog sketch;
+
+	if (hllStoreGet(&worker->groups, key_hash, &sketch))
+	{
+		hllAdd(&sketch, &item);
+		return;
+	}
+
+	struct GroupKey *group = malloc(sizeof(struct GroupKey) + key_length);
+
+	if (group == NULL || hllStoreAdd(&worker->groups, key_hash, &item) != 0)
+	{
+		free(group);
+		worker->status = -1;
+		return;
+	}
+
+	group->hash = key_hash;
+	group->length = key_length;
+	memcpy(group->name, key, key_length);
+
+	if (!avlInsert(&worker->keys, group))
+		free(group);
+}
+
+/**
+ * Counts one line (without the line break).
+ */
+static void processLine(struct Worker *worker, const char *line, size_t length)
+{
+	const struct Options *options = worker->options;
+
+	if (length > 0 && line[length - 1] == '\r')
+		length--;
+
+	if (options->group_column != 0)
+	{
+		const char *key, *value = line;
+		size_t key_length, value_length = length;
+
+		if (!findField(line, length, options->delimiter, options->group_column, &key, &key_length))
+			return;
+
+		if (options->value_column != 0 &&
+			!findField(line, length, options->delimiter, options->value_column, &value, &value_length))
+			return;
+
+		addToGroup(worker, key, key_length, hashBytes(value, value_length, 0));
+	}
+	else if (options->whole_lines)
+	{
+		uint64_t item = hashBytes(line, length, 0);
+		hllAdd(&worker->sketches[0], &item);
+	}
+	else
+	{
+		const char *end = line + length;
+		size_t column = 1;
+
+		while (column <= MAX_COLUMNS)
+		{
+			const char *field_end = memchr(line, options->delimiter, (size_t)(end - line));
+
+			if (field_end == NULL)
+				field_end = end;
+
+			if (options->sketch_of_column[column] >= 0)
+			{
+				uint64_t item = hashBytes(line, (size_t)(field_end - line), 0);
+				hllAdd(&worker->sketches[options->sketch_of_column[column]], &item);
+			}
+
+			if (column > worker->n_columns_seen)
+				worker->n_columns_seen = column;
+
+			if (field_end == end)
+				break;
+
+			line = field_end + 1;
+			column++;
+		}
+	}
+}
+
+/**
+ * Counts all lines of the chunk of a worker.
+ */
+static void *processChunk(void *argument)
+{
+	struct Worker *worker = argument;
+	const char *line = worker->data;
+	const char *end = worker->data + worker->length;
+
+	while (line < end && worker->status == 0)
+	{
+		const char *line_end = memchr(line, '\n', (size_t)(end - line));
+
+		if (line_end == NULL)
+			line_end = end;
+
+		processLine(worker, line, (size_t)(line_end - line));
+		line = line_end + 1;
+	}
+
+	return NULL;
+}
+
+/**
+ * Runs the first `n` workers on their chunks and waits for them.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int runWorkers(struct Worker *workers, size_t n)
+{
+	size_t n_started = 0;
+	int status = 0;
+
+	// the last chunk is processed by this thread
+	while (n_started + 1 < n && pthread_create(&workers[n_started].thread, NULL, &processChunk,
+		&workers[n_started]) == 0)
+		n_started++;
+
+	for (size_t i = n_started; i < n; i++)
+		processChunk(&workers[i]);
+
+	for (size_t i = 0; i < n_started; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (workers[i].status != 0)
+			status = -1;
+	}
+
+	return status;
+}
+
+/**
+ * Splits memory-mapped data into one chunk per worker (at line breaks) and processes it.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int processMemory(struct Worker *workers, size_t n_workers, const char *data, size_t length)
+{
+	const char *begin = data;
+	const char *end = data + length;
+
+	for (size_t i = 0; i < n_workers; i++)
+	{
+		const char *chunk_end = i + 1 < n_workers ? data + (i + 1) * (length / n_workers) : end;
+
+		if (chunk_end < begin)
+			chunk_end = begin;
+
+		const char *line_break = chunk_end < end ? memchr(chunk_end, '\n', (size_t)(end - chunk_end)) : NULL;
+		chunk_end = line_break != NULL ? line_break + 1 : end;
+
+		workers[i].data = begin;
+		workers[i].length = (size_t)(chunk_end - begin);
+		begin = chunk_end;
+	}
+
+	return runWorkers(workers, n_workers);
+}
+
+/**
+ * Reads a file descriptor in chunks (one per worker, split at line breaks) and processes them. Lines longer than a
+ * chunk are split.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int processStream(struct Worker *workers, size_t n_workers, int fd, size_t *n_bytes)
+{
+	char *buffers = malloc(n_workers * STREAM_CHUNK_SIZE);
+	char *carry_buffer = malloc(STREAM_CHUNK_SIZE);
+	size_t carry = 0;
+	int eof = 0;
+	int status = buffers == NULL || carry_buffer == NULL ? -1 : 0;
+
+	while (status == 0 && !eof)
+	{
+		size_t n_used = 0;
+
+		while (status == 0 && !eof && n_used < n_workers)
+		{
+			char *buffer = buffers + n_used * STREAM_CHUNK_SIZE;
+			size_t filled = carry;
+
+			// the rest of the last line of the previous chunk
+			memcpy(buffer, carry_buffer, carry);
+
+			while (filled < STREAM_CHUNK_SIZE)
+			{
+				ssize_t n_read = read(fd, buffer + filled, STREAM_CHUNK_SIZE - filled);
+
+				if (n_read < 0 && errno == EINTR)
+					continue;
+
+				if (n_read < 0)
+					status = -1;
+
+				if (n_read <= 0)
+				{
+					eof = 1;
+					break;
+				}
+
+				filled += (size_t)n_read;
+			}
+
+			size_t length = filled;
+
+			if (!eof)
+			{
+				while (length > 0 && buffer[length - 1] != '\n')
+					length--;
+
+				if (length == 0)
+					length = filled;
+			}
+
+			carry = filled - length;
+			memcpy(carry_buffer, buffer + length, carry);
+
+			workers[n_used].data = buffer;
+			workers[n_used].length = length;
+			*n_bytes += length;
+			n_used++;
+		}
+
+		if (runWorkers(workers, n_used) != 0)
+			status = -1;
+	}
+
+	free(buffers);
+	free(carry_buffer);
+
+	return status;
+}
+
+/**
+ * Processes a file (or stdin, if `path` is "-").
+ *
+ * @return 0 on success, -1 on error
+ */
+static int processFile(struct Worker *workers, size_t n_workers, const char *path, size_t *n_bytes)
+{
+	if (strcmp(path, "-") == 0)
+		return processStream(workers, n_workers, STDIN_FILENO, n_bytes);
+
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+
+	if (fd < 0 || fstat(fd, &info) != 0)
+	{
+		perror(path);
+
+		if (fd >= 0)
+			close(fd);
+
+		return -1;
+	}
+
+	int status = 0;
+
+	if (S_ISREG(info.st_mode) && info.st_size > 0)
+	{
+		char *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data != MAP_FAILED)
+		{
+			posix_madvise(data, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+			status = processMemory(workers, n_workers, data, (size_t)info.st_size);
+			*n_bytes += (size_t)info.st_size;
+
+			munmap(data, (size_t)info.st_size);
+			close(fd);
+
+			return status;
+		}
+	}
+
+	// pipes, devices and files that can't be mapped
+	if (!S_ISREG(info.st_mode) || info.st_size > 0)
+		status = processStream(workers, n_workers, fd, n_bytes);
+
+	close(fd);
+
+	return status;
+}
+
+/**
+ * Parses a comma separated list of columns.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseColumns(struct Options *options, const char *list)
+{
+	while (*list != '\0')
+	{
+		char *end;
+		long column = strtol(list, &end, 10);
+
+		if (end == list || column < 1 || column > MAX_COLUMNS || (*end != ',' && *end != '\0'))
+			return -1;
+
+		if (options->sketch_of_column[column] < 0)
+			options->sketch_of_column[column] = (int)options->n_sketches++;
+
+		list = *end == ',' ? end + 1 : end;
+	}
+
+	return options->n_sketches > 0 ? 0 : -1;
+}
+
+/**
+ * Parses a decimal number in the range [`min`, `max`].
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseNumber(const char *text, unsigned long min, unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	// strtoul() accepts a sign and negates the value
+	if (*text < '0' || *text > '9')
+		return -1;
+
+	errno = 0;
+	*value = strtoul(text, &end, 10);
+
+	return errno == 0 && *end == '\0' && *value >= min && *value <= max ? 0 : -1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t <threads>] [-r <register size>] [-b <index bits>] [-d <delimiter>] "
+		"[-c <columns> | -a] [-g <key column>] [<file>...]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct Options options = {MEDIUM, 14, 0, '\t', {0}, 0, 0, 0, 0};
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int all_columns = 0;
+	int option;
+	unsigned long value;
+
+	options.n_threads = n_cpus > 0 ? (size_t)n_cpus : 1;
+
+	for (size_t c = 0; c <= MAX_COLUMNS; c++)
+		options.sketch_of_column[c] = -1;
+
+	while ((option = getopt(argc, argv, "t:r:b:d:c:ag:")) != -1)
+	{
+		switch (option)
+		{
+			case 't':
+				if (parseNumber(optarg, 1, MAX_THREADS, &value) != 0)
+					usage(argv[0]);
+				options.n_threads = (size_t)value;
+				break;
+			case 'r':
+				if (parseNumber(optarg, SMALL, LARGE, &value) != 0 ||
+					(value != SMALL && value != MEDIUM && value != LARGE))
+					usage(argv[0]);
+				options.r = (unsigned char)value;
+				break;
+			case 'b':
+				if (parseNumber(optarg, 4, sizeof(size_t) * CHAR_BIT - 1, &value) != 0)
+					usage(argv[0]);
+				options.b = (unsigned char)value;
+				break;
+			case 'd':
+				if (strlen(optarg) != 1)
+					usage(argv[0]);
+				options.delimiter = optarg[0];
+				break;
+			case 'c':
+				if (parseColumns(&options, optarg) != 0)
+					usage(argv[0]);
+				break;
+			case 'a':
+				all_columns = 1;
+				break;
+			case 'g':
+				if (parseNumber(optarg, 1, ULONG_MAX, &value) != 0)
+					usage(argv[0]);
+				options.group_column = (size_t)value;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (options.n_threads == 0 || options.n_threads > MAX_THREADS)
+		usage(argv[0]);
+
+	// -a can't be combined with -c or -g, and -g counts at most one column
+	if ((all_columns && (options.n_sketches > 0 || options.group_column != 0)) ||
+		(options.group_column != 0 && options.n_sketches > 1))
+		usage(argv[0]);
+
+	if (all_columns)
+	{
+		for (size_t c = 1; c <= MAX_COLUMNS; c++)
+			options.sketch_of_column[c] = (int)options.n_sketches++;
+	}
+
+	for (size_t c = 1; c <= MAX_COLUMNS; c++)
+	{
+		if (options.group_column != 0 && options.sketch_of_column[c] >= 0)
+			options.value_column = c;
+	}
+
+	if (options.n_sketches == 0)
+	{
+		options.whole_lines = 1;
+		options.n_sketches = 1;
+	}
+
+	struct HyperLogLog test;
+
+	if (hllInit(&test, options.r, options.b, &hashExpand) != 0)
+	{
+		fprintf(stderr, "%s: invalid register size or number of index bits\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	hllFree(&test);
+
+	struct Worker *workers = calloc(options.n_threads, sizeof(struct Worker));
+
+	if (workers == NULL)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < options.n_threads; i++)
+	{
+		workers[i].options = &options;
+
+		for (size_t s = 0; s < options.n_sketches; s++)
+		{
+			if (hllInit(&workers[i].sketches[s], options.r, options.b, &hashExpand) != 0)
+				return EXIT_FAILURE;
+		}
+
+		if (hllStoreInit(&workers[i].groups, options.r, options.b, &hashExpand) != 0)
+			return EXIT_FAILURE;
+
+		avlInit(&workers[i].keys, &compareGroupKeys);
+	}
+
+	struct timespec start, stop;
+	size_t n_bytes = 0;
+	int status = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (optind == argc)
+		status = processFile(workers, options.n_threads, "-", &n_bytes);
+
+	for (int i = optind; status == 0 && i < argc; i++)
+		status = processFile(workers, options.n_threads, argv[i], &n_bytes);
+
+	if (status != 0)
+	{
+		fprintf(stderr, "%s: failed to process the input\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// merge the sketches of all threads into the sketches of the first thread
+	for (size_t i = 1; i < options.n_threads; i++)
+	{
+		for (size_t s = 0; s < options.n_sketches; s++)
+			hllMerge(&workers[0].sketches[s], &workers[i].sketches[s]);
+
+		if (workers[i].n_columns_seen > workers[0].n_columns_seen)
+			workers[0].n_columns_seen = workers[i].n_columns_seen;
+	}
+
+	if (options.group_column != 0)
+	{
+		// the union of the keys of all threads, sorted by name
+		struct AvlTree keys;
+		struct HyperLogLog merged;
+
+		avlInit(&keys, &compareGroupKeys);
+		hllInit(&merged, options.r, options.b, &hashExpand);
+
+		for (size_t i = 0; i < options.n_threads; i++)
+		{
+			for (struct AvlNode *node = leftmost(workers[i].keys.root); node != NULL; node = successor(node))
+				avlInsert(&keys, node->value);
+		}
+
+		for (struct AvlNode *node = leftmost(keys.root); node != NULL; node = successor(node))
+		{
+			struct GroupKey *group = node->value;
+
+			hllClear(&merged);
+
+			for (size_t i = 0; i < options.n_threads; i++)
+				hllStoreMerge(&workers[i].groups, &group->hash, 1, &merged);
+
+			printf("%.*s\t%.0f\n", (int)group->length, group->name, hllCount(&merged));
+		}
+
+		hllFree(&merged);
+		avlFree(&keys);
+	}
+	else if (options.whole_lines)
+	{
+		printf("%.0f\n", hllCount(&workers[0].sketches[0]));
+	}
+	else
+	{
+		for (size_t c = 1; c <= MAX_COLUMNS; c++)
+		{
+			if (options.sketch_of_column[c] >= 0 && (!all_columns || c <= workers[0].n_columns_seen))
+				printf("%zu\t%.0f\n", c, hllCount(&workers[0].sketches[options.sketch_of_column[c]]));
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	double seconds = (double)(stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+	fprintf(stderr, "%zu bytes in %.3f s (%.2f GB/s, %zu threads)\n", n_bytes, seconds, n_bytes / seconds / 1e9,
+		options.n_threads);
+
+	for (size_t i = 0; i < options.n_threads; i++)
+	{
+		for (size_t s = 0; s < options.n_sketches; s++)
+			hllFree(&workers[i].sketches[s]);
+
+		for (struct AvlNode *node = leftmost(workers[i].keys.root); node != NULL; node = successor(node))
+			free(node->value);
+
+		hllStoreFree(&workers[i].groups);
+		avlFree(&workers[i].keys);
+	}
+
+	free(workers);
+
+	return EXIT_SUCCESS;
+}
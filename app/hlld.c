@@ -0,0 +1,608 @@
+/**
+ * @file hlld.c
+ *
+ * A sketch aggregation server, that collects HyperLogLog sketches of the processes of a host over a Unix domain
+ * socket, and answers count queries.
+ *
+ * usage: hlld [-s <socket>] [-r <register size>] [-b <index bits>] [-m <memory limit>]
+ *
+ *  * `-s` path of the socket (default: /tmp/hlld.sock), an existing file at this path is replaced
+ *  * `-r`, `-b` parameters of the sketches, see `hllInit()` (default: 6 and 14)
+ *  * `-m` memory limit of the sketches in bytes (optionally with the suffix k, M or G), least recently used sketches
+ *    are evicted above it, see `hllStoreLimit()` (default: no limit)
+ *
+ * The protocol and the client library are described in _inc/HllClient.h_. The server keeps one sketch per name in a
+ * `struct HyperLogLogStore`. Merged sets are folded on the fly, if they have a greater precision than the store.
+ *
+ * A single thread serves all connections with an epoll event loop. Whenever a connection is readable, everything that
+ * has arrived is read at once, all complete requests are applied, and their responses are sent with a single write. A
+ * connection is not read again, before all of its responses are sent, so a client that doesn't read its responses
+ * can't make the server buffer an unlimited amount of data.
+ *
+ * The server stops on SIGINT or SIGTERM, and prints some statistics to stderr.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../inc/Hash.h"
+#include "../inc/HllClient.h"
+#include "../inc/HyperLogLog.h"
+#include "../inc/HyperLogLogStore.h"
+
+/**
+ * The maximum number of events, that are handled per call of `epoll_wait()`.
+ */
+#define MAX_EVENTS 64
+
+/**
+ * The number of bytes, that are read at least per call of `read()`.
+ */
+#define READ_SIZE ((size_t)64 << 10)
+
+/**
+ * The number of item hashes, that are copied out of a request at once to add them to a sketch.
+ */
+#define ADD_BATCH 256
+
+/**
+ * A client connection.
+ */
+struct Connection
+{
+	int fd;
+
+	/**
+	 * Received bytes, that were not processed yet (at most one incomplete request).
+	 */
+	uint8_t *input;
+	size_t input_size;
+	size_t input_capacity;
+
+	/**
+	 * Responses, that were not sent yet.
+	 */
+	uint8_t *output;
+	size_t output_size;
+	size_t output_sent;
+	size_t output_capacity;
+
+	/**
+	 * Non-zero, if the connection waits for the socket to become writable (instead of waiting for input).
+	 */
+	int writing;
+};
+
+/**
+ * The state of the server.
+ */
+struct Server
+{
+	int epoll_fd;
+	int listen_fd;
+	struct HyperLogLogStore store;
+
+	size_t n_connections;
+	size_t n_requests;
+	size_t n_errors;
+	size_t n_evicted;
+};
+
+static volatile sig_atomic_t stop = 0;
+
+static void handleSignal(int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static void countEviction(uint64_t key, const struct HyperLogLog *sketch, void *context)
+{
+	(void)key;
+	(void)sketch;
+
+	((struct Server *)context)->n_evicted++;
+}
+
+/**
+ * Makes sure, that `buffer` can hold at least `size` bytes.
+ *
+ * @return 0 on success, -1 on malloc error
+ */
+static int reserve(uint8_t **buffer, size_t *capacity, size_t size)
+{
+	if (size <= *capacity)
+		return 0;
+
+	size_t new_capacity = *capacity > 0 ? *capacity : READ_SIZE;
+
+	while (new_capacity < size)
+		new_capacity *= 2;
+
+	uint8_t *new_buffer = realloc(*buffer, new_capacity);
+	if (new_buffer == NULL)
+		return -1;
+
+	*buffer = new_buffer;
+	*capacity = new_capacity;
+
+	return 0;
+}
+
+/**
+ * Applies a request to the store.
+ *
+ * @return a value of `enum HllResponseStatus`
+ */
+static int32_t handleRequest(struct Server *server, const struct HllRequestHeader *header, const uint8_t *name,
+	const uint8_t *body, size_t body_size, double *count)
+{
+	uint64_t key = hashBytes(name, header->name_length, 0);
+	struct HyperLogLog sketch;
+
+	switch (header->type)
+	{
+		case HLL_REQUEST_MERGE:
+		{
+			struct HyperLogLog set;
+
+			if (hllDeserialize(&set, body, body_size, &hashExpand) != 0)
+				return HLL_STATUS_BAD_REQUEST;
+
+			int32_t status = HLL_STATUS_OK;
+
+			if (set.r < server->store.r || set.b < server->store.b)
+				status = HLL_STATUS_INCOMPATIBLE;
+			else if (hllStoreOpen(&server->store, key, &sketch) != 0)
+				status = HLL_STATUS_NO_MEMORY;
+			else
+				hllMerge(&sketch, &set);
+
+			hllFree(&set);
+
+			return status;
+		}
+
+		case HLL_REQUEST_ADD:
+		{
+			if (body_size % sizeof(uint64_t) != 0)
+				return HLL_STATUS_BAD_REQUEST;
+
+			if (hllStoreOpen(&server->store, key, &sketch) != 0)
+				return HLL_STATUS_NO_MEMORY;
+
+			// the body is not aligned in the input buffer, and the items are already hashed (see `hllAddHash()`)
+			uint64_t items[ADD_BATCH];
+
+			for (size_t i = 0; i < body_size; i += sizeof(items))
+			{
+				size_t n_bytes = body_size - i < sizeof(items) ? body_size - i : sizeof(items);
+
+				memcpy(items, body + i, n_bytes);
+				hllAddHashes(&sketch, items, n_bytes / sizeof(uint64_t));
+			}
+
+			return HLL_STATUS_OK;
+		}
+
+		case HLL_REQUEST_COUNT:
+		{
+			if (body_size != 0)
+				return HLL_STATUS_BAD_REQUEST;
+
+			*count = hllStoreGet(&server->store, key, &sketch) ? hllCount(&sketch) : 0;
+
+			return HLL_STATUS_OK;
+		}
+
+		default:
+			return HLL_STATUS_BAD_REQUEST;
+	}
+}
+
+/**
+ * Processes all complete requests in the input buffer of a connection, and appends their responses to the output
+ * buffer.
+ *
+ * @return 0 on success, -1 if the connection has to be closed (malformed request or malloc error)
+ */
+static int processInput(struct Server *server, struct Connection *connection)
+{
+	size_t position = 0;
+	struct HllRequestHeader header;
+
+	while (connection->input_size - position >= sizeof(header))
+	{
+		memcpy(&header, connection->input + position, sizeof(header));
+
+		// the length can't be trusted, so it's checked before the buffer is grown for the request
+		if (header.length > HLL_MAX_REQUEST_SIZE || header.name_length > header.length)
+			return -1;
+
+		size_t request_size = sizeof(header) + header.length;
+
+		if (connection->input_size - position < request_size)
+		{
+			if (reserve(&connection->input, &connection->input_capacity, request_size + READ_SIZE) != 0)
+				return -1;
+
+			break;
+		}
+
+		const uint8_t *name = connection->input + position + sizeof(header);
+		struct HllResponse response = {HLL_STATUS_OK, 0, 0};
+
+		response.status = handleRequest(server, &header, name, name + header.name_length,
+			header.length - header.name_length, &response.count);
+
+		server->n_requests++;
+		server->n_errors += response.status != HLL_STATUS_OK;
+
+		if (reserve(&connection->output, &connection->output_capacity,
+			connection->output_size + sizeof(response)) != 0)
+			return -1;
+
+		memcpy(connection->output + connection->output_size, &response, sizeof(response));
+		connection->output_size += sizeof(response);
+		position += request_size;
+	}
+
+	// keep the incomplete request at the front of the buffer
+	memmove(connection->input, connection->input + position, connection->input_size - position);
+	connection->input_size -= position;
+
+	return 0;
+}
+
+/**
+ * Waits for input, if all responses were sent, and for the socket to become writable otherwise.
+ */
+static int watch(struct Server *server, struct Connection *connection, int op)
+{
+	struct epoll_event event;
+
+	connection->writing = connection->output_sent < connection->output_size;
+	event.events = connection->writing ? EPOLLOUT : EPOLLIN;
+	event.data.ptr = connection;
+
+	return epoll_ctl(server->epoll_fd, op, connection->fd, &event);
+}
+
+/**
+ * Sends as many pending responses as possible.
+ *
+ * @return 0 on success, -1 if the connection has to be closed
+ */
+static int flush(struct Server *server, struct Connection *connection)
+{
+	while (connection->output_sent < connection->output_size)
+	{
+		ssize_t sent = send(connection->fd, connection->output + connection->output_sent,
+			connection->output_size - connection->output_sent, MSG_NOSIGNAL);
+
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			return -1;
+		}
+
+		connection->output_sent += (size_t)sent;
+	}
+
+	int pending = connection->output_sent < connection->output_size;
+
+	if (!pending)
+	{
+		connection->output_size = 0;
+		connection->output_sent = 0;
+	}
+
+	if (pending != connection->writing)
+		return watch(server, connection, EPOLL_CTL_MOD);
+
+	return 0;
+}
+
+static void closeConnection(struct Server *server, struct Connection *connection)
+{
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+	close(connection->fd);
+	free(connection->input);
+	free(connection->output);
+	free(connection);
+
+	server->n_connections--;
+}
+
+/**
+ * Accepts all pending connections.
+ */
+static void acceptConnections(struct Server *server)
+{
+	while (1)
+	{
+		int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+		if (fd < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				perror("accept");
+
+			return;
+		}
+
+		struct Connection *connection = calloc(1, sizeof(struct Connection));
+
+		if (connection == NULL)
+		{
+			close(fd);
+			continue;
+		}
+
+		connection->fd = fd;
+
+		if (watch(server, connection, EPOLL_CTL_ADD) != 0)
+		{
+			close(fd);
+			free(connection);
+			continue;
+		}
+
+		server->n_connections++;
+	}
+}
+
+/**
+ * Handles an event of a client connection.
+ *
+ * @return 0 on success, -1 if the connection has to be closed
+ */
+static int handleConnection(struct Server *server, struct Connection *connection, uint32_t events)
+{
+	if (events & EPOLLOUT)
+		return flush(server, connection);
+
+	if (reserve(&connection->input, &connection->input_capacity, connection->input_size + READ_SIZE) != 0)
+		return -1;
+
+	ssize_t received = read(connection->fd, connection->input + connection->input_size,
+		connection->input_capacity - connection->input_size);
+
+	if (received < 0)
+		return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+	// the client closed the connection
+	if (received == 0)
+		return -1;
+
+	connection->input_size += (size_t)received;
+
+	if (processInput(server, connection) != 0)
+		return -1;
+
+	return flush(server, connection);
+}
+
+/**
+ * Creates the listening socket.
+ *
+ * @return 0 on success, -1 on error (`errno` is set)
+ */
+static int listenOn(struct Server *server, const char *path)
+{
+	struct sockaddr_un address;
+
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (server->listen_fd < 0)
+		return -1;
+
+	unlink(path);
+
+	if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+		return -1;
+
+	if (listen(server->listen_fd, SOMAXCONN) != 0)
+		return -1;
+
+	struct epoll_event event;
+
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event);
+}
+
+/**
+ * Parses a decimal size with an optional suffix k, M or G.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseSize(const char *text, size_t *size)
+{
+	char *end;
+	unsigned shift;
+
+	// strtoull() accepts a sign and negates the value
+	if (*text < '0' || *text > '9')
+		return -1;
+
+	errno = 0;
+	unsigned long long value = strtoull(text, &end, 10);
+
+	if (errno != 0)
+		return -1;
+
+	switch (*end)
+	{
+		case '\0': shift = 0; break;
+		case 'k': shift = 10; break;
+		case 'M': shift = 20; break;
+		case 'G': shift = 30; break;
+		default: return -1;
+	}
+
+	if ((shift != 0 && end[1] != '\0') || value > SIZE_MAX >> shift)
+		return -1;
+
+	*size = (size_t)value << shift;
+
+	return 0;
+}
+
+/**
+ * Parses a decimal number in the range [`min`, `max`].
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseNumber(const char *text, unsigned long min, unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	// strtoul() accepts a sign and negates the value
+	if (*text < '0' || *text > '9')
+		return -1;
+
+	errno = 0;
+	*value = strtoul(text, &end, 10);
+
+	return errno == 0 && *end == '\0' && *value >= min && *value <= max ? 0 : -1;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-s <socket>] [-r <register size>] [-b <index bits>] [-m <memory limit>]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = "/tmp/hlld.sock";
+	unsigned char r = MEDIUM;
+	unsigned char b = 14;
+	size_t max_bytes = 0;
+	int option;
+	unsigned long value;
+
+	while ((option = getopt(argc, argv, "s:r:b:m:")) != -1)
+	{
+		switch (option)
+		{
+			case 's':
+				path = optarg;
+				break;
+			case 'r':
+				if (parseNumber(optarg, SMALL, LARGE, &value) != 0 ||
+					(value != SMALL && value != MEDIUM && value != LARGE))
+					usage(argv[0]);
+				r = (unsigned char)value;
+				break;
+			case 'b':
+				if (parseNumber(optarg, 4, sizeof(size_t) * CHAR_BIT - 1, &value) != 0)
+					usage(argv[0]);
+				b = (unsigned char)value;
+				break;
+			case 'm':
+				if (parseSize(optarg, &max_bytes) != 0)
+					usage(argv[0]);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (optind != argc)
+		usage(argv[0]);
+
+	struct Server server;
+
+	memset(&server, 0, sizeof(server));
+
+	if (hllStoreInit(&server.store, r, b, &hashExpand) != 0)
+	{
+		fprintf(stderr, "%s: invalid register size or number of index bits\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (max_bytes > 0)
+		hllStoreLimit(&server.store, max_bytes, &countEviction, &server);
+
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &handleSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (server.epoll_fd < 0 || listenOn(&server, path) != 0)
+	{
+		fprintf(stderr, "%s: %s: %s\n", argv[0], path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "listening on %s (r = %d, b = %d)\n", path, r, b);
+
+	struct epoll_event events[MAX_EVENTS];
+
+	while (!stop)
+	{
+		int n_events = epoll_wait(server.epoll_fd, events, MAX_EVENTS, -1);
+
+		if (n_events < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			perror("epoll_wait");
+			break;
+		}
+
+		for (int i = 0; i < n_events; i++)
+		{
+			struct Connection *connection = events[i].data.ptr;
+
+			if (connection == NULL)
+				acceptConnections(&server);
+			else if (handleConnection(&server, connection, events[i].events) != 0)
+				closeConnection(&server, connection);
+		}
+	}
+
+	fprintf(stderr, "%zu requests (%zu failed), %zu sketches (%zu evicted), %zu bytes, %zu open connections\n",
+		server.n_requests, server.n_errors, server.store.count, server.n_evicted, hllStoreMemory(&server.store),
+		server.n_connections);
+
+	close(server.listen_fd);
+	close(server.epoll_fd);
+	unlink(path);
+	hllStoreFree(&server.store);
+
+	return EXIT_SUCCESS;
+}
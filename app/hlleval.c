@@ -0,0 +1,621 @@
+/**
+ * @file hlleval.c
+ *
+ * A command line tool, that evaluates the accuracy, memory usage and speed of HyperLogLog sketches for several
+ * register sizes, numbers of index bits and hash functions, to choose the parameters of a sketch for an application.
+ *
+ * usage: hlleval [-t <threads>] [-r <register sizes>] [-b <min>[-<max>]] [-n <max cardinality>] [-k <trials>]
+ *                [-h <hash functions>]
+ *
+ *  * `-t` number of worker threads (default: number of CPUs)
+ *  * `-r` comma separated list of register sizes (default: 4,6,8)
+ *  * `-b` range of index bits (default: 4-18)
+ *  * `-n` greatest cardinality, the estimates are evaluated at every power of 10 up to it (default: 1e7, up to 1e9 is
+ *    reasonable)
+ *  * `-k` number of trials per hash function (default: 16, at most 2^24)
+ *  * `-h` comma separated list of hash functions: splitmix, murmur, fibonacci (default: all)
+ *
+ * Every trial adds a stream of distinct synthetic items (64-bit integers) to one LARGE sketch with the greatest number
+ * of index bits. At every checkpoint, this sketch is merged into empty sketches of all evaluated parameters. Since all
+ * hash functions are prefix-consistent, this gives the same registers as adding the items to those sketches directly
+ * (see `hllFold()`), but every item is only hashed once. The trials run in parallel.
+ *
+ * Afterwards, the time per `hllAdd()` and `hllCount()` is measured for every hash function and parameters. It's
+ * measured as CPU time of the worker thread, but other threads still share the caches, so use `-t 1` for exact
+ * timings.
+ *
+ * The results are written to stdout as a table with one row per hash function, parameters and cardinality:
+ *
+ *  * `bytes` the size of a sketch including `struct HyperLogLog`
+ *  * `bias` the mean relative error of the estimates
+ *  * `rmse` the root mean square relative error of the estimates
+ *  * `expected` the expected standard error \f$\frac{1.04}{\sqrt{2^b}}\f$
+ *  * `ns/add`, `ns/count` the time per `hllAdd()` and `hllCount()`
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLog.h"
+
+/**
+ * The maximum number of worker threads.
+ */
+#define MAX_THREADS 256
+
+/**
+ * The number of items that are added to measure the time per `hllAdd()`.
+ */
+#define TIMING_ADDS ((size_t)1 << 20)
+
+/**
+ * The trials of a hash function use the items `[trial << TRIAL_SHIFT, (trial << TRIAL_SHIFT) + n)`.
+ */
+#define TRIAL_SHIFT 40
+
+/**
+ * The greatest number of trials per hash function, so the items of all trials are distinct 64-bit integers.
+ */
+#define MAX_TRIALS ((size_t)1 << (64 - TRIAL_SHIFT))
+
+/**
+ * Hashes the item with MurmurHash64A, with a different seed for every 8 bytes.
+ */
+static void murmurHash(const void *item, size_t h, void *buffer)
+{
+	char *bytes = buffer;
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t word = hashBytes(item, sizeof(uint64_t), i);
+		memcpy(bytes + i, &word, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+/**
+ * Multiplies the item with the golden ratio (Fibonacci hashing). This is a weak hash: the lower bits of the hash only
+ * depend on the lower bits of the item, so it shows how sketches behave with a poor hash function.
+ */
+static void fibonacciHash(const void *item, size_t h, void *buffer)
+{
+	char *bytes = buffer;
+	uint64_t x;
+
+	memcpy(&x, item, sizeof(x));
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t word = (x + i) * 0x9E3779B97F4A7C15;
+		memcpy(bytes + i, &word, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+/**
+ * A hash function that can be evaluated.
+ */
+struct HashFunction
+{
+	const char *name;
+	void (*hash)(const void *item, size_t h, void *buffer);
+};
+
+static const struct HashFunction HASH_FUNCTIONS[] =
+{
+	{"splitmix", &hashExpand},
+	{"murmur", &murmurHash},
+	{"fibonacci", &fibonacciHash}
+};
+
+#define N_HASH_FUNCTIONS (sizeof(HASH_FUNCTIONS) / sizeof(HASH_FUNCTIONS[0]))
+
+/**
+ * The command line options.
+ */
+struct Options
+{
+	unsigned char r[3];
+	size_t n_r;
+	unsigned char b_min;
+	unsigned char b_max;
+	double n_max;
+	size_t n_trials;
+	size_t n_threads;
+
+	/**
+	 * The indices of the evaluated hash functions in `HASH_FUNCTIONS`.
+	 */
+	size_t hashes[N_HASH_FUNCTIONS];
+	size_t n_hashes;
+};
+
+/**
+ * The state of an evaluation, that is shared by all threads.
+ */
+struct Evaluation
+{
+	const struct Options *options;
+
+	/**
+	 * The parameters of the evaluated sketches, `n_configs` of them.
+	 */
+	unsigned char *config_r;
+	unsigned char *config_b;
+	size_t n_configs;
+
+	/**
+	 * The cardinalities, at which the estimates are evaluated.
+	 */
+	double *checkpoints;
+	size_t n_checkpoints;
+
+	/**
+	 * `errors[((hash * n_trials + trial) * n_configs + config) * n_checkpoints + checkpoint]` is the relative error of
+	 * one estimate.
+	 */
+	double *errors;
+
+	/**
+	 * `ns_add[hash * n_configs + config]` and `ns_count[...]` are the measured times.
+	 */
+	double *ns_add;
+	double *ns_count;
+
+	/**
+	 * The next job, that is not taken by a thread yet, and the function that runs a job.
+	 */
+	pthread_mutex_t lock;
+	size_t next_job;
+	size_t n_jobs;
+	int (*run)(struct Evaluation *evaluation, size_t job);
+
+	/**
+	 * 0 on success, -1 on malloc error.
+	 */
+	int status;
+};
+
+/**
+ * Returns the CPU time of the calling thread in nanoseconds.
+ */
+static double getThreadTime(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+
+	return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+/**
+ * Adds the items of one trial to a sketch, and evaluates the estimates of all parameters at every checkpoint.
+ *
+ * @param job `hash * n_trials + trial`
+ * @return 0 on success, -1 on malloc error
+ */
+static int evaluateAccuracy(struct Evaluation *evaluation, size_t job)
+{
+	const struct Options *options = evaluation->options;
+	void (*hash)(const void *, size_t, void *) = HASH_FUNCTIONS[options->hashes[job / options->n_trials]].hash;
+	uint64_t first_item = (uint64_t)(job % options->n_trials) << TRIAL_SHIFT;
+	double *errors = evaluation->errors + job * evaluation->n_configs * evaluation->n_checkpoints;
+
+	struct HyperLogLog source, sketch;
+
+	if (hllInit(&source, LARGE, options->b_max, hash) != 0)
+		return -1;
+
+	uint64_t n = 0;
+
+	for (size_t i = 0; i < evaluation->n_checkpoints; i++)
+	{
+		double checkpoint = evaluation->checkpoints[i];
+
+		for (; n < (uint64_t)checkpoint; n++)
+		{
+			uint64_t item = first_item + n;
+			hllAdd(&source, &item);
+		}
+
+		for (size_t c = 0; c < evaluation->n_configs; c++)
+		{
+			if (hllInit(&sketch, evaluation->config_r[c], evaluation->config_b[c], hash) != 0)
+			{
+				hllFree(&source);
+				return -1;
+			}
+
+			hllMerge(&sketch, &source);
+			errors[c * evaluation->n_checkpoints + i] = (hllCount(&sketch) - checkpoint) / checkpoint;
+			hllFree(&sketch);
+		}
+	}
+
+	hllFree(&source);
+
+	return 0;
+}
+
+/**
+ * Measures the time per `hllAdd()` and `hllCount()` of one hash function and parameters.
+ *
+ * @param job `hash * n_configs + config`
+ * @return 0 on success, -1 on malloc error
+ */
+static int evaluateSpeed(struct Evaluation *evaluation, size_t job)
+{
+	const struct Options *options = evaluation->options;
+	void (*hash)(const void *, size_t, void *) = HASH_FUNCTIONS[options->hashes[job / evaluation->n_configs]].hash;
+	size_t config = job % evaluation->n_configs;
+	unsigned char b = evaluation->config_b[config];
+
+	struct HyperLogLog set;
+
+	if (hllInit(&set, evaluation->config_r[config], b, hash) != 0)
+		return -1;
+
+	double start = getThreadTime();
+
+	for (uint64_t i = 0; i < TIMING_ADDS; i++)
+		hllAdd(&set, &i);
+
+	evaluation->ns_add[job] = (getThreadTime() - start) / TIMING_ADDS;
+
+	// counting takes time proportional to the number of registers
+	size_t n_counts = ((size_t)1 << 22 >> b) + 16;
+	volatile double sum = 0;
+
+	start = getThreadTime();
+
+	for (size_t i = 0; i < n_counts; i++)
+		sum += hllCount(&set);
+
+	evaluation->ns_count[job] = (getThreadTime() - start) / (double)n_counts;
+
+	hllFree(&set);
+
+	return 0;
+}
+
+/**
+ * Runs jobs until there are none left.
+ */
+static void *runJobs(void *argument)
+{
+	struct Evaluation *evaluation = argument;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&evaluation->lock);
+		size_t job = evaluation->next_job++;
+		pthread_mutex_unlock(&evaluation->lock);
+
+		if (job >= evaluation->n_jobs)
+			break;
+
+		if (evaluation->run(evaluation, job) != 0)
+		{
+			pthread_mutex_lock(&evaluation->lock);
+			evaluation->status = -1;
+			pthread_mutex_unlock(&evaluation->lock);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Runs `n_jobs` jobs on the worker threads (including the calling thread).
+ *
+ * @return 0 on success, -1 on error
+ */
+static int runParallel(struct Evaluation *evaluation, size_t n_jobs,
+	int (*run)(struct Evaluation *evaluation, size_t job))
+{
+	size_t n_threads = evaluation->options->n_threads < n_jobs ? evaluation->options->n_threads : n_jobs;
+	pthread_t threads[MAX_THREADS];
+	size_t n_started = 0;
+
+	evaluation->next_job = 0;
+	evaluation->n_jobs = n_jobs;
+	evaluation->run = run;
+
+	while (n_started + 1 < n_threads && pthread_create(&threads[n_started], NULL, &runJobs, evaluation) == 0)
+		n_started++;
+
+	runJobs(evaluation);
+
+	for (size_t i = 0; i < n_started; i++)
+		pthread_join(threads[i], NULL);
+
+	return evaluation->status;
+}
+
+/**
+ * Writes the table of results to stdout.
+ */
+static void printResults(const struct Evaluation *evaluation)
+{
+	const struct Options *options = evaluation->options;
+
+	printf("%-10s %2s %3s %12s %9s %10s %10s %10s %9s %9s\n", "hash", "r", "b", "n", "bytes", "bias", "rmse",
+		"expected", "ns/add", "ns/count");
+
+	for (size_t h = 0; h < options->n_hashes; h++)
+	{
+		for (size_t c = 0; c < evaluation->n_configs; c++)
+		{
+			unsigned char r = evaluation->config_r[c];
+			unsigned char b = evaluation->config_b[c];
+
+			for (size_t i = 0; i < evaluation->n_checkpoints; i++)
+			{
+				double sum = 0;
+				double square_sum = 0;
+
+				for (size_t t = 0; t < options->n_trials; t++)
+				{
+					double error = evaluation->errors[((h * options->n_trials + t) * evaluation->n_configs + c) *
+						evaluation->n_checkpoints + i];
+
+					sum += error;
+					square_sum += error * error;
+				}
+
+				printf("%-10s %2u %3u %12.0f %9zu %+10.4f %10.4f %10.4f %9.1f %9.1f\n",
+					HASH_FUNCTIONS[options->hashes[h]].name, r, b, evaluation->checkpoints[i],
+					hllDataSize(r, b) + sizeof(struct HyperLogLog), sum / options->n_trials,
+					sqrt(square_sum / options->n_trials), 1.04 / sqrt((double)((size_t)1 << b)),
+					evaluation->ns_add[h * evaluation->n_configs + c], evaluation->ns_count[h * evaluation->n_configs + c]);
+			}
+		}
+	}
+}
+
+/**
+ * Parses a comma separated list of register sizes.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseRegisterSizes(struct Options *options, const char *list)
+{
+	options->n_r = 0;
+
+	while (*list != '\0')
+	{
+		char *end;
+		long r = strtol(list, &end, 10);
+
+		if (end == list || (r != SMALL && r != MEDIUM && r != LARGE) || (*end != ',' && *end != '\0') ||
+			options->n_r == sizeof(options->r))
+			return -1;
+
+		options->r[options->n_r++] = (unsigned char)r;
+		list = *end == ',' ? end + 1 : end;
+	}
+
+	return options->n_r > 0 ? 0 : -1;
+}
+
+/**
+ * Parses a range of index bits (e.g. "4-18" or "11").
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseIndexBits(struct Options *options, const char *range)
+{
+	char *end;
+	long b_min = strtol(range, &end, 10);
+	long b_max = b_min;
+
+	if (*end == '-')
+		b_max = strtol(end + 1, &end, 10);
+
+	if (*end != '\0' || b_min < 4 || b_max < b_min || b_max > 30)
+		return -1;
+
+	options->b_min = (unsigned char)b_min;
+	options->b_max = (unsigned char)b_max;
+
+	return 0;
+}
+
+/**
+ * Parses a comma separated list of hash function names.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseHashFunctions(struct Options *options, const char *list)
+{
+	options->n_hashes = 0;
+
+	while (*list != '\0')
+	{
+		size_t length = strcspn(list, ",");
+		size_t i = 0;
+
+		while (i < N_HASH_FUNCTIONS && (strlen(HASH_FUNCTIONS[i].name) != length ||
+			strncmp(HASH_FUNCTIONS[i].name, list, length) != 0))
+			i++;
+
+		if (i == N_HASH_FUNCTIONS || options->n_hashes == N_HASH_FUNCTIONS)
+			return -1;
+
+		options->hashes[options->n_hashes++] = i;
+		list += list[length] == ',' ? length + 1 : length;
+	}
+
+	return options->n_hashes > 0 ? 0 : -1;
+}
+
+/**
+ * Parses a decimal number in the range [`min`, `max`].
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseNumber(const char *text, unsigned long min, unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	// strtoul() accepts a sign and negates the value
+	if (*text < '0' || *text > '9')
+		return -1;
+
+	errno = 0;
+	*value = strtoul(text, &end, 10);
+
+	return errno == 0 && *end == '\0' && *value >= min && *value <= max ? 0 : -1;
+}
+
+/**
+ * Parses the greatest cardinality (e.g. "1e7"), which has to be at least 1 and less than `2^TRIAL_SHIFT`, so the
+ * trials don't overlap.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int parseCardinality(struct Options *options, const char *text)
+{
+	char *end;
+
+	errno = 0;
+	double n_max = strtod(text, &end);
+
+	if (end == text || *end != '\0' || errno != 0 || !(n_max >= 1 && n_max < (double)((uint64_t)1 << TRIAL_SHIFT)))
+		return -1;
+
+	options->n_max = n_max;
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t <threads>] [-r <register sizes>] [-b <min>[-<max>]] [-n <max cardinality>] "
+		"[-k <trials>] [-h <hash functions>]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct Options options = {{SMALL, MEDIUM, LARGE}, 3, 4, 18, 1e7, 16, 0, {0, 1, 2}, N_HASH_FUNCTIONS};
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int option;
+	unsigned long value;
+
+	options.n_threads = n_cpus > 0 ? (size_t)n_cpus : 1;
+
+	while ((option = getopt(argc, argv, "t:r:b:n:k:h:")) != -1)
+	{
+		switch (option)
+		{
+			case 't':
+				if (parseNumber(optarg, 1, MAX_THREADS, &value) != 0)
+					usage(argv[0]);
+				options.n_threads = (size_t)value;
+				break;
+			case 'r':
+				if (parseRegisterSizes(&options, optarg) != 0)
+					usage(argv[0]);
+				break;
+			case 'b':
+				if (parseIndexBits(&options, optarg) != 0)
+					usage(argv[0]);
+				break;
+			case 'n':
+				if (parseCardinality(&options, optarg) != 0)
+					usage(argv[0]);
+				break;
+			case 'k':
+				if (parseNumber(optarg, 1, MAX_TRIALS, &value) != 0)
+					usage(argv[0]);
+				options.n_trials = (size_t)value;
+				break;
+			case 'h':
+				if (parseHashFunctions(&options, optarg) != 0)
+					usage(argv[0]);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	// the default number of threads may exceed the limit
+	if (optind != argc || options.n_threads > MAX_THREADS)
+		usage(argv[0]);
+
+	struct Evaluation evaluation = {&options, NULL, NULL, 0, NULL, 0, NULL, NULL, NULL, PTHREAD_MUTEX_INITIALIZER,
+		0, 0, NULL, 0};
+
+	// all combinations of the parameters, and the powers of 10 up to the greatest cardinality
+	evaluation.n_configs = options.n_r * (size_t)(options.b_max - options.b_min + 1);
+
+	while (evaluation.n_checkpoints < 20 && pow(10, (double)evaluation.n_checkpoints + 1) <= options.n_max)
+		evaluation.n_checkpoints++;
+
+	if (evaluation.n_checkpoints == 0 || pow(10, (double)evaluation.n_checkpoints) < options.n_max)
+		evaluation.n_checkpoints++;
+
+	size_t n_accuracy_jobs = options.n_hashes * options.n_trials;
+	size_t n_speed_jobs = options.n_hashes * evaluation.n_configs;
+
+	evaluation.config_r = malloc(evaluation.n_configs * sizeof(unsigned char));
+	evaluation.config_b = malloc(evaluation.n_configs * sizeof(unsigned char));
+	evaluation.checkpoints = malloc(evaluation.n_checkpoints * sizeof(double));
+	evaluation.errors = malloc(n_accuracy_jobs * evaluation.n_configs * evaluation.n_checkpoints * sizeof(double));
+	evaluation.ns_add = malloc(n_speed_jobs * sizeof(double));
+	evaluation.ns_count = malloc(n_speed_jobs * sizeof(double));
+
+	if (evaluation.config_r == NULL || evaluation.config_b == NULL || evaluation.checkpoints == NULL ||
+		evaluation.errors == NULL || evaluation.ns_add == NULL || evaluation.ns_count == NULL)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < options.n_r; i++)
+	{
+		for (unsigned char b = options.b_min; b <= options.b_max; b++)
+		{
+			size_t c = i * (size_t)(options.b_max - options.b_min + 1) + (b - options.b_min);
+
+			evaluation.config_r[c] = options.r[i];
+			evaluation.config_b[c] = b;
+		}
+	}
+
+	for (size_t i = 0; i < evaluation.n_checkpoints; i++)
+		evaluation.checkpoints[i] = fmin(pow(10, (double)i + 1), floor(options.n_max));
+
+	struct timespec start, stop;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (runParallel(&evaluation, n_accuracy_jobs, &evaluateAccuracy) != 0 ||
+		runParallel(&evaluation, n_speed_jobs, &evaluateSpeed) != 0)
+	{
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	printResults(&evaluation);
+
+	double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+	double n_items = (double)n_accuracy_jobs * evaluation.checkpoints[evaluation.n_checkpoints - 1];
+
+	fprintf(stderr, "%.0f items in %.2f s (%zu threads)\n", n_items, seconds, options.n_threads);
+
+	free(evaluation.config_r);
+	free(evaluation.config_b);
+	free(evaluation.checkpoints);
+	free(evaluation.errors);
+	free(evaluation.ns_add);
+	free(evaluation.ns_count);
+
+	return EXIT_SUCCESS;
+}
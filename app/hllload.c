@@ -0,0 +1,353 @@
+/**
+ * @file hllload.c
+ *
+ * A load test client for the sketch aggregation server _hlld_, that measures its throughput (requests per second) and
+ * latency percentiles.
+ *
+ * usage: hllload [-s <socket>] [-c <connections>] [-d <seconds>] [-k <names>] [-n <batch size>] [-r <register size>]
+ *                [-b <index bits>] [-w add|merge|count|mixed]
+ *
+ *  * `-s` path of the socket of the server (default: /tmp/hlld.sock)
+ *  * `-c` number of connections, each one is used by its own thread (default: 4)
+ *  * `-d` duration of the test in seconds (default: 5)
+ *  * `-k` number of distinct sketch names, that are used (default: 1000)
+ *  * `-n` number of items per add request (default: 100)
+ *  * `-r`, `-b` parameters of the merged sets (default: 6 and 14, they must not be less than the ones of the server)
+ *  * `-w` the workload: only add, merge or count requests, or a mix of 80% add, 10% merge and 10% count requests
+ *    (default: mixed)
+ *
+ * Every thread sends one request at a time (closed loop) and measures the time until the response arrived.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../inc/Hash.h"
+#include "../inc/HllClient.h"
+#include "../inc/HyperLogLog.h"
+
+/**
+ * The maximum number of connections.
+ */
+#define MAX_CONNECTIONS 1024
+
+enum Workload
+{
+	WORKLOAD_ADD,
+	WORKLOAD_MERGE,
+	WORKLOAD_COUNT,
+	WORKLOAD_MIXED
+};
+
+/**
+ * The command line options.
+ */
+struct Options
+{
+	const char *path;
+	size_t n_connections;
+	double seconds;
+	size_t n_names;
+	size_t batch_size;
+	unsigned char r;
+	unsigned char b;
+	enum Workload workload;
+};
+
+/**
+ * The state of a load thread.
+ */
+struct Loader
+{
+	pthread_t thread;
+	const struct Options *options;
+	uint64_t seed;
+
+	/**
+	 * The latencies of all requests in nanoseconds.
+	 */
+	uint64_t *latencies;
+	size_t n_requests;
+	size_t capacity;
+
+	size_t n_errors;
+
+	/**
+	 * 0 on success, -1 if the connection failed.
+	 */
+	int status;
+};
+
+static inline uint64_t splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t now(void)
+{
+	struct timespec time;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+/**
+ * Sends requests to the server until the test is over.
+ */
+static void *load(void *argument)
+{
+	struct Loader *loader = argument;
+	const struct Options *options = loader->options;
+	struct HllClient client;
+	struct HyperLogLog set;
+	uint64_t *hashes = malloc(options->batch_size * sizeof(uint64_t));
+
+	if (hashes == NULL || hllInit(&set, options->r, options->b, &hashExpand) != 0)
+	{
+		loader->status = -1;
+		return NULL;
+	}
+
+	if (hllClientConnect(&client, options->path) != 0)
+	{
+		perror(options->path);
+		loader->status = -1;
+		hllFree(&set);
+		free(hashes);
+		return NULL;
+	}
+
+	uint64_t end = now() + (uint64_t)(options->seconds * 1e9);
+	uint64_t state = loader->seed;
+	uint64_t start;
+
+	do
+	{
+		char name[32];
+		enum Workload workload = options->workload;
+
+		snprintf(name, sizeof(name), "name%zu", (size_t)(splitmix64(&state) % options->n_names));
+
+		if (workload == WORKLOAD_MIXED)
+		{
+			uint64_t dice = splitmix64(&state) % 10;
+
+			workload = dice < 8 ? WORKLOAD_ADD : dice < 9 ? WORKLOAD_MERGE : WORKLOAD_COUNT;
+		}
+
+		// the items are prepared outside of the measured region
+		if (workload == WORKLOAD_ADD)
+		{
+			for (size_t i = 0; i < options->batch_size; i++)
+				hashes[i] = splitmix64(&state);
+		}
+		else if (workload == WORKLOAD_MERGE)
+		{
+			for (size_t i = 0; i < options->batch_size; i++)
+			{
+				uint64_t item = splitmix64(&state);
+				hllAdd(&set, &item);
+			}
+		}
+
+		double count;
+		int status;
+
+		start = now();
+
+		switch (workload)
+		{
+			case WORKLOAD_ADD:
+				status = hllClientAdd(&client, name, hashes, options->batch_size);
+				break;
+			case WORKLOAD_MERGE:
+				status = hllClientMerge(&client, name, &set);
+				break;
+			default:
+				status = hllClientCount(&client, name, &count);
+				break;
+		}
+
+		uint64_t stop = now();
+
+		if (status == -1)
+		{
+			perror("request");
+			loader->status = -1;
+			break;
+		}
+
+		loader->n_errors += status != 0;
+
+		if (loader->n_requests == loader->capacity)
+		{
+			size_t capacity = loader->capacity > 0 ? 2 * loader->capacity : 4096;
+			uint64_t *latencies = realloc(loader->latencies, capacity * sizeof(uint64_t));
+
+			if (latencies == NULL)
+			{
+				loader->status = -1;
+				break;
+			}
+
+			loader->latencies = latencies;
+			loader->capacity = capacity;
+		}
+
+		loader->latencies[loader->n_requests++] = stop - start;
+		start = stop;
+	}
+	while (start < end);
+
+	hllClientClose(&client);
+	hllFree(&set);
+	free(hashes);
+
+	return NULL;
+}
+
+static int compareLatencies(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Returns the latency percentile `p` (between 0 and 1) of sorted latencies in microseconds.
+ */
+static double percentile(const uint64_t *latencies, size_t n, double p)
+{
+	if (n == 0)
+		return 0;
+
+	size_t index = (size_t)(p * (double)(n - 1) + 0.5);
+
+	return (double)latencies[index] / 1e3;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-s <socket>] [-c <connections>] [-d <seconds>] [-k <names>] [-n <batch size>] "
+		"[-r <register size>] [-b <index bits>] [-w add|merge|count|mixed]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct Options options = {"/tmp/hlld.sock", 4, 5, 1000, 100, MEDIUM, 14, WORKLOAD_MIXED};
+	int option;
+
+	while ((option = getopt(argc, argv, "s:c:d:k:n:r:b:w:")) != -1)
+	{
+		switch (option)
+		{
+			case 's':
+				options.path = optarg;
+				break;
+			case 'c':
+				options.n_connections = (size_t)strtoul(optarg, NULL, 10);
+				break;
+			case 'd':
+				options.seconds = atof(optarg);
+				break;
+			case 'k':
+				options.n_names = (size_t)strtoul(optarg, NULL, 10);
+				break;
+			case 'n':
+				options.batch_size = (size_t)strtoul(optarg, NULL, 10);
+				break;
+			case 'r':
+				options.r = (unsigned char)atoi(optarg);
+				break;
+			case 'b':
+				options.b = (unsigned char)atoi(optarg);
+				break;
+			case 'w':
+				if (strcmp(optarg, "add") == 0)
+					options.workload = WORKLOAD_ADD;
+				else if (strcmp(optarg, "merge") == 0)
+					options.workload = WORKLOAD_MERGE;
+				else if (strcmp(optarg, "count") == 0)
+					options.workload = WORKLOAD_COUNT;
+				else if (strcmp(optarg, "mixed") == 0)
+					options.workload = WORKLOAD_MIXED;
+				else
+					usage(argv[0]);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (optind != argc || options.n_connections == 0 || options.n_connections > MAX_CONNECTIONS ||
+		options.n_names == 0 || options.batch_size == 0 || !(options.seconds > 0))
+		usage(argv[0]);
+
+	struct Loader *loaders = calloc(options.n_connections, sizeof(struct Loader));
+
+	if (loaders == NULL)
+		return EXIT_FAILURE;
+
+	uint64_t start = now();
+
+	for (size_t i = 0; i < options.n_connections; i++)
+	{
+		loaders[i].options = &options;
+		loaders[i].seed = i + 1;
+
+		if (pthread_create(&loaders[i].thread, NULL, &load, &loaders[i]) != 0)
+			return EXIT_FAILURE;
+	}
+
+	size_t n_requests = 0;
+	size_t n_errors = 0;
+	int status = 0;
+
+	for (size_t i = 0; i < options.n_connections; i++)
+	{
+		pthread_join(loaders[i].thread, NULL);
+
+		n_requests += loaders[i].n_requests;
+		n_errors += loaders[i].n_errors;
+		status |= loaders[i].status;
+	}
+
+	double seconds = (double)(now() - start) / 1e9;
+	uint64_t *latencies = malloc((n_requests > 0 ? n_requests : 1) * sizeof(uint64_t));
+
+	if (latencies == NULL)
+		return EXIT_FAILURE;
+
+	n_requests = 0;
+
+	for (size_t i = 0; i < options.n_connections; i++)
+	{
+		memcpy(latencies + n_requests, loaders[i].latencies, loaders[i].n_requests * sizeof(uint64_t));
+		n_requests += loaders[i].n_requests;
+		free(loaders[i].latencies);
+	}
+
+	qsort(latencies, n_requests, sizeof(uint64_t), &compareLatencies);
+
+	printf("requests\terrors\treq/s\tp50 [us]\tp99 [us]\tp99.9 [us]\tmax [us]\n");
+	printf("%zu\t%zu\t%.0f\t%.1f\t%.1f\t%.1f\t%.1f\n", n_requests, n_errors, n_requests / seconds,
+		percentile(latencies, n_requests, 0.5), percentile(latencies, n_requests, 0.99),
+		percentile(latencies, n_requests, 0.999), percentile(latencies, n_requests, 1));
+
+	free(latencies);
+	free(loaders);
+
+	return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,115 @@
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "../inc/AvlSet.hpp"
+
+/**
+ * The approximate node size of `std::set`/`std::map` (libstdc++: color, parent, left, right, value).
+ */
+template <typename Value>
+static size_t stdNodeSize()
+{
+	return 4 * sizeof(void *) + sizeof(Value);
+}
+
+template <typename Value>
+static const uint64_t &keyOf(const Value &value)
+{
+	return value;
+}
+
+template <typename Key, typename T>
+static const uint64_t &keyOf(const std::pair<const Key, T> &value)
+{
+	return value.first;
+}
+
+/**
+ * Benchmarks inserting random keys, looking them up and iterating over a container with the interface of `std::set`
+ * or `std::map`.
+ *
+ * @param make Returns the item for a key.
+ */
+template <typename Container, typename Make>
+static void benchContainer(Bench &bench, const std::string &impl, size_t node_size, Make make)
+{
+	for (size_t n : bench.sizes())
+	{
+		std::vector<uint64_t> keys(n);
+		uint64_t state = n;
+
+		for (uint64_t &key : keys)
+			key = splitmix64(state);
+
+		std::string params = "n=" + std::to_string(n) + " impl=" + impl;
+		size_t bytes = sizeof(Container) + n * node_size;
+
+		bench.run("avlSetInsert", params, n, [&](Timer &timer)
+		{
+			Container container;
+
+			timer.start();
+			for (uint64_t key : keys)
+				container.insert(make(key));
+			timer.stop();
+
+			return bytes;
+		});
+
+		Container container;
+		for (uint64_t key : keys)
+			container.insert(make(key));
+
+		bench.run("avlSetFind", params, n, [&](Timer &timer)
+		{
+			size_t found = 0;
+
+			timer.start();
+			for (uint64_t key : keys)
+				found += container.find(key) != container.end();
+			timer.stop();
+
+			doNotOptimize(found);
+
+			return bytes;
+		});
+
+		bench.run("avlSetIterate", params, n, [&](Timer &timer)
+		{
+			uint64_t sum = 0;
+
+			timer.start();
+			for (const typename Container::value_type &value : container)
+				sum += keyOf(value);
+			timer.stop();
+
+			doNotOptimize(sum);
+
+			return bytes;
+		});
+	}
+}
+
+static uint64_t makeKey(uint64_t key)
+{
+	return key;
+}
+
+static std::pair<const uint64_t, uint64_t> makePair(uint64_t key)
+{
+	return std::pair<const uint64_t, uint64_t>(key, key);
+}
+
+void benchAvlSet(Bench &bench)
+{
+	typedef aud::avl_set<uint64_t> AvlSet;
+	typedef aud::avl_map<uint64_t, uint64_t> AvlMap;
+
+	benchContainer<AvlSet>(bench, "avl_set", AvlSet::node_size(), &makeKey);
+	benchContainer<std::set<uint64_t>>(bench, "std::set", stdNodeSize<uint64_t>(), &makeKey);
+	benchContainer<AvlMap>(bench, "avl_map", AvlMap::node_size(), &makePair);
+	benchContainer<std::map<uint64_t, uint64_t>>(bench, "std::map",
+		stdNodeSize<std::pair<const uint64_t, uint64_t>>(), &makePair);
+}
@@ -0,0 +1,607 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/AvlTree.h"
+}
+
+static int compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns `n` distinct keys in the order of the distribution `dist`.
+ */
+static std::vector<uint64_t> makeKeys(size_t n, const std::string &dist)
+{
+	std::vector<uint64_t> keys(n);
+	uint64_t state = 42;
+
+	for (size_t i = 0; i < n; i++)
+		keys[i] = 2 * i;
+
+	if (dist == "random")
+	{
+		for (size_t i = n; i > 1; i--)
+			std::swap(keys[i - 1], keys[splitmix64(state) % i]);
+	}
+	else if (dist == "reverse")
+	{
+		std::reverse(keys.begin(), keys.end());
+	}
+
+	return keys;
+}
+
+/**
+ * Returns the lookup order for keys that were inserted with `makeKeys()`.
+ */
+static std::vector<uint64_t> makeLookups(size_t n, bool hit)
+{
+	std::vector<uint64_t> lookups = makeKeys(n, "random");
+
+	if (!hit)
+	{
+		for (uint64_t &key : lookups)
+			key++;
+	}
+
+	return lookups;
+}
+
+struct Interval
+{
+	uint64_t low;
+	uint64_t high;
+};
+
+static const void *intervalLow(const void *item)
+{
+	return &((const struct Interval *)item)->low;
+}
+
+static const void *intervalHigh(const void *item)
+{
+	return &((const struct Interval *)item)->high;
+}
+
+static int compareIntervals(const void *a, const void *b)
+{
+	const struct Interval *x = (const struct Interval *)a;
+	const struct Interval *y = (const struct Interval *)b;
+
+	if (x->low != y->low)
+		return x->low < y->low ? -1 : 1;
+
+	return x < y ? -1 : x > y;
+}
+
+static void countInterval(void *item, void *context)
+{
+	doNotOptimize(item);
+	(*(size_t *)context)++;
+}
+
+/**
+ * Compares stabbing queries on a tree in interval mode with a linear scan over all intervals.
+ */
+static void benchIntervals(Bench &bench)
+{
+	static const struct AvlIntervalType type = {&intervalLow, &intervalHigh, &compare};
+	const size_t n_queries = 1000;
+
+	for (size_t n : bench.sizes())
+	{
+		// short intervals (like sessions) on a line of length 1000 * n, so a point is in a few intervals
+		std::vector<struct Interval> intervals(n);
+		std::vector<uint64_t> points(n_queries);
+		uint64_t state = n;
+
+		for (struct Interval &interval : intervals)
+		{
+			interval.low = splitmix64(state) % (1000 * n);
+			interval.high = interval.low + splitmix64(state) % 3000;
+		}
+
+		for (uint64_t &point : points)
+			point = splitmix64(state) % (1000 * n);
+
+		struct AvlTree tree;
+		struct AvlStats stats;
+
+		avlInitInterval(&tree, &compareIntervals, &type);
+		for (struct Interval &interval : intervals)
+			avlInsert(&tree, &interval);
+		avlStats(&tree, &stats);
+
+		std::string params = "n=" + std::to_string(n);
+
+		bench.run("avlStab", params + " impl=tree", n_queries, [&](Timer &timer)
+		{
+			size_t found = 0;
+
+			timer.start();
+			for (uint64_t &point : points)
+				avlStab(&tree, &point, &countInterval, &found);
+			timer.stop();
+
+			timer.record("found", (double)found / n_queries);
+
+			return stats.memory;
+		});
+
+		bench.run("avlStab", params + " impl=scan", n_queries, [&](Timer &timer)
+		{
+			size_t found = 0;
+
+			timer.start();
+			for (uint64_t point : points)
+			{
+				for (struct Interval &interval : intervals)
+				{
+					if (interval.low <= point && point <= interval.high)
+						countInterval(&interval, &found);
+				}
+			}
+			timer.stop();
+
+			timer.record("found", (double)found / n_queries);
+
+			return intervals.size() * sizeof(struct Interval);
+		});
+
+		avlFree(&tree);
+	}
+}
+
+/**
+ * Measures bursts of insertions into a tree of `n` random keys, in normal mode and in relaxed mode (without and with a
+ * height bound), as well as lookups after the burst.
+ *
+ * The time of a burst includes the final `avlRebalance()`, whose share is recorded separately.
+ */
+static void benchBurst(Bench &bench)
+{
+	for (size_t n : bench.sizes())
+	{
+		std::vector<uint64_t> base = makeKeys(n, "random");
+		std::vector<uint64_t> lookups = makeLookups(n, true);
+		size_t max_height = 3 * (size_t)std::ceil(std::log2(2.0 * n + 1));
+
+		for (const char *dist : {"sequential", "random", "append"})
+		{
+			// the burst keys are odd, so they fall between the keys of the tree (or they are appended after them)
+			std::vector<uint64_t> burst = makeKeys(n, std::string(dist) == "append" ? "sequential" : dist);
+
+			for (uint64_t &key : burst)
+				key += std::string(dist) == "append" ? 2 * n : 1;
+
+			for (const char *mode : {"strict", "relaxed", "bounded"})
+			{
+				// without a height bound, appended keys form a list, so the insertions take quadratic time
+				if (std::string(dist) == "append" && std::string(mode) == "relaxed")
+					continue;
+
+				std::string params = "n=" + std::to_string(n) + " dist=" + dist + " mode=" + mode;
+				struct AvlTree tree;
+				struct AvlStats stats;
+
+				auto fill = [&](Timer &timer)
+				{
+					avlInit(&tree, &compare);
+					for (uint64_t &key : base)
+						avlInsert(&tree, &key);
+
+					if (std::string(mode) != "strict")
+						avlRelax(&tree, std::string(mode) == "bounded" ? max_height : 0);
+
+					timer.start();
+					for (uint64_t &key : burst)
+						avlInsert(&tree, &key);
+
+					avlStats(&tree, &stats);
+					auto begin = std::chrono::steady_clock::now();
+					avlRebalance(&tree);
+					auto end = std::chrono::steady_clock::now();
+					timer.stop();
+
+					timer.record("height", (double)stats.height);
+					timer.record("rebalance_ns_per_op", std::chrono::duration<double, std::nano>(end - begin).count() / n);
+				};
+
+				bench.run("avlBurstInsert", params, n, [&](Timer &timer)
+				{
+					fill(timer);
+					avlStats(&tree, &stats);
+					avlFree(&tree);
+
+					return stats.memory;
+				});
+
+				Timer ignored;
+				fill(ignored);
+				avlStats(&tree, &stats);
+
+				bench.run("avlBurstContains", params, n, [&](Timer &timer)
+				{
+					size_t found = 0;
+
+					timer.start();
+					for (uint64_t &key : lookups)
+						found += avlContains(&tree, &key);
+					timer.stop();
+
+					doNotOptimize(found);
+
+					return stats.memory;
+				});
+
+				avlFree(&tree);
+			}
+		}
+	}
+}
+
+static size_t hashKey(const void *item)
+{
+	uint64_t x = *(const uint64_t *)item;
+
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+	return (size_t)(x ^ (x >> 31));
+}
+
+/**
+ * Returns `n_lookups` keys of `keys`, drawn from a Zipf distribution with exponent `s` (the first key is the most
+ * frequent one, `s = 0` is uniform).
+ */
+static std::vector<uint64_t> makeZipfLookups(const std::vector<uint64_t> &keys, size_t n_lookups, double s)
+{
+	std::vector<double> cdf(keys.size());
+	std::vector<uint64_t> lookups(n_lookups);
+	double sum = 0;
+	uint64_t state = 7;
+
+	for (size_t i = 0; i < keys.size(); i++)
+		cdf[i] = sum += std::pow((double)(i + 1), -s);
+
+	for (uint64_t &key : lookups)
+	{
+		double u = (double)(splitmix64(state) >> 11) / (double)((uint64_t)1 << 53) * sum;
+		size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+
+		key = keys[rank < keys.size() ? rank : keys.size() - 1];
+	}
+
+	return lookups;
+}
+
+/**
+ * Benchmarks `avlContains()` with and without a lookup cache, for lookups with different skews.
+ */
+static void benchCache(Bench &bench)
+{
+	const size_t n_lookups = 200000;
+
+	for (size_t n : bench.sizes())
+	{
+		// the keys are inserted in random order, so the hot keys are spread over the tree
+		std::vector<uint64_t> keys = makeKeys(n, "random");
+		struct AvlTree tree;
+		struct AvlStats stats;
+
+		avlInit(&tree, &compare);
+		for (uint64_t &key : keys)
+			avlInsert(&tree, &key);
+
+		for (double s : {0.0, 0.6, 0.9, 1.1, 1.3})
+		{
+			std::vector<uint64_t> lookups = makeZipfLookups(keys, n_lookups, s);
+
+			for (size_t n_slots : {0, 1024, 16384})
+			{
+				std::string params = "n=" + std::to_string(n) + " zipf=" + std::to_string(s).substr(0, 3) + " slots=" +
+					std::to_string(n_slots);
+
+				bench.run("avlCachedContains", params, n_lookups, [&](Timer &timer)
+				{
+					size_t found = 0;
+
+					// every repetition starts with an empty cache and fresh counters
+					avlCache(&tree, 0, NULL);
+					avlCache(&tree, n_slots, &hashKey);
+					memset(&tree.counters, 0, sizeof(tree.counters));
+
+					timer.start();
+					for (uint64_t &key : lookups)
+						found += avlContains(&tree, &key);
+					timer.stop();
+
+					doNotOptimize(found);
+					avlStats(&tree, &stats);
+
+					if (stats.counters.cache_hits + stats.counters.cache_misses > 0)
+						timer.record("hit_rate", (double)stats.counters.cache_hits / n_lookups);
+
+					return stats.memory;
+				});
+			}
+		}
+
+		avlFree(&tree);
+	}
+}
+
+/**
+ * Benchmarks a scheduler (hold model): the earliest task is popped, and inserted again with a later deadline. The keys
+ * are `(deadline << 20) | id`, so they are unique.
+ */
+static void benchQueue(Bench &bench)
+{
+	for (size_t n : bench.sizes())
+	{
+		std::vector<uint64_t> tasks(n);
+		std::vector<uint64_t> delays(n);
+		uint64_t state = 42;
+
+		for (size_t i = 0; i < n; i++)
+		{
+			tasks[i] = (splitmix64(state) % (4 * n) << 20) | i;
+			delays[i] = (1 + splitmix64(state) % (4 * n)) << 20;
+		}
+
+		for (const char *api : {"avlPopMin", "avlDelete", "priority_queue"})
+		{
+			std::string params = "n=" + std::to_string(n) + " api=" + api;
+
+			bench.run("avlQueue", params, n, [&](Timer &timer)
+			{
+				std::vector<uint64_t> keys = tasks;
+				struct AvlTree tree;
+				struct AvlStats stats;
+				size_t memory;
+
+				if (std::string(api) == "priority_queue")
+				{
+					std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> queue(keys.begin(),
+						keys.end());
+
+					timer.start();
+					for (uint64_t delay : delays)
+					{
+						uint64_t key = queue.top();
+						queue.pop();
+						queue.push(key + delay);
+					}
+					timer.stop();
+
+					doNotOptimize(queue.top());
+
+					return n * sizeof(uint64_t);
+				}
+
+				avlInit(&tree, &compare);
+				for (uint64_t &key : keys)
+					avlInsert(&tree, &key);
+
+				timer.start();
+				if (std::string(api) == "avlPopMin")
+				{
+					for (uint64_t delay : delays)
+					{
+						uint64_t *key = (uint64_t *)avlPopMin(&tree);
+						*key += delay;
+						avlInsert(&tree, key);
+					}
+				}
+				else
+				{
+					// without the cached minimum, the least item is searched along the left spine
+					for (uint64_t delay : delays)
+					{
+						struct AvlNode *node = tree.root;
+
+						while (node->left != NULL)
+							node = node->left;
+
+						uint64_t *key = (uint64_t *)node->value;
+						avlDelete(&tree, key);
+						*key += delay;
+						avlInsert(&tree, key);
+					}
+				}
+				timer.stop();
+
+				avlStats(&tree, &stats);
+				memory = stats.memory;
+				avlFree(&tree);
+
+				return memory;
+			});
+		}
+	}
+}
+
+/**
+ * Measures the cost of the memory accounting: random inserts and deletes into a tree, that allocates its nodes with
+ * `malloc()` directly, or through a counting allocator with a budget.
+ */
+static void benchAllocator(Bench &bench)
+{
+	for (size_t n : bench.sizes())
+	{
+		std::vector<uint64_t> keys = makeKeys(n, "random");
+
+		for (const char *allocator_name : {"none", "counting"})
+		{
+			std::string params = "n=" + std::to_string(n) + " allocator=" + allocator_name;
+
+			bench.run("avlAllocator", params, 2 * n, [&](Timer &timer)
+			{
+				struct AvlTree tree;
+				struct Allocator allocator;
+
+				avlInit(&tree, &compare);
+				allocatorInit(&allocator, n * sizeof(struct AvlNode));
+
+				if (std::string(allocator_name) == "counting")
+					avlSetAllocator(&tree, &allocator);
+
+				timer.start();
+				for (uint64_t &key : keys)
+					avlInsert(&tree, &key);
+
+				for (uint64_t &key : keys)
+					avlDelete(&tree, &key);
+				timer.stop();
+
+				avlFree(&tree);
+
+				return sizeof(struct AvlTree) + n * sizeof(struct AvlNode);
+			});
+		}
+	}
+}
+
+/**
+ * Compares a loop of `avlInsert()` with `avlInsertBatch()` at different thread counts, for a batch of random keys that
+ * is inserted into an empty tree, and into a tree with as many keys (interleaved with the batch).
+ */
+static void benchBatch(Bench &bench)
+{
+	for (size_t n : bench.sizes())
+	{
+		std::vector<uint64_t> keys = makeKeys(n, "random");
+		std::vector<uint64_t> batch_keys(keys);
+		std::vector<void *> batch(n);
+
+		for (size_t i = 0; i < n; i++)
+		{
+			batch_keys[i]++;
+			batch[i] = &batch_keys[i];
+		}
+
+		for (const char *tree_name : {"empty", "full"})
+		{
+			std::vector<std::string> impls = {"loop"};
+
+			for (size_t n_threads : threadCounts())
+				impls.push_back("batch threads=" + std::to_string(n_threads));
+
+			for (const std::string &impl : impls)
+			{
+				std::string params = "n=" + std::to_string(n) + " tree=" + tree_name + " impl=" + impl;
+
+				bench.run("avlInsertBatch", params, n, [&](Timer &timer)
+				{
+					struct AvlTree tree;
+
+					avlInit(&tree, &compare);
+
+					if (std::string(tree_name) == "full")
+					{
+						for (uint64_t &key : keys)
+							avlInsert(&tree, &key);
+					}
+
+					timer.start();
+					if (impl == "loop")
+					{
+						for (void *item : batch)
+							avlInsert(&tree, item);
+					}
+					else
+					{
+						avlInsertBatch(&tree, batch.data(), n, std::stoul(impl.substr(impl.find('=') + 1)));
+					}
+					timer.stop();
+
+					size_t memory = avlMemory(&tree);
+					avlFree(&tree);
+
+					return memory;
+				});
+			}
+		}
+	}
+}
+
+void benchAvlTree(Bench &bench)
+{
+	for (size_t n : bench.sizes())
+	{
+		for (const char *dist : {"sequential", "reverse", "random"})
+		{
+			std::vector<uint64_t> keys = makeKeys(n, dist);
+			std::string params = "n=" + std::to_string(n) + " dist=" + dist;
+
+			bench.run("avlInsert", params, n, [&](Timer &timer)
+			{
+				struct AvlTree tree;
+				struct AvlStats stats;
+
+				avlInit(&tree, &compare);
+
+				timer.start();
+				for (uint64_t &key : keys)
+					avlInsert(&tree, &key);
+				timer.stop();
+
+				avlStats(&tree, &stats);
+				avlFree(&tree);
+
+				return stats.memory;
+			});
+		}
+
+		std::vector<uint64_t> keys = makeKeys(n, "random");
+		struct AvlTree tree;
+		struct AvlStats stats;
+
+		avlInit(&tree, &compare);
+		for (uint64_t &key : keys)
+			avlInsert(&tree, &key);
+		avlStats(&tree, &stats);
+
+		for (bool hit : {true, false})
+		{
+			std::vector<uint64_t> lookups = makeLookups(n, hit);
+			std::string params = "n=" + std::to_string(n) + (hit ? " lookup=hit" : " lookup=miss");
+
+			bench.run("avlContains", params, n, [&](Timer &timer)
+			{
+				size_t found = 0;
+
+				timer.start();
+				for (uint64_t &key : lookups)
+					found += avlContains(&tree, &key);
+				timer.stop();
+
+				doNotOptimize(found);
+
+				return stats.memory;
+			});
+		}
+
+		avlFree(&tree);
+	}
+
+	benchIntervals(bench);
+	benchBurst(bench);
+	benchQueue(bench);
+	benchCache(bench);
+	benchAllocator(bench);
+	benchBatch(bench);
+}
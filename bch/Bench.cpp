@@ -0,0 +1,200 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Bench.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+PerfCounters::PerfCounters()
+{
+	for (int &fd : fds)
+		fd = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	for (int fd : fds)
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+#endif
+}
+
+int PerfCounters::open()
+{
+#ifdef __linux__
+	static const struct
+	{
+		uint32_t type;
+		uint64_t config;
+	}
+	EVENTS[N_EVENTS] = {
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+			PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+	};
+
+	int n_available = 0;
+
+	for (int i = 0; i < N_EVENTS; i++)
+	{
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = EVENTS[i].type;
+		attr.config = EVENTS[i].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// the counters are never disabled, they are read before and after every measured region
+		fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		n_available += fds[i] >= 0;
+	}
+
+	return n_available;
+#else
+	errno = ENOSYS;
+	return 0;
+#endif
+}
+
+void PerfCounters::read(uint64_t *values) const
+{
+	for (int i = 0; i < N_EVENTS; i++)
+	{
+		values[i] = 0;
+
+#ifdef __linux__
+		// value, time enabled, time running
+		uint64_t data[3];
+
+		if (fds[i] < 0 || ::read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0)
+			continue;
+
+		values[i] = data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+#endif
+	}
+}
+
+void Timer::recordCounters(size_t ops)
+{
+	static const char *NAMES[PerfCounters::N_EVENTS] = {
+		"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+	};
+
+	if (counters == nullptr || ops == 0)
+		return;
+
+	for (int i = 0; i < PerfCounters::N_EVENTS; i++)
+	{
+		if (counters->available((PerfCounters::Event)i))
+			record(NAMES[i], (double)counts[i] / ops);
+	}
+
+	if (counters->available(PerfCounters::CYCLES) && counters->available(PerfCounters::INSTRUCTIONS) &&
+		counts[PerfCounters::CYCLES] > 0)
+	{
+		record("ipc", (double)counts[PerfCounters::INSTRUCTIONS] / counts[PerfCounters::CYCLES]);
+	}
+}
+
+Bench::Bench(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (value != NULL && strcmp(arg, "--format") == 0)
+			format = value;
+		else if (value != NULL && strcmp(arg, "--filter") == 0)
+			filter = value;
+		else if (value != NULL && strcmp(arg, "--repeat") == 0)
+			repeat = atoi(value) > 0 ? atoi(value) : 1;
+		else if (value != NULL && strcmp(arg, "--max-size") == 0)
+			max_size = strtoull(value, NULL, 10);
+		else if (strcmp(arg, "--counters") == 0)
+		{
+			use_counters = true;
+			continue;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--format csv|json] [--filter <name>] [--repeat <n>] [--max-size <n>] "
+				"[--counters]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		i++;
+	}
+
+	if (use_counters && counters.open() == 0)
+	{
+		fprintf(stderr, "hardware counters are not available (%s), only the time is measured\n", strerror(errno));
+		use_counters = false;
+	}
+}
+
+bool Bench::enabled(const std::string &name) const
+{
+	return name.find(filter) != std::string::npos;
+}
+
+std::vector<size_t> Bench::sizes() const
+{
+	std::vector<size_t> result;
+
+	for (size_t size = 1000; size <= max_size; size *= 10)
+		result.push_back(size);
+
+	return result;
+}
+
+void Bench::add(const BenchResult &result)
+{
+	results.push_back(result);
+
+	fprintf(stderr, "%-24s %-40s %10.2f ns/op  %s\n", result.name.c_str(), result.params.c_str(),
+		result.seconds * 1e9 / result.ops, result.metrics.c_str());
+}
+
+void Bench::report() const
+{
+	if (format == "json")
+	{
+		printf("[\n");
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const BenchResult &r = results[i];
+
+			printf("  {\"name\": \"%s\", \"params\": \"%s\", \"ops\": %zu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, "
+				"\"bytes\": %zu, \"metrics\": \"%s\"}%s\n", r.name.c_str(), r.params.c_str(), r.ops,
+				r.seconds * 1e9 / r.ops, r.ops / r.seconds, r.bytes, r.metrics.c_str(), i + 1 < results.size() ? "," : "");
+		}
+
+		printf("]\n");
+	}
+	else
+	{
+		printf("name,params,ops,ns_per_op,ops_per_sec,bytes,metrics\n");
+
+		for (const BenchResult &r : results)
+		{
+			printf("%s,%s,%zu,%.3f,%.1f,%zu,%s\n", r.name.c_str(), r.params.c_str(), r.ops, r.seconds * 1e9 / r.ops,
+				r.ops / r.seconds, r.bytes, r.metrics.c_str());
+		}
+	}
+}
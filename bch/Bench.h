@@ -0,0 +1,301 @@
+#ifndef AUD_BENCH_H
+#define AUD_BENCH_H
+
+/**
+ * @file Bench.h
+ *
+ * Contains the benchmark harness that is used by all benchmarks in the _bch/_ folder.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Hardware performance counters (Linux `perf_event_open()`), that are read around the measured regions of benchmarks.
+ *
+ * Every counter is opened on its own, so unavailable counters (e.g. in virtual machines, or if
+ * _/proc/sys/kernel/perf_event_paranoid_ forbids them) are skipped, and benchmarks run without them. Only user space
+ * events of the calling thread are counted.
+ */
+class PerfCounters
+{
+public:
+	enum Event
+	{
+		CYCLES,
+		INSTRUCTIONS,
+		L1D_MISSES,
+		LLC_MISSES,
+		BRANCH_MISSES,
+		N_EVENTS
+	};
+
+	PerfCounters();
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters &) = delete;
+	PerfCounters &operator=(const PerfCounters &) = delete;
+
+	/**
+	 * Opens all counters.
+	 *
+	 * @return The number of available counters (0 on systems without `perf_event_open()`).
+	 */
+	int open();
+
+	/**
+	 * Returns true, if the counter `event` is available.
+	 */
+	bool available(Event event) const
+	{
+		return fds[event] >= 0;
+	}
+
+	/**
+	 * Stores the current values of all counters in `values` (0 for unavailable counters). The values are scaled up, if
+	 * the kernel had to multiplex the counters.
+	 */
+	void read(uint64_t *values) const;
+
+private:
+	int fds[N_EVENTS];
+};
+
+/**
+ * Measures the time (and optionally the hardware counters) of the benchmarked region of a benchmark.
+ */
+class Timer
+{
+public:
+	/**
+	 * @param counters The counters to read in `start()` and `stop()`, or `nullptr`.
+	 */
+	explicit Timer(const PerfCounters *counters = nullptr) : counters(counters)
+	{
+	}
+
+	void start()
+	{
+		if (counters != nullptr)
+			counters->read(begin_counts);
+
+		begin = std::chrono::steady_clock::now();
+	}
+
+	void stop()
+	{
+		elapsed += std::chrono::steady_clock::now() - begin;
+
+		if (counters != nullptr)
+		{
+			uint64_t end_counts[PerfCounters::N_EVENTS];
+			counters->read(end_counts);
+
+			for (int i = 0; i < PerfCounters::N_EVENTS; i++)
+				counts[i] += end_counts[i] - begin_counts[i];
+		}
+	}
+
+	double seconds() const
+	{
+		return std::chrono::duration<double>(elapsed).count();
+	}
+
+	/**
+	 * Records an additional metric of the benchmark (e.g. an error), that is reported together with the time.
+	 */
+	void record(const std::string &metric, double value)
+	{
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%s%s=%g", metrics.empty() ? "" : " ", metric.c_str(), value);
+		metrics += buffer;
+	}
+
+	/**
+	 * Records the available hardware counters of the measured region per operation (and the instructions per cycle).
+	 */
+	void recordCounters(size_t ops);
+
+	/**
+	 * The recorded metrics as "key=value" pairs, separated by spaces.
+	 */
+	std::string metrics;
+
+private:
+	const PerfCounters *counters;
+	uint64_t begin_counts[PerfCounters::N_EVENTS] = {0};
+	uint64_t counts[PerfCounters::N_EVENTS] = {0};
+	std::chrono::steady_clock::time_point begin;
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::duration::zero();
+};
+
+/**
+ * The result of one benchmark.
+ */
+struct BenchResult
+{
+	/**
+	 * The name of the benchmark, e.g. "avlInsert".
+	 */
+	std::string name;
+
+	/**
+	 * The parameters of the benchmark as "key=value" pairs, separated by spaces.
+	 */
+	std::string params;
+
+	/**
+	 * The number of operations that were performed in one repetition.
+	 */
+	size_t ops;
+
+	/**
+	 * The fastest time of all repetitions in seconds.
+	 */
+	double seconds;
+
+	/**
+	 * The memory used by the benchmarked data structure in bytes.
+	 */
+	size_t bytes;
+
+	/**
+	 * Additional metrics of the fastest repetition.
+	 *
+	 * @see Timer::record()
+	 */
+	std::string metrics;
+};
+
+/**
+ * Runs benchmarks and prints their results as CSV or JSON.
+ *
+ * Command line options:
+ *  * `--format csv|json` output format (default: csv)
+ *  * `--filter <string>` only run benchmarks whose name contains `<string>`
+ *  * `--repeat <n>` number of repetitions of every benchmark, the fastest one is reported (default: 3)
+ *  * `--max-size <n>` the maximum number of items used by benchmarks (default: 1000000)
+ *  * `--counters` records hardware counters per operation as metrics (cycles, instructions, IPC, L1 data cache
+ *    misses, last level cache misses and branch misses), if they are available
+ */
+class Bench
+{
+public:
+	Bench(int argc, char **argv);
+
+	/**
+	 * Returns true, if the benchmark `name` was selected with `--filter`.
+	 */
+	bool enabled(const std::string &name) const;
+
+	/**
+	 * Returns the sizes (number of items) benchmarks should use: powers of 10 from 1000 to `--max-size`.
+	 */
+	std::vector<size_t> sizes() const;
+
+	/**
+	 * Runs a benchmark. `f` is called once per repetition with a `Timer &` and has to start and stop the timer around
+	 * the measured region. It returns the memory used by the benchmarked data structure in bytes.
+	 *
+	 * @param name The name of the benchmark.
+	 * @param params The parameters of the benchmark.
+	 * @param ops The number of operations `f` performs in the measured region.
+	 */
+	template <typename F>
+	void run(const std::string &name, const std::string &params, size_t ops, F f)
+	{
+		if (!enabled(name))
+			return;
+
+		BenchResult result = {name, params, ops, 0, 0, ""};
+
+		for (int i = 0; i < repeat; i++)
+		{
+			Timer timer(use_counters ? &counters : nullptr);
+			size_t bytes = f(timer);
+
+			if (use_counters)
+				timer.recordCounters(ops);
+
+			if (i == 0 || timer.seconds() < result.seconds)
+			{
+				result.seconds = timer.seconds();
+				result.bytes = bytes;
+				result.metrics = timer.metrics;
+			}
+		}
+
+		add(result);
+	}
+
+	/**
+	 * Prints all results to stdout.
+	 */
+	void report() const;
+
+private:
+	void add(const BenchResult &result);
+
+	std::string format = "csv";
+	std::string filter;
+	int repeat = 3;
+	size_t max_size = 1000000;
+	bool use_counters = false;
+	PerfCounters counters;
+	std::vector<BenchResult> results;
+};
+
+/**
+ * Returns the next pseudo random number of a splitmix64 generator.
+ */
+inline uint64_t splitmix64(uint64_t &state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Returns the thread counts to benchmark: powers of 2 up to the number of cores, and the number of cores.
+ */
+inline std::vector<size_t> threadCounts()
+{
+	size_t n_cores = std::thread::hardware_concurrency();
+	std::vector<size_t> counts;
+
+	if (n_cores == 0)
+		n_cores = 1;
+
+	for (size_t n = 1; n < n_cores; n *= 2)
+		counts.push_back(n);
+
+	counts.push_back(n_cores);
+
+	return counts;
+}
+
+/**
+ * Prevents the compiler from optimizing away the computation of `value`.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+void benchAvlSet(Bench &bench);
+void benchAvlTree(Bench &bench);
+void benchBitOps(Bench &bench);
+void benchHash(Bench &bench);
+void benchHyperLogLog(Bench &bench);
+void benchHyperLogLogPipeline(Bench &bench);
+void benchHyperLogLogStore(Bench &bench);
+void benchSlidingHyperLogLog(Bench &bench);
+
+#endif //AUD_BENCH_H
@@ -0,0 +1,69 @@
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/BitOps.h"
+}
+
+void benchBitOps(Bench &bench)
+{
+	const size_t n = 1000000;
+	std::vector<uint64_t> words(n);
+	uint64_t state = 42;
+
+	// random words with a geometric distribution of trailing zeros, like the hashes in HyperLogLog
+	for (uint64_t &word : words)
+		word = splitmix64(state) << (splitmix64(state) % 64);
+
+	// 256-bit buffers that have their least significant set bit at a random position
+	std::vector<uint64_t> buffers(4 * n / 16);
+	for (size_t i = 0; i < buffers.size(); i += 4)
+	{
+		size_t bit = splitmix64(state) % 256;
+		buffers[i + bit / 64] = (uint64_t)1 << (bit % 64);
+	}
+
+	struct
+	{
+		enum BitOpsImpl impl;
+		const char *name;
+	} impls[] = {{BITOPS_BMI, "bmi"}, {BITOPS_BUILTIN, "builtin"}, {BITOPS_DEBRUIJN, "debruijn"}};
+
+	for (auto &impl : impls)
+	{
+		if (bitOpsSelect(impl.impl) != 0)
+			continue;
+
+		bench.run("bitTzcnt64", std::string("impl=") + impl.name, n, [&](Timer &timer)
+		{
+			uint64_t sum = 0;
+
+			timer.start();
+			for (uint64_t word : words)
+				sum += bitTzcnt64(word);
+			timer.stop();
+
+			doNotOptimize(sum);
+
+			return 0;
+		});
+
+		bench.run("bitTzcntWords", std::string("impl=") + impl.name + " bits=256", buffers.size() / 4, [&](Timer &timer)
+		{
+			uint64_t sum = 0;
+
+			timer.start();
+			for (size_t i = 0; i < buffers.size(); i += 4)
+				sum += bitTzcntWords(&buffers[i], 4);
+			timer.stop();
+
+			doNotOptimize(sum);
+
+			return 0;
+		});
+	}
+
+	bitOpsSelect(BITOPS_AUTO);
+}
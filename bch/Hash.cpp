@@ -0,0 +1,40 @@
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/Hash.h"
+}
+
+void benchHash(Bench &bench)
+{
+	const size_t n_bytes = 64 << 20;
+	std::vector<char> data(n_bytes);
+	uint64_t state = 42;
+
+	for (char &byte : data)
+		byte = (char)splitmix64(state);
+
+	// typical lengths of fields and lines of log files
+	for (size_t length : {8, 16, 64, 256, 4096})
+	{
+		const size_t n = n_bytes / length;
+
+		bench.run("hashBytes", "length=" + std::to_string(length), n, [&](Timer &timer)
+		{
+			uint64_t sum = 0;
+
+			timer.start();
+			for (size_t i = 0; i < n; i++)
+				sum += hashBytes(data.data() + i * length, length, 0);
+			timer.stop();
+
+			doNotOptimize(sum);
+
+			timer.record("gb_per_s", n_bytes / timer.seconds() / 1e9);
+
+			return 0;
+		});
+	}
+}
@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLog.h"
+}
+
+/**
+ * A fast hash function for integer items (the item pointer itself is the integer).
+ */
+static void hash(const void *item, size_t h, void *buffer)
+{
+	uint64_t state = (uintptr_t)item;
+	char *bytes = (char *)buffer;
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t word = splitmix64(state);
+		memcpy(bytes + i, &word, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+/**
+ * The former MEDIUM layout (4 registers in unaligned 3 byte blocks), as a baseline for the current layout.
+ */
+namespace legacy
+{
+	static size_t dataSize(unsigned char b)
+	{
+		return ((size_t)1 << b) / 4 * 3 + 1;
+	}
+
+	static uint8_t getReg(uint32_t block, unsigned index)
+	{
+		return (uint8_t)((block & (0x3F << index * 6)) >> index * 6);
+	}
+
+	static void add(uint8_t *data, unsigned char b, const void *item)
+	{
+		char buffer[16];
+		uint64_t word;
+		size_t index;
+
+		hash(item, sizeof(buffer), buffer);
+		memcpy(&word, buffer, sizeof(word));
+		memcpy(&index, buffer + 8, sizeof(index));
+		index &= ((size_t)1 << b) - 1;
+
+		uint8_t rho = (uint8_t)(__builtin_ctzll(word | 0xC000000000000000) + 1);
+		uint32_t *block = (uint32_t *)(data + index / 4 * 3);
+		unsigned reg_index = index % 4;
+
+		if (rho > getReg(*block, reg_index))
+		{
+			*block &= ~(0x3F << reg_index * 6);
+			*block |= rho << reg_index * 6;
+		}
+	}
+
+	static double count(const uint8_t *data, unsigned char b)
+	{
+		double sum = 0;
+		size_t n_empty_regs = 0;
+
+		for (size_t i = 0; i + 3 < dataSize(b); i += 3)
+		{
+			uint32_t block = *(const uint32_t *)(data + i);
+
+			for (unsigned j = 0; j < 4; j++)
+			{
+				uint8_t reg = getReg(block, j);
+				sum += pow(2, -reg);
+				n_empty_regs += reg == 0;
+			}
+		}
+
+		size_t m = (size_t)1 << b;
+		double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+		return raw <= 2 * m && n_empty_regs > 0 ? m * log((double)m / n_empty_regs) : raw;
+	}
+
+	static void merge(uint8_t *data, const uint8_t *other, unsigned char b)
+	{
+		for (size_t i = 0; i + 3 < dataSize(b); i += 3)
+		{
+			uint32_t *block = (uint32_t *)(data + i);
+			uint32_t other_block = *(const uint32_t *)(other + i);
+
+			for (unsigned j = 0; j < 4; j++)
+			{
+				uint8_t reg = getReg(other_block, j);
+
+				if (reg > getReg(*block, j))
+				{
+					*block &= ~(0x3F << j * 6);
+					*block |= reg << j * 6;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * The former SMALL layout (plain 4-bit registers, that saturate at 15), as a baseline for the offset encoding.
+ */
+namespace legacy_small
+{
+	static void add(uint8_t *data, unsigned char b, const void *item)
+	{
+		char buffer[sizeof(size_t) + sizeof(uint16_t)];
+		uint16_t word;
+		size_t index;
+
+		hash(item, sizeof(buffer), buffer);
+		memcpy(&index, buffer, sizeof(index));
+		memcpy(&word, buffer + sizeof(size_t), sizeof(word));
+		index &= ((size_t)1 << b) - 1;
+
+		uint8_t rho = (uint8_t)(__builtin_ctz(word | 0xC000) + 1);
+		unsigned shift = index % 2 * 4;
+
+		if (rho > ((data[index / 2] >> shift) & 0xF))
+		{
+			data[index / 2] &= (uint8_t)~(0xF << shift);
+			data[index / 2] |= (uint8_t)(rho << shift);
+		}
+	}
+
+	static double count(const uint8_t *data, unsigned char b)
+	{
+		double sum = 0;
+		size_t n_empty_regs = 0;
+		size_t m = (size_t)1 << b;
+
+		for (size_t i = 0; i < m; i++)
+		{
+			uint8_t reg = (data[i / 2] >> (i % 2 * 4)) & 0xF;
+			sum += pow(2, -reg);
+			n_empty_regs += reg == 0;
+		}
+
+		double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+		return raw <= 2.5 * m && n_empty_regs > 0 ? m * log((double)m / n_empty_regs) : raw;
+	}
+}
+
+/**
+ * Compares the accuracy and add throughput of the SMALL offset encoding with the former saturating SMALL registers, up
+ * to cardinalities where the former registers saturate.
+ */
+static void benchSmallLayout(Bench &bench)
+{
+	const unsigned char b = 8;
+	const size_t n_trials = 3;
+
+	for (size_t n : {10000, 100000, 1000000, 10000000})
+	{
+		std::string params = "b=" + std::to_string(b) + " n=" + std::to_string(n);
+
+		bench.run("hllSmallAdd", params + " layout=saturating", n * n_trials, [&](Timer &timer)
+		{
+			double error = 0;
+
+			for (size_t trial = 0; trial < n_trials; trial++)
+			{
+				std::vector<uint8_t> data(((size_t)1 << b) / 2);
+				uintptr_t offset = trial * n;
+
+				timer.start();
+				for (uintptr_t i = offset; i < offset + n; i++)
+					legacy_small::add(data.data(), b, (const void *)i);
+				timer.stop();
+
+				error += pow((legacy_small::count(data.data(), b) - n) / n, 2);
+			}
+
+			timer.record("rmse", sqrt(error / n_trials));
+
+			return ((size_t)1 << b) / 2;
+		});
+
+		bench.run("hllSmallAdd", params + " layout=offset", n * n_trials, [&](Timer &timer)
+		{
+			double error = 0;
+
+			for (size_t trial = 0; trial < n_trials; trial++)
+			{
+				struct HyperLogLog hll;
+				hllInit(&hll, SMALL, b, &hash);
+				uintptr_t offset = trial * n;
+
+				timer.start();
+				for (uintptr_t i = offset; i < offset + n; i++)
+					hllAdd(&hll, (const void *)i);
+				timer.stop();
+
+				error += pow((hllCount(&hll) - n) / n, 2);
+				hllFree(&hll);
+			}
+
+			timer.record("rmse", sqrt(error / n_trials));
+
+			return hllDataSize(SMALL, b);
+		});
+	}
+}
+
+/**
+ * Measures folding a LARGE set to lower precisions, compared to merging sets with equal parameters.
+ */
+static void benchFold(Bench &bench)
+{
+	const unsigned char b = 16;
+	const size_t n_folds = 100;
+
+	struct HyperLogLog hll;
+	hllInit(&hll, LARGE, b, &hash);
+
+	for (uintptr_t i = 0; i < 1000000; i++)
+		hllAdd(&hll, (const void *)i);
+
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		for (unsigned char new_b : {12, 16})
+		{
+			std::string params = "r=" + std::to_string(LARGE) + "->" + std::to_string(r) + " b=" + std::to_string(b) +
+				"->" + std::to_string(new_b);
+
+			bench.run("hllFold", params, n_folds, [&](Timer &timer)
+			{
+				struct HyperLogLog folded;
+				hllInit(&folded, r, new_b, &hash);
+
+				timer.start();
+				for (size_t i = 0; i < n_folds; i++)
+					hllMerge(&folded, &hll);
+				timer.stop();
+
+				hllFree(&folded);
+
+				return hllDataSize(r, new_b);
+			});
+		}
+	}
+
+	hllFree(&hll);
+}
+
+/**
+ * Compares the current MEDIUM layout with the former one.
+ */
+static void benchMediumLayout(Bench &bench)
+{
+	const size_t n = 1000000;
+
+	for (unsigned char b : {8, 11, 14, 16})
+	{
+		std::string params = "b=" + std::to_string(b);
+
+		std::vector<uint8_t> block_data(legacy::dataSize(b));
+		std::vector<uint8_t> block_other(legacy::dataSize(b));
+		struct HyperLogLog word_data, word_other;
+
+		hllInit(&word_data, MEDIUM, b, &hash);
+		hllInit(&word_other, MEDIUM, b, &hash);
+
+		bench.run("hllMediumAdd", params + " layout=block", n, [&](Timer &timer)
+		{
+			timer.start();
+			for (uintptr_t i = 0; i < n; i++)
+				legacy::add(block_data.data(), b, (const void *)i);
+			timer.stop();
+
+			return block_data.size();
+		});
+
+		bench.run("hllMediumAdd", params + " layout=word", n, [&](Timer &timer)
+		{
+			timer.start();
+			for (uintptr_t i = 0; i < n; i++)
+				hllAdd(&word_data, (const void *)i);
+			timer.stop();
+
+			return hllDataSize(MEDIUM, b);
+		});
+
+		for (uintptr_t i = n; i < 2 * n; i++)
+		{
+			legacy::add(block_other.data(), b, (const void *)i);
+			hllAdd(&word_other, (const void *)i);
+		}
+
+		const size_t n_counts = 100;
+
+		bench.run("hllMediumCount", params + " layout=block", n_counts, [&](Timer &timer)
+		{
+			double sum = 0;
+
+			timer.start();
+			for (size_t i = 0; i < n_counts; i++)
+				sum += legacy::count(block_data.data(), b);
+			timer.stop();
+
+			doNotOptimize(sum);
+
+			return block_data.size();
+		});
+
+		bench.run("hllMediumCount", params + " layout=word", n_counts, [&](Timer &timer)
+		{
+			double sum = 0;
+
+			timer.start();
+			for (size_t i = 0; i < n_counts; i++)
+				sum += hllCount(&word_data);
+			timer.stop();
+
+			doNotOptimize(sum);
+
+			return hllDataSize(MEDIUM, b);
+		});
+
+		const size_t n_merges = 100;
+
+		bench.run("hllMediumMerge", params + " layout=block", n_merges, [&](Timer &timer)
+		{
+			timer.start();
+			for (size_t i = 0; i < n_merges; i++)
+				legacy::merge(block_data.data(), block_other.data(), b);
+			timer.stop();
+
+			return block_data.size();
+		});
+
+		bench.run("hllMediumMerge", params + " layout=word", n_merges, [&](Timer &timer)
+		{
+			timer.start();
+			for (size_t i = 0; i < n_merges; i++)
+				hllMerge(&word_data, &word_other);
+			timer.stop();
+
+			return hllDataSize(MEDIUM, b);
+		});
+
+		hllFree(&word_data);
+		hllFree(&word_other);
+	}
+}
+
+/**
+ * Measures the accuracy and speed of the joint estimation compared to the inclusion-exclusion principle.
+ */
+static void benchJointCount(Bench &bench)
+{
+	const size_t n = std::min<size_t>(bench.sizes().back(), 100000);
+	const size_t n_trials = 20;
+
+	for (double overlap : {0.001, 0.01, 0.1, 0.5})
+	{
+		size_t n_both = (size_t)(overlap * n);
+		std::string params = "r=6 b=12 n=" + std::to_string(n) + " overlap=" + std::to_string(overlap);
+
+		bench.run("hllJointCount", params, n_trials, [&](Timer &timer)
+		{
+			double joint_error = 0;
+			double incl_excl_error = 0;
+
+			for (size_t trial = 0; trial < n_trials; trial++)
+			{
+				struct HyperLogLog a, b, both;
+				struct HyperLogLogJoint joint;
+
+				hllInit(&a, MEDIUM, 12, &hash);
+				hllInit(&b, MEDIUM, 12, &hash);
+				hllInit(&both, MEDIUM, 12, &hash);
+
+				// A = [offset, offset + n), B = [offset + n - n_both, offset + 2 * n - n_both)
+				uintptr_t offset = (trial + 1) * 10 * n;
+
+				for (uintptr_t i = offset; i < offset + n; i++)
+					hllAdd(&a, (const void *)i);
+				for (uintptr_t i = offset + n - n_both; i < offset + 2 * n - n_both; i++)
+					hllAdd(&b, (const void *)i);
+
+				timer.start();
+				hllJointCount(&a, &b, &joint);
+				timer.stop();
+
+				hllMerge(&both, &a);
+				hllMerge(&both, &b);
+				double incl_excl = hllCount(&a) + hllCount(&b) - hllCount(&both);
+
+				joint_error += pow((joint.intersection - n_both) / n_both, 2);
+				incl_excl_error += pow((incl_excl - n_both) / n_both, 2);
+
+				hllFree(&a);
+				hllFree(&b);
+				hllFree(&both);
+			}
+
+			timer.record("rmse_joint", sqrt(joint_error / n_trials));
+			timer.record("rmse_incl_excl", sqrt(incl_excl_error / n_trials));
+
+			return 2 * hllDataSize(MEDIUM, 12);
+		});
+	}
+}
+
+/**
+ * Measures adding every item to many sketches (e.g. one per dimension), with the hash function called by every sketch
+ * (`hllAdd()`) compared to hashing every item once (`hllAddHash()` per item, or `hllAddHashes()` per batch).
+ */
+static void benchFanOut(Bench &bench)
+{
+	const size_t n = std::min<size_t>(bench.sizes().back(), 1000000);
+	const size_t batch_size = 1024;
+
+	for (unsigned char r : {SMALL, MEDIUM})
+	{
+		for (size_t n_sketches : {1, 4, 12})
+		{
+			std::string params = "r=" + std::to_string(r) + " b=11 sketches=" + std::to_string(n_sketches) + " n=" +
+				std::to_string(n);
+			std::vector<struct HyperLogLog> sketches(n_sketches);
+
+			for (struct HyperLogLog &sketch : sketches)
+				hllInit(&sketch, r, 11, &hashExpand);
+
+			// one operation is one item added to all sketches
+			bench.run("hllFanOut", params + " api=hllAdd", n, [&](Timer &timer)
+			{
+				timer.start();
+				for (uint64_t item = 0; item < n; item++)
+				{
+					for (struct HyperLogLog &sketch : sketches)
+						hllAdd(&sketch, &item);
+				}
+				timer.stop();
+
+				return n_sketches * hllDataSize(r, 11);
+			});
+
+			bench.run("hllFanOut", params + " api=hllAddHash", n, [&](Timer &timer)
+			{
+				timer.start();
+				for (uint64_t item = 0; item < n; item++)
+				{
+					uint64_t hash;
+					hashExpand(&item, sizeof(hash), &hash);
+
+					for (struct HyperLogLog &sketch : sketches)
+						hllAddHash(&sketch, hash);
+				}
+				timer.stop();
+
+				return n_sketches * hllDataSize(r, 11);
+			});
+
+			bench.run("hllFanOut", params + " api=hllAddHashes", n, [&](Timer &timer)
+			{
+				std::vector<uint64_t> hashes(batch_size);
+
+				timer.start();
+				for (uint64_t first = 0; first < n; first += batch_size)
+				{
+					size_t n_batch = std::min(batch_size, (size_t)(n - first));
+
+					for (size_t i = 0; i < n_batch; i++)
+					{
+						uint64_t item = first + i;
+						hashExpand(&item, sizeof(hashes[i]), &hashes[i]);
+					}
+
+					for (struct HyperLogLog &sketch : sketches)
+						hllAddHashes(&sketch, hashes.data(), n_batch);
+				}
+				timer.stop();
+
+				return n_sketches * hllDataSize(r, 11) + batch_size * sizeof(uint64_t);
+			});
+
+			for (struct HyperLogLog &sketch : sketches)
+				hllFree(&sketch);
+		}
+	}
+}
+
+void benchHyperLogLog(Bench &bench)
+{
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		for (unsigned char b : {4, 8, 11, 14, 16})
+		{
+			std::string params = "r=" + std::to_string(r) + " b=" + std::to_string(b);
+
+			for (size_t n : bench.sizes())
+			{
+				bench.run("hllAdd", params + " n=" + std::to_string(n), n, [&](Timer &timer)
+				{
+					struct HyperLogLog hll;
+					hllInit(&hll, r, b, &hash);
+
+					timer.start();
+					for (uintptr_t i = 0; i < n; i++)
+						hllAdd(&hll, (const void *)i);
+					timer.stop();
+
+					hllFree(&hll);
+
+					return hllDataSize(r, b);
+				});
+			}
+
+			struct HyperLogLog hll;
+			hllInit(&hll, r, b, &hash);
+
+			for (uintptr_t i = 0; i < 100000; i++)
+				hllAdd(&hll, (const void *)i);
+
+			size_t n_counts = b > 14 ? 100 : 1000;
+
+			bench.run("hllCount", params, n_counts, [&](Timer &timer)
+			{
+				double sum = 0;
+
+				timer.start();
+				for (size_t i = 0; i < n_counts; i++)
+					sum += hllCount(&hll);
+				timer.stop();
+
+				doNotOptimize(sum);
+
+				return hllDataSize(r, b);
+			});
+
+			bench.run("hllMerge", params, n_counts, [&](Timer &timer)
+			{
+				struct HyperLogLog other;
+				hllInit(&other, r, b, &hash);
+
+				timer.start();
+				for (size_t i = 0; i < n_counts; i++)
+					hllMerge(&other, &hll);
+				timer.stop();
+
+				hllFree(&other);
+
+				return hllDataSize(r, b);
+			});
+
+			hllFree(&hll);
+		}
+	}
+
+	benchFold(bench);
+	benchSmallLayout(bench);
+	benchMediumLayout(bench);
+	benchJointCount(bench);
+	benchFanOut(bench);
+}
@@ -0,0 +1,155 @@
+#include <string>
+#include <thread>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLogPipeline.h"
+}
+
+/**
+ * Adds the items `[first, first + n)` to a LARGE set, that is shared with other threads, with an atomic maximum per
+ * register.
+ */
+static void addShared(struct HyperLogLog *set, uint64_t first, uint64_t n)
+{
+	uint8_t *registers = (uint8_t *)set->data;
+
+	for (uint64_t item = first; item < first + n; item++)
+	{
+		uint64_t hash;
+
+		hashExpand(&item, sizeof(hash), &hash);
+
+		uint8_t *reg = registers + (hash & (((uint64_t)1 << set->b) - 1));
+		uint8_t value = (uint8_t)(__builtin_clzll(hash | (uint64_t)1 << (set->b - 1)) + 1);
+		uint8_t old = __atomic_load_n(reg, __ATOMIC_RELAXED);
+
+		while (value > old && !__atomic_compare_exchange_n(reg, &old, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+	}
+}
+
+/**
+ * Adds the items `[first, first + n)` to a set, that is only used by this thread.
+ */
+static void addPrivate(struct HyperLogLog *set, uint64_t first, uint64_t n)
+{
+	for (uint64_t item = first; item < first + n; item++)
+	{
+		uint64_t hash;
+
+		hashExpand(&item, sizeof(hash), &hash);
+		hllAddHash(set, hash);
+	}
+}
+
+/**
+ * Adds the items `[first, first + n)` to a pipeline as reader `reader`.
+ */
+static void addPipeline(struct HyperLogLogPipeline *pipeline, size_t reader, uint64_t first, uint64_t n)
+{
+	for (uint64_t item = first; item < first + n; item++)
+		hllPipelineAdd(pipeline, reader, &item);
+
+	hllPipelineFlush(pipeline, reader);
+}
+
+/**
+ * Compares three ways to fill one set from several threads: an atomic maximum on the shared registers, one set per
+ * thread that are merged at the end, and the pipeline (with as many workers as readers).
+ */
+void benchHyperLogLogPipeline(Bench &bench)
+{
+	const unsigned char b = 14;
+
+	for (size_t n : bench.sizes())
+	{
+		for (size_t n_threads : threadCounts())
+		{
+			std::string params = "n=" + std::to_string(n) + " threads=" + std::to_string(n_threads);
+			uint64_t share = n / n_threads;
+
+			bench.run("hllShared", params, n, [&](Timer &timer)
+			{
+				struct HyperLogLog set;
+				std::vector<std::thread> threads;
+
+				hllInit(&set, LARGE, b, &hashExpand);
+
+				timer.start();
+				for (size_t i = 0; i < n_threads; i++)
+					threads.emplace_back(&addShared, &set, i * share, i + 1 < n_threads ? share : n - i * share);
+
+				for (std::thread &thread : threads)
+					thread.join();
+
+				double count = hllCount(&set);
+				timer.stop();
+
+				timer.record("error", count / n - 1);
+				hllFree(&set);
+
+				return hllDataSize(LARGE, b);
+			});
+
+			bench.run("hllPerThread", params, n, [&](Timer &timer)
+			{
+				std::vector<struct HyperLogLog> sets(n_threads);
+				std::vector<std::thread> threads;
+
+				for (struct HyperLogLog &set : sets)
+					hllInit(&set, LARGE, b, &hashExpand);
+
+				timer.start();
+				for (size_t i = 0; i < n_threads; i++)
+					threads.emplace_back(&addPrivate, &sets[i], i * share, i + 1 < n_threads ? share : n - i * share);
+
+				for (std::thread &thread : threads)
+					thread.join();
+
+				for (size_t i = 1; i < n_threads; i++)
+					hllMerge(&sets[0], &sets[i]);
+
+				double count = hllCount(&sets[0]);
+				timer.stop();
+
+				timer.record("error", count / n - 1);
+
+				for (struct HyperLogLog &set : sets)
+					hllFree(&set);
+
+				return n_threads * hllDataSize(LARGE, b);
+			});
+
+			bench.run("hllPipeline", params, n, [&](Timer &timer)
+			{
+				struct HyperLogLog set;
+				struct HyperLogLogPipeline pipeline;
+				std::vector<std::thread> threads;
+
+				hllInit(&set, LARGE, b, &hashExpand);
+
+				timer.start();
+				hllPipelineInit(&pipeline, &set, n_threads, n_threads, 0);
+
+				for (size_t i = 0; i < n_threads; i++)
+					threads.emplace_back(&addPipeline, &pipeline, i, i * share, i + 1 < n_threads ? share : n - i * share);
+
+				for (std::thread &thread : threads)
+					thread.join();
+
+				double count = hllPipelineCount(&pipeline);
+				hllPipelineFree(&pipeline);
+				timer.stop();
+
+				timer.record("error", count / n - 1);
+				hllFree(&set);
+
+				return hllDataSize(LARGE, b) + n_threads * n_threads * HLL_PIPELINE_CAPACITY * sizeof(uint64_t);
+			});
+		}
+	}
+}
@@ -0,0 +1,159 @@
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/HyperLogLogStore.h"
+}
+
+static void hash(const void *item, size_t h, void *buffer)
+{
+	uint64_t state = (uintptr_t)item;
+	char *bytes = (char *)buffer;
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t word = splitmix64(state);
+		memcpy(bytes + i, &word, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+void benchHyperLogLogStore(Bench &bench)
+{
+	const unsigned char r = SMALL;
+	const unsigned char b = 6;
+
+	for (size_t n_keys : bench.sizes())
+	{
+		// 4 (key, item) pairs per key, in random order
+		const size_t n_pairs = 4 * n_keys;
+		std::vector<uint64_t> keys(n_pairs);
+		std::vector<const void *> items(n_pairs);
+		uint64_t state = n_keys;
+
+		for (size_t i = 0; i < n_pairs; i++)
+		{
+			keys[i] = splitmix64(state) % n_keys;
+			items[i] = (const void *)(uintptr_t)splitmix64(state);
+		}
+
+		std::string params = "r=4 b=6 keys=" + std::to_string(n_keys) + " pairs=" + std::to_string(n_pairs);
+
+		// one separately allocated sketch per key in a hash map
+		bench.run("hllStoreAdd", params + " impl=map", n_pairs, [&](Timer &timer)
+		{
+			std::unordered_map<uint64_t, struct HyperLogLog> map;
+
+			timer.start();
+			for (size_t i = 0; i < n_pairs; i++)
+			{
+				auto it = map.find(keys[i]);
+
+				if (it == map.end())
+				{
+					it = map.emplace(keys[i], HyperLogLog()).first;
+					hllInit(&it->second, r, b, &hash);
+				}
+
+				hllAdd(&it->second, items[i]);
+			}
+			timer.stop();
+
+			// sketch, node (key, sketch and next pointer) and bucket
+			size_t memory = map.size() * (hllDataSize(r, b) + sizeof(*map.begin()) + 2 * sizeof(void *)) +
+				map.bucket_count() * sizeof(void *);
+
+			for (auto &entry : map)
+				hllFree(&entry.second);
+
+			return memory;
+		});
+
+		bench.run("hllStoreAdd", params + " impl=single", n_pairs, [&](Timer &timer)
+		{
+			struct HyperLogLogStore store;
+			hllStoreInit(&store, r, b, &hash);
+
+			timer.start();
+			for (size_t i = 0; i < n_pairs; i++)
+				hllStoreAdd(&store, keys[i], items[i]);
+			timer.stop();
+
+			size_t memory = hllStoreMemory(&store);
+			hllStoreFree(&store);
+
+			return memory;
+		});
+
+		bench.run("hllStoreAdd", params + " impl=batch", n_pairs, [&](Timer &timer)
+		{
+			struct HyperLogLogStore store;
+			hllStoreInit(&store, r, b, &hash);
+
+			timer.start();
+			hllStoreAddBatch(&store, keys.data(), items.data(), n_pairs);
+			timer.stop();
+
+			size_t memory = hllStoreMemory(&store);
+			hllStoreFree(&store);
+
+			return memory;
+		});
+
+		struct HyperLogLogStore store;
+		hllStoreInit(&store, r, b, &hash);
+		hllStoreAddBatch(&store, keys.data(), items.data(), n_pairs);
+
+		std::vector<uint64_t> query(keys.begin(), keys.begin() + n_keys);
+		std::vector<double> results(n_keys);
+
+		bench.run("hllStoreCount", params, n_keys, [&](Timer &timer)
+		{
+			timer.start();
+			hllStoreCount(&store, query.data(), n_keys, results.data());
+			timer.stop();
+
+			doNotOptimize(results[0]);
+
+			return hllStoreMemory(&store);
+		});
+
+		bench.run("hllStoreMerge", params, n_keys, [&](Timer &timer)
+		{
+			struct HyperLogLog all;
+			hllInit(&all, r, b, &hash);
+
+			timer.start();
+			hllStoreMerge(&store, query.data(), n_keys, &all);
+			timer.stop();
+
+			hllFree(&all);
+
+			return hllStoreMemory(&store);
+		});
+
+		// a budget of a quarter of the keys
+		bench.run("hllStoreAdd", params + " impl=batch budget=1/4", n_pairs, [&](Timer &timer)
+		{
+			struct HyperLogLogStore limited;
+			hllStoreInit(&limited, r, b, &hash);
+			hllStoreLimit(&limited, hllStoreMemory(&store) / 4, NULL, NULL);
+
+			timer.start();
+			hllStoreAddBatch(&limited, keys.data(), items.data(), n_pairs);
+			timer.stop();
+
+			timer.record("kept_keys", (double)limited.count / store.count);
+
+			size_t memory = hllStoreMemory(&limited);
+			hllStoreFree(&limited);
+
+			return memory;
+		});
+
+		hllStoreFree(&store);
+	}
+}
@@ -0,0 +1,112 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+extern "C"
+{
+#include "../inc/SlidingHyperLogLog.h"
+}
+
+static void hash(const void *item, size_t h, void *buffer)
+{
+	uint64_t state = (uintptr_t)item;
+	char *bytes = (char *)buffer;
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t word = splitmix64(state);
+		memcpy(bytes + i, &word, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+void benchSlidingHyperLogLog(Bench &bench)
+{
+	const unsigned char b = 12;
+	const size_t register_bytes = ((size_t)1 << b) / 10 * 8 + 8;
+
+	for (size_t n_slots : {64, 512, 4096})
+	{
+		struct SlidingHyperLogLog window;
+		shllInit(&window, MEDIUM, b, &hash, n_slots, 1);
+
+		// the rotating sketches that have to be re-merged for every query
+		std::vector<struct HyperLogLog> slots(n_slots);
+		for (struct HyperLogLog &slot : slots)
+			hllInit(&slot, MEDIUM, b, &hash);
+
+		// 100 items per slot
+		const size_t n_items = 100 * n_slots;
+		const size_t memory = 2 * n_slots * (register_bytes + sizeof(struct HyperLogLog) + 1);
+		std::string params = "r=6 b=12 slots=" + std::to_string(n_slots);
+
+		bench.run("shllAdd", params, n_items, [&](Timer &timer)
+		{
+			timer.start();
+			for (uintptr_t i = 0; i < n_items; i++)
+				shllAdd(&window, (const void *)i, i / 100);
+			timer.stop();
+
+			return memory;
+		});
+
+		for (uintptr_t i = 0; i < n_items; i++)
+			hllAdd(&slots[i / 100], (const void *)i);
+
+		uint64_t now = n_slots - 1;
+
+		for (size_t n_window_slots : {(size_t)1, n_slots / 8, n_slots / 2 + 1, n_slots})
+		{
+			std::string window_params = params + " window=" + std::to_string(n_window_slots);
+			const size_t n_queries = 100;
+
+			bench.run("shllCount", window_params, n_queries, [&](Timer &timer)
+			{
+				double sum = 0;
+
+				timer.start();
+				for (size_t i = 0; i < n_queries; i++)
+				{
+					// adding an item makes the pre-merged sketches dirty, like in a real stream
+					shllAdd(&window, (const void *)(n_items + i), now);
+					sum += shllCount(&window, now, n_window_slots);
+				}
+				timer.stop();
+
+				doNotOptimize(sum);
+
+				return memory;
+			});
+
+			bench.run("shllCountRebuild", window_params, n_queries, [&](Timer &timer)
+			{
+				struct HyperLogLog result;
+				hllInit(&result, MEDIUM, b, &hash);
+				double sum = 0;
+
+				timer.start();
+				for (size_t i = 0; i < n_queries; i++)
+				{
+					hllAdd(&slots[now], (const void *)(n_items + i));
+					hllClear(&result);
+
+					for (size_t slot = n_slots - n_window_slots; slot < n_slots; slot++)
+						hllMerge(&result, &slots[slot]);
+
+					sum += hllCount(&result);
+				}
+				timer.stop();
+
+				hllFree(&result);
+				doNotOptimize(sum);
+
+				return n_slots * (register_bytes + sizeof(struct HyperLogLog));
+			});
+		}
+
+		for (struct HyperLogLog &slot : slots)
+			hllFree(&slot);
+
+		shllFree(&window);
+	}
+}
@@ -0,0 +1,19 @@
+#include "Bench.h"
+
+int main(int argc, char **argv)
+{
+	Bench bench(argc, argv);
+
+	benchAvlSet(bench);
+	benchAvlTree(bench);
+	benchBitOps(bench);
+	benchHash(bench);
+	benchHyperLogLog(bench);
+	benchHyperLogLogPipeline(bench);
+	benchHyperLogLogStore(bench);
+	benchSlidingHyperLogLog(bench);
+
+	bench.report();
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+#ifndef AUD_ALLOCATOR_H
+#define AUD_ALLOCATOR_H
+
+/**
+ * @file Allocator.h
+ *
+ * Contains the struct definition of `struct Allocator` as well as related function prototypes.
+ */
+
+#include <stddef.h>
+
+/**
+ * Allocates the memory of data structures, counts the allocated bytes and enforces a memory budget.
+ *
+ * AVL trees (see `avlSetAllocator()`) and HyperLogLog sets (see `hllInitAllocator()`) can allocate their memory through
+ * an allocator. Without one, they use `malloc()` and `free()` directly (that's the default). The data structures pass
+ * the size of every block to `allocatorFree()`, so the allocator knows exactly how many bytes are in use, without
+ * storing a header per block.
+ *
+ * An allocator can be shared by any number of data structures, e.g. to enforce one global budget for all of them, or
+ * every data structure can have its own one. If an allocation would exceed the budget, it fails like a failed
+ * `malloc()`, and the data structure reports a malloc error. The accounting uses atomic operations, so an allocator can
+ * be used by several threads at the same time.
+ *
+ * The memory itself comes from `malloc()`, unless `allocate` and `release` are replaced after `allocatorInit()` (e.g.
+ * by an arena or a pool).
+ *
+ * The members `limit`, `allocate`, `release` and `context` may be changed, as long as no other thread uses the
+ * allocator. The counters may be read directly, if no other thread uses the allocator, or with `allocatorUsed()`.
+ *
+ * @see allocatorInit()
+ * @see allocatorMalloc()
+ * @see allocatorCalloc()
+ * @see allocatorFree()
+ * @see allocatorUsed()
+ */
+struct Allocator
+{
+	/**
+	 * Allocates `size` bytes, like `malloc()`.
+	 *
+	 * @param context The member `context` of the allocator.
+	 * @return The allocated block, or `NULL` on failure.
+	 */
+	void *(*allocate)(void *context, size_t size);
+
+	/**
+	 * Frees a block, that was returned by `allocate`.
+	 *
+	 * @param context The member `context` of the allocator.
+	 * @param size The size of the block, as it was passed to `allocate`.
+	 */
+	void (*release)(void *context, void *pointer, size_t size);
+
+	/**
+	 * Is passed to `allocate` and `release`.
+	 */
+	void *context;
+
+	/**
+	 * The memory budget in bytes, or 0 if there is none. `used` never exceeds it.
+	 */
+	size_t limit;
+
+	/**
+	 * The number of bytes, that are allocated at the moment.
+	 */
+	size_t used;
+
+	/**
+	 * The greatest value of `used` so far.
+	 */
+	size_t peak;
+
+	/**
+	 * The number of allocations, that failed (because of the budget, or because `allocate` returned `NULL`).
+	 */
+	size_t failures;
+};
+
+/**
+ * Initializes an allocator, that allocates memory with `malloc()`.
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the allocator to be initialized.
+ * @param limit The memory budget in bytes, or 0 for no budget.
+ */
+void allocatorInit(struct Allocator *_this, size_t limit);
+
+/**
+ * Allocates a block of memory, if it fits into the budget.
+ *
+ * @param _this Points to the allocator, or `NULL` to use `malloc()` directly.
+ * @param size The size of the block in bytes.
+ * @return The allocated block, or `NULL` if the budget would be exceeded or the allocation failed.
+ */
+void *allocatorMalloc(struct Allocator *_this, size_t size);
+
+/**
+ * Allocates a block of memory, that is filled with zeros, if it fits into the budget (see `allocatorMalloc()`).
+ *
+ * @param _this Points to the allocator, or `NULL` to use `calloc()` directly.
+ * @param size The size of the block in bytes.
+ * @return The allocated block, or `NULL` if the budget would be exceeded or the allocation failed.
+ */
+void *allocatorCalloc(struct Allocator *_this, size_t size);
+
+/**
+ * Frees a block of memory, that was allocated with `allocatorMalloc()` or `allocatorCalloc()`.
+ *
+ * If `pointer` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the allocator, that allocated the block, or `NULL` to use `free()` directly.
+ * @param pointer The block to free.
+ * @param size The size of the block, as it was passed when it was allocated.
+ */
+void allocatorFree(struct Allocator *_this, void *pointer, size_t size);
+
+/**
+ * Returns the number of bytes, that are allocated at the moment (safe while other threads use the allocator).
+ *
+ * @param _this Points to the allocator.
+ * @return The number of allocated bytes, or 0 if `_this` is `NULL`.
+ */
+size_t allocatorUsed(struct Allocator *_this);
+
+#endif //AUD_ALLOCATOR_H
@@ -0,0 +1,1154 @@
+#ifndef AUD_AVLSET_HPP
+#define AUD_AVLSET_HPP
+
+/**
+ * @file AvlSet.hpp
+ *
+ * Contains the header-only C++11 containers `aud::avl_set` and `aud::avl_map`, that are built on top of
+ * `struct AvlTree`.
+ *
+ * Unlike `struct AvlTree`, which stores pointers to items that are owned by the caller, these containers own their
+ * items and store them inline in the nodes. The nodes embed a `struct AvlNode` and are linked into the tree with
+ * `avlLinkNode()` and `avlUnlinkNode()`, so the balancing code is shared with the C library, while the search uses the
+ * (inlined) `Compare` of the container instead of a function pointer.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+extern "C"
+{
+#include "AvlTree.h"
+}
+
+namespace aud
+{
+
+namespace detail
+{
+
+/**
+ * A node of `avl_tree`. The value is constructed in `storage` by the allocator of the container.
+ */
+template <typename Value>
+struct avl_node
+{
+	/**
+	 * The node of the C library. `base.value` points to the inline value, so the node is a valid `struct AvlNode`.
+	 */
+	struct AvlNode base;
+
+	typename std::aligned_storage<sizeof(Value), alignof(Value)>::type storage;
+
+	Value *valptr()
+	{
+		return reinterpret_cast<Value *>(&storage);
+	}
+};
+
+/**
+ * Returns the leftmost node of the subtree of `node`, or `nullptr` if `node` is `nullptr`.
+ */
+inline struct AvlNode *avl_first(struct AvlNode *node)
+{
+	if (node != nullptr)
+	{
+		while (node->left != nullptr)
+			node = node->left;
+	}
+
+	return node;
+}
+
+/**
+ * Returns the rightmost node of the subtree of `node`, or `nullptr` if `node` is `nullptr`.
+ */
+inline struct AvlNode *avl_last(struct AvlNode *node)
+{
+	if (node != nullptr)
+	{
+		while (node->right != nullptr)
+			node = node->right;
+	}
+
+	return node;
+}
+
+/**
+ * Returns the in-order successor of `node`, or `nullptr` if `node` is the last node.
+ */
+inline struct AvlNode *avl_next(struct AvlNode *node)
+{
+	if (node->right != nullptr)
+		return avl_first(node->right);
+
+	struct AvlNode *parent = node->parent;
+
+	while (parent != nullptr && node == parent->right)
+	{
+		node = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+/**
+ * Returns the in-order predecessor of `node`, or `nullptr` if `node` is the first node.
+ */
+inline struct AvlNode *avl_prev(struct AvlNode *node)
+{
+	if (node->left != nullptr)
+		return avl_last(node->left);
+
+	struct AvlNode *parent = node->parent;
+
+	while (parent != nullptr && node == parent->left)
+	{
+		node = parent;
+		parent = parent->parent;
+	}
+
+	return parent;
+}
+
+/**
+ * Extracts the key of a set item (the item itself).
+ */
+struct avl_identity
+{
+	template <typename T>
+	const T &operator()(const T &value) const
+	{
+		return value;
+	}
+};
+
+/**
+ * Extracts the key of a map item (`first`).
+ */
+struct avl_select_first
+{
+	template <typename Pair>
+	const typename Pair::first_type &operator()(const Pair &pair) const
+	{
+		return pair.first;
+	}
+};
+
+template <typename Key, typename Value, typename KeyOfValue, typename Compare, typename Allocator, bool Mutable>
+class avl_tree;
+
+/**
+ * A bidirectional iterator over the items of an `avl_tree`, in ascending order.
+ *
+ * The iterator stays valid until its item is erased. The end iterator remembers its tree, so it can be decremented.
+ */
+template <typename Value, bool Const>
+class avl_iterator
+{
+public:
+	typedef std::bidirectional_iterator_tag iterator_category;
+	typedef Value value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef typename std::conditional<Const, const Value *, Value *>::type pointer;
+	typedef typename std::conditional<Const, const Value &, Value &>::type reference;
+
+	avl_iterator() : tree(nullptr), node(nullptr)
+	{
+	}
+
+	avl_iterator(const struct AvlTree *tree, struct AvlNode *node) : tree(tree), node(node)
+	{
+	}
+
+	/**
+	 * Converts a mutable iterator into a const iterator.
+	 */
+	template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+	avl_iterator(const avl_iterator<Value, OtherConst> &other) : tree(other.tree), node(other.node)
+	{
+	}
+
+	reference operator*() const
+	{
+		return *reinterpret_cast<avl_node<Value> *>(node)->valptr();
+	}
+
+	pointer operator->() const
+	{
+		return reinterpret_cast<avl_node<Value> *>(node)->valptr();
+	}
+
+	avl_iterator &operator++()
+	{
+		node = avl_next(node);
+		return *this;
+	}
+
+	avl_iterator operator++(int)
+	{
+		avl_iterator old = *this;
+		node = avl_next(node);
+		return old;
+	}
+
+	avl_iterator &operator--()
+	{
+		node = node == nullptr ? tree->max : avl_prev(node);
+		return *this;
+	}
+
+	avl_iterator operator--(int)
+	{
+		avl_iterator old = *this;
+		--*this;
+		return old;
+	}
+
+	friend bool operator==(const avl_iterator &a, const avl_iterator &b)
+	{
+		return a.node == b.node;
+	}
+
+	friend bool operator!=(const avl_iterator &a, const avl_iterator &b)
+	{
+		return a.node != b.node;
+	}
+
+private:
+	template <typename, bool>
+	friend class avl_iterator;
+
+	template <typename, typename, typename, typename, typename, bool>
+	friend class avl_tree;
+
+	const struct AvlTree *tree;
+	struct AvlNode *node;
+};
+
+/**
+ * The common implementation of `avl_set` and `avl_map`: an ordered container of unique keys, whose items are stored
+ * inline in the nodes of a `struct AvlTree`.
+ *
+ * @tparam Key The type of the keys.
+ * @tparam Value The type of the items (`Key` for sets, `std::pair<const Key, T>` for maps).
+ * @tparam KeyOfValue Extracts the key of an item.
+ * @tparam Compare Orders the keys. If it has a member type `is_transparent`, the lookup functions accept any type that
+ * can be compared with the keys (heterogeneous lookup).
+ * @tparam Allocator Allocates the nodes (rebound with `std::allocator_traits`) and constructs the items in them.
+ * @tparam Mutable true, if the items can be modified through iterators (maps).
+ */
+template <typename Key, typename Value, typename KeyOfValue, typename Compare, typename Allocator, bool Mutable>
+class avl_tree
+{
+protected:
+	typedef avl_node<Value> node_type;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node_type> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+
+	static_assert(std::is_standard_layout<node_type>::value, "avl_node must start with its struct AvlNode");
+
+public:
+	typedef Key key_type;
+	typedef Value value_type;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Compare key_compare;
+	typedef Allocator allocator_type;
+	typedef value_type &reference;
+	typedef const value_type &const_reference;
+	typedef typename std::allocator_traits<Allocator>::pointer pointer;
+	typedef typename std::allocator_traits<Allocator>::const_pointer const_pointer;
+	typedef avl_iterator<Value, !Mutable> iterator;
+	typedef avl_iterator<Value, true> const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	avl_tree() : avl_tree(Compare())
+	{
+	}
+
+	explicit avl_tree(const Compare &comp, const Allocator &alloc = Allocator()) : comp(comp), alloc(alloc)
+	{
+		avlInit(&tree, nullptr);
+	}
+
+	explicit avl_tree(const Allocator &alloc) : avl_tree(Compare(), alloc)
+	{
+	}
+
+	template <typename InputIt>
+	avl_tree(InputIt first, InputIt last, const Compare &comp = Compare(), const Allocator &alloc = Allocator())
+		: avl_tree(comp, alloc)
+	{
+		insert(first, last);
+	}
+
+	avl_tree(std::initializer_list<value_type> init, const Compare &comp = Compare(),
+		const Allocator &alloc = Allocator()) : avl_tree(comp, alloc)
+	{
+		insert(init);
+	}
+
+	avl_tree(const avl_tree &other)
+		: comp(other.comp), alloc(node_traits::select_on_container_copy_construction(other.alloc))
+	{
+		avlInit(&tree, nullptr);
+		copyFrom(other);
+	}
+
+	avl_tree(const avl_tree &other, const Allocator &alloc) : avl_tree(other.comp, alloc)
+	{
+		copyFrom(other);
+	}
+
+	avl_tree(avl_tree &&other) noexcept : comp(std::move(other.comp)), alloc(std::move(other.alloc))
+	{
+		avlInit(&tree, nullptr);
+		steal(other);
+	}
+
+	avl_tree(avl_tree &&other, const Allocator &alloc) : avl_tree(other.comp, alloc)
+	{
+		if (this->alloc == other.alloc)
+			steal(other);
+		else
+			moveFrom(other);
+	}
+
+	~avl_tree()
+	{
+		clear();
+	}
+
+	avl_tree &operator=(const avl_tree &other)
+	{
+		if (this != &other)
+		{
+			clear();
+			comp = other.comp;
+			assignAllocator(other.alloc, typename node_traits::propagate_on_container_copy_assignment());
+			copyFrom(other);
+		}
+
+		return *this;
+	}
+
+	avl_tree &operator=(avl_tree &&other) noexcept(node_traits::propagate_on_container_move_assignment::value)
+	{
+		if (this != &other)
+		{
+			clear();
+			comp = std::move(other.comp);
+			moveAssign(other, typename node_traits::propagate_on_container_move_assignment());
+		}
+
+		return *this;
+	}
+
+	avl_tree &operator=(std::initializer_list<value_type> init)
+	{
+		clear();
+		insert(init);
+
+		return *this;
+	}
+
+	allocator_type get_allocator() const
+	{
+		return allocator_type(alloc);
+	}
+
+	key_compare key_comp() const
+	{
+		return comp;
+	}
+
+	// iterators
+
+	iterator begin() noexcept
+	{
+		return iterator(&tree, tree.min);
+	}
+
+	const_iterator begin() const noexcept
+	{
+		return const_iterator(&tree, tree.min);
+	}
+
+	const_iterator cbegin() const noexcept
+	{
+		return begin();
+	}
+
+	iterator end() noexcept
+	{
+		return iterator(&tree, nullptr);
+	}
+
+	const_iterator end() const noexcept
+	{
+		return const_iterator(&tree, nullptr);
+	}
+
+	const_iterator cend() const noexcept
+	{
+		return end();
+	}
+
+	reverse_iterator rbegin() noexcept
+	{
+		return reverse_iterator(end());
+	}
+
+	const_reverse_iterator rbegin() const noexcept
+	{
+		return const_reverse_iterator(end());
+	}
+
+	const_reverse_iterator crbegin() const noexcept
+	{
+		return rbegin();
+	}
+
+	reverse_iterator rend() noexcept
+	{
+		return reverse_iterator(begin());
+	}
+
+	const_reverse_iterator rend() const noexcept
+	{
+		return const_reverse_iterator(begin());
+	}
+
+	const_reverse_iterator crend() const noexcept
+	{
+		return rend();
+	}
+
+	// capacity
+
+	bool empty() const noexcept
+	{
+		return tree.count == 0;
+	}
+
+	size_type size() const noexcept
+	{
+		return tree.count;
+	}
+
+	size_type max_size() const noexcept
+	{
+		return node_traits::max_size(alloc);
+	}
+
+	/**
+	 * Returns the number of bytes that one node occupies (not counting allocator overhead).
+	 */
+	static constexpr size_type node_size() noexcept
+	{
+		return sizeof(node_type);
+	}
+
+	// modifiers
+
+	void clear() noexcept
+	{
+		destroySubtree(tree.root);
+		tree.root = nullptr;
+		tree.min = nullptr;
+		tree.max = nullptr;
+		tree.count = 0;
+	}
+
+	std::pair<iterator, bool> insert(const value_type &value)
+	{
+		return insertUnique(KeyOfValue()(value), value);
+	}
+
+	std::pair<iterator, bool> insert(value_type &&value)
+	{
+		return insertUnique(KeyOfValue()(value), std::move(value));
+	}
+
+	iterator insert(const_iterator, const value_type &value)
+	{
+		return insert(value).first;
+	}
+
+	iterator insert(const_iterator, value_type &&value)
+	{
+		return insert(std::move(value)).first;
+	}
+
+	template <typename InputIt>
+	void insert(InputIt first, InputIt last)
+	{
+		for (; first != last; ++first)
+			emplace(*first);
+	}
+
+	void insert(std::initializer_list<value_type> init)
+	{
+		insert(init.begin(), init.end());
+	}
+
+	/**
+	 * Constructs an item in place. The node is always allocated, because the key is only known after the item was
+	 * constructed. If the key already exists, the new item is destroyed again.
+	 */
+	template <typename... Args>
+	std::pair<iterator, bool> emplace(Args &&...args)
+	{
+		node_type *node = createNode(std::forward<Args>(args)...);
+		Position position = search(KeyOfValue()(*node->valptr()));
+
+		if (position.existing != nullptr)
+		{
+			destroyNode(node);
+			return std::pair<iterator, bool>(iterator(&tree, position.existing), false);
+		}
+
+		avlLinkNode(&tree, &node->base, position.parent, position.right);
+
+		return std::pair<iterator, bool>(iterator(&tree, &node->base), true);
+	}
+
+	template <typename... Args>
+	iterator emplace_hint(const_iterator, Args &&...args)
+	{
+		return emplace(std::forward<Args>(args)...).first;
+	}
+
+	iterator erase(const_iterator position)
+	{
+		struct AvlNode *node = position.node;
+		struct AvlNode *next = avl_next(node);
+
+		avlUnlinkNode(&tree, node);
+		destroyNode(reinterpret_cast<node_type *>(node));
+
+		return iterator(&tree, next);
+	}
+
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		while (first != last)
+			first = erase(first);
+
+		return iterator(&tree, last.node);
+	}
+
+	size_type erase(const key_type &key)
+	{
+		struct AvlNode *node = findNode(key);
+		if (node == nullptr)
+			return 0;
+
+		erase(const_iterator(&tree, node));
+
+		return 1;
+	}
+
+	void swap(avl_tree &other) noexcept
+	{
+		using std::swap;
+
+		swap(tree.root, other.tree.root);
+		swap(tree.min, other.tree.min);
+		swap(tree.max, other.tree.max);
+		swap(tree.count, other.tree.count);
+		swap(comp, other.comp);
+		swapAllocator(other.alloc, typename node_traits::propagate_on_container_swap());
+	}
+
+	friend void swap(avl_tree &a, avl_tree &b) noexcept
+	{
+		a.swap(b);
+	}
+
+	// lookup
+
+	size_type count(const key_type &key) const
+	{
+		return findNode(key) != nullptr;
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	size_type count(const K &key) const
+	{
+		return std::distance(lower_bound(key), upper_bound(key));
+	}
+
+	bool contains(const key_type &key) const
+	{
+		return findNode(key) != nullptr;
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	bool contains(const K &key) const
+	{
+		return findNode(key) != nullptr;
+	}
+
+	iterator find(const key_type &key)
+	{
+		return makeIterator(findNode(key));
+	}
+
+	const_iterator find(const key_type &key) const
+	{
+		return const_iterator(&tree, findNode(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	iterator find(const K &key)
+	{
+		return makeIterator(findNode(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	const_iterator find(const K &key) const
+	{
+		return const_iterator(&tree, findNode(key));
+	}
+
+	iterator lower_bound(const key_type &key)
+	{
+		return makeIterator(lowerBound(key));
+	}
+
+	const_iterator lower_bound(const key_type &key) const
+	{
+		return const_iterator(&tree, lowerBound(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	iterator lower_bound(const K &key)
+	{
+		return makeIterator(lowerBound(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	const_iterator lower_bound(const K &key) const
+	{
+		return const_iterator(&tree, lowerBound(key));
+	}
+
+	iterator upper_bound(const key_type &key)
+	{
+		return makeIterator(upperBound(key));
+	}
+
+	const_iterator upper_bound(const key_type &key) const
+	{
+		return const_iterator(&tree, upperBound(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	iterator upper_bound(const K &key)
+	{
+		return makeIterator(upperBound(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	const_iterator upper_bound(const K &key) const
+	{
+		return const_iterator(&tree, upperBound(key));
+	}
+
+	std::pair<iterator, iterator> equal_range(const key_type &key)
+	{
+		return std::pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+	}
+
+	std::pair<const_iterator, const_iterator> equal_range(const key_type &key) const
+	{
+		return std::pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	std::pair<iterator, iterator> equal_range(const K &key)
+	{
+		return std::pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+	}
+
+	template <typename K, typename C = Compare, typename = typename C::is_transparent>
+	std::pair<const_iterator, const_iterator> equal_range(const K &key) const
+	{
+		return std::pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+	}
+
+	// comparison
+
+	friend bool operator==(const avl_tree &a, const avl_tree &b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+	}
+
+	friend bool operator!=(const avl_tree &a, const avl_tree &b)
+	{
+		return !(a == b);
+	}
+
+	friend bool operator<(const avl_tree &a, const avl_tree &b)
+	{
+		return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+	}
+
+	friend bool operator>(const avl_tree &a, const avl_tree &b)
+	{
+		return b < a;
+	}
+
+	friend bool operator<=(const avl_tree &a, const avl_tree &b)
+	{
+		return !(b < a);
+	}
+
+	friend bool operator>=(const avl_tree &a, const avl_tree &b)
+	{
+		return !(a < b);
+	}
+
+protected:
+	/**
+	 * The result of `search()`: either the node with an equal key, or the position of a new leaf for the key.
+	 */
+	struct Position
+	{
+		struct AvlNode *parent;
+		int right;
+		struct AvlNode *existing;
+	};
+
+	/**
+	 * Inserts an item, if there is no item with an equal `key` yet. The node is only allocated, if the item is
+	 * inserted, so `args` are not consumed otherwise.
+	 */
+	template <typename K, typename... Args>
+	std::pair<iterator, bool> insertUnique(const K &key, Args &&...args)
+	{
+		Position position = search(key);
+
+		if (position.existing != nullptr)
+			return std::pair<iterator, bool>(iterator(&tree, position.existing), false);
+
+		node_type *node = createNode(std::forward<Args>(args)...);
+		avlLinkNode(&tree, &node->base, position.parent, position.right);
+
+		return std::pair<iterator, bool>(iterator(&tree, &node->base), true);
+	}
+
+private:
+	static const key_type &keyOf(struct AvlNode *node)
+	{
+		return KeyOfValue()(*reinterpret_cast<node_type *>(node)->valptr());
+	}
+
+	iterator makeIterator(struct AvlNode *node)
+	{
+		return iterator(&tree, node);
+	}
+
+	/**
+	 * Finds the position of `key` with one comparison per level (plus one at the end): the last node where the search
+	 * went right is the greatest key that is not greater than `key`, so it's the only candidate for an equal key.
+	 */
+	template <typename K>
+	Position search(const K &key) const
+	{
+		Position position = {nullptr, 0, nullptr};
+		struct AvlNode *node = tree.root;
+		struct AvlNode *candidate = nullptr;
+
+		while (node != nullptr)
+		{
+			position.parent = node;
+			position.right = !comp(key, keyOf(node));
+
+			if (position.right)
+			{
+				candidate = node;
+				node = node->right;
+			}
+			else
+			{
+				node = node->left;
+			}
+		}
+
+		if (candidate != nullptr && !comp(keyOf(candidate), key))
+			position.existing = candidate;
+
+		return position;
+	}
+
+	template <typename K>
+	struct AvlNode *lowerBound(const K &key) const
+	{
+		struct AvlNode *node = tree.root;
+		struct AvlNode *result = nullptr;
+
+		while (node != nullptr)
+		{
+			if (comp(keyOf(node), key))
+			{
+				node = node->right;
+			}
+			else
+			{
+				result = node;
+				node = node->left;
+			}
+		}
+
+		return result;
+	}
+
+	template <typename K>
+	struct AvlNode *upperBound(const K &key) const
+	{
+		struct AvlNode *node = tree.root;
+		struct AvlNode *result = nullptr;
+
+		while (node != nullptr)
+		{
+			if (comp(key, keyOf(node)))
+			{
+				result = node;
+				node = node->left;
+			}
+			else
+			{
+				node = node->right;
+			}
+		}
+
+		return result;
+	}
+
+	template <typename K>
+	struct AvlNode *findNode(const K &key) const
+	{
+		struct AvlNode *node = lowerBound(key);
+
+		return node != nullptr && !comp(key, keyOf(node)) ? node : nullptr;
+	}
+
+	template <typename... Args>
+	node_type *createNode(Args &&...args)
+	{
+		node_type *node = node_traits::allocate(alloc, 1);
+
+		try
+		{
+			node_traits::construct(alloc, node->valptr(), std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits::deallocate(alloc, node, 1);
+			throw;
+		}
+
+		node->base.value = node->valptr();
+
+		return node;
+	}
+
+	void destroyNode(node_type *node) noexcept
+	{
+		node_traits::destroy(alloc, node->valptr());
+		node_traits::deallocate(alloc, node, 1);
+	}
+
+	void destroySubtree(struct AvlNode *node) noexcept
+	{
+		if (node == nullptr)
+			return;
+
+		destroySubtree(node->left);
+		destroySubtree(node->right);
+		destroyNode(reinterpret_cast<node_type *>(node));
+	}
+
+	/**
+	 * Copies a subtree node by node, so the copy has the same shape and balance factors (linear time).
+	 */
+	struct AvlNode *cloneSubtree(struct AvlNode *source, struct AvlNode *parent)
+	{
+		node_type *node = createNode(*reinterpret_cast<node_type *>(source)->valptr());
+
+		node->base.parent = parent;
+		node->base.left = nullptr;
+		node->base.right = nullptr;
+		node->base.balance = source->balance;
+		node->base.dirty = 0;
+
+		try
+		{
+			if (source->left != nullptr)
+				node->base.left = cloneSubtree(source->left, &node->base);
+
+			if (source->right != nullptr)
+				node->base.right = cloneSubtree(source->right, &node->base);
+		}
+		catch (...)
+		{
+			destroySubtree(&node->base);
+			throw;
+		}
+
+		return &node->base;
+	}
+
+	/**
+	 * Copies all items of `other` into this (empty) tree.
+	 */
+	void copyFrom(const avl_tree &other)
+	{
+		if (other.tree.root != nullptr)
+		{
+			tree.root = cloneSubtree(other.tree.root, nullptr);
+			tree.min = avl_first(tree.root);
+			tree.max = avl_last(tree.root);
+		}
+
+		tree.count = other.tree.count;
+	}
+
+	/**
+	 * Moves the items of `other` one by one into this (empty) tree, if the allocators differ.
+	 */
+	void moveFrom(avl_tree &other)
+	{
+		for (struct AvlNode *node = avl_first(other.tree.root); node != nullptr; node = avl_next(node))
+			emplace(std::move(*reinterpret_cast<node_type *>(node)->valptr()));
+
+		other.clear();
+	}
+
+	/**
+	 * Takes the nodes of `other` over, if the allocators are equal (constant time).
+	 */
+	void steal(avl_tree &other) noexcept
+	{
+		tree.root = other.tree.root;
+		tree.min = other.tree.min;
+		tree.max = other.tree.max;
+		tree.count = other.tree.count;
+		other.tree.root = nullptr;
+		other.tree.min = nullptr;
+		other.tree.max = nullptr;
+		other.tree.count = 0;
+	}
+
+	void moveAssign(avl_tree &other, std::true_type) noexcept
+	{
+		alloc = std::move(other.alloc);
+		steal(other);
+	}
+
+	void moveAssign(avl_tree &other, std::false_type)
+	{
+		if (alloc == other.alloc)
+			steal(other);
+		else
+			moveFrom(other);
+	}
+
+	void assignAllocator(const node_allocator &other, std::true_type)
+	{
+		alloc = other;
+	}
+
+	void assignAllocator(const node_allocator &, std::false_type)
+	{
+	}
+
+	void swapAllocator(node_allocator &other, std::true_type) noexcept
+	{
+		using std::swap;
+
+		swap(alloc, other);
+	}
+
+	void swapAllocator(node_allocator &, std::false_type) noexcept
+	{
+	}
+
+	struct AvlTree tree;
+	Compare comp;
+	node_allocator alloc;
+};
+
+} // namespace detail
+
+/**
+ * An ordered set of unique keys, like `std::set`, that stores its keys inline in the nodes of an AVL tree.
+ *
+ * Keys can be move-only (see `emplace()`). If `Compare` has a member type `is_transparent`, `find()`, `count()`,
+ * `contains()`, `lower_bound()`, `upper_bound()` and `equal_range()` accept any type that can be compared with the keys.
+ * `Allocator` can be any allocator that works with `std::allocator_traits`, including stateful ones (e.g.
+ * `std::pmr::polymorphic_allocator` in C++17).
+ *
+ * Iterators and references stay valid until their item is erased.
+ */
+template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
+class avl_set : public detail::avl_tree<Key, Key, detail::avl_identity, Compare, Allocator, false>
+{
+	typedef detail::avl_tree<Key, Key, detail::avl_identity, Compare, Allocator, false> base_type;
+
+public:
+	typedef Compare value_compare;
+
+	using base_type::base_type;
+	using base_type::operator=;
+
+	avl_set() = default;
+
+	value_compare value_comp() const
+	{
+		return this->key_comp();
+	}
+};
+
+/**
+ * An ordered map with unique keys, like `std::map`, that stores its items (`std::pair<const Key, T>`) inline in the
+ * nodes of an AVL tree.
+ *
+ * Supports the same heterogeneous lookup and allocators as `avl_set`.
+ */
+template <typename Key, typename T, typename Compare = std::less<Key>,
+	typename Allocator = std::allocator<std::pair<const Key, T>>>
+class avl_map : public detail::avl_tree<Key, std::pair<const Key, T>, detail::avl_select_first, Compare, Allocator, true>
+{
+	typedef detail::avl_tree<Key, std::pair<const Key, T>, detail::avl_select_first, Compare, Allocator, true> base_type;
+
+public:
+	typedef T mapped_type;
+	typedef typename base_type::value_type value_type;
+	typedef typename base_type::iterator iterator;
+	typedef typename base_type::const_iterator const_iterator;
+
+	/**
+	 * Compares items by their keys.
+	 */
+	class value_compare
+	{
+	public:
+		bool operator()(const value_type &a, const value_type &b) const
+		{
+			return comp(a.first, b.first);
+		}
+
+	protected:
+		friend class avl_map;
+
+		explicit value_compare(Compare comp) : comp(comp)
+		{
+		}
+
+		Compare comp;
+	};
+
+	using base_type::base_type;
+	using base_type::operator=;
+
+	avl_map() = default;
+
+	value_compare value_comp() const
+	{
+		return value_compare(this->key_comp());
+	}
+
+	/**
+	 * Returns the value of `key`. If `key` is not in the map, a value-initialized value is inserted first.
+	 */
+	T &operator[](const Key &key)
+	{
+		return try_emplace(key).first->second;
+	}
+
+	T &operator[](Key &&key)
+	{
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	/**
+	 * Returns the value of `key`.
+	 *
+	 * @throws std::out_of_range if `key` is not in the map.
+	 */
+	T &at(const Key &key)
+	{
+		iterator it = this->find(key);
+		if (it == this->end())
+			throw std::out_of_range("aud::avl_map::at");
+
+		return it->second;
+	}
+
+	const T &at(const Key &key) const
+	{
+		const_iterator it = this->find(key);
+		if (it == this->end())
+			throw std::out_of_range("aud::avl_map::at");
+
+		return it->second;
+	}
+
+	/**
+	 * Inserts a value constructed from `args`, if `key` is not in the map. Otherwise `args` are not touched.
+	 */
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(const Key &key, Args &&...args)
+	{
+		return this->insertUnique(key, std::piecewise_construct, std::forward_as_tuple(key),
+			std::forward_as_tuple(std::forward<Args>(args)...));
+	}
+
+	template <typename... Args>
+	std::pair<iterator, bool> try_emplace(Key &&key, Args &&...args)
+	{
+		return this->insertUnique(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+			std::forward_as_tuple(std::forward<Args>(args)...));
+	}
+
+	/**
+	 * Inserts `value` for `key`, or assigns it to the existing value of `key`.
+	 */
+	template <typename M>
+	std::pair<iterator, bool> insert_or_assign(const Key &key, M &&value)
+	{
+		std::pair<iterator, bool> result = try_emplace(key, std::forward<M>(value));
+		if (!result.second)
+			result.first->second = std::forward<M>(value);
+
+		return result;
+	}
+
+	template <typename M>
+	std::pair<iterator, bool> insert_or_assign(Key &&key, M &&value)
+	{
+		std::pair<iterator, bool> result = try_emplace(std::move(key), std::forward<M>(value));
+		if (!result.second)
+			result.first->second = std::forward<M>(value);
+
+		return result;
+	}
+};
+
+} // namespace aud
+
+#endif //AUD_AVLSET_HPP
@@ -0,0 +1,160 @@
+#ifndef AUD_AVLSNAPSHOT_H
+#define AUD_AVLSNAPSHOT_H
+
+/**
+ * @file AvlSnapshot.h
+ *
+ * Contains the struct definition of `struct AvlSnapshot`, as well as functions to write the contents of an AVL tree to
+ * a file and to load it back.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "AvlTree.h"
+
+/**
+ * The in-memory (and on-disk) representation of a length-prefixed key.
+ *
+ * If a snapshot is written with `key_size` 0, every value of the tree has to point to a `struct AvlBytes`.
+ *
+ * @see avlSnapshotWrite()
+ */
+struct AvlBytes
+{
+	/**
+	 * The number of bytes in `data`.
+	 */
+	uint32_t length;
+
+	/**
+	 * The actual bytes of the key.
+	 */
+	unsigned char data[];
+};
+
+/**
+ * Represents a read-only, memory mapped snapshot file of an AVL tree.
+ *
+ * A snapshot file contains all items of a tree in sorted order, as well as a checksum. Items are either keys of a fixed
+ * size (e.g. integers), or length-prefixed byte strings (`struct AvlBytes`). The items are stored in the file exactly
+ * as they are represented in memory, so after opening a snapshot, the items can be used right out of the mapped file.
+ * There are two ways to do this:
+ *
+ *  * `avlSnapshotLoad()` rebuilds a balanced `struct AvlTree` in linear time, whose values point into the mapping.
+ *  * `avlSnapshotContains()` performs a binary search directly on the mapping, so no tree has to be built at all.
+ *
+ * The file is stored in native byte order, so it can only be read on machines with the same endianness.
+ *
+ * You should always call `avlSnapshotOpen()` before and `avlSnapshotClose()` after using a snapshot. A snapshot must not
+ * be closed as long as a tree that was loaded from it is still in use.
+ *
+ * Methods of this struct start with "avlSnapshot".
+ *
+ * @see avlSnapshotWrite()
+ * @see avlSnapshotOpen()
+ * @see avlSnapshotClose()
+ * @see avlSnapshotLoad()
+ * @see avlSnapshotContains()
+ */
+struct AvlSnapshot
+{
+	/**
+	 * Points to the start of the mapped file.
+	 */
+	void *map;
+
+	/**
+	 * The size of the mapped file in bytes.
+	 */
+	size_t map_size;
+
+	/**
+	 * The size of one key in bytes, or 0 if the keys are length-prefixed.
+	 */
+	size_t key_size;
+
+	/**
+	 * The number of keys in the snapshot.
+	 */
+	size_t count;
+
+	/**
+	 * Points to the first key in the mapping.
+	 */
+	const unsigned char *keys;
+
+	/**
+	 * Points to the offsets (relative to `keys`) of all length-prefixed keys, or `NULL` if the keys have a fixed size.
+	 */
+	const uint64_t *offsets;
+};
+
+/**
+ * Writes all items of a tree into a snapshot file, in sorted order.
+ *
+ * The file is first written to a temporary file (`path` with the suffix ".tmp"), that is synced to the disk (`fsync()`)
+ * and then renamed to `path`, so a crash or a power loss during writing never leaves a broken snapshot behind.
+ *
+ * @param _this Points to the tree to write.
+ * @param path The path of the snapshot file.
+ * @param key_size The size of one item in bytes. If this is 0, every item has to point to a `struct AvlBytes`.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `path`
+ *  * 3 = invalid argument `key_size`
+ *  * -1 = I/O error
+ */
+int avlSnapshotWrite(struct AvlTree *_this, const char *path, size_t key_size);
+
+/**
+ * Opens and memory maps a snapshot file, and verifies its checksum.
+ *
+ * @param _this Points to the snapshot to be initialized.
+ * @param path The path of the snapshot file.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `path` (the file can't be opened)
+ *  * 3 = the file is not a valid snapshot
+ *  * 4 = checksum mismatch
+ *  * -1 = I/O error
+ */
+int avlSnapshotOpen(struct AvlSnapshot *_this, const char *path);
+
+/**
+ * Unmaps a snapshot file. All trees that were loaded from this snapshot become invalid (but still have to be freed
+ * with `avlFree()`).
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the snapshot to close.
+ */
+void avlSnapshotClose(struct AvlSnapshot *_this);
+
+/**
+ * Builds a balanced tree out of a snapshot in linear time. The values of the tree point directly into the mapped file.
+ *
+ * @param _this Points to the snapshot to load.
+ * @param tree Points to an initialized and empty tree. Its comparison function has to match the order of the
+ * snapshot.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `tree` (`NULL` or not empty)
+ *  * -1 = malloc error
+ */
+int avlSnapshotLoad(struct AvlSnapshot *_this, struct AvlTree *tree);
+
+/**
+ * Checks if a snapshot contains a specific item, by performing a binary search directly on the mapped file.
+ *
+ * @param _this Points to the snapshot to inspect.
+ * @param item The item that is searched.
+ * @param compare The comparison function that was used by the tree the snapshot was written from.
+ * @return 0 if `item` was not found or if `_this` or `compare` is `NULL`<br/>
+ * 1, if `item` was found in the snapshot
+ */
+int avlSnapshotContains(struct AvlSnapshot *_this, const void *item, int (*compare)(const void *, const void *));
+
+#endif //AUD_AVLSNAPSHOT_H
@@ -8,6 +8,7 @@
  */
 
 #include <stddef.h>
+#include "Allocator.h"
 
 /**
  * Represents a node in a balanced AVL tree. This struct is only there to be used by `struct AvlTree`. If you want to
@@ -43,6 +44,154 @@ struct AvlNode
 	 * balance = <height of right subtree> - <height of left subtree>
 	 */
 	signed char balance;
+
+	/**
+	 * Non-zero, if the balance factor of this node may be wrong, because nodes were inserted below it in relaxed mode
+	 * (see `avlRelax()`). All ancestors of a dirty node are dirty, too.
+	 */
+	unsigned char dirty;
+};
+
+/**
+ * Describes the items of an AVL tree in interval mode (see `avlInitInterval()`). Every item is a closed interval
+ * \f$[low, high]\f$, whose endpoints are accessed through this type.
+ *
+ * @see avlInitInterval()
+ */
+struct AvlIntervalType
+{
+	/**
+	 * Returns a pointer to the low endpoint of an item.
+	 */
+	const void *(*low)(const void *item);
+
+	/**
+	 * Returns a pointer to the high endpoint of an item. The pointer has to stay valid as long as the item is in the
+	 * tree.
+	 */
+	const void *(*high)(const void *item);
+
+	/**
+	 * Compares two endpoints (as returned by `low` and `high`).
+	 *
+	 * @return 0, if both endpoints are equal<br/>
+	 * &lt; 0, if the first endpoint is less than the second one<br/>
+	 * &gt; 0, if the first endpoint is greater than the second one
+	 */
+	int (*compare)(const void *a, const void *b);
+};
+
+/**
+ * Counters for the hot paths of an AVL tree.
+ *
+ * The counters are only updated, if the library is compiled with `-D AVL_STATS` (`make AVL_STATS=1`). Otherwise they
+ * stay 0 and don't cost anything.
+ *
+ * @see avlStats()
+ */
+struct AvlCounters
+{
+	/**
+	 * The number of calls to `AvlTree::compare`.
+	 */
+	size_t comparisons;
+
+	/**
+	 * The number of single left rotations (right-right case).
+	 */
+	size_t rotations_left;
+
+	/**
+	 * The number of single right rotations (left-left case).
+	 */
+	size_t rotations_right;
+
+	/**
+	 * The number of double rotations in the left-right case.
+	 */
+	size_t rotations_left_right;
+
+	/**
+	 * The number of double rotations in the right-left case.
+	 */
+	size_t rotations_right_left;
+
+	/**
+	 * The total number of ancestors that were visited while updating balance factors after insertions.
+	 */
+	size_t retracing_steps;
+
+	/**
+	 * The number of allocated nodes (failed allocations are not counted).
+	 */
+	size_t allocations;
+
+	/**
+	 * The number of rebalance passes in relaxed mode (see `avlRelax()`), including the ones triggered by the height
+	 * bound.
+	 */
+	size_t rebalances;
+
+	/**
+	 * The number of calls to `avlContains()`, that were answered by the lookup cache (see `avlCache()`).
+	 */
+	size_t cache_hits;
+
+	/**
+	 * The number of calls to `avlContains()`, that had to search the tree, although it has a lookup cache.
+	 */
+	size_t cache_misses;
+};
+
+/**
+ * A slot of the lookup cache of an AVL tree.
+ *
+ * @see avlCache()
+ */
+struct AvlCacheSlot
+{
+	/**
+	 * The hash of `value`.
+	 */
+	size_t hash;
+
+	/**
+	 * An item of the tree, or `NULL` if the slot is empty.
+	 */
+	void *value;
+};
+
+/**
+ * Describes the health of an AVL tree.
+ *
+ * @see avlStats()
+ */
+struct AvlStats
+{
+	/**
+	 * A copy of the counters of the tree (all 0, if the library was compiled without `-D AVL_STATS`).
+	 */
+	struct AvlCounters counters;
+
+	/**
+	 * The number of nodes in the tree.
+	 */
+	size_t count;
+
+	/**
+	 * The height of the tree (0 for an empty tree, 1 for a tree with only one node).
+	 */
+	size_t height;
+
+	/**
+	 * The average depth of all nodes (the root has depth 0).
+	 */
+	double average_depth;
+
+	/**
+	 * The memory used by the tree structure, its nodes and its lookup cache in bytes, the same as `avlMemory()`.
+	 */
+	size_t memory;
 };
 
 /**
@@ -52,14 +201,43 @@ struct AvlNode
  *
  * You should always call `avlInit()` before and `avlFree()` after using an AVL tree.
  *
+ * In interval mode (see `avlInitInterval()`), every node additionally caches the greatest high endpoint of its subtree,
+ * so all items that overlap an interval can be found in \f$O(log(n) + k)\f$ time, where \f$k\f$ is the number of
+ * items found.
+ *
+ * The tree keeps pointers to the nodes of its least and greatest items, so they can be accessed and removed without
+ * searching (e.g. to use the tree as a priority queue, that also supports removing arbitrary items).
+ *
+ * In relaxed mode (see `avlRelax()`), insertions only mark the path to the new node, and the tree is rebalanced in one
+ * pass later, which makes bursts of insertions faster.
+ *
  * Methods of this struct start with "avl".
  *
  * @see https://en.wikipedia.org/wiki/AVL_tree
+ * @see https://en.wikipedia.org/wiki/Interval_tree#Augmented_tree
  * @see avlInit()
+ * @see avlInitInterval()
  * @see avlFree()
  * @see avlContains()
  * @see avlInsert()
+ * @see avlDelete()
+ * @see avlLinkNode()
+ * @see avlUnlinkNode()
  * @see avlIsEmpty()
+ * @see avlMin()
+ * @see avlMax()
+ * @see avlPopMin()
+ * @see avlPopMax()
+ * @see avlBuild()
+ * @see avlInsertBatch()
+ * @see avlRelax()
+ * @see avlRebalance()
+ * @see avlCache()
+ * @see avlSetAllocator()
+ * @see avlMemory()
+ * @see avlStats()
+ * @see avlStab()
+ * @see avlOverlap()
  */
 struct AvlTree
 {
@@ -81,6 +259,79 @@ struct AvlTree
 	 * Points to the root node of the tree, or `NULL` if the tree is empty.
 	 */
 	struct AvlNode *root;
+
+	/**
+	 * Points to the node with the least item, or `NULL` if the tree is empty.
+	 *
+	 * @see avlMin()
+	 */
+	struct AvlNode *min;
+
+	/**
+	 * Points to the node with the greatest item, or `NULL` if the tree is empty.
+	 *
+	 * @see avlMax()
+	 */
+	struct AvlNode *max;
+
+	/**
+	 * Describes the endpoints of the items in interval mode, or `NULL`.
+	 *
+	 * @see avlInitInterval()
+	 */
+	const struct AvlIntervalType *interval;
+
+	/**
+	 * Non-zero, if the tree is in relaxed mode.
+	 *
+	 * @see avlRelax()
+	 */
+	int relaxed;
+
+	/**
+	 * The height bound of relaxed mode (0, if there is none).
+	 *
+	 * @see avlRelax()
+	 */
+	size_t max_height;
+
+	/**
+	 * The lookup cache (`cache_mask + 1` slots), or `NULL`.
+	 *
+	 * @see avlCache()
+	 */
+	struct AvlCacheSlot *cache;
+
+	/**
+	 * The number of slots of `cache` minus 1.
+	 */
+	size_t cache_mask;
+
+	/**
+	 * The hash function of the lookup cache.
+	 */
+	size_t (*cache_hash)(const void *item);
+
+	/**
+	 * Allocates the nodes and the lookup cache of the tree, or `NULL` to use `malloc()`.
+	 *
+	 * @see avlSetAllocator()
+	 */
+	struct Allocator *allocator;
+
+	/**
+	 * The number of bytes, that the tree allocated for its nodes and its lookup cache.
+	 *
+	 * @see avlMemory()
+	 */
+	size_t bytes;
+
+	/**
+	 * Hot path counters of this tree.
+	 *
+	 * @see avlStats()
+	 */
+	struct AvlCounters counters;
 };
 
 /**
@@ -95,6 +346,26 @@ struct AvlTree
  */
 void avlInit(struct AvlTree *_this, int (*compare)(const void *, const void *));
 
+/**
+ * Initializes an empty tree in interval mode. The items of the tree are intervals, whose endpoints are described by
+ * `type`. Every node caches the greatest high endpoint of its subtree, so the tree supports `avlStab()` and
+ * `avlOverlap()`.
+ *
+ * `compare` has to order the items by their low endpoints first (and should break ties, e.g. by the high endpoint, since
+ * every item occures at most once in the tree).
+ *
+ * If `_this` is `NULL`, nothing happens. If `type` is `NULL`, the tree is initialized like with `avlInit()`.
+ *
+ * @param _this Points to the tree that gets initialized.
+ * @param compare The comparrison function for the tree.
+ * @param type Describes the endpoints of the items. Only the pointer is stored, so `type` has to stay valid as long as
+ * the tree is used.
+ *
+ * @see AvlIntervalType
+ */
+void avlInitInterval(struct AvlTree *_this, int (*compare)(const void *, const void *),
+	const struct AvlIntervalType *type);
+
 /**
  * Frees all memory used by the nodes of a tree (not the actual data and not the tree pointer).
  * If `_this` is `NULL`, nothing happens.
@@ -111,6 +382,8 @@ void avlFree(struct AvlTree *_this);
  * If you want to check if an item is in the tree before inserting it, then it's faster to call `avlInsert()` right
  * away, an check the return value.
  *
+ * If the tree has a lookup cache (see `avlCache()`), items that were found recently are looked up in the cache first.
+ *
  * @param _this Points to the tree to inspect.
  * @param item The item that is searched in the tree.
  * @return 0 if `item` was not found or if `_this` is `NULL`<br/>
@@ -128,6 +401,251 @@ int avlContains(struct AvlTree *_this, void *item);
  */
 int avlInsert(struct AvlTree *_this, void *item);
 
+/**
+ * Removes an item from an AVL tree and rebalances the tree. The item itself is not freed.
+ *
+ * @param _this Points to the tree to remove the item from.
+ * @param item The item to remove.
+ * @return 1, if the item was removed<br/>
+ * 0, if the item was not found or `_this` is `NULL`.
+ */
+int avlDelete(struct AvlTree *_this, void *item);
+
+/**
+ * Returns the least item of a tree in constant time.
+ *
+ * @param _this Points to the tree to inspect.
+ * @return The least item, or `NULL` if the tree is empty or `_this` is `NULL` (use `avlIsEmpty()`, if `NULL` is an
+ * item of the tree).
+ */
+void *avlMin(struct AvlTree *_this);
+
+/**
+ * Returns the greatest item of a tree in constant time.
+ *
+ * @param _this Points to the tree to inspect.
+ * @return The greatest item, or `NULL` if the tree is empty or `_this` is `NULL` (use `avlIsEmpty()`, if `NULL` is an
+ * item of the tree).
+ */
+void *avlMax(struct AvlTree *_this);
+
+/**
+ * Removes the least item from a tree and rebalances the tree. The item itself is not freed.
+ *
+ * This is faster than `avlDelete()`, because the item doesn't have to be searched (no calls to `AvlTree::compare`),
+ * and the removed node has at most one child. Repeatedly popping the least item retraces only a constant number of
+ * nodes on average.
+ *
+ * @param _this Points to the tree to remove the item from.
+ * @return The removed item, or `NULL` if the tree is empty or `_this` is `NULL`.
+ */
+void *avlPopMin(struct AvlTree *_this);
+
+/**
+ * Removes the greatest item from a tree and rebalances the tree (see `avlPopMin()`). The item itself is not freed.
+ *
+ * @param _this Points to the tree to remove the item from.
+ * @return The removed item, or `NULL` if the tree is empty or `_this` is `NULL`.
+ */
+void *avlPopMax(struct AvlTree *_this);
+
+/**
+ * Links a node, that is allocated and owned by the caller, into a tree as a new leaf and rebalances the tree.
+ *
+ * This is the low level counterpart of `avlInsert()` for containers that embed `struct AvlNode` in their own nodes
+ * (e.g. to store the items inline). The caller searches the position of the new node itself (so `AvlTree::compare` is
+ * not used), and has to keep the order of the tree intact. `node->value` is not touched. The node is never freed by the
+ * tree, so such trees must not be passed to `avlFree()`, and `avlDelete()` must not be used on them.
+ *
+ * Interval mode is not supported, because the tree can't know the size of caller-allocated nodes.
+ *
+ * @param _this Points to the tree.
+ * @param node The node to link. All its fields except `value` are initialized by this function.
+ * @param parent The parent of the new leaf, or `NULL` if the tree is empty.
+ * @param right Non-zero, if `node` becomes the right child of `parent`, 0 if it becomes the left child.
+ * @return 1, if the node was linked<br/>
+ * 0, if `_this` or `node` is `NULL`, the tree is in interval mode or the child of `parent` (or the root) is already set.
+ *
+ * @see avlUnlinkNode()
+ */
+int avlLinkNode(struct AvlTree *_this, struct AvlNode *node, struct AvlNode *parent, int right);
+
+/**
+ * Removes a node from a tree and rebalances the tree, without freeing the node (see `avlLinkNode()`).
+ *
+ * @param _this Points to the tree that contains `node`.
+ * @param node The node to remove.
+ * @return 1, if the node was removed<br/>
+ * 0, if `_this` or `node` is `NULL`.
+ */
+int avlUnlinkNode(struct AvlTree *_this, struct AvlNode *node);
+
+/**
+ * Fills an empty tree with the given items in linear time. The resulting tree is perfectly balanced.
+ *
+ * This is a lot faster than calling `avlInsert()` for every single item, but `items` has to be sorted in ascending
+ * order (with respect to `AvlTree::compare`) and must not contain any duplicates. This is not checked.
+ *
+ * @param _this Points to the (empty) tree to fill.
+ * @param items Array of the items to insert. Only the item pointers are stored in the tree, not the array.
+ * @param n The number of items in `items`.
+ * @return 1, if all items were added<br/>
+ * 0, if `_this` is `NULL`, not empty, `items` is `NULL` (and `n` isn't 0) or if a malloc error occurred (the tree
+ * stays empty, then).
+ */
+int avlBuild(struct AvlTree *_this, void **items, size_t n);
+
+/**
+ * Inserts a batch of items in any order into a tree, with up to `n_threads` threads (POSIX threads).
+ *
+ * The batch is copied, sorted with a parallel merge sort and deduplicated first (of equal items in the batch, only one
+ * is inserted). Then the batch is split at the root of the tree, both parts are inserted into the left and right
+ * subtree on separate threads, and the results are joined with the root again, so only the seams between the subtrees
+ * are rebalanced (recursively, until there are no threads left). Items, that are in the tree already, are skipped like
+ * by `avlInsert()`. Parts of the batch, that fall into empty subtrees, are built like by `avlBuild()`.
+ *
+ * The resulting tree is balanced, even in relaxed mode (see `avlRelax()`). Batches of a few thousand items or less
+ * are inserted by the calling thread. In interval mode, the sorted batch is inserted with `avlInsert()`.
+ *
+ * @param _this Points to the tree.
+ * @param items Array of the items to insert. Only the item pointers are stored in the tree, the array isn't modified.
+ * @param n The number of items in `items`.
+ * @param n_threads The maximum number of threads, including the calling thread (0 is treated like 1).
+ * @return 1, if all items are in the tree now<br/>
+ * 0, if `_this` is `NULL`, `items` is `NULL` (and `n` isn't 0) or if a malloc error occurred (some of the items may
+ * be missing in the tree, then, but the tree is valid).
+ */
+int avlInsertBatch(struct AvlTree *_this, void **items, size_t n, size_t n_threads);
+
+/**
+ * Switches a tree to relaxed mode, which is meant for bursts of insertions that are followed by a phase of lookups.
+ *
+ * In relaxed mode, `avlInsert()` (and `avlLinkNode()`) only links the new leaf and marks its ancestors as dirty, until
+ * it reaches an ancestor that is dirty already. No balance factors are updated and no rotations are performed, so an
+ * insertion costs little more than the search. The tree stays a valid search tree, but it may become unbalanced, which
+ * slows down searching. `avlRebalance()` restores the AVL invariant in one pass over the dirty nodes, that joins the
+ * already balanced subtrees bottom-up.
+ *
+ * If `max_height` is not 0, the tree is rebalanced automatically as soon as a node is inserted at a depth greater than
+ * `max_height` (the root has depth 1), so lookups never get too slow. The tree stays in relaxed mode then. The bound
+ * should be well above the height of a balanced tree (\f$1.44 \log_2(n)\f$), e.g. \f$3 \log_2(n)\f$, otherwise the
+ * tree is rebalanced very often.
+ *
+ * Deleting an item rebalances the tree first, if it has dirty nodes. All other functions work on unbalanced trees, too.
+ * Interval mode is not supported.
+ *
+ * @param _this Points to the tree.
+ * @param max_height The height bound (0 = no bound).
+ * @return 1, if the tree is in relaxed mode now<br/>
+ * 0, if `_this` is `NULL` or the tree is in interval mode
+ *
+ * @see avlRebalance()
+ */
+int avlRelax(struct AvlTree *_this, size_t max_height);
+
+/**
+ * Rebalances a tree, that is in relaxed mode, and switches it back to normal mode (see `avlRelax()`).
+ *
+ * The rebalancing takes \f$O(d \log(n))\f$ time, where \f$d\f$ is the number of dirty nodes. If the tree is not
+ * in relaxed mode, nothing happens.
+ *
+ * @param _this Points to the tree.
+ * @return 1, if the tree is balanced now<br/>
+ * 0, if `_this` is `NULL`
+ */
+int avlRebalance(struct AvlTree *_this);
+
+/**
+ * Puts a small direct-mapped cache of recently found items in front of `avlContains()`, for skewed lookups, where a few
+ * items are looked up most of the time.
+ *
+ * `avlContains()` looks the item up in the slot of its hash first. If the slot holds an equal item, the lookup costs one
+ * call of `hash` and one of `AvlTree::compare`, instead of a search from the root. Otherwise the tree is searched, and
+ * the item is stored in the slot, if it was found (replacing the previous item of the slot). Only items of the tree are
+ * cached, so inserting items never invalidates the cache. Removing an item (with `avlDelete()`, `avlUnlinkNode()` or
+ * the "pop" functions) clears its slot.
+ *
+ * The cache only pays off, if most lookups hit it, because a miss costs an additional hash and memory access. Since
+ * `avlContains()` writes to the cache, it must not be called by several threads at the same time, if the tree has a
+ * cache.
+ *
+ * @param _this Points to the tree.
+ * @param n_slots The number of slots (a power of 2), or 0 to remove the cache.
+ * @param hash The hash function of the items. Equal items (according to `AvlTree::compare`) must have equal hashes.
+ * The slot of an item is chosen by the low bits of its hash, so they should be well mixed.
+ * @return 1, on success<br/>
+ * 0, if `_this` is `NULL`, `n_slots` is not a power of 2, `hash` is `NULL` or if a malloc error occurred (the previous
+ * cache is kept, then)
+ */
+int avlCache(struct AvlTree *_this, size_t n_slots, size_t (*hash)(const void *item));
+
+/**
+ * Makes a tree allocate its nodes and its lookup cache with an allocator, e.g. to enforce a memory budget.
+ *
+ * If the allocator refuses an allocation, the tree behaves like on a malloc error (e.g. `avlInsert()` returns 0 and the
+ * tree stays unchanged). The tree must not have allocated anything yet (nodes linked with `avlLinkNode()` don't count).
+ *
+ * @param _this Points to the tree.
+ * @param allocator The allocator, or `NULL` to use `malloc()`. It has to stay valid as long as the tree is used.
+ * @return 1, on success<br/>
+ * 0, if `_this` is `NULL` or the tree has allocated nodes or a lookup cache already
+ *
+ * @see Allocator
+ */
+int avlSetAllocator(struct AvlTree *_this, struct Allocator *allocator);
+
+/**
+ * Returns the exact number of bytes a tree uses, in constant time: the size of `struct AvlTree`, plus the nodes and the
+ * lookup cache the tree allocated (not counting the items, nodes linked with `avlLinkNode()` and the overhead of the
+ * allocator).
+ *
+ * @param _this Points to the tree.
+ * @return The number of bytes, or 0 if `_this` is `NULL`.
+ */
+size_t avlMemory(const struct AvlTree *_this);
+
+/**
+ * Inspects a tree and reports its height, depth and memory usage, as well as the values of its counters.
+ *
+ * This function visits every node of the tree, so it takes linear time.
+ *
+ * @param _this Points to the tree to inspect.
+ * @param stats The result is stored here.
+ * @return 1, on success<br/>
+ * 0, if `_this` or `stats` is `NULL`
+ *
+ * @see AvlCounters
+ */
+int avlStats(struct AvlTree *_this, struct AvlStats *stats);
+
+/**
+ * Finds all items of a tree in interval mode, that contain a point (\f$low \le point \le high\f$).
+ *
+ * @param _this Points to the tree to search in.
+ * @param point Points to an endpoint, that is compared with `AvlIntervalType::compare`.
+ * @param callback Is called for every item found (in ascending order), or `NULL`.
+ * @param context Is passed to `callback`.
+ * @return The number of items found (0, if `_this` is `NULL` or not in interval mode).
+ *
+ * @see avlInitInterval()
+ */
+size_t avlStab(struct AvlTree *_this, const void *point, void (*callback)(void *item, void *context), void *context);
+
+/**
+ * Finds all items of a tree in interval mode, that overlap the closed interval \f$[low, high]\f$.
+ *
+ * @param _this Points to the tree to search in.
+ * @param low Points to the low endpoint of the interval.
+ * @param high Points to the high endpoint of the interval.
+ * @param callback Is called for every item found (in ascending order), or `NULL`.
+ * @param context Is passed to `callback`.
+ * @return The number of items found (0, if `_this` is `NULL` or not in interval mode).
+ *
+ * @see avlInitInterval()
+ */
+size_t avlOverlap(struct AvlTree *_this, const void *low, const void *high,
+	void (*callback)(void *item, void *context), void *context);
+
 /**
  * Checks if the given tree contains any elements, at all.
  *
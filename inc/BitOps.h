@@ -0,0 +1,74 @@
+#ifndef AUD_BITOPS_H
+#define AUD_BITOPS_H
+
+/**
+ * @file BitOps.h
+ *
+ * Contains bit manipulation primitives, whose implementation is chosen at runtime depending on the features of the CPU.
+ *
+ * The implementation is selected automatically when the program starts. Use `bitOpsSelect()` to select one explicitly
+ * (e.g. for benchmarks).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Specifies an implementation of the bit manipulation primitives.
+ *
+ * @see bitOpsSelect()
+ */
+enum BitOpsImpl
+{
+	/**
+	 * Selects the fastest implementation that is supported by the CPU.
+	 */
+	BITOPS_AUTO,
+
+	/**
+	 * Uses the `tzcnt` instruction of the BMI instruction set (x86 only).
+	 */
+	BITOPS_BMI,
+
+	/**
+	 * Uses `__builtin_ctzll()`.
+	 */
+	BITOPS_BUILTIN,
+
+	/**
+	 * Uses a de Bruijn sequence and a lookup table. Works everywhere.
+	 */
+	BITOPS_DEBRUIJN
+};
+
+/**
+ * Counts the number of trailing zeros in a 64-bit word.
+ *
+ * @param x The word to inspect.
+ * @return The index of the least significant set bit of `x`, or 64 if `x` is 0.
+ */
+extern uint64_t (*bitTzcnt64)(uint64_t x);
+
+/**
+ * Counts the number of trailing zeros in a multi-word number, whose least significant word comes first.
+ *
+ * This can be used to count the trailing zeros of a 128 or 256 bit buffer.
+ *
+ * @param words Points to the words of the number.
+ * @param n The number of words.
+ * @return The index of the least significant set bit, or `64 * n` if all words are 0.
+ */
+uint64_t bitTzcntWords(const uint64_t *words, size_t n);
+
+/**
+ * Selects the implementation of the bit manipulation primitives.
+ *
+ * This is not thread safe, so it should only be called before using any other function of this module.
+ *
+ * @param impl The implementation to use.
+ * @return 0, on success<br/>
+ * 1, if `impl` is not supported by this CPU (the selection is not changed, then)
+ */
+int bitOpsSelect(enum BitOpsImpl impl);
+
+#endif //AUD_BITOPS_H
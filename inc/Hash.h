@@ -0,0 +1,43 @@
+#ifndef AUD_HASH_H
+#define AUD_HASH_H
+
+/**
+ * @file Hash.h
+ *
+ * Contains hash functions for byte strings, that can be used together with `struct HyperLogLog`.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Computes a 64-bit hash of a byte string (MurmurHash64A).
+ *
+ * The string is processed 8 bytes at a time, so this is fast enough to hash large inputs (e.g. every line of a log
+ * file). It's not a cryptographic hash.
+ *
+ * @param data Points to the bytes to hash.
+ * @param length The number of bytes.
+ * @param seed Different seeds give independent hashes of the same string.
+ * @return The hash of the string.
+ *
+ * @see https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp
+ */
+uint64_t hashBytes(const void *data, size_t length, uint64_t seed);
+
+/**
+ * Expands a 64-bit hash into an arbitrary number of hash bytes. This function can be used as the hash function of a
+ * `struct HyperLogLog`, whose items are pointers to 64-bit hashes (e.g. computed with `hashBytes()`).
+ *
+ * The bytes are generated by a splitmix64 generator, that is seeded with the hash. So a shorter output is always a
+ * prefix of a longer one, as required by `hllFold()`.
+ *
+ * @param item Points to the `uint64_t` hash to expand.
+ * @param h The number of bytes to generate.
+ * @param buffer The generated bytes are stored here.
+ *
+ * @see HyperLogLog::hash
+ */
+void hashExpand(const void *item, size_t h, void *buffer);
+
+#endif //AUD_HASH_H
@@ -0,0 +1,229 @@
+#ifndef AUD_HLLCLIENT_H
+#define AUD_HLLCLIENT_H
+
+/**
+ * @file HllClient.h
+ *
+ * Contains the protocol of the sketch aggregation server _hlld_ (see _app/hlld.c_) and the struct definition of
+ * `struct HllClient`, as well as related function prototypes.
+ *
+ * The client uses POSIX sockets, so it's only available on POSIX systems.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "HyperLogLog.h"
+
+/**
+ * The greatest size of a request (without the header) in bytes. Larger requests make the server close the connection.
+ */
+#define HLL_MAX_REQUEST_SIZE ((uint32_t)1 << 24)
+
+/**
+ * The greatest length of a sketch name in bytes.
+ */
+#define HLL_MAX_NAME_LENGTH 255
+
+/**
+ * The types of requests.
+ *
+ * @see HllRequestHeader
+ */
+enum HllRequestType
+{
+	/**
+	 * Merges a set into the named sketch. The body is a set serialized with `hllSerialize()`.
+	 */
+	HLL_REQUEST_MERGE = 1,
+
+	/**
+	 * Adds items to the named sketch. The body is an array of 64-bit item hashes (e.g. computed with `hashBytes()`).
+	 */
+	HLL_REQUEST_ADD = 2,
+
+	/**
+	 * Estimates the number of distinct items of the named sketch. The body is empty.
+	 */
+	HLL_REQUEST_COUNT = 3
+};
+
+/**
+ * The status of a response.
+ *
+ * @see HllResponse
+ */
+enum HllResponseStatus
+{
+	HLL_STATUS_OK = 0,
+
+	/**
+	 * The request was malformed (e.g. an unknown type or a corrupted set).
+	 */
+	HLL_STATUS_BAD_REQUEST = 1,
+
+	/**
+	 * A merged set has a smaller register size or fewer registers than the sketches of the server.
+	 */
+	HLL_STATUS_INCOMPATIBLE = 2,
+
+	/**
+	 * The server ran out of memory.
+	 */
+	HLL_STATUS_NO_MEMORY = 3
+};
+
+/**
+ * The header of a request. It's followed by `name_length` bytes of the sketch name and the body.
+ *
+ * All fields are in host byte order, because the server only accepts local connections (Unix domain sockets).
+ */
+struct HllRequestHeader
+{
+	/**
+	 * The number of bytes after the header (name and body).
+	 */
+	uint32_t length;
+
+	/**
+	 * A value of `enum HllRequestType`.
+	 */
+	uint8_t type;
+
+	/**
+	 * The length of the sketch name in bytes.
+	 */
+	uint8_t name_length;
+
+	uint16_t reserved;
+};
+
+/**
+ * The response to a request. The server answers every request with exactly one response, in the order of the
+ * requests, so requests can be pipelined.
+ */
+struct HllResponse
+{
+	/**
+	 * A value of `enum HllResponseStatus`.
+	 */
+	int32_t status;
+
+	uint32_t reserved;
+
+	/**
+	 * The estimate of a count request (0 for unknown names), 0 otherwise.
+	 */
+	double count;
+};
+
+/**
+ * A connection to the sketch aggregation server _hlld_.
+ *
+ * The server keeps one sketch per name. The sketches of the server all use the hash function `hashExpand()` on 64-bit
+ * item hashes, so sets that are merged into them have to be built the same way (e.g.
+ * `hllInit(&set, r, b, &hashExpand)` and `hllAdd(&set, &item_hash)`, or `hllAddHash(&set, item_hash)` with any hash
+ * function).
+ *
+ * You should always call `hllClientConnect()` before and `hllClientClose()` after using this structure. A client must
+ * not be used by several threads at the same time.
+ *
+ * @see hllClientConnect()
+ * @see hllClientClose()
+ * @see hllClientMerge()
+ * @see hllClientAdd()
+ * @see hllClientCount()
+ */
+struct HllClient
+{
+	/**
+	 * The socket, or -1 if the client is not connected.
+	 */
+	int fd;
+
+	/**
+	 * Buffer for serialized sets.
+	 */
+	void *buffer;
+
+	/**
+	 * The size of `buffer` in bytes.
+	 */
+	size_t capacity;
+};
+
+/**
+ * Connects to the server.
+ *
+ * @param _this Points to the client to be initialized.
+ * @param path The path of the Unix domain socket of the server.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `path` (`NULL` or too long)
+ *  * -1 = socket error (see `errno`), the client is not connected then
+ */
+int hllClientConnect(struct HllClient *_this, const char *path);
+
+/**
+ * Closes the connection to the server and frees all memory used by a client.
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the client to be closed. This pointer itself is not freed.
+ */
+void hllClientClose(struct HllClient *_this);
+
+/**
+ * Merges a set into the sketch `name` of the server. The sketch is created, if it doesn't exist yet.
+ *
+ * The set may have a greater register size or more registers than the sketches of the server (see `hllMerge()`).
+ *
+ * @param _this Points to the client.
+ * @param name The name of the sketch (at most `HLL_MAX_NAME_LENGTH` bytes).
+ * @param set The set to merge.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this` (`NULL` or not connected)
+ *  * 2 = invalid argument `name`
+ *  * 3 = invalid argument `set`
+ *  * -1 = malloc or socket error (see `errno`)
+ *  * -2 = the server rejected the request (see `enum HllResponseStatus`)
+ */
+int hllClientMerge(struct HllClient *_this, const char *name, const struct HyperLogLog *set);
+
+/**
+ * Adds items to the sketch `name` of the server. The sketch is created, if it doesn't exist yet.
+ *
+ * Large batches are split into several requests of at most `HLL_MAX_REQUEST_SIZE` bytes, which are pipelined.
+ *
+ * @param _this Points to the client.
+ * @param name The name of the sketch (at most `HLL_MAX_NAME_LENGTH` bytes).
+ * @param hashes The 64-bit hashes of the items, `n` of them.
+ * @param n The number of items.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this` (`NULL` or not connected)
+ *  * 2 = invalid argument `name`
+ *  * 3 = invalid argument `hashes`
+ *  * -1 = socket error (see `errno`)
+ *  * -2 = the server rejected the request (see `enum HllResponseStatus`)
+ */
+int hllClientAdd(struct HllClient *_this, const char *name, const uint64_t *hashes, size_t n);
+
+/**
+ * Estimates the number of distinct items of the sketch `name` of the server.
+ *
+ * @param _this Points to the client.
+ * @param name The name of the sketch (at most `HLL_MAX_NAME_LENGTH` bytes).
+ * @param result The estimate is stored here (0, if there is no sketch `name`).
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this` (`NULL` or not connected)
+ *  * 2 = invalid argument `name`
+ *  * 3 = invalid argument `result`
+ *  * -1 = socket error (see `errno`)
+ *  * -2 = the server rejected the request (see `enum HllResponseStatus`)
+ */
+int hllClientCount(struct HllClient *_this, const char *name, double *result);
+
+#endif //AUD_HLLCLIENT_H
@@ -1,7 +1,9 @@
 #ifndef AUD_HYPERLOGLOG_H
 #define AUD_HYPERLOGLOG_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "Allocator.h"
 
 /**
  * @file HyperLogLog.h
@@ -21,6 +23,35 @@ enum HyperLogLogRegisterSize
 	LARGE = 8
 };
 
+/**
+ * The result of a joint estimation of two sets \f$A\f$ and \f$B\f$.
+ *
+ * @see hllJointCount()
+ * @see hllFold()
+ */
+struct HyperLogLogJoint
+{
+	/**
+	 * The estimated number of items that are only in \f$A\f$: \f$|A \setminus B|\f$.
+	 */
+	double only_a;
+
+	/**
+	 * The estimated number of items that are only in \f$B\f$: \f$|B \setminus A|\f$.
+	 */
+	double only_b;
+
+	/**
+	 * The estimated size of the intersection \f$|A \cap B|\f$.
+	 */
+	double intersection;
+
+	/**
+	 * The estimated Jaccard index \f$\frac{|A \cap B|}{|A \cup B|}\f$.
+	 */
+	double jaccard;
+};
+
 /**
  * Stores probabilistic information for counting the number of unique elements in a set.
  * HyperLogLog is suited extremely well for counting very huge sets with decent precision, since the memory usage is
@@ -38,26 +69,36 @@ enum HyperLogLogRegisterSize
  * #### Choosing \f$r\f$ and \f$b\f$
  *
  * \f$r\f$ has a huge influence on the maximum number of items \f$c\f$ in the set.
- * Specifically \f$c = 2^{b + 2^r - 2}\f$.
+ * Specifically \f$c = 2^{b + 2^r - 2}\f$ (with \f$r = 6\f$ for SMALL sets, see below).
  * This doesn't stop you from adding more than \f$c\f$ items, but if you do, the counting result can get very inaccurate.<br/>
- * As a rule of thumb, if you want to count in the range of millions and billions, \f$r = 4\f$ should be fine.
- * \f$r = 6\f$ is good, if you stay below \f$10^{21}\f$.
+ * \f$r = 4\f$ and \f$r = 6\f$ are good, if you stay below \f$10^{21}\f$.
  * \f$r = 8\f$ is for virtually infinitely expandable sets (calculate it through if you're curious).
  *
+ * \f$r = 4\f$ registers are stored as 4-bit offsets to a base value shared by all registers, because the registers of
+ * a set are close to each other. The few registers that are too far above the base are stored in a small exception
+ * list, and the base is raised when all registers are above it. So SMALL sets count as far as MEDIUM sets, but need
+ * less memory. Only if the exception list overflows (which is very unlikely), registers are clamped. Sets with fewer
+ * than 512 registers have no exception list, which barely affects the estimate, because the clamped registers are the
+ * greatest ones.
+ *
  * The other parameter, \f$b\f$, influences how much the counted value might deviate from the actual number of items
  * added, as well as how much memory is needed.
  * The typical relative error can be calculated with \f$\frac{1.04}{\sqrt{2^b}}\f$.<br/>
  * The memory used can be calculated with \f$ r \cdot 2^b bit\f$
+ * (\f$r = 6\f$ registers are packed 10 per 64-bit word, so they actually need 6.4 bits each, and \f$r = 4\f$
+ * registers need an 8 byte header and \f$\lfloor 2^b / 512 \rfloor\f$ exception entries of 8 bytes each, so SMALL
+ * sets are never larger than MEDIUM or LARGE sets, and need the same 16 bytes at \f$b = 4\f$).
+ * SMALL sets support \f$b \le 31\f$.
  *
  * #### Formular Summary
  *
  * \f$2^b\f$ registers of \f$r\f$ bits each.
  *
- * \f$c = 2^{b + 2^r - 2}\f$ (maximum cardinality)
+ * \f$c = 2^{b + 2^{max(r, 6)} - 2}\f$ (maximum cardinality)
  *
  * \f$e = \frac{1.04}{\sqrt{2^b}}\f$ (error)
  *
- * \f$u = r \cdot 2^b bit\f$ (memory usage)
+ * \f$u \approx r \cdot 2^b bit\f$ (memory usage)
  *
  * #### If you don't wanna read, skip to this section.
  *
@@ -73,9 +114,18 @@ enum HyperLogLogRegisterSize
  * @see https://en.wikipedia.org/wiki/HyperLogLog
  * @see https://en.wikipedia.org/wiki/Flajolet%E2%80%93Martin_algorithm
  * @see hllInit()
+ * @see hllInitAllocator()
  * @see hllFree()
+ * @see hllMemory()
  * @see hllAdd()
+ * @see hllAddHash()
+ * @see hllAddHashes()
  * @see hllCount()
+ * @see hllMerge()
+ * @see hllJointCount()
+ * @see hllFold()
+ * @see hllSerialize()
+ * @see hllDeserialize()
  */
 struct HyperLogLog
 {
@@ -94,6 +144,8 @@ struct HyperLogLog
 	 * added to the set (every time `hllAdd()` is called).
 	 *
 	 * The generated hash should have a uniform distribution of 1- and 0-bits.
+	 * The first bytes of the hash must not depend on `h` (i.e. a shorter hash has to be a prefix of a longer one).
+	 * Otherwise `hllFold()` and `hllMerge()` of sets with different register sizes are not exact.
 	 *
 	 * @param item: The item that gets added to the set.
 	 * @param h: How many hash bytes the function shall generate.
@@ -105,6 +157,13 @@ struct HyperLogLog
 	 * Points to the actual data.
 	 */
 	void *data;
+
+	/**
+	 * Allocates `data`, or `NULL` to use `malloc()`.
+	 *
+	 * @see hllInitAllocator()
+	 */
+	struct Allocator *allocator;
 };
 
 /**
@@ -127,6 +186,50 @@ struct HyperLogLog
  */
 int hllInit(struct HyperLogLog *_this, unsigned char r, unsigned char b, void (*hash)(const void*, size_t, void*));
 
+/**
+ * Initializes an empty HyperLogLog, whose registers are allocated with an allocator (e.g. to enforce a memory budget).
+ * `hllFold()` uses the same allocator for the folded registers.
+ *
+ * @param _this Points to the set to be initialized.
+ * @param hash Pointer to the hash function used.
+ * @param allocator The allocator, or `NULL` to use `malloc()` (like `hllInit()`). It has to stay valid as long as the
+ * set is used.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `r`
+ *  * 3 = invalid argument `b`
+ *  * 4 = invalid argument `hash`
+ *  * -1 = malloc error (or the allocator refused the allocation)
+ *
+ * @see hllInit()
+ * @see Allocator
+ */
+int hllInitAllocator(struct HyperLogLog *_this, unsigned char r, unsigned char b,
+	void (*hash)(const void*, size_t, void*), struct Allocator *allocator);
+
+/**
+ * Returns the size of the register array of a set with the given parameters, in bytes.
+ *
+ * SMALL registers are packed two per byte (as offsets to a shared base, with a header and an exception list), MEDIUM
+ * registers are packed 10 per (aligned) 64-bit word and LARGE registers use one byte each. Since `b >= 4`, the size is
+ * always a multiple of 8 bytes.
+ *
+ * @param r The register size.
+ * @param b The number of index bits.
+ * @return The size of the register array in bytes, or 0 if `r` or `b` is invalid.
+ */
+size_t hllDataSize(unsigned char r, unsigned char b);
+
+/**
+ * Returns the exact number of bytes a set uses: the size of `struct HyperLogLog` plus its registers (see
+ * `hllDataSize()`).
+ *
+ * @param _this Points to the set.
+ * @return The number of bytes, or 0 if `_this` is `NULL`.
+ */
+size_t hllMemory(const struct HyperLogLog *_this);
+
 /**
  * Frees all the memory used by a HyperLogLog structure. You can not use the struct after you passed it to this function.
  *
@@ -136,6 +239,15 @@ int hllInit(struct HyperLogLog *_this, unsigned char r, unsigned char b, void (*
  */
 void hllFree(struct HyperLogLog *_this);
 
+/**
+ * Removes all items from the set.
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the HyperLogLog structure to clear.
+ */
+void hllClear(struct HyperLogLog *_this);
+
 /**
  * Adds an item to the set.
  *
@@ -145,6 +257,32 @@ void hllFree(struct HyperLogLog *_this);
  */
 void hllAdd(struct HyperLogLog *_this, const void *item);
 
+/**
+ * Adds an item to the set, whose 64-bit hash was already computed. The hash function of the set is not called.
+ *
+ * This is useful, if the same item is added to many sets (e.g. one per dimension or time bucket), because the item is
+ * hashed only once then. The registers are updated exactly like by `hllAdd(_this, &hash)` on a set with the hash
+ * function `hashExpand()`, so sets filled either way (like the sketches of _hlld_, see `HllClient`) can be merged, and
+ * folding stays exact (see `hllFold()`).
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the HyperLogLog structure, that counts the set.
+ * @param hash The uniformly distributed 64-bit hash of the item (e.g. computed with `hashBytes()`).
+ */
+void hllAddHash(struct HyperLogLog *_this, uint64_t hash);
+
+/**
+ * Adds several items to the set, whose 64-bit hashes were already computed (see `hllAddHash()`).
+ *
+ * If `_this` or `hashes` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the HyperLogLog structure, that counts the set.
+ * @param hashes The 64-bit hashes of the items, `n` of them.
+ * @param n The number of items.
+ */
+void hllAddHashes(struct HyperLogLog *_this, const uint64_t *hashes, size_t n);
+
 /**
  * Counts the number of unique items added to the set.
  *
@@ -153,4 +291,101 @@ void hllAdd(struct HyperLogLog *_this, const void *item);
  */
 double hllCount(struct HyperLogLog *_this);
 
+/**
+ * Merges another set into a set, so that the set counts the union of both sets afterwards.
+ *
+ * Both sets have to use the same hash function. `other` may have a greater register size or number of registers than
+ * `_this`, in that case it's folded on the fly (see `hllFold()`), which is slower than merging sets with equal
+ * parameters.
+ *
+ * @param _this Points to the HyperLogLog structure, that receives the union.
+ * @param other Points to the HyperLogLog structure, that is merged into `_this`. It is not modified.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `other` (`NULL` or smaller `r` or `b`)
+ */
+int hllMerge(struct HyperLogLog *_this, const struct HyperLogLog *other);
+
+/**
+ * Reduces the precision of a set to save memory, or to make it compatible to sets with a lower precision.
+ *
+ * The number of registers can be reduced (\f$b' \le b\f$) by combining all registers whose indices have the same
+ * \f$b'\f$ least significant bits. The register size can be narrowed (\f$r' \le r\f$) by clamping the registers to
+ * the greatest value of the new register size. Since the register index and the trailing zero count are taken from
+ * disjoint parts of the hash, the result is exactly the same as if all items had been added to a set with \f$r'\f$
+ * and \f$b'\f$ directly (as long as the hash function meets the requirements described at `HyperLogLog::hash`).
+ *
+ * @param _this Points to the HyperLogLog structure to fold.
+ * @param r The new register size (\f$\le\f$ the current one).
+ * @param b The new number of index bits (\f$4 \le b \le\f$ the current one).
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `r`
+ *  * 3 = invalid argument `b`
+ *  * -1 = malloc error (the set is not modified, then)
+ */
+int hllFold(struct HyperLogLog *_this, unsigned char r, unsigned char b);
+
+/**
+ * Writes a set into a buffer, so it can be sent to another process (e.g. to an aggregation server, see
+ * `hllClientMerge()`) and restored with `hllDeserialize()`.
+ *
+ * The buffer starts with an 8 byte header (magic "HL", format version, `r`, `b`), followed by the registers as they
+ * are stored in memory (see `hllDataSize()`). The hash function is not stored. The registers are written in host byte
+ * order, so the buffer is only meant to be read on the same kind of machine.
+ *
+ * @param _this Points to the set to serialize.
+ * @param buffer The serialized set is stored here, if it's large enough. May be `NULL`, to query the size.
+ * @param size The size of `buffer` in bytes.
+ * @return The size of the serialized set in bytes (also if `buffer` was too small), or 0 if `_this` is `NULL` or
+ * invalid.
+ */
+size_t hllSerialize(const struct HyperLogLog *_this, void *buffer, size_t size);
+
+/**
+ * Initializes a set from a buffer, that was written by `hllSerialize()`.
+ *
+ * The buffer is validated, so it may come from an untrusted source: a corrupted buffer is rejected instead of crashing
+ * later operations on the set.
+ *
+ * @param _this Points to the set to be initialized. It must not be initialized yet (call `hllFree()` after using it).
+ * @param buffer Points to the serialized set.
+ * @param size The size of `buffer` in bytes.
+ * @param hash The hash function of the set. It has to be the one the serialized set was built with.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `buffer` (`NULL` or corrupted)
+ *  * 3 = invalid argument `size` (doesn't match the header)
+ *  * 4 = invalid argument `hash`
+ *  * -1 = malloc error
+ */
+int hllDeserialize(struct HyperLogLog *_this, const void *buffer, size_t size,
+	void (*hash)(const void *, size_t, void *));
+
+/**
+ * Estimates the sizes of the intersection and the differences of two sets, as well as their Jaccard index.
+ *
+ * This scans the registers of both sets once and then maximizes the joint likelihood of the register values (Ertl's
+ * joint maximum-likelihood method). This is a lot more accurate than the inclusion-exclusion principle
+ * (\f$|A \cap B| = |A| + |B| - |A \cup B|\f$), especially for small intersections.
+ *
+ * Both sets have to use the same register size, number of registers and hash function.
+ *
+ * @param _this Points to the HyperLogLog structure of set \f$A\f$.
+ * @param other Points to the HyperLogLog structure of set \f$B\f$.
+ * @param result The estimates are stored here. All estimates are 0, if both sets are empty.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `other` (`NULL` or different `r` or `b`)
+ *  * 3 = invalid argument `result`
+ *  * -1 = malloc error
+ *
+ * @see http://oertl.github.io/hyperloglog-sketch-estimation-paper/paper/paper.pdf
+ */
+int hllJointCount(struct HyperLogLog *_this, struct HyperLogLog *other, struct HyperLogLogJoint *result);
+
 #endif //AUD_HYPERLOGLOG_H
@@ -0,0 +1,284 @@
+#ifndef AUD_HYPERLOGLOGPIPELINE_H
+#define AUD_HYPERLOGLOGPIPELINE_H
+
+/**
+ * @file HyperLogLogPipeline.h
+ *
+ * Contains the struct definition of `struct HyperLogLogPipeline` as well as related function prototypes.
+ *
+ * The pipeline uses POSIX threads, so it's only available on POSIX systems.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "HyperLogLog.h"
+
+/**
+ * The number of hashes a reader buffers per worker, before it pushes them into the ring of the worker.
+ */
+#define HLL_PIPELINE_BATCH 64
+
+/**
+ * The default number of hashes per ring buffer.
+ */
+#define HLL_PIPELINE_CAPACITY 1024
+
+/**
+ * The assumed size of a cache line in bytes. The indices of a ring, that are written by different threads, are kept
+ * this far apart.
+ */
+#define HLL_PIPELINE_CACHE_LINE 64
+
+/**
+ * A single-producer/single-consumer ring buffer of 64-bit hashes, from one reader to one worker.
+ *
+ * The indices only grow (they are not wrapped), so the ring holds `tail - head` hashes.
+ */
+struct HyperLogLogPipelineRing
+{
+	/**
+	 * The slots of the ring. The number of slots is a power of 2.
+	 */
+	uint64_t *slots;
+
+	/**
+	 * The number of slots minus 1.
+	 */
+	size_t mask;
+
+	char padding0[HLL_PIPELINE_CACHE_LINE];
+
+	/**
+	 * The index of the next hash to be pushed. Only written by the reader.
+	 */
+	size_t tail;
+
+	/**
+	 * The last value of `head`, that the reader has seen (so it doesn't read `head` for every push).
+	 */
+	size_t head_cache;
+
+	char padding1[HLL_PIPELINE_CACHE_LINE];
+
+	/**
+	 * The index of the next hash to be applied. Only written by the worker, after the hashes were applied.
+	 */
+	size_t head;
+
+	/**
+	 * The last value of `tail`, that the worker has seen.
+	 */
+	size_t tail_cache;
+
+	char padding2[HLL_PIPELINE_CACHE_LINE];
+};
+
+/**
+ * The state of a reader of a pipeline.
+ */
+struct HyperLogLogPipelineReader
+{
+	/**
+	 * `HLL_PIPELINE_BATCH` hashes per worker, that were not pushed yet.
+	 */
+	uint64_t *buffers;
+
+	/**
+	 * The number of hashes in the buffer of each worker.
+	 */
+	size_t *lengths;
+};
+
+/**
+ * A worker thread of a pipeline.
+ */
+struct HyperLogLogPipelineWorker
+{
+	/**
+	 * The thread, that applies the hashes of the worker's rings.
+	 */
+	pthread_t thread;
+
+	/**
+	 * Is held while the worker updates its registers, so the set can be counted in between.
+	 */
+	pthread_mutex_t lock;
+
+	/**
+	 * The pipeline the worker belongs to.
+	 */
+	struct HyperLogLogPipeline *pipeline;
+
+	/**
+	 * The number of the worker.
+	 */
+	size_t index;
+};
+
+/**
+ * Adds items to a single HyperLogLog set from several threads, without synchronizing the registers.
+ *
+ * The registers of the set are split into disjoint ranges, and every range is owned by one worker thread. The caller's
+ * threads (readers) hash the items and route each hash to the worker that owns its register, through a
+ * single-producer/single-consumer ring buffer per reader and worker. Only the owning worker ever writes a register, so
+ * the updates need neither atomics nor locks, and no cache line of the set is shared between workers.
+ *
+ * If a ring is full, the reader waits until the worker catches up (backpressure). Readers buffer a few hashes per
+ * worker, so they have to call `hllPipelineFlush()` to make sure that all of their items are pushed.
+ * `hllPipelineCount()` counts all items, that were pushed before the call.
+ *
+ * Items are added like with `hllAddHash()`, using the first 8 bytes of their hash, so the set is the same as if
+ * `hllAddHash()` was called for every item.
+ *
+ * Only sets with MEDIUM or LARGE registers can be used, because the registers of SMALL sets share their base and
+ * exception list.
+ *
+ * You should always call `hllPipelineInit()` before and `hllPipelineFree()` after using this structure. The set must
+ * not be accessed otherwise while the pipeline exists, except for reading it after `hllPipelineWait()` (as long as no
+ * reader adds items).
+ *
+ * The members of this struct should not be accessed directly.
+ * Allways use this struct through the provided methods that start with "hllPipeline".
+ *
+ * @see hllPipelineInit()
+ * @see hllPipelineFree()
+ * @see hllPipelineAdd()
+ * @see hllPipelineAddHash()
+ * @see hllPipelineFlush()
+ * @see hllPipelineWait()
+ * @see hllPipelineCount()
+ */
+struct HyperLogLogPipeline
+{
+	/**
+	 * The set the items are added to.
+	 */
+	struct HyperLogLog *set;
+
+	/**
+	 * The number of readers, that may add items (see `hllPipelineAdd()`).
+	 */
+	size_t n_readers;
+
+	/**
+	 * The number of worker threads, that own the registers.
+	 */
+	size_t n_workers;
+
+	/**
+	 * The number of registers owned by every worker (a multiple of a cache line). Worker `i` owns the registers from
+	 * `i * span - shift` to `(i + 1) * span - shift - 1`.
+	 */
+	size_t span;
+
+	/**
+	 * The number of registers, that would fit into the cache line of the first register in front of it. Shifting the
+	 * ranges by this makes them start at cache line boundaries, even if the registers don't.
+	 */
+	size_t shift;
+
+	/**
+	 * The rings of all readers and workers. The ring from reader `i` to worker `j` is `rings[i * n_workers + j]`.
+	 */
+	struct HyperLogLogPipelineRing *rings;
+
+	/**
+	 * The buffered hashes of every reader, `n_readers` of them.
+	 */
+	struct HyperLogLogPipelineReader *readers;
+
+	/**
+	 * The worker threads, `n_workers` of them.
+	 */
+	struct HyperLogLogPipelineWorker *workers;
+
+	/**
+	 * Non-zero, if the workers shall stop after they applied all hashes.
+	 */
+	int stop;
+};
+
+/**
+ * Initializes a pipeline and starts its workers.
+ *
+ * @param _this Points to the pipeline to be initialized.
+ * @param set The set the items are added to (MEDIUM or LARGE registers). It must not be freed before the pipeline.
+ * @param n_readers The number of readers. Every reader must only be used by one thread at a time.
+ * @param n_workers The number of worker threads. If the set has fewer cache lines of registers than workers, the
+ * excess workers stay idle.
+ * @param capacity The number of hashes per ring (a power of 2, at least `HLL_PIPELINE_BATCH`), or 0 for
+ * `HLL_PIPELINE_CAPACITY`.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `set` (`NULL` or SMALL registers)
+ *  * 3 = invalid argument `n_readers` (0)
+ *  * 4 = invalid argument `n_workers` (0)
+ *  * 5 = invalid argument `capacity`
+ *  * -1 = malloc error or the threads could not be started
+ */
+int hllPipelineInit(struct HyperLogLogPipeline *_this, struct HyperLogLog *set, size_t n_readers, size_t n_workers,
+	size_t capacity);
+
+/**
+ * Applies all items, that were added so far (including the buffered ones), stops the workers and frees all the memory
+ * used by a pipeline. The set is not freed.
+ *
+ * No reader may add items during or after this call. If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the pipeline to be freed. This pointer itself is not freed.
+ */
+void hllPipelineFree(struct HyperLogLogPipeline *_this);
+
+/**
+ * Adds an item to the set of a pipeline. The item is hashed by the calling thread.
+ *
+ * The item may only be counted after the reader called `hllPipelineFlush()`. If the ring to the worker is full, this
+ * function waits.
+ *
+ * @param _this Points to the pipeline.
+ * @param reader The number of the reader (less than `n_readers`).
+ * @param item The item to add.
+ */
+void hllPipelineAdd(struct HyperLogLogPipeline *_this, size_t reader, const void *item);
+
+/**
+ * Adds an item with a precomputed 64-bit hash to the set of a pipeline (see `hllAddHash()` and `hllPipelineAdd()`).
+ *
+ * @param _this Points to the pipeline.
+ * @param reader The number of the reader (less than `n_readers`).
+ * @param hash The hash of the item.
+ */
+void hllPipelineAddHash(struct HyperLogLogPipeline *_this, size_t reader, uint64_t hash);
+
+/**
+ * Pushes the buffered hashes of a reader to the workers, so they are counted by the next `hllPipelineWait()` or
+ * `hllPipelineCount()`.
+ *
+ * @param _this Points to the pipeline.
+ * @param reader The number of the reader (less than `n_readers`).
+ */
+void hllPipelineFlush(struct HyperLogLogPipeline *_this, size_t reader);
+
+/**
+ * Waits until the workers applied all hashes, that were pushed before the call (barrier).
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the pipeline.
+ */
+void hllPipelineWait(struct HyperLogLogPipeline *_this);
+
+/**
+ * Estimates the number of distinct items, that were pushed before the call (see `hllPipelineWait()` and
+ * `hllCount()`).
+ *
+ * The workers are paused while the registers are counted, so readers may keep adding items during the call.
+ *
+ * @param _this Points to the pipeline.
+ * @return The estimated number of distinct items, or NaN if `_this` is `NULL`.
+ */
+double hllPipelineCount(struct HyperLogLogPipeline *_this);
+
+#endif //AUD_HYPERLOGLOGPIPELINE_H
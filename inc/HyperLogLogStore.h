@@ -0,0 +1,337 @@
+#ifndef AUD_HYPERLOGLOGSTORE_H
+#define AUD_HYPERLOGLOGSTORE_H
+
+/**
+ * @file HyperLogLogStore.h
+ *
+ * Contains the struct definition of `struct HyperLogLogStore` as well as related function prototypes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "HyperLogLog.h"
+
+/**
+ * A slot of the hash table of `struct HyperLogLogStore`.
+ */
+struct HyperLogLogStoreEntry
+{
+	/**
+	 * The key of the sketch.
+	 */
+	uint64_t key;
+
+	/**
+	 * The number of the sketch in the slabs.
+	 */
+	uint32_t sketch;
+
+	/**
+	 * Non-zero, if this slot is in use.
+	 */
+	uint8_t used;
+
+	/**
+	 * Non-zero, if the sketch was accessed since the eviction clock hand passed this slot the last time.
+	 */
+	uint8_t referenced;
+};
+
+/**
+ * Stores one HyperLogLog sketch per key (e.g. "distinct users per customer"), for a large number of keys.
+ *
+ * All sketches share the same parameters `r`, `b` and `hash`, so they are not stored per sketch. The registers of the
+ * sketches are stored in large shared slabs instead of one allocation per sketch, and the keys are stored in an open
+ * addressing hash table with linear probing. To access a single sketch, the store fills a `struct HyperLogLog`, that
+ * points into the slab (see `hllStoreGet()`), so all the "hll" functions can be used on it.
+ *
+ * Items can be added in batches of (key, item) pairs (see `hllStoreAddBatch()`). The pairs of a batch are partitioned
+ * by the hash of their key first, so that every partition only touches a small part of the hash table. The number of
+ * new keys of a batch is estimated with a HyperLogLog, so the hash table can be grown before the batch is added.
+ *
+ * The memory usage can be limited (see `hllStoreLimit()`). If a new key would exceed the limit, sketches that were not
+ * accessed recently are evicted (CLOCK algorithm). Alternatively, the precision of all sketches can be reduced with
+ * `hllStoreFold()`.
+ *
+ * You should always call `hllStoreInit()` before and `hllStoreFree()` after using this structure.
+ *
+ * The members of this struct should not be accessed directly, except for `count`.
+ * Allways use this struct through the provided methods that start with "hllStore".
+ *
+ * @see hllStoreInit()
+ * @see hllStoreFree()
+ * @see hllStoreLimit()
+ * @see hllStoreAdd()
+ * @see hllStoreAddBatch()
+ * @see hllStoreGet()
+ * @see hllStoreOpen()
+ * @see hllStoreRemove()
+ * @see hllStoreCount()
+ * @see hllStoreMerge()
+ * @see hllStoreFold()
+ */
+struct HyperLogLogStore
+{
+	/**
+	 * The register size of all sketches.
+	 */
+	unsigned char r;
+
+	/**
+	 * The number of index bits of all sketches.
+	 */
+	unsigned char b;
+
+	/**
+	 * The hash function of all sketches.
+	 */
+	void (*hash)(const void *item, size_t h, void *buffer);
+
+	/**
+	 * The size of the registers of one sketch in bytes.
+	 */
+	size_t data_size;
+
+	/**
+	 * The number of keys in the store.
+	 */
+	size_t count;
+
+	/**
+	 * The hash table. Its capacity is a power of 2, and it's at most half full.
+	 */
+	struct HyperLogLogStoreEntry *entries;
+
+	/**
+	 * The capacity of the hash table.
+	 */
+	size_t capacity;
+
+	/**
+	 * The slabs that contain the registers of the sketches. Every slab holds `1 << slab_shift` sketches.
+	 */
+	uint8_t **slabs;
+
+	/**
+	 * The number of slabs.
+	 */
+	size_t n_slabs;
+
+	/**
+	 * Every slab holds `1 << slab_shift` sketches.
+	 */
+	unsigned char slab_shift;
+
+	/**
+	 * The number of sketches that were handed out from the slabs so far (including the free ones).
+	 */
+	size_t n_sketches;
+
+	/**
+	 * Stack of sketches that were released by evicted or removed keys, and can be reused.
+	 */
+	uint32_t *free_sketches;
+
+	/**
+	 * The number of sketches in `free_sketches`.
+	 */
+	size_t n_free;
+
+	/**
+	 * The memory limit in bytes, or 0 if there is no limit.
+	 */
+	size_t max_bytes;
+
+	/**
+	 * Is called for every evicted sketch, or `NULL`.
+	 */
+	void (*evict)(uint64_t key, const struct HyperLogLog *sketch, void *context);
+
+	/**
+	 * Is passed to `evict`.
+	 */
+	void *context;
+
+	/**
+	 * The position of the clock hand in the hash table.
+	 */
+	size_t hand;
+};
+
+/**
+ * Initializes an empty store.
+ *
+ * `r`, `b` and `hash` are the same as for `hllInit()`, and are used for all sketches of the store.
+ *
+ * @param _this Points to the store to be initialized.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `r`
+ *  * 3 = invalid argument `b`
+ *  * 4 = invalid argument `hash`
+ *  * -1 = malloc error
+ *
+ * @see hllInit()
+ */
+int hllStoreInit(struct HyperLogLogStore *_this, unsigned char r, unsigned char b,
+	void (*hash)(const void *, size_t, void *));
+
+/**
+ * Frees all the memory used by a store.
+ *
+ * If `_this` is `NULL`, nothing happens. `evict` is not called.
+ *
+ * @param _this Points to the store to be freed. This pointer itself is not freed.
+ */
+void hllStoreFree(struct HyperLogLogStore *_this);
+
+/**
+ * Limits the memory usage of a store.
+ *
+ * The limit applies to the registers of all sketches in use, plus the hash table. Whenever a new key would exceed the
+ * limit, sketches are evicted until it fits. Sketches that were accessed recently are evicted last. At least one
+ * sketch is always kept, even if it doesn't fit.
+ *
+ * If the store already exceeds the new limit, sketches are evicted right away.
+ *
+ * @param _this Points to the store.
+ * @param max_bytes The memory limit in bytes, or 0 for no limit.
+ * @param evict Is called for every evicted sketch (before it's discarded), or `NULL`. The sketch must not be modified
+ * and is only valid during the call. The store must not be modified by this function.
+ * @param context Is passed to `evict`.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *
+ * @see hllStoreMemory()
+ */
+int hllStoreLimit(struct HyperLogLogStore *_this, size_t max_bytes,
+	void (*evict)(uint64_t key, const struct HyperLogLog *sketch, void *context), void *context);
+
+/**
+ * Returns the memory usage of a store in bytes, as it's used for the limit of `hllStoreLimit()`.
+ *
+ * @param _this Points to the store.
+ * @return The memory usage in bytes, or 0 if `_this` is `NULL`.
+ */
+size_t hllStoreMemory(const struct HyperLogLogStore *_this);
+
+/**
+ * Adds an item to the sketch of a key. If there is no sketch for `key` yet, it's created.
+ *
+ * @param _this Points to the store.
+ * @param key The key of the sketch.
+ * @param item The item to add.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * -1 = malloc error (or too many sketches)
+ */
+int hllStoreAdd(struct HyperLogLogStore *_this, uint64_t key, const void *item);
+
+/**
+ * Adds many items to the sketches of their keys. `items[i]` is added to the sketch of `keys[i]`.
+ *
+ * For large batches, this is faster than calling `hllStoreAdd()` for each pair, because the pairs are partitioned by
+ * the hash of their keys first, so accesses to the hash table are local. If the memory limit (see `hllStoreLimit()`)
+ * is too low for the keys of the store plus all keys of the batch, the pairs are added in their original order
+ * instead.
+ *
+ * @param _this Points to the store.
+ * @param keys The keys, `n` of them.
+ * @param items The items, `n` of them.
+ * @param n The number of (key, item) pairs.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `keys`
+ *  * 3 = invalid argument `items`
+ *  * -1 = malloc error (some of the items may have been added)
+ */
+int hllStoreAddBatch(struct HyperLogLogStore *_this, const uint64_t *keys, const void *const *items, size_t n);
+
+/**
+ * Looks up the sketch of a key.
+ *
+ * @param _this Points to the store.
+ * @param key The key of the sketch.
+ * @param sketch Is set to the sketch of `key`, if it was found. The sketch points into the store, so it must not be
+ * freed. It's valid until the store is modified the next time (except for adding items to this sketch).
+ * @return 1 if the sketch was found, 0 if it was not found or if `_this` or `sketch` is `NULL`.
+ */
+int hllStoreGet(struct HyperLogLogStore *_this, uint64_t key, struct HyperLogLog *sketch);
+
+/**
+ * Looks up the sketch of a key, like `hllStoreGet()`, but creates an empty sketch, if there is none for `key` yet (other
+ * sketches may be evicted, then). This is useful to merge other sets into the sketch of a key with `hllMerge()`.
+ *
+ * @param _this Points to the store.
+ * @param key The key of the sketch.
+ * @param sketch Is set to the sketch of `key`. It's valid until the store is modified the next time (see
+ * `hllStoreGet()`).
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 3 = invalid argument `sketch`
+ *  * -1 = malloc error (or too many sketches)
+ */
+int hllStoreOpen(struct HyperLogLogStore *_this, uint64_t key, struct HyperLogLog *sketch);
+
+/**
+ * Removes the sketch of a key. `evict` is not called.
+ *
+ * @param _this Points to the store.
+ * @param key The key of the sketch.
+ * @return 1 if the sketch was removed, 0 if it was not found or if `_this` is `NULL`.
+ */
+int hllStoreRemove(struct HyperLogLogStore *_this, uint64_t key);
+
+/**
+ * Estimates the number of unique items of many keys.
+ *
+ * @param _this Points to the store.
+ * @param keys The keys, `n` of them.
+ * @param n The number of keys.
+ * @param results Receives the estimates, `n` of them. The estimate of an unknown key is 0.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `keys`
+ *  * 3 = invalid argument `results`
+ */
+int hllStoreCount(struct HyperLogLogStore *_this, const uint64_t *keys, size_t n, double *results);
+
+/**
+ * Merges the sketches of many keys into a set, so that the set counts the union of all those keys afterwards.
+ *
+ * Unknown keys are ignored. `result` may have a lower precision than the store (see `hllMerge()`).
+ *
+ * @param _this Points to the store.
+ * @param keys The keys, `n` of them.
+ * @param n The number of keys.
+ * @param result Points to an initialized set, that receives the union.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `keys`
+ *  * 3 = invalid argument `result` (`NULL` or greater `r` or `b` than the store)
+ */
+int hllStoreMerge(struct HyperLogLogStore *_this, const uint64_t *keys, size_t n, struct HyperLogLog *result);
+
+/**
+ * Reduces the precision of all sketches of a store (see `hllFold()`), to fit more keys into the same memory.
+ *
+ * @param _this Points to the store.
+ * @param r The new register size (\f$\le\f$ the current one).
+ * @param b The new number of index bits (\f$4 \le b \le\f$ the current one).
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `r`
+ *  * 3 = invalid argument `b`
+ *  * -1 = malloc error (the store is not modified, then)
+ */
+int hllStoreFold(struct HyperLogLogStore *_this, unsigned char r, unsigned char b);
+
+#endif //AUD_HYPERLOGLOGSTORE_H
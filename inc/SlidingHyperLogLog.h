@@ -0,0 +1,124 @@
+#ifndef AUD_SLIDINGHYPERLOGLOG_H
+#define AUD_SLIDINGHYPERLOGLOG_H
+
+/**
+ * @file SlidingHyperLogLog.h
+ *
+ * Contains the struct definition of `struct SlidingHyperLogLog` as well as related function prototypes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "HyperLogLog.h"
+
+/**
+ * Counts the number of unique items that were added within a sliding time window (e.g. "distinct users in the last 5
+ * minutes").
+ *
+ * Time is divided into slots of a fixed length, and every slot has its own `struct HyperLogLog`. The slots form a ring
+ * buffer, so the oldest slot is reused when time moves on. On top of the slots, there is a binary tree of pre-merged
+ * sketches (every inner sketch is the union of its two children), so a window query only needs to merge
+ * \f$O(log(n))\f$ sketches instead of one sketch per slot. Inner sketches are updated lazily, when they are needed by
+ * a query.
+ *
+ * Adding an item only updates one register (and hashes the item once), just like `hllAdd()`.
+ *
+ * The memory usage is about \f$2n\f$ times the memory of a single `struct HyperLogLog`, where \f$n\f$ is the number
+ * of slots.
+ *
+ * You should always call `shllInit()` before and `shllFree()` after using this structure.
+ *
+ * The members of this struct should not be accessed directly.
+ * Allways use this struct through the provided methods that start with "shll".
+ *
+ * @see shllInit()
+ * @see shllFree()
+ * @see shllAdd()
+ * @see shllCount()
+ */
+struct SlidingHyperLogLog
+{
+	/**
+	 * The sketches of the binary tree. `nodes[1]` is the root, the children of `nodes[i]` are `nodes[2 * i]` and
+	 * `nodes[2 * i + 1]`, and the slots are `nodes[n_slots]` to `nodes[2 * n_slots - 1]`. `nodes[0]` is used to
+	 * combine the sketches of a query.
+	 */
+	struct HyperLogLog *nodes;
+
+	/**
+	 * `dirty[i]` is non-zero, if `nodes[i]` has to be recomputed from its children.
+	 */
+	unsigned char *dirty;
+
+	/**
+	 * The number of slots (a power of 2).
+	 */
+	size_t n_slots;
+
+	/**
+	 * The length of one slot in time units.
+	 */
+	uint64_t slot_length;
+
+	/**
+	 * The number of the newest slot (the time of the latest item divided by `slot_length`).
+	 */
+	uint64_t head;
+};
+
+/**
+ * Initializes an empty sliding window counter.
+ *
+ * `r`, `b` and `hash` are the same as for `hllInit()`.
+ *
+ * @param _this Points to the counter to be initialized.
+ * @param n_slots The number of slots. It's rounded up to the next power of 2.
+ * @param slot_length The length of one slot in time units (e.g. seconds). Windows are rounded up to whole slots, so
+ * this is the granularity of the window. The longest window, that can be counted is `n_slots * slot_length`.
+ * @return status code with the following meanings:<br/>
+ *  * 0 = success
+ *  * 1 = invalid argument `_this`
+ *  * 2 = invalid argument `r`
+ *  * 3 = invalid argument `b`
+ *  * 4 = invalid argument `hash`
+ *  * 5 = invalid argument `n_slots`
+ *  * 6 = invalid argument `slot_length`
+ *  * -1 = malloc error
+ *
+ * @see hllInit()
+ */
+int shllInit(struct SlidingHyperLogLog *_this, unsigned char r, unsigned char b,
+	void (*hash)(const void *, size_t, void *), size_t n_slots, uint64_t slot_length);
+
+/**
+ * Frees all the memory used by a sliding window counter.
+ *
+ * If `_this` is `NULL`, nothing happens.
+ *
+ * @param _this Points to the structure to be freed. This pointer itself is not freed.
+ */
+void shllFree(struct SlidingHyperLogLog *_this);
+
+/**
+ * Adds an item that occurred at a given time.
+ *
+ * Times should be (roughly) increasing. Items that are older than the oldest slot are ignored.
+ *
+ * @param _this Points to the counter.
+ * @param item The item to add.
+ * @param time The time the item occurred, in the same units as `slot_length`.
+ */
+void shllAdd(struct SlidingHyperLogLog *_this, const void *item, uint64_t time);
+
+/**
+ * Counts the number of unique items that were added within the time window `(now - window, now]` (rounded to whole
+ * slots).
+ *
+ * @param _this Points to the counter.
+ * @param now The end of the window.
+ * @param window The length of the window. Windows longer than `n_slots * slot_length` are shortened.
+ * @return An approximation of the number of unique items in the window, or NaN on error.
+ */
+double shllCount(struct SlidingHyperLogLog *_this, uint64_t now, uint64_t window);
+
+#endif //AUD_SLIDINGHYPERLOGLOG_H
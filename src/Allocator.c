@@ -0,0 +1,129 @@
+/**
+ * @file Allocator.c
+ *
+ * Contains the implementations of the functions defined in Allocator.h, as well as some static helper functions.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../inc/Allocator.h"
+
+/**
+ * The default backend of `Allocator::allocate`: calls `malloc()`.
+ */
+static void *allocate(void *context, size_t size)
+{
+	(void)context;
+
+	return malloc(size);
+}
+
+/**
+ * The default backend of `Allocator::release`: calls `free()`.
+ */
+static void release(void *context, void *pointer, size_t size)
+{
+	(void)context;
+	(void)size;
+
+	free(pointer);
+}
+
+/**
+ * Adds `size` bytes to the used bytes of an allocator, if they fit into the budget.
+ *
+ * @return 1 on success, 0 if the budget would be exceeded
+ */
+static int reserve(struct Allocator *this, size_t size)
+{
+	size_t used = __atomic_load_n(&this->used, __ATOMIC_RELAXED);
+	size_t new_used;
+
+	do
+	{
+		new_used = used + size;
+
+		if (new_used < used || (this->limit != 0 && new_used > this->limit))
+		{
+			__atomic_add_fetch(&this->failures, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+	}
+	while (!__atomic_compare_exchange_n(&this->used, &used, new_used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	size_t peak = __atomic_load_n(&this->peak, __ATOMIC_RELAXED);
+
+	while (new_used > peak && !__atomic_compare_exchange_n(&this->peak, &peak, new_used, 1, __ATOMIC_RELAXED,
+		__ATOMIC_RELAXED));
+
+	return 1;
+}
+
+void allocatorInit(struct Allocator *this, size_t limit)
+{
+	if (this == NULL)
+		return;
+
+	this->allocate = &allocate;
+	this->release = &release;
+	this->context = NULL;
+	this->limit = limit;
+	this->used = 0;
+	this->peak = 0;
+	this->failures = 0;
+}
+
+void *allocatorMalloc(struct Allocator *this, size_t size)
+{
+	if (this == NULL)
+		return malloc(size);
+
+	if (!reserve(this, size))
+		return NULL;
+
+	void *pointer = this->allocate(this->context, size);
+
+	if (pointer == NULL)
+	{
+		__atomic_sub_fetch(&this->used, size, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&this->failures, 1, __ATOMIC_RELAXED);
+	}
+
+	return pointer;
+}
+
+void *allocatorCalloc(struct Allocator *this, size_t size)
+{
+	if (this == NULL)
+		return calloc(size, sizeof(char));
+
+	void *pointer = allocatorMalloc(this, size);
+
+	if (pointer != NULL)
+		memset(pointer, 0, size);
+
+	return pointer;
+}
+
+void allocatorFree(struct Allocator *this, void *pointer, size_t size)
+{
+	if (pointer == NULL)
+		return;
+
+	if (this == NULL)
+	{
+		free(pointer);
+		return;
+	}
+
+	this->release(this->context, pointer, size);
+	__atomic_sub_fetch(&this->used, size, __ATOMIC_RELAXED);
+}
+
+size_t allocatorUsed(struct Allocator *this)
+{
+	if (this == NULL)
+		return 0;
+
+	return __atomic_load_n(&this->used, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,494 @@
+/**
+ * @file AvlSnapshot.c
+ *
+ * Contains implementations of the functions defined in AvlSnapshot.h, as well as some static helper functions.
+ *
+ * A snapshot file consists of a 64 byte header (`struct SnapshotHeader`), followed by the payload. The payload
+ * contains all keys in sorted order. Length-prefixed keys are padded to a multiple of 4 bytes and are followed by a
+ * table of 64-bit offsets. The payload is always padded to a multiple of 8 bytes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../inc/AvlSnapshot.h"
+
+/**
+ * Identifies a snapshot file.
+ */
+static const char MAGIC[8] = "AUDAVLS";
+
+/**
+ * The version of the file format.
+ */
+#define VERSION 1
+
+/**
+ * The size of the write buffer (has to be a multiple of 8).
+ */
+#define BUFFER_SIZE 65536
+
+/**
+ * The header at the beginning of every snapshot file.
+ */
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t key_size;
+	uint64_t count;
+	uint64_t payload_size;
+	uint64_t checksum;
+	uint64_t reserved[3];
+};
+
+/**
+ * Buffers the payload of a snapshot while it is written, and computes its checksum.
+ */
+struct SnapshotWriter
+{
+	FILE *file;
+	uint64_t checksum;
+	uint64_t size;
+	size_t used;
+	int error;
+
+	/**
+	 * Holds `used` bytes of the payload. It's declared as an array of words, so `updateChecksum()` can read it.
+	 */
+	uint64_t buffer[BUFFER_SIZE / sizeof(uint64_t)];
+};
+
+/**
+ * Rounds `x` up to the next multiple of `alignment` (which has to be a power of 2).
+ */
+static inline uint64_t alignUp(uint64_t x, uint64_t alignment)
+{
+	return (x + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Updates a checksum (a variant of FNV-1a that processes 64-bit words) with `n` bytes of data.
+ *
+ * @param checksum The checksum of the preceding data.
+ * @param data Points to the data. Has to be 8 byte aligned.
+ * @param n The number of bytes in `data`. Has to be a multiple of 8.
+ * @return The updated checksum.
+ */
+static uint64_t updateChecksum(uint64_t checksum, const void *data, size_t n)
+{
+	const uint64_t *words = data;
+
+	for (size_t i = 0; i < n / sizeof(uint64_t); i++)
+	{
+		checksum ^= words[i];
+		checksum *= 0x100000001B3;
+		checksum ^= checksum >> 32;
+	}
+
+	return checksum;
+}
+
+/**
+ * Writes the buffer of a writer to its file.
+ */
+static void writerFlush(struct SnapshotWriter *writer)
+{
+	if (writer->used == 0)
+		return;
+
+	writer->checksum = updateChecksum(writer->checksum, writer->buffer, writer->used);
+
+	if (fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)
+		writer->error = 1;
+
+	writer->used = 0;
+}
+
+/**
+ * Appends `n` bytes to the payload.
+ */
+static void writerPut(struct SnapshotWriter *writer, const void *data, size_t n)
+{
+	const unsigned char *bytes = data;
+
+	writer->size += n;
+
+	while (n > 0)
+	{
+		size_t chunk = BUFFER_SIZE - writer->used;
+		if (chunk > n)
+			chunk = n;
+
+		memcpy((unsigned char *)writer->buffer + writer->used, bytes, chunk);
+		writer->used += chunk;
+		bytes += chunk;
+		n -= chunk;
+
+		if (writer->used == BUFFER_SIZE)
+			writerFlush(writer);
+	}
+}
+
+/**
+ * Appends zero bytes to the payload, until its size is a multiple of `alignment`.
+ */
+static void writerPad(struct SnapshotWriter *writer, uint64_t alignment)
+{
+	static const unsigned char zeros[8];
+
+	writerPut(writer, zeros, (size_t)(alignUp(writer->size, alignment) - writer->size));
+}
+
+/**
+ * Returns the node with the smallest value in the subtree of `node`.
+ */
+static struct AvlNode *leftmost(struct AvlNode *node)
+{
+	if (node != NULL)
+	{
+		while (node->left != NULL)
+			node = node->left;
+	}
+
+	return node;
+}
+
+/**
+ * Returns the in-order successor of `node`, or `NULL` if `node` has the greatest value of the tree.
+ */
+static struct AvlNode *successor(struct AvlNode *node)
+{
+	if (node->right != NULL)
+		return leftmost(node->right);
+
+	while (node->parent != NULL && node == node->parent->right)
+		node = node->parent;
+
+	return node->parent;
+}
+
+/**
+ * Returns a pointer to the `index`th key of a snapshot.
+ */
+static const void *getKey(struct AvlSnapshot *snapshot, size_t index)
+{
+	if (snapshot->offsets == NULL)
+		return snapshot->keys + index * snapshot->key_size;
+	else
+		return snapshot->keys + snapshot->offsets[index];
+}
+
+/**
+ * Checks the offset table of a snapshot with length-prefixed keys.
+ *
+ * @return non-zero, if all keys lie within the payload<br/>
+ * 0, otherwise
+ */
+static int checkOffsets(struct AvlSnapshot *snapshot, uint64_t records_size)
+{
+	for (size_t i = 0; i < snapshot->count; i++)
+	{
+		uint64_t offset = snapshot->offsets[i];
+		uint32_t length;
+
+		if (offset % sizeof(uint32_t) != 0 || offset + sizeof(uint32_t) > records_size)
+			return 0;
+
+		memcpy(&length, snapshot->keys + offset, sizeof(uint32_t));
+
+		if (length > records_size - offset - sizeof(uint32_t))
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Flushes the directory entries of the directory, that contains `path`, to the disk (so a renamed file survives a power
+ * loss). Errors are ignored, because some file systems don't support syncing directories.
+ */
+static void syncDirectory(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char *directory;
+
+	if (slash == NULL)
+	{
+		directory = strdup(".");
+	}
+	else
+	{
+		size_t length = slash == path ? 1 : (size_t)(slash - path);
+
+		directory = strndup(path, length);
+	}
+
+	if (directory == NULL)
+		return;
+
+	int fd = open(directory, O_RDONLY);
+
+	if (fd >= 0)
+	{
+		fsync(fd);
+		close(fd);
+	}
+
+	free(directory);
+}
+
+int avlSnapshotWrite(struct AvlTree *this, const char *path, size_t key_size)
+{
+	if (this == NULL)
+		return 1;
+
+	if (path == NULL)
+		return 2;
+
+	if (key_size > UINT32_MAX)
+		return 3;
+
+	size_t path_length = strlen(path);
+	char *tmp_path = malloc(path_length + sizeof(".tmp"));
+	if (tmp_path == NULL)
+		return -1;
+
+	memcpy(tmp_path, path, path_length);
+	memcpy(tmp_path + path_length, ".tmp", sizeof(".tmp"));
+
+	struct SnapshotWriter *writer = malloc(sizeof(struct SnapshotWriter));
+	if (writer == NULL)
+	{
+		free(tmp_path);
+		return -1;
+	}
+
+	writer->file = fopen(tmp_path, "wb");
+	if (writer->file == NULL)
+	{
+		free(writer);
+		free(tmp_path);
+		return 2;
+	}
+
+	writer->checksum = 0xCBF29CE484222325;
+	writer->size = 0;
+	writer->used = 0;
+	writer->error = 0;
+
+	struct SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+
+	// reserve space for the header, it's written when the checksum is known
+	if (fwrite(&header, sizeof(header), 1, writer->file) != 1)
+		writer->error = 1;
+
+	// keys
+	for (struct AvlNode *node = leftmost(this->root); node != NULL; node = successor(node))
+	{
+		if (key_size > 0)
+		{
+			writerPut(writer, node->value, key_size);
+		}
+		else
+		{
+			uint32_t length;
+			memcpy(&length, node->value, sizeof(uint32_t));
+
+			writerPut(writer, node->value, sizeof(uint32_t) + length);
+			writerPad(writer, sizeof(uint32_t));
+		}
+	}
+
+	// offset table
+	if (key_size == 0)
+	{
+		writerPad(writer, sizeof(uint64_t));
+
+		uint64_t offset = 0;
+
+		for (struct AvlNode *node = leftmost(this->root); node != NULL; node = successor(node))
+		{
+			uint32_t length;
+			memcpy(&length, node->value, sizeof(uint32_t));
+
+			writerPut(writer, &offset, sizeof(uint64_t));
+			offset += alignUp(sizeof(uint32_t) + length, sizeof(uint32_t));
+		}
+	}
+
+	writerPad(writer, sizeof(uint64_t));
+	writerFlush(writer);
+
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.key_size = (uint32_t)key_size;
+	header.count = this->count;
+	header.payload_size = writer->size;
+	header.checksum = writer->checksum;
+
+	if (fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, writer->file) != 1)
+		writer->error = 1;
+
+	// the data has to be on the disk before the rename, otherwise the renamed file may be empty after a power loss
+	if (fflush(writer->file) != 0 || fsync(fileno(writer->file)) != 0)
+		writer->error = 1;
+
+	if (fclose(writer->file) != 0)
+		writer->error = 1;
+
+	int error = writer->error;
+	free(writer);
+
+	if (!error && rename(tmp_path, path) != 0)
+		error = 1;
+
+	if (!error)
+		syncDirectory(path);
+
+	if (error)
+		remove(tmp_path);
+
+	free(tmp_path);
+
+	return error ? -1 : 0;
+}
+
+int avlSnapshotOpen(struct AvlSnapshot *this, const char *path)
+{
+	if (this == NULL)
+		return 1;
+
+	memset(this, 0, sizeof(struct AvlSnapshot));
+
+	if (path == NULL)
+		return 2;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 2;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t)st.st_size < sizeof(struct SnapshotHeader))
+	{
+		close(fd);
+		return 3;
+	}
+
+	void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return -1;
+
+	this->map = map;
+	this->map_size = (size_t)st.st_size;
+
+	const struct SnapshotHeader *header = map;
+	uint64_t payload_size = this->map_size - sizeof(struct SnapshotHeader);
+	int status = 0;
+
+	this->key_size = header->key_size;
+	this->count = header->count;
+	this->keys = (const unsigned char *)map + sizeof(struct SnapshotHeader);
+
+	if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION)
+		status = 3;
+	else if (header->payload_size != payload_size)
+		status = 3;
+	else if (this->key_size > 0 && (this->count > payload_size / this->key_size ||
+		alignUp(this->count * this->key_size, sizeof(uint64_t)) != payload_size))
+		status = 3;
+	else if (this->key_size == 0 && (this->count > payload_size / sizeof(uint64_t) ||
+		payload_size % sizeof(uint64_t) != 0))
+		status = 3;
+	else if (updateChecksum(0xCBF29CE484222325, this->keys, payload_size) != header->checksum)
+		status = 4;
+	else if (this->key_size == 0)
+	{
+		uint64_t offsets_size = this->count * sizeof(uint64_t);
+
+		this->offsets = (const uint64_t *)(this->keys + payload_size - offsets_size);
+
+		if (!checkOffsets(this, payload_size - offsets_size))
+			status = 3;
+	}
+
+	if (status != 0)
+		avlSnapshotClose(this);
+
+	return status;
+}
+
+void avlSnapshotClose(struct AvlSnapshot *this)
+{
+	if (this == NULL)
+		return;
+
+	if (this->map != NULL)
+		munmap(this->map, this->map_size);
+
+	memset(this, 0, sizeof(struct AvlSnapshot));
+}
+
+int avlSnapshotLoad(struct AvlSnapshot *this, struct AvlTree *tree)
+{
+	if (this == NULL || this->map == NULL)
+		return 1;
+
+	if (tree == NULL || tree->root != NULL)
+		return 2;
+
+	// the tree stays empty (and `malloc(0)` may return `NULL`)
+	if (this->count == 0)
+		return 0;
+
+	void **items = malloc(this->count * sizeof(void *));
+	if (items == NULL)
+		return -1;
+
+	for (size_t i = 0; i < this->count; i++)
+		items[i] = (void *)getKey(this, i);
+
+	int success = avlBuild(tree, items, this->count);
+	free(items);
+
+	return success ? 0 : -1;
+}
+
+int avlSnapshotContains(struct AvlSnapshot *this, const void *item, int (*compare)(const void *, const void *))
+{
+	if (this == NULL || compare == NULL)
+		return 0;
+
+	size_t low = 0;
+	size_t high = this->count;
+
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		int comp = compare(item, getKey(this, mid));
+
+		if (comp < 0)
+			high = mid;
+		else if (comp > 0)
+			low = mid + 1;
+		else
+			return 1;
+	}
+
+	return 0;
+}
@@ -4,10 +4,50 @@
  * Contains implementations of the functions defined in AvlTree.h, as well as some static helper functions.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include "../inc/AvlTree.h"
 
+/**
+ * Increments a counter of `struct AvlCounters`, if the library is compiled with `-D AVL_STATS`.
+ */
+#ifdef AVL_STATS
+#define COUNT(tree, counter) ((tree)->counters.counter++)
+#else
+#define COUNT(tree, counter) ((void)(tree))
+#endif
+
+/**
+ * The value of `AvlNode::dirty` for dirty nodes.
+ */
+#define DIRTY 1
+
+/**
+ * During `treeRebalance()`, the roots of joined subtrees store their height plus `DIRTY_HEIGHT` in `AvlNode::dirty`.
+ */
+#define DIRTY_HEIGHT 2
+
+/**
+ * Batches (or parts of batches) of at most this many items are sorted and inserted by one thread.
+ */
+#define AVL_BATCH_GRAIN 4096
+
+/**
+ * The node of a tree in interval mode. Normal trees allocate only the `struct AvlNode`.
+ */
+struct AvlIntervalNode
+{
+	struct AvlNode node;
+
+	/**
+	 * The greatest high endpoint of all items in the subtree of this node.
+	 */
+	const void *max;
+};
+
 /**
  * This function is used as comparrison function, if `avlInit()` is passed `NULL` for the argument `compare`.
  *
@@ -19,26 +59,81 @@ int dummyCompare(const void *a, const void *b)
 	return a - a + b - b;
 }
 
+/**
+ * Returns the size of the nodes, that a tree allocates.
+ */
+static inline size_t nodeSize(const struct AvlTree *tree)
+{
+	return tree->interval != NULL ? sizeof(struct AvlIntervalNode) : sizeof(struct AvlNode);
+}
+
 /**
  * Allocates and initializes a new `AvlNode` with a given value and all pointers set to `NULL`.
  *
+ * @param tree Points to the tree the node is created for.
  * @param value The value of the new node.
  * @return Pointer to the newly allocated node, or `NULL` on failure.
  */
-static struct AvlNode *nodeCreate(void *value)
+static struct AvlNode *nodeCreate(struct AvlTree *tree, void *value)
 {
 	struct AvlNode *node;
+	size_t size = nodeSize(tree);
 
-	node = malloc(sizeof(struct AvlNode));
+	node = allocatorMalloc(tree->allocator, size);
 	if (node == NULL)
 		return NULL;
 
-	memset(node, 0, sizeof(struct AvlNode));
+	COUNT(tree, allocations);
+	tree->bytes += size;
+	memset(node, 0, size);
 	node->value = value;
 
+	if (tree->interval != NULL)
+		((struct AvlIntervalNode *)node)->max = tree->interval->high(value);
+
 	return node;
 }
 
+/**
+ * Frees a node, that was allocated by `nodeCreate()`.
+ */
+static void nodeDestroy(struct AvlTree *tree, struct AvlNode *node)
+{
+	allocatorFree(tree->allocator, node, nodeSize(tree));
+	tree->bytes -= nodeSize(tree);
+}
+
+/**
+ * Returns the greatest high endpoint in the subtree of a node of a tree in interval mode.
+ */
+static inline const void *nodeGetMax(const struct AvlNode *node)
+{
+	return ((const struct AvlIntervalNode *)node)->max;
+}
+
+/**
+ * Recalculates the greatest high endpoint in the subtree of a node of a tree in interval mode, from the node's own item
+ * and its children.
+ *
+ * @return non-zero, if the greatest high endpoint changed
+ */
+static int nodeUpdateMax(const struct AvlTree *tree, struct AvlNode *node)
+{
+	const struct AvlIntervalType *type = tree->interval;
+	const void *max = type->high(node->value);
+
+	if (node->left != NULL && type->compare(nodeGetMax(node->left), max) > 0)
+		max = nodeGetMax(node->left);
+
+	if (node->right != NULL && type->compare(nodeGetMax(node->right), max) > 0)
+		max = nodeGetMax(node->right);
+
+	int changed = max != nodeGetMax(node);
+	((struct AvlIntervalNode *)node)->max = max;
+
+	return changed;
+}
+
 /**
  * Performs a rotation around an unbalanced node, to rebalance the tree.
  *
@@ -105,18 +200,22 @@ static void nodeRotate(struct AvlNode *node, struct AvlTree *tree, int right)
 		node->parent = child;
 	}
 
-	// update balance factors
-	signed char child_old_balance = child->balance;
-
+	// update balance factors (these formulas hold for any balance factors, not only the ones after an insertion)
 	if (right)
 	{
-		child->balance++;
-		node->balance += -child_old_balance + 1;
+		node->balance = (signed char)(node->balance + 1 - (child->balance < 0 ? child->balance : 0));
+		child->balance = (signed char)(child->balance + 1 + (node->balance > 0 ? node->balance : 0));
 	}
 	else
 	{
-		child->balance--;
-		node->balance += -child_old_balance - 1;
+		node->balance = (signed char)(node->balance - 1 - (child->balance > 0 ? child->balance : 0));
+		child->balance = (signed char)(child->balance - 1 + (node->balance < 0 ? node->balance : 0));
+	}
+
+	if (tree->interval != NULL)
+	{
+		nodeUpdateMax(tree, node);
+		nodeUpdateMax(tree, child);
 	}
 }
 
@@ -141,6 +240,11 @@ static void nodeFixBalance(struct AvlNode *node, struct AvlTree *tree)
 		{
 			// rotate right around the right child
 			nodeRotate(node->right, tree, 1);
+			COUNT(tree, rotations_right_left);
+		}
+		else
+		{
+			COUNT(tree, rotations_left);
 		}
 
 		// rotate left
@@ -153,6 +257,11 @@ static void nodeFixBalance(struct AvlNode *node, struct AvlTree *tree)
 		{
 			// rotate left aroun left child
 			nodeRotate(node->left, tree, 0);
+			COUNT(tree, rotations_left_right);
+		}
+		else
+		{
+			COUNT(tree, rotations_right);
 		}
 
 		// rotate right
@@ -161,18 +270,96 @@ static void nodeFixBalance(struct AvlNode *node, struct AvlTree *tree)
 }
 
 /**
- * Frees the given node and it's child nodes recursively.
+ * Frees the given node and it's child nodes.
  *
+ * The subtree is freed iteratively (bottom-up via the parent pointers), because the tree may be very deep in relaxed
+ * mode. The child pointer of the parent of `node` is reset.
+ *
+ * @param tree Points to the tree, that allocated the nodes.
  * @param node Points to the node to be freed.
  */
-static void nodeFree(struct AvlNode *node)
+static void nodeFree(struct AvlTree *tree, struct AvlNode *node)
 {
 	if (node == NULL)
 		return;
 
-	nodeFree(node->left);
-	nodeFree(node->right);
-	free(node);
+	struct AvlNode *stop = node->parent;
+
+	while (node != stop)
+	{
+		if (node->left != NULL)
+		{
+			node = node->left;
+		}
+		else if (node->right != NULL)
+		{
+			node = node->right;
+		}
+		else
+		{
+			struct AvlNode *parent = node->parent;
+
+			if (parent != NULL)
+			{
+				if (node == parent->left)
+					parent->left = NULL;
+				else
+					parent->right = NULL;
+			}
+
+			nodeDestroy(tree, node);
+			node = parent;
+		}
+	}
+}
+
+/**
+ * Builds a perfectly balanced subtree out of a sorted array of items.
+ *
+ * @param tree Points to the tree the subtree is built for.
+ * @param items The sorted items of the subtree.
+ * @param n The number of items in `items`.
+ * @param parent The parent of the root of the new subtree.
+ * @param root The root of the new subtree is stored here (`NULL` if `n` is 0).
+ * @return The height of the new subtree, or -1 on a malloc error (no memory is leaked, then).
+ */
+static int nodeBuild(struct AvlTree *tree, void **items, size_t n, struct AvlNode *parent, struct AvlNode **root)
+{
+	*root = NULL;
+
+	if (n == 0)
+		return 0;
+
+	// the left subtree gets the extra item, so the balance factor is always -1 or 0
+	size_t mid = n / 2;
+	struct AvlNode *node = nodeCreate(tree, items[mid]);
+	if (node == NULL)
+		return -1;
+
+	node->parent = parent;
+
+	int left_height = nodeBuild(tree, items, mid, node, &node->left);
+	if (left_height < 0)
+	{
+		nodeDestroy(tree, node);
+		return -1;
+	}
+
+	int right_height = nodeBuild(tree, items + mid + 1, n - mid - 1, node, &node->right);
+	if (right_height < 0)
+	{
+		nodeFree(tree, node->left);
+		nodeDestroy(tree, node);
+		return -1;
+	}
+
+	node->balance = (signed char)(right_height - left_height);
+	*root = node;
+
+	if (tree->interval != NULL)
+		nodeUpdateMax(tree, node);
+
+	return 1 + (left_height > right_height ? left_height : right_height);
 }
 
 /**
@@ -186,16 +373,17 @@ static void nodeFree(struct AvlNode *node)
  * @param created If `created` is `NULL`, it has no effect. If not, a boolean value (false = 0, true = non-zero) is
  * stored at the location `created` points to. This value tells the caller if a new node was created (true) or not
  * (false).
+ * @param depth If `depth` is not `NULL`, the depth of the found/inserted node is stored there (the root has depth 1).
  * @return `NULL`, if `tree` is `NULL`, or if the item was not found or couldn't be inserted (e.g. due to a malloc
  * error).<br/>
  * Otherwise a pointer to the found/inserted item is returned.
  */
-static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert, int *created)
+static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert, int *created, size_t *depth)
 {
 	// Calls `nodeCreate()` and updates `created`.
 	struct AvlNode *createNode(void *value)
 	{
-		struct AvlNode *result = nodeCreate(value);
+		struct AvlNode *result = nodeCreate(tree, value);
 
 		if (created != NULL)
 			*created = (result != NULL);
@@ -212,6 +400,9 @@ static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert,
 	// special case of an empty tree
 	if (tree->root == NULL)
 	{
+		if (depth != NULL)
+			*depth = 1;
+
 		if (insert)
 			return tree->root = createNode(item);
 		else
@@ -221,6 +412,7 @@ static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert,
 	struct AvlNode *parent;
 	struct AvlNode *current;
 	int comp;
+	size_t level = 0;
 
 	current = tree->root;
 
@@ -228,7 +420,9 @@ static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert,
 	while (current != NULL)
 	{
 		parent = current;
+		level++;
 		comp = tree->compare(item, current->value);
+		COUNT(tree, comparisons);
 
 		if (comp < 0)
 		{
@@ -241,10 +435,16 @@ static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert,
 		else
 		{
 			// node already exists
+			if (depth != NULL)
+				*depth = level;
+
 			return current;
 		}
 	}
 
+	if (depth != NULL)
+		*depth = level + 1;
+
 	// insert the new node
 	if (insert)
 	{
@@ -268,9 +468,10 @@ static struct AvlNode *nodeSearch(struct AvlTree *tree, void *item, int insert,
  * Updates the balance factors of a tree after inserting a node.
  *
  * @param node The new inserted node.
+ * @param tree Points to the tree that contains `node`.
  * @return Pointer to the node that has to be rebalanced or `NULL` if the entire tree is still in balance.
  */
-struct AvlNode *nodeUpdateBalance(struct AvlNode *node)
+struct AvlNode *nodeUpdateBalance(struct AvlNode *node, struct AvlTree *tree)
 {
 	if (node == NULL)
 		return NULL;
@@ -290,6 +491,7 @@ struct AvlNode *nodeUpdateBalance(struct AvlNode *node)
 
 		// go up on level (note: we could be at the root node then)
 		node = node->parent;
+		COUNT(tree, retracing_steps);
 
 		if (node->balance == 0)
 		{
@@ -312,48 +514,1167 @@ struct AvlNode *nodeUpdateBalance(struct AvlNode *node)
 	return NULL;
 }
 
+/**
+ * Returns the height of a subtree, whose balance factors are correct, by following the higher child on every level.
+ */
+static size_t nodeHeight(const struct AvlNode *node)
+{
+	size_t height = 0;
+
+	while (node != NULL)
+	{
+		height++;
+		node = node->balance > 0 ? node->right : node->left;
+	}
+
+	return height;
+}
+
+/**
+ * Joins two balanced subtrees and a node into one balanced subtree. All items of `left` have to be less than the item
+ * of `node`, which has to be less than all items of `right`, but the heights of the subtrees may differ arbitrarily.
+ *
+ * If the heights differ by more than one, `node` is attached to the inner spine of the higher subtree, where the
+ * heights match, and the spine is rebalanced like after an insertion. This takes \f$O(\log(n))\f$ time.
+ *
+ * *NOTE:* `tree->root` is overwritten, because it's used for rotations at the root of the joined subtree.
+ *
+ * @param tree Points to the tree, that contains the nodes.
+ * @param height The height of the joined subtree is stored here.
+ * @return The root of the joined subtree, whose parent is `NULL`.
+ */
+static struct AvlNode *nodeJoin(struct AvlTree *tree, struct AvlNode *left, size_t left_height, struct AvlNode *node,
+	struct AvlNode *right, size_t right_height, size_t *height)
+{
+	node->dirty = 0;
+	node->parent = NULL;
+
+	if (left_height <= right_height + 1 && right_height <= left_height + 1)
+	{
+		node->left = left;
+		node->right = right;
+		node->balance = (signed char)((int)right_height - (int)left_height);
+
+		if (left != NULL)
+			left->parent = node;
+		if (right != NULL)
+			right->parent = node;
+
+		*height = 1 + (left_height > right_height ? left_height : right_height);
+
+		return node;
+	}
+
+	// descend the inner spine of the higher subtree, until its height matches the other subtree
+	int right_spine = left_height > right_height;
+	struct AvlNode *spine = right_spine ? left : right;
+	struct AvlNode *parent = NULL;
+	size_t spine_height = right_spine ? left_height : right_height;
+	size_t other_height = right_spine ? right_height : left_height;
+
+	tree->root = spine;
+	spine->parent = NULL;
+
+	while (spine_height > other_height + 1)
+	{
+		parent = spine;
+
+		if (right_spine)
+		{
+			spine_height -= spine->balance < 0 ? 2 : 1;
+			spine = spine->right;
+		}
+		else
+		{
+			spine_height -= spine->balance > 0 ? 2 : 1;
+			spine = spine->left;
+		}
+	}
+
+	// `node` takes the place of `spine`, with `spine` and the lower subtree as its children
+	node->parent = parent;
+
+	if (right_spine)
+	{
+		node->left = spine;
+		node->right = right;
+		node->balance = (signed char)((int)other_height - (int)spine_height);
+		parent->right = node;
+	}
+	else
+	{
+		node->left = left;
+		node->right = spine;
+		node->balance = (signed char)((int)spine_height - (int)other_height);
+		parent->left = node;
+	}
+
+	if (node->left != NULL)
+		node->left->parent = node;
+	if (node->right != NULL)
+		node->right->parent = node;
+
+	// the subtree at `node` is one level higher than `spine` was
+	nodeFixBalance(nodeUpdateBalance(node, tree), tree);
+	*height = nodeHeight(tree->root);
+
+	return tree->root;
+}
+
+/**
+ * Returns the height of a child of a dirty node during `treeRebalance()`, and removes the cached height of a joined
+ * subtree.
+ */
+static size_t nodeTakeHeight(struct AvlNode *node)
+{
+	if (node == NULL)
+		return 0;
+
+	if (node->dirty < DIRTY_HEIGHT)
+		return nodeHeight(node);
+
+	size_t height = (size_t)(node->dirty - DIRTY_HEIGHT);
+	node->dirty = 0;
+
+	return height;
+}
+
+/**
+ * Rebalances all dirty nodes of a tree in relaxed mode.
+ *
+ * The dirty nodes are visited in post-order (iteratively, because an unbalanced tree can be very deep). When a node is
+ * visited, both of its subtrees are balanced already, so they are joined with the node by `nodeJoin()`. The root of
+ * the joined subtree caches its height in `AvlNode::dirty`, until its parent is visited.
+ *
+ * @param tree Points to the tree to rebalance.
+ */
+static void treeRebalance(struct AvlTree *tree)
+{
+	struct AvlNode *root = tree->root;
+	struct AvlNode *node = root;
+
+	if (node == NULL || node->dirty != DIRTY)
+		return;
+
+	COUNT(tree, rebalances);
+
+	while (node != NULL)
+	{
+		// clean subtrees are balanced (all ancestors of a dirty node are dirty)
+		if (node->left != NULL && node->left->dirty == DIRTY)
+		{
+			node = node->left;
+			continue;
+		}
+
+		if (node->right != NULL && node->right->dirty == DIRTY)
+		{
+			node = node->right;
+			continue;
+		}
+
+		struct AvlNode *parent = node->parent;
+		int left = parent != NULL && node == parent->left;
+		size_t left_height = nodeTakeHeight(node->left);
+		size_t right_height = nodeTakeHeight(node->right);
+		size_t height;
+		struct AvlNode *joined = nodeJoin(tree, node->left, left_height, node, node->right, right_height, &height);
+
+		joined->parent = parent;
+
+		if (parent == NULL)
+		{
+			root = joined;
+		}
+		else
+		{
+			// a balanced subtree of a 64-bit address space is less than 253 levels high
+			joined->dirty = (unsigned char)(height + DIRTY_HEIGHT);
+
+			if (left)
+				parent->left = joined;
+			else
+				parent->right = joined;
+		}
+
+		node = parent;
+	}
+
+	tree->root = root;
+}
+
+/**
+ * Marks the ancestors of a node, that was just inserted into a tree in relaxed mode, as dirty, and rebalances the tree,
+ * if the node is deeper than the height bound.
+ *
+ * @param tree Points to the tree that contains `node`.
+ * @param node The new leaf.
+ * @param depth The depth of `node`, or 0 if it's not known.
+ */
+static void nodeMarkDirty(struct AvlTree *tree, struct AvlNode *node, size_t depth)
+{
+	// the ancestors of a dirty node are dirty already
+	for (struct AvlNode *ancestor = node->parent; ancestor != NULL && !ancestor->dirty; ancestor = ancestor->parent)
+	{
+		ancestor->dirty = DIRTY;
+		COUNT(tree, retracing_steps);
+	}
+
+	if (tree->max_height == 0)
+		return;
+
+	if (depth == 0)
+	{
+		for (struct AvlNode *ancestor = node; ancestor != NULL; ancestor = ancestor->parent)
+			depth++;
+	}
+
+	if (depth > tree->max_height)
+		treeRebalance(tree);
+}
+
 void avlInit(struct AvlTree *this, int (*compare)(const void *, const void *))
 {
 	if (this == NULL)
 		return;
 
 	this->root = NULL;
+	this->min = NULL;
+	this->max = NULL;
 	this->count = 0;
+	this->interval = NULL;
+	this->relaxed = 0;
+	this->max_height = 0;
+	this->cache = NULL;
+	this->cache_mask = 0;
+	this->cache_hash = NULL;
+	this->allocator = NULL;
+	this->bytes = 0;
+	memset(&this->counters, 0, sizeof(struct AvlCounters));
 	this->compare = compare == NULL ? &dummyCompare : compare;
 }
 
+void avlInitInterval(struct AvlTree *this, int (*compare)(const void *, const void *),
+	const struct AvlIntervalType *type)
+{
+	avlInit(this, compare);
+
+	if (this != NULL)
+		this->interval = type;
+}
+
 void avlFree(struct AvlTree *this)
 {
 	if (this == NULL)
 		return;
 
-	nodeFree(this->root);
+	nodeFree(this, this->root);
+
+	if (this->cache != NULL)
+	{
+		allocatorFree(this->allocator, this->cache, (this->cache_mask + 1) * sizeof(struct AvlCacheSlot));
+		this->bytes -= (this->cache_mask + 1) * sizeof(struct AvlCacheSlot);
+		this->cache = NULL;
+	}
+}
+
+/**
+ * Looks an item up in the lookup cache of a tree first, and in the tree, if it's not cached.
+ */
+static int cacheContains(struct AvlTree *tree, void *item)
+{
+	size_t hash = tree->cache_hash(item);
+	struct AvlCacheSlot *slot = &tree->cache[hash & tree->cache_mask];
+
+	if (slot->value != NULL && slot->hash == hash)
+	{
+		COUNT(tree, comparisons);
+
+		if (tree->compare(item, slot->value) == 0)
+		{
+			COUNT(tree, cache_hits);
+			return 1;
+		}
+	}
+
+	COUNT(tree, cache_misses);
+
+	struct AvlNode *node = nodeSearch(tree, item, 0, NULL, NULL);
+
+	if (node == NULL)
+		return 0;
+
+	slot->hash = hash;
+	slot->value = node->value;
+
+	return 1;
 }
 
 int avlContains(struct AvlTree *this, void *item)
 {
-	return nodeSearch(this, item, 0, NULL) != NULL;
+	if (this != NULL && this->cache != NULL)
+		return cacheContains(this, item);
+
+	return nodeSearch(this, item, 0, NULL, NULL) != NULL;
 }
 
-int avlInsert(struct AvlTree *this, void *item)
+/**
+ * Counts a node, that was just linked into a tree as a leaf, and rebalances the tree.
+ *
+ * @param tree Points to the tree that contains `node`.
+ * @param node The new leaf.
+ * @param depth The depth of `node`, or 0 if it's not known.
+ */
+static void nodeInserted(struct AvlTree *tree, struct AvlNode *node, size_t depth)
 {
-	struct AvlNode *node;
-	int created;
+	tree->count++;
 
-	// insert node
-	node = nodeSearch(this, item, 1, &created);
-	if (node == NULL)
-		return 0;
+	// a new leaf is the least (greatest) item, if it's the left (right) child of the old least (greatest) item
+	if (node->parent == NULL || (node->parent == tree->min && node == node->parent->left))
+		tree->min = node;
+	if (node->parent == NULL || (node->parent == tree->max && node == node->parent->right))
+		tree->max = node;
 
-	if (!created)
-		return 0;
+	if (tree->relaxed)
+	{
+		nodeMarkDirty(tree, node, depth);
+		return;
+	}
 
-	this->count++;
+	// update the greatest high endpoints of the ancestors, before rotations use them
+	if (tree->interval != NULL)
+	{
+		for (struct AvlNode *ancestor = node->parent; ancestor != NULL; ancestor = ancestor->parent)
+		{
+			if (!nodeUpdateMax(tree, ancestor))
+				break;
+		}
+	}
 
 	// fix balance
-	node = nodeUpdateBalance(node);
-	nodeFixBalance(node, this);
+	node = nodeUpdateBalance(node, tree);
+	nodeFixBalance(node, tree);
+}
 
-	return 1;
+/**
+ * Returns the node with the least item of a subtree.
+ */
+static struct AvlNode *nodeLeftmost(struct AvlNode *node)
+{
+	while (node->left != NULL)
+		node = node->left;
+
+	return node;
+}
+
+/**
+ * Returns the node with the greatest item of a subtree.
+ */
+static struct AvlNode *nodeRightmost(struct AvlNode *node)
+{
+	while (node->right != NULL)
+		node = node->right;
+
+	return node;
 }
 
+/**
+ * Removes a node from a tree and rebalances the tree. The node itself is not freed.
+ *
+ * @param tree Points to the tree that contains `node`.
+ * @param node The node to remove.
+ */
+static void nodeUnlink(struct AvlTree *tree, struct AvlNode *node)
+{
+	// retracing needs correct balance factors (rebalancing doesn't move `node` out of the tree)
+	treeRebalance(tree);
+
+	if (tree->cache != NULL)
+	{
+		struct AvlCacheSlot *slot = &tree->cache[tree->cache_hash(node->value) & tree->cache_mask];
+
+		if (slot->value == node->value)
+			slot->value = NULL;
+	}
+
+	// the least item has no left child, so its successor is the leftmost node of its right subtree or its parent
+	if (node == tree->min)
+		tree->min = node->right != NULL ? nodeLeftmost(node->right) : node->parent;
+	if (node == tree->max)
+		tree->max = node->left != NULL ? nodeRightmost(node->left) : node->parent;
+
+	// pointer to the parents child field that points to 'node'
+	struct AvlNode **parents_child;
+
+	if (node->parent == NULL)
+		parents_child = &tree->root;
+	else if (node == node->parent->left)
+		parents_child = &node->parent->left;
+	else
+		parents_child = &node->parent->right;
+
+	// the height of the left (or right) subtree of `retrace` decreased by one
+	struct AvlNode *retrace;
+	int left;
+
+	if (node->left != NULL && node->right != NULL)
+	{
+		// the in-order successor takes the place of `node`
+		struct AvlNode *successor = nodeLeftmost(node->right);
+
+		if (successor->parent == node)
+		{
+			retrace = successor;
+			left = 0;
+		}
+		else
+		{
+			retrace = successor->parent;
+			left = 1;
+
+			successor->parent->left = successor->right;
+			if (successor->right != NULL)
+				successor->right->parent = successor->parent;
+
+			successor->right = node->right;
+			node->right->parent = successor;
+		}
+
+		successor->left = node->left;
+		node->left->parent = successor;
+		successor->parent = node->parent;
+		successor->balance = node->balance;
+		*parents_child = successor;
+	}
+	else
+	{
+		struct AvlNode *child = node->left != NULL ? node->left : node->right;
+
+		retrace = node->parent;
+		left = retrace != NULL && node == retrace->left;
+
+		*parents_child = child;
+		if (child != NULL)
+			child->parent = node->parent;
+	}
+
+	tree->count--;
+
+	// update the greatest high endpoints of the ancestors, before rotations use them
+	if (tree->interval != NULL)
+	{
+		for (struct AvlNode *ancestor = retrace; ancestor != NULL; ancestor = ancestor->parent)
+			nodeUpdateMax(tree, ancestor);
+	}
+
+	// update the balance factors up the tree, as long as the height of the subtree decreased
+	while (retrace != NULL)
+	{
+		struct AvlNode *parent = retrace->parent;
+		int parent_left = parent != NULL && retrace == parent->left;
+
+		retrace->balance = (signed char)(retrace->balance + (left ? 1 : -1));
+
+		if (abs(retrace->balance) == 1)
+		{
+			// the height of this subtree didn't change
+			break;
+		}
+
+		if (abs(retrace->balance) == 2)
+		{
+			struct AvlNode *sibling = retrace->balance > 0 ? retrace->right : retrace->left;
+			int sibling_balance = sibling->balance;
+
+			nodeFixBalance(retrace, tree);
+
+			// after a single rotation around a balanced sibling, the height of the subtree didn't change
+			if (sibling_balance == 0)
+				break;
+		}
+
+		retrace = parent;
+		left = parent_left;
+	}
+}
+
+int avlInsert(struct AvlTree *this, void *item)
+{
+	struct AvlNode *node;
+	int created;
+	size_t depth;
+
+	// insert node
+	node = nodeSearch(this, item, 1, &created, &depth);
+	if (node == NULL)
+		return 0;
+
+	if (!created)
+		return 0;
+
+	nodeInserted(this, node, depth);
+
+	return 1;
+}
+
+int avlDelete(struct AvlTree *this, void *item)
+{
+	struct AvlNode *node = nodeSearch(this, item, 0, NULL, NULL);
+	if (node == NULL)
+		return 0;
+
+	nodeUnlink(this, node);
+	nodeDestroy(this, node);
+
+	return 1;
+}
+
+void *avlMin(struct AvlTree *this)
+{
+	if (this == NULL || this->min == NULL)
+		return NULL;
+
+	return this->min->value;
+}
+
+void *avlMax(struct AvlTree *this)
+{
+	if (this == NULL || this->max == NULL)
+		return NULL;
+
+	return this->max->value;
+}
+
+void *avlPopMin(struct AvlTree *this)
+{
+	if (this == NULL || this->min == NULL)
+		return NULL;
+
+	struct AvlNode *node = this->min;
+	void *item = node->value;
+
+	nodeUnlink(this, node);
+	nodeDestroy(this, node);
+
+	return item;
+}
+
+void *avlPopMax(struct AvlTree *this)
+{
+	if (this == NULL || this->max == NULL)
+		return NULL;
+
+	struct AvlNode *node = this->max;
+	void *item = node->value;
+
+	nodeUnlink(this, node);
+	nodeDestroy(this, node);
+
+	return item;
+}
+
+int avlLinkNode(struct AvlTree *this, struct AvlNode *node, struct AvlNode *parent, int right)
+{
+	if (this == NULL || node == NULL)
+		return 0;
+	if (this->interval != NULL)
+		return 0;
+
+	struct AvlNode **slot = parent == NULL ? &this->root : (right ? &parent->right : &parent->left);
+	if (*slot != NULL)
+		return 0;
+
+	node->parent = parent;
+	node->left = NULL;
+	node->right = NULL;
+	node->balance = 0;
+	node->dirty = 0;
+	*slot = node;
+
+	nodeInserted(this, node, 0);
+
+	return 1;
+}
+
+int avlUnlinkNode(struct AvlTree *this, struct AvlNode *node)
+{
+	if (this == NULL || node == NULL)
+		return 0;
+
+	nodeUnlink(this, node);
+
+	return 1;
+}
+
+int avlBuild(struct AvlTree *this, void **items, size_t n)
+{
+	if (this == NULL)
+		return 0;
+	if (this->root != NULL)
+		return 0;
+	if (items == NULL && n > 0)
+		return 0;
+
+	if (nodeBuild(this, items, n, NULL, &this->root) < 0)
+		return 0;
+
+	this->count = n;
+
+	if (n > 0)
+	{
+		this->min = nodeLeftmost(this->root);
+		this->max = nodeRightmost(this->root);
+	}
+
+	return 1;
+}
+
+/**
+ * Runs two tasks, the first one on a new thread if `fork` is non-zero (or on the calling thread, if no thread can be
+ * created), and the second one on the calling thread. Returns when both are done.
+ */
+static void batchFork(void *(*function)(void *), void *first, void *second, int fork)
+{
+	pthread_t thread;
+
+	if (fork && pthread_create(&thread, NULL, function, first) == 0)
+	{
+		function(second);
+		pthread_join(thread, NULL);
+	}
+	else
+	{
+		function(first);
+		function(second);
+	}
+}
+
+/**
+ * Returns the index of the first item in a sorted array, that is not less than `item`.
+ */
+static size_t batchLowerBound(int (*compare)(const void *, const void *), void **items, size_t n, const void *item)
+{
+	size_t low = 0;
+
+	while (n > 0)
+	{
+		size_t half = n / 2;
+
+		if (compare(items[low + half], item) < 0)
+		{
+			low += half + 1;
+			n -= half + 1;
+		}
+		else
+		{
+			n = half;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * The arguments of `batchMerge()`.
+ */
+struct BatchMerge
+{
+	int (*compare)(const void *, const void *);
+	void **a;
+	size_t n_a;
+	void **b;
+	size_t n_b;
+	void **out;
+	size_t n_threads;
+};
+
+/**
+ * Merges two sorted arrays into `out`, with up to `n_threads` threads.
+ */
+static void *batchMerge(void *argument)
+{
+	struct BatchMerge *task = argument;
+
+	if (task->n_threads > 1 && task->n_a + task->n_b > AVL_BATCH_GRAIN)
+	{
+		// the median of the longer array goes to its final position, and both sides are merged independently
+		struct BatchMerge low = *task, high = *task;
+
+		if (task->n_a < task->n_b)
+		{
+			low.a = task->b;
+			low.n_a = task->n_b;
+			low.b = task->a;
+			low.n_b = task->n_a;
+			high = low;
+		}
+
+		size_t mid = low.n_a / 2;
+		size_t split = batchLowerBound(task->compare, low.b, low.n_b, low.a[mid]);
+
+		task->out[mid + split] = low.a[mid];
+		low.n_a = mid;
+		low.n_b = split;
+		low.n_threads = task->n_threads / 2;
+		high.a += mid + 1;
+		high.n_a -= mid + 1;
+		high.b += split;
+		high.n_b -= split;
+		high.out += mid + split + 1;
+		high.n_threads = task->n_threads - low.n_threads;
+
+		batchFork(&batchMerge, &low, &high, 1);
+		return NULL;
+	}
+
+	size_t i = 0, j = 0, k = 0;
+
+	while (i < task->n_a && j < task->n_b)
+	{
+		if (task->compare(task->b[j], task->a[i]) < 0)
+			task->out[k++] = task->b[j++];
+		else
+			task->out[k++] = task->a[i++];
+	}
+
+	memcpy(task->out + k, task->a + i, (task->n_a - i) * sizeof(void *));
+	k += task->n_a - i;
+	memcpy(task->out + k, task->b + j, (task->n_b - j) * sizeof(void *));
+
+	return NULL;
+}
+
+/**
+ * The arguments of `batchSort()`.
+ */
+struct BatchSort
+{
+	int (*compare)(const void *, const void *);
+	void **items;
+	void **buffer;
+	size_t n;
+	size_t n_threads;
+	int to_buffer;
+};
+
+/**
+ * Sorts an array with merge sort and up to `n_threads` threads. `buffer` has the same size as `items`, and both arrays
+ * are used alternately for the merged runs. The result is stored in `buffer`, if `to_buffer` is non-zero, otherwise in
+ * `items`.
+ */
+static void *batchSort(void *argument)
+{
+	struct BatchSort *task = argument;
+
+	if (task->n <= 16)
+	{
+		// insertion sort for short runs
+		for (size_t i = 1; i < task->n; i++)
+		{
+			void *item = task->items[i];
+			size_t j = i;
+
+			for (; j > 0 && task->compare(item, task->items[j - 1]) < 0; j--)
+				task->items[j] = task->items[j - 1];
+
+			task->items[j] = item;
+		}
+
+		if (task->to_buffer)
+			memcpy(task->buffer, task->items, task->n * sizeof(void *));
+
+		return NULL;
+	}
+
+	// the halves are sorted into the other array, and merged back into the target array
+	size_t mid = task->n / 2;
+	struct BatchSort low = *task, high = *task;
+
+	low.n = mid;
+	low.n_threads = task->n_threads / 2;
+	low.to_buffer = !task->to_buffer;
+	high.items += mid;
+	high.buffer += mid;
+	high.n -= mid;
+	high.n_threads = task->n_threads - low.n_threads;
+	high.to_buffer = !task->to_buffer;
+
+	batchFork(&batchSort, &low, &high, task->n_threads > 1 && task->n > AVL_BATCH_GRAIN);
+
+	void **runs = task->to_buffer ? task->items : task->buffer;
+	struct BatchMerge merge = {task->compare, runs, mid, runs + mid, task->n - mid,
+		task->to_buffer ? task->buffer : task->items, task->n_threads};
+
+	batchMerge(&merge);
+
+	return NULL;
+}
+
+/**
+ * The arguments and results of `batchInsert()`.
+ */
+struct BatchInsert
+{
+	struct AvlTree *tree;
+	struct AvlNode *node;
+	void **items;
+	size_t n;
+	size_t n_threads;
+
+	/**
+	 * The root of the resulting subtree, its height, the number of inserted items and non-zero on a malloc error.
+	 */
+	struct AvlNode *root;
+	size_t height;
+	size_t inserted;
+	int failed;
+};
+
+/**
+ * Inserts a sorted array of distinct items into the balanced subtree of `node`, with up to `n_threads` threads.
+ *
+ * The items are split at the root of the subtree (or at their median, if the subtree is empty), both halves are
+ * inserted into the children of the root independently, and the results are joined with the root by `nodeJoin()`, so
+ * only the seams between the subtrees are rebalanced. Small empty subtrees are built by `nodeBuild()`.
+ *
+ * Since `nodeCreate()` and `nodeJoin()` write to `tree`, every new thread works with its own copy of the tree struct,
+ * whose counters and allocated bytes are added to the original afterwards.
+ */
+static void *batchInsert(void *argument)
+{
+	struct BatchInsert *task = argument;
+	struct AvlTree *tree = task->tree;
+	struct AvlNode *pivot = task->node;
+	size_t low_end, high_start;
+
+	task->root = pivot;
+	task->inserted = 0;
+	task->failed = 0;
+
+	if (task->n == 0)
+	{
+		task->height = nodeHeight(pivot);
+		return NULL;
+	}
+
+	if (pivot == NULL && (task->n_threads <= 1 || task->n <= AVL_BATCH_GRAIN))
+	{
+		int height = nodeBuild(tree, task->items, task->n, NULL, &task->root);
+
+		task->failed = height < 0;
+		task->height = task->failed ? 0 : (size_t)height;
+		task->inserted = task->failed ? 0 : task->n;
+
+		return NULL;
+	}
+
+	struct BatchInsert low = *task, high = *task;
+
+	if (pivot == NULL)
+	{
+		low_end = task->n / 2;
+		high_start = low_end + 1;
+
+		pivot = nodeCreate(tree, task->items[low_end]);
+		if (pivot == NULL)
+		{
+			task->failed = 1;
+			task->height = 0;
+			return NULL;
+		}
+
+		task->inserted = 1;
+	}
+	else
+	{
+		// items, that are in the tree already, are skipped
+		low_end = batchLowerBound(tree->compare, task->items, task->n, pivot->value);
+		high_start = low_end + (low_end < task->n && tree->compare(task->items[low_end], pivot->value) == 0);
+		low.node = pivot->left;
+		high.node = pivot->right;
+	}
+
+	low.n = low_end;
+	high.items += high_start;
+	high.n -= high_start;
+
+	// the threads are shared proportionally to the number of items on both sides
+	int fork = task->n_threads > 1 && low.n > 0 && high.n > 0 && task->n > AVL_BATCH_GRAIN;
+	struct AvlTree low_tree;
+
+	if (fork)
+	{
+		low.n_threads = task->n_threads * low.n / (low.n + high.n);
+
+		if (low.n_threads == 0)
+			low.n_threads = 1;
+		else if (low.n_threads == task->n_threads)
+			low.n_threads--;
+
+		high.n_threads = task->n_threads - low.n_threads;
+
+		low_tree = *tree;
+		low_tree.bytes = 0;
+		memset(&low_tree.counters, 0, sizeof(struct AvlCounters));
+		low.tree = &low_tree;
+	}
+
+	batchFork(&batchInsert, &low, &high, fork);
+
+	if (fork)
+	{
+		size_t *counters = (size_t *)&tree->counters;
+		size_t *low_counters = (size_t *)&low_tree.counters;
+
+		for (size_t i = 0; i < sizeof(struct AvlCounters) / sizeof(size_t); i++)
+			counters[i] += low_counters[i];
+
+		tree->bytes += low_tree.bytes;
+	}
+
+	task->root = nodeJoin(tree, low.root, low.height, pivot, high.root, high.height, &task->height);
+	task->inserted += low.inserted + high.inserted;
+	task->failed = low.failed || high.failed;
+
+	return NULL;
+}
+
+int avlInsertBatch(struct AvlTree *this, void **items, size_t n, size_t n_threads)
+{
+	if (this == NULL || (items == NULL && n > 0))
+		return 0;
+
+	if (n == 0)
+		return 1;
+
+	void **sorted = malloc(2 * n * sizeof(void *));
+	if (sorted == NULL)
+		return 0;
+
+	if (n_threads == 0)
+		n_threads = 1;
+
+	memcpy(sorted + n, items, n * sizeof(void *));
+
+	struct BatchSort sort = {this->compare, sorted + n, sorted, n, n_threads, 1};
+	batchSort(&sort);
+
+	// remove duplicates
+	size_t n_distinct = 1;
+
+	for (size_t i = 1; i < n; i++)
+	{
+		if (this->compare(sorted[i], sorted[n_distinct - 1]) != 0)
+			sorted[n_distinct++] = sorted[i];
+	}
+
+	int success = 1;
+
+	if (this->interval != NULL)
+	{
+		// `nodeJoin()` doesn't maintain the greatest high endpoints
+		for (size_t i = 0; i < n_distinct; i++)
+		{
+			if (!avlInsert(this, sorted[i]) && !avlContains(this, sorted[i]))
+				success = 0;
+		}
+
+		free(sorted);
+
+		return success;
+	}
+
+	// the subtrees need correct balance factors
+	treeRebalance(this);
+
+	struct BatchInsert insert = {this, this->root, sorted, n_distinct, n_threads, NULL, 0, 0, 0};
+	batchInsert(&insert);
+
+	this->root = insert.root;
+	this->count += insert.inserted;
+
+	if (this->root != NULL)
+	{
+		this->min = nodeLeftmost(this->root);
+		this->max = nodeRightmost(this->root);
+	}
+
+	free(sorted);
+
+	return !insert.failed;
+}
+
+int avlRelax(struct AvlTree *this, size_t max_height)
+{
+	if (this == NULL || this->interval != NULL)
+		return 0;
+
+	this->relaxed = 1;
+	this->max_height = max_height;
+
+	return 1;
+}
+
+int avlRebalance(struct AvlTree *this)
+{
+	if (this == NULL)
+		return 0;
+
+	treeRebalance(this);
+	this->relaxed = 0;
+	this->max_height = 0;
+
+	return 1;
+}
+
+int avlCache(struct AvlTree *this, size_t n_slots, size_t (*hash)(const void *item))
+{
+	if (this == NULL || (n_slots & (n_slots - 1)) != 0)
+		return 0;
+
+	struct AvlCacheSlot *cache = NULL;
+
+	if (n_slots > 0)
+	{
+		if (hash == NULL || n_slots > (size_t)-1 / sizeof(struct AvlCacheSlot))
+			return 0;
+
+		cache = allocatorCalloc(this->allocator, n_slots * sizeof(struct AvlCacheSlot));
+		if (cache == NULL)
+			return 0;
+
+		this->bytes += n_slots * sizeof(struct AvlCacheSlot);
+	}
+
+	if (this->cache != NULL)
+	{
+		allocatorFree(this->allocator, this->cache, (this->cache_mask + 1) * sizeof(struct AvlCacheSlot));
+		this->bytes -= (this->cache_mask + 1) * sizeof(struct AvlCacheSlot);
+	}
+
+	this->cache = cache;
+	this->cache_mask = n_slots > 0 ? n_slots - 1 : 0;
+	this->cache_hash = hash;
+
+	return 1;
+}
+
+int avlSetAllocator(struct AvlTree *this, struct Allocator *allocator)
+{
+	if (this == NULL || this->bytes != 0)
+		return 0;
+
+	this->allocator = allocator;
+
+	return 1;
+}
+
+size_t avlMemory(const struct AvlTree *this)
+{
+	if (this == NULL)
+		return 0;
+
+	return sizeof(struct AvlTree) + this->bytes;
+}
+
+int avlStats(struct AvlTree *this, struct AvlStats *stats)
+{
+	if (this == NULL || stats == NULL)
+		return 0;
+
+	memset(stats, 0, sizeof(struct AvlStats));
+	stats->counters = this->counters;
+	stats->count = this->count;
+	stats->memory = avlMemory(this);
+
+	// iterative in-order traversal, that keeps track of the depth of the current node
+	struct AvlNode *node = this->root;
+	struct AvlNode *previous = NULL;
+	size_t depth = 0;
+	size_t depth_sum = 0;
+
+	while (node != NULL)
+	{
+		struct AvlNode *next;
+
+		if (previous == node->parent)
+		{
+			// first visit
+			depth_sum += depth;
+
+			if (depth + 1 > stats->height)
+				stats->height = depth + 1;
+
+			next = node->left != NULL ? node->left : (node->right != NULL ? node->right : node->parent);
+		}
+		else if (previous == node->left && node->right != NULL)
+		{
+			next = node->right;
+		}
+		else
+		{
+			next = node->parent;
+		}
+
+		if (next == node->parent)
+			depth--;
+		else
+			depth++;
+
+		previous = node;
+		node = next;
+	}
+
+	if (this->count > 0)
+		stats->average_depth = (double)depth_sum / this->count;
+
+	return 1;
+}
+
+/**
+ * Finds all items in the subtree of `node`, that overlap the interval \f$[low, high]\f$.
+ *
+ * @return The number of items found.
+ */
+static size_t nodeOverlap(const struct AvlTree *tree, struct AvlNode *node, const void *low, const void *high,
+	void (*callback)(void *item, void *context), void *context)
+{
+	const struct AvlIntervalType *type = tree->interval;
+	size_t n_found = 0;
+
+	// no item of this subtree reaches `low`
+	while (node != NULL && type->compare(nodeGetMax(node), low) >= 0)
+	{
+		n_found += nodeOverlap(tree, node->left, low, high, callback, context);
+
+		// this item and all items of the right subtree start after `high`
+		if (type->compare(type->low(node->value), high) > 0)
+			break;
+
+		if (type->compare(type->high(node->value), low) >= 0)
+		{
+			if (callback != NULL)
+				callback(node->value, context);
+
+			n_found++;
+		}
+
+		node = node->right;
+	}
+
+	return n_found;
+}
+
+size_t avlStab(struct AvlTree *this, const void *point, void (*callback)(void *item, void *context), void *context)
+{
+	return avlOverlap(this, point, point, callback, context);
+}
+
+size_t avlOverlap(struct AvlTree *this, const void *low, const void *high,
+	void (*callback)(void *item, void *context), void *context)
+{
+	if (this == NULL || this->interval == NULL)
+		return 0;
+
+	return nodeOverlap(this, this->root, low, high, callback, context);
+}
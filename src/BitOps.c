@@ -0,0 +1,139 @@
+/**
+ * @file BitOps.c
+ *
+ * Contains the implementations of the functions defined in BitOps.h, as well as the runtime dispatch.
+ */
+
+#include "../inc/BitOps.h"
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_BMI 1
+#endif
+
+/**
+ * The de Bruijn sequence B(2, 6).
+ */
+#define DEBRUIJN64 0x03F79D71B4CB0A89
+
+/**
+ * Maps the upper 6 bits of `DEBRUIJN64 * (1 << i)` to `i`.
+ */
+static const uint8_t DEBRUIJN_TABLE[64] =
+{
+	 0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+	62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+	63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+	46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+};
+
+#ifdef HAVE_BMI
+/**
+ * `bitTzcnt64()` using the `tzcnt` instruction.
+ */
+__attribute__((target("bmi")))
+static uint64_t tzcntBmi(uint64_t x)
+{
+	return __tzcnt_u64(x);
+}
+#endif
+
+/**
+ * `bitTzcnt64()` using `__builtin_ctzll()` (which is undefined for 0).
+ */
+static uint64_t tzcntBuiltin(uint64_t x)
+{
+	return x ? (uint64_t)__builtin_ctzll(x) : 64;
+}
+
+/**
+ * `bitTzcnt64()` using a de Bruijn multiplication.
+ */
+static uint64_t tzcntDeBruijn(uint64_t x)
+{
+	return x ? DEBRUIJN_TABLE[((x & -x) * DEBRUIJN64) >> 58] : 64;
+}
+
+/**
+ * Selects the best implementation, if `bitTzcnt64()` is called before `selectOnStartup()` ran (e.g. by another
+ * constructor), and forwards the call to it.
+ */
+static uint64_t tzcntResolve(uint64_t x)
+{
+	bitOpsSelect(BITOPS_AUTO);
+
+	return __atomic_load_n(&bitTzcnt64, __ATOMIC_RELAXED)(x);
+}
+
+uint64_t (*bitTzcnt64)(uint64_t x) = &tzcntResolve;
+
+/**
+ * Selects the best implementation when the program starts, before any threads exist, so concurrent first calls of
+ * `bitTzcnt64()` don't race on the function pointer.
+ */
+__attribute__((constructor))
+static void selectOnStartup(void)
+{
+	bitOpsSelect(BITOPS_AUTO);
+}
+
+/**
+ * Sets the implementation of `bitTzcnt64()`.
+ */
+static inline void setTzcnt(uint64_t (*tzcnt)(uint64_t x))
+{
+	__atomic_store_n(&bitTzcnt64, tzcnt, __ATOMIC_RELAXED);
+}
+
+uint64_t bitTzcntWords(const uint64_t *words, size_t n)
+{
+	uint64_t result = 0;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (words[i])
+			return result + bitTzcnt64(words[i]);
+
+		result += 64;
+	}
+
+	return result;
+}
+
+int bitOpsSelect(enum BitOpsImpl impl)
+{
+	switch (impl)
+	{
+		case BITOPS_AUTO:
+#ifdef HAVE_BMI
+			if (__builtin_cpu_supports("bmi"))
+			{
+				setTzcnt(&tzcntBmi);
+				return 0;
+			}
+#endif
+			setTzcnt(&tzcntBuiltin);
+			return 0;
+
+		case BITOPS_BMI:
+#ifdef HAVE_BMI
+			if (__builtin_cpu_supports("bmi"))
+			{
+				setTzcnt(&tzcntBmi);
+				return 0;
+			}
+#endif
+			return 1;
+
+		case BITOPS_BUILTIN:
+			setTzcnt(&tzcntBuiltin);
+			return 0;
+
+		case BITOPS_DEBRUIJN:
+			setTzcnt(&tzcntDeBruijn);
+			return 0;
+
+		default:
+			return 1;
+	}
+}
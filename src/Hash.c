@@ -0,0 +1,63 @@
+/**
+ * @file Hash.c
+ *
+ * Contains the implementations of the functions defined in Hash.h.
+ */
+
+#include <string.h>
+#include "../inc/Hash.h"
+
+uint64_t hashBytes(const void *data, size_t length, uint64_t seed)
+{
+	const uint64_t m = 0xC6A4A7935BD1E995;
+	const int r = 47;
+
+	const unsigned char *bytes = data;
+	uint64_t h = seed ^ (length * m);
+
+	for (size_t i = 0; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+	{
+		uint64_t k;
+		memcpy(&k, bytes + i, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	// the last (length % 8) bytes
+	size_t tail = length % sizeof(uint64_t);
+
+	if (tail > 0)
+	{
+		for (size_t i = 0; i < tail; i++)
+			h ^= (uint64_t)bytes[length - tail + i] << (8 * i);
+
+		h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+void hashExpand(const void *item, size_t h, void *buffer)
+{
+	uint64_t state;
+	memcpy(&state, item, sizeof(state));
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		z ^= z >> 31;
+
+		memcpy((char *)buffer + i, &z, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
@@ -0,0 +1,294 @@
+/**
+ * @file HllClient.c
+ *
+ * Contains the implementations of the functions defined in HllClient.h, as well as some static helper functions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../inc/HllClient.h"
+
+/**
+ * Sends all bytes of the buffers `iov` (the buffers are modified). Partial writes and interrupts are retried.
+ *
+ * @return 0 on success, -1 on socket error
+ */
+static int sendAll(int fd, struct iovec *iov, int n_iov)
+{
+	while (n_iov > 0)
+	{
+		struct msghdr message;
+
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = iov;
+		message.msg_iovlen = (size_t)n_iov;
+
+		// don't get killed by SIGPIPE, if the server is gone
+		ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return -1;
+		}
+
+		while (n_iov > 0 && (size_t)sent >= iov->iov_len)
+		{
+			sent -= (ssize_t)iov->iov_len;
+			iov++;
+			n_iov--;
+		}
+
+		if (n_iov > 0)
+		{
+			iov->iov_base = (char *)iov->iov_base + sent;
+			iov->iov_len -= (size_t)sent;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Receives exactly `size` bytes. Interrupts are retried.
+ *
+ * @return 0 on success, -1 on socket error or if the server closed the connection
+ */
+static int receiveAll(int fd, void *buffer, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t received = read(fd, buffer, size);
+
+		if (received < 0 && errno == EINTR)
+			continue;
+
+		if (received <= 0)
+		{
+			if (received == 0)
+				errno = ECONNRESET;
+
+			return -1;
+		}
+
+		buffer = (char *)buffer + received;
+		size -= (size_t)received;
+	}
+
+	return 0;
+}
+
+/**
+ * Receives a response and translates its status.
+ *
+ * @param count The estimate of the response is stored here, if it's not `NULL`.
+ * @return 0 on success, -1 on socket error, -2 if the server rejected the request
+ */
+static int receiveResponse(int fd, double *count)
+{
+	struct HllResponse response;
+
+	if (receiveAll(fd, &response, sizeof(response)) != 0)
+		return -1;
+
+	if (response.status != HLL_STATUS_OK)
+		return -2;
+
+	if (count != NULL)
+		*count = response.count;
+
+	return 0;
+}
+
+/**
+ * Sends a request with a sketch name and an optional body.
+ *
+ * @return 0 on success, -1 on socket error
+ */
+static int sendRequest(int fd, uint8_t type, const char *name, size_t name_length, const void *body, size_t body_size)
+{
+	struct HllRequestHeader header = {(uint32_t)(name_length + body_size), type, (uint8_t)name_length, 0};
+	struct iovec iov[3] = {
+		{.iov_base = &header, .iov_len = sizeof(header)},
+		{.iov_base = (void *)name, .iov_len = name_length},
+		{.iov_base = (void *)body, .iov_len = body_size}
+	};
+
+	return sendAll(fd, iov, body_size > 0 ? 3 : 2);
+}
+
+/**
+ * Checks the common arguments of all requests.
+ *
+ * @return 0, if the arguments are valid, or the status code of the invalid argument
+ */
+static int checkArguments(const struct HllClient *this, const char *name, size_t *name_length)
+{
+	if (this == NULL || this->fd < 0)
+		return 1;
+
+	if (name == NULL)
+		return 2;
+
+	*name_length = strlen(name);
+
+	if (*name_length > HLL_MAX_NAME_LENGTH)
+		return 2;
+
+	return 0;
+}
+
+int hllClientConnect(struct HllClient *this, const char *path)
+{
+	if (this == NULL)
+		return 1;
+
+	this->fd = -1;
+	this->buffer = NULL;
+	this->capacity = 0;
+
+	struct sockaddr_un address;
+
+	if (path == NULL || strlen(path) >= sizeof(address.sun_path))
+		return 2;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
+	{
+		int error = errno;
+
+		close(fd);
+		errno = error;
+
+		return -1;
+	}
+
+	this->fd = fd;
+
+	return 0;
+}
+
+void hllClientClose(struct HllClient *this)
+{
+	if (this == NULL)
+		return;
+
+	if (this->fd >= 0)
+		close(this->fd);
+
+	free(this->buffer);
+
+	this->fd = -1;
+	this->buffer = NULL;
+	this->capacity = 0;
+}
+
+int hllClientMerge(struct HllClient *this, const char *name, const struct HyperLogLog *set)
+{
+	size_t name_length;
+	int status = checkArguments(this, name, &name_length);
+
+	if (status != 0)
+		return status;
+
+	size_t size = hllSerialize(set, NULL, 0);
+
+	if (size == 0 || name_length + size > HLL_MAX_REQUEST_SIZE)
+		return 3;
+
+	if (size > this->capacity)
+	{
+		void *buffer = realloc(this->buffer, size);
+		if (buffer == NULL)
+			return -1;
+
+		this->buffer = buffer;
+		this->capacity = size;
+	}
+
+	hllSerialize(set, this->buffer, size);
+
+	if (sendRequest(this->fd, HLL_REQUEST_MERGE, name, name_length, this->buffer, size) != 0)
+		return -1;
+
+	return receiveResponse(this->fd, NULL);
+}
+
+int hllClientAdd(struct HllClient *this, const char *name, const uint64_t *hashes, size_t n)
+{
+	size_t name_length;
+	int status = checkArguments(this, name, &name_length);
+
+	if (status != 0)
+		return status;
+
+	if (hashes == NULL && n > 0)
+		return 3;
+
+	size_t max_batch = (HLL_MAX_REQUEST_SIZE - name_length) / sizeof(uint64_t);
+	size_t n_requests = 0;
+
+	// send all requests first, so they are pipelined
+	do
+	{
+		size_t batch = n < max_batch ? n : max_batch;
+
+		if (sendRequest(this->fd, HLL_REQUEST_ADD, name, name_length, hashes, batch * sizeof(uint64_t)) != 0)
+			return -1;
+
+		if (batch > 0)
+			hashes += batch;
+
+		n -= batch;
+		n_requests++;
+	}
+	while (n > 0);
+
+	status = 0;
+
+	for (size_t i = 0; i < n_requests; i++)
+	{
+		int response_status = receiveResponse(this->fd, NULL);
+
+		if (response_status == -1)
+			return -1;
+
+		if (response_status != 0)
+			status = response_status;
+	}
+
+	return status;
+}
+
+int hllClientCount(struct HllClient *this, const char *name, double *result)
+{
+	size_t name_length;
+	int status = checkArguments(this, name, &name_length);
+
+	if (status != 0)
+		return status;
+
+	if (result == NULL)
+		return 3;
+
+	if (sendRequest(this->fd, HLL_REQUEST_COUNT, name, name_length, NULL, 0) != 0)
+		return -1;
+
+	return receiveResponse(this->fd, result);
+}
@@ -2,15 +2,16 @@
 #include <math.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include "../inc/BitOps.h"
+#include "../inc/Hash.h"
 #include "../inc/HyperLogLog.h"
-#include "../inc/tzcnt.h"
 
 /**
  * @file HyperLogLog.c
  *
  * Contains the implementations of the functions defined in HyperLogLog.h, as well as some static helper functions.
  *
- * **Compile with `-mbmi` or if that doesn't work with `-D NO_BMI`**<br/>
  * **Link with `-lm`**
  */
 
@@ -19,15 +20,89 @@
 #endif
 
 /**
- * Returns the greatest value of `a` and `b`.
+ * The number of MEDIUM registers that are packed into one 64-bit word.
+ */
+#define MEDIUM_REGS_PER_WORD 10
+
+/**
+ * Has the most significant bit of every 6-bit field of a MEDIUM word set.
+ */
+#define MEDIUM_HIGH_BITS 0x0820820820820820
+
+/**
+ * Has the most significant bit of every 4-bit field of a 64-bit word of SMALL offsets set.
+ */
+#define SMALL_HIGH_BITS 0x8888888888888888
+
+/**
+ * Has the least significant bit of every 4-bit field of a 64-bit word of SMALL offsets set.
+ */
+#define SMALL_LOW_BITS 0x1111111111111111
+
+/**
+ * The SMALL offset that marks a register, whose value is stored in the exception list.
+ */
+#define SMALL_ESCAPE 15
+
+/**
+ * The greatest number of hash bytes, that are needed to add an item (see `getHashSize()`).
  */
-static inline size_t max(size_t a, size_t b)
+#define MAX_HASH_SIZE (sizeof(size_t) + 4 * sizeof(uint64_t))
+
+/**
+ * The greatest number of index bits of a SMALL set.
+ */
+#define SMALL_MAX_B 31
+
+/**
+ * The size of the header of a serialized set: "HL", the format version, `r`, `b` and 3 reserved bytes.
+ */
+#define SERIALIZED_HEADER_SIZE 8
+
+/**
+ * The version of the serialization format (see `hllSerialize()`).
+ */
+#define SERIALIZED_VERSION 1
+
+/**
+ * The header of the data of a SMALL set.
+ *
+ * SMALL registers are stored as 4-bit offsets to a base value, that is shared by all registers. A register whose
+ * offset doesn't fit into 4 bits has the offset `SMALL_ESCAPE`, and its value is stored in the exception list (as
+ * `index << 8 | value`). The exception list has a fixed capacity (see `getSmallCapacity()`). If it's full, new
+ * exceptions are clamped to the greatest offset below `SMALL_ESCAPE`.
+ *
+ * Whenever all registers are above the base, the base is raised (see `rebaseSmall()`). Since the registers of a set
+ * are close to each other, this keeps the range of SMALL registers the same as of MEDIUM registers, while only using 4
+ * bits per register.
+ *
+ * The data consists of the header, followed by the offsets (packed two per byte) and the exception list.
+ */
+struct SmallHeader
 {
-	return a > b ? a : b;
-}
+	/**
+	 * The number of index bits, so registers can be accessed without the `struct HyperLogLog`.
+	 */
+	uint8_t b;
+
+	/**
+	 * The value of all registers with offset 0.
+	 */
+	uint8_t base;
+
+	/**
+	 * The number of entries in the exception list.
+	 */
+	uint16_t n_exceptions;
+
+	/**
+	 * The number of registers with an offset greater than 0 (this is why `b` is at most `SMALL_MAX_B`).
+	 */
+	uint32_t n_above;
+};
 
 /**
- * Same as `max()` but with `uint8_t`.
+ * Returns the greatest value of `a` and `b`.
  */
 static inline uint8_t maxb(uint8_t a, uint8_t b)
 {
@@ -35,11 +110,11 @@ static inline uint8_t maxb(uint8_t a, uint8_t b)
 }
 
 /**
- * Returns the lowers value of `a` and `b`.
+ * Returns the greatest register value of a register size. SMALL registers have the same range as MEDIUM registers.
  */
-static inline uint8_t minb(uint8_t a, uint8_t b)
+static inline uint8_t getMaxReg(unsigned char r)
 {
-	return a < b ? a : b;
+	return r == LARGE ? UINT8_MAX : 63;
 }
 
 /**
@@ -57,309 +132,1289 @@ static double getAlpha(unsigned char b)
 }
 
 /**
- * Returns the size of the data array, in bytes.
+ * Returns the `b` least significant bits of `x`.
+ *
+ * @param b: b < sizeof(size_t) * CHAR_BIT
  */
-static size_t getDataSize(unsigned char r, unsigned char b)
+static inline size_t getFirstBBits(size_t x, size_t b)
 {
-	// number of registers
-	size_t result = (size_t)1 << b;
+	return x & (((size_t)1 << b) - 1);
+}
 
-	switch (r)
+/**
+ * Returns the field-wise maximum of two words of packed unsigned `width`-bit fields, without unpacking them.
+ *
+ * @param high Has the most significant bit of every field set.
+ */
+static inline uint64_t maxFields(uint64_t a, uint64_t b, uint64_t high, unsigned width)
+{
+	// the most significant bit of every field of `t` is set, if the lower bits of the field in `a` are greater or equal
+	// than the lower bits of the field in `b` (no borrow can cross field boundaries)
+	uint64_t t = (a | high) - (b & ~high);
+	uint64_t a_greater_equal = ((a & ~b) | (~(a ^ b) & t)) & high;
+	uint64_t mask = (a_greater_equal >> (width - 1)) * (((uint64_t)1 << width) - 1);
+
+	return (a & mask) | (b & ~mask);
+}
+
+/**
+ * Returns the capacity of the exception list of a SMALL set: one entry per 512 registers, so the list takes less than
+ * 2% of the memory. Sets with fewer than 512 registers have none, since a clamped register hardly changes the estimate.
+ */
+static inline size_t getSmallCapacity(unsigned char b)
+{
+	size_t capacity = ((size_t)1 << b) / 512;
+
+	return capacity < UINT16_MAX ? capacity : UINT16_MAX;
+}
+
+/**
+ * Returns the offsets of a SMALL set.
+ */
+static inline uint8_t *getSmallOffsets(const void *data)
+{
+	return (uint8_t *)data + sizeof(struct SmallHeader);
+}
+
+/**
+ * Returns the exception list of a SMALL set.
+ */
+static inline uint64_t *getSmallExceptions(const void *data)
+{
+	const struct SmallHeader *header = data;
+
+	return (uint64_t *)(getSmallOffsets(data) + ((size_t)1 << header->b) / 2);
+}
+
+/**
+ * Returns the 4-bit field at `index`.
+ */
+static inline uint8_t getNibble(const uint8_t *nibbles, size_t index)
+{
+	return (uint8_t)((nibbles[index / 2] >> (index % 2 * 4)) & 0xF);
+}
+
+/**
+ * Sets the 4-bit field at `index` to `value`.
+ */
+static inline void setNibble(uint8_t *nibbles, size_t index, uint8_t value)
+{
+	unsigned shift = index % 2 * 4;
+
+	nibbles[index / 2] &= (uint8_t)~(0xF << shift);
+	nibbles[index / 2] |= (uint8_t)(value << shift);
+}
+
+/**
+ * Returns the entry of the register at `index` in the exception list of a SMALL set, or `NULL`.
+ */
+static uint64_t *findSmallException(const void *data, size_t index)
+{
+	const struct SmallHeader *header = data;
+	uint64_t *exceptions = getSmallExceptions(data);
+
+	for (size_t i = 0; i < header->n_exceptions; i++)
 	{
-		case SMALL:// 4 bit per register
-			result = max(result, 2);
-			result /= 2;
-			break;
-		case MEDIUM: // 6 bit per register
-			result = max(result, 4);
-			result /= 4;
-			result *= 3;
-			// each block is 3 bytes big, but we're accessing them through uint32_t, so we need an extra byte at end to
-			// prevent segfaults
-			result += 1;
-			break;
+		if (exceptions[i] >> 8 == index)
+			return &exceptions[i];
 	}
 
-	return result;
+	return NULL;
 }
 
 /**
- * Returns the `b` least significant bits of `x`.
- *
- * @param b: b < sizeof(size_t) * CHAR_BIT
+ * Returns the value of a register of a SMALL set, given its offset.
  */
-static inline size_t getFirstBBits(size_t x, size_t b)
+static inline uint8_t getSmallRegFromOffset(const void *data, size_t index, uint8_t offset)
 {
-	return x & ((1 << b) - 1);
+	const struct SmallHeader *header = data;
+
+	if (offset != SMALL_ESCAPE)
+		return (uint8_t)(header->base + offset);
+
+	return (uint8_t)(*findSmallException(data, index) & 0xFF);
 }
 
 /**
- * Returns the content of the `index`th 6-bits in `block`.
+ * Returns the value of the register at `index` of a SMALL set.
  */
-static inline uint8_t getMediumReg(uint32_t block, unsigned char index)
+static inline uint8_t getSmallReg(const void *data, size_t index)
 {
-	return (uint8_t)( (block & (0x3F << index * 6)) >> index * 6 );
+	return getSmallRegFromOffset(data, index, getNibble(getSmallOffsets(data), index));
 }
 
 /**
- * Returns the content of the `index`th 4 bit in `block`.
+ * Counts the 4-bit fields of a word, that are not 0.
  */
-static inline uint8_t getSmallReg(uint8_t block, unsigned char index)
+static inline int countNonZeroNibbles(uint64_t word)
 {
-	return (uint8_t)( (block & (0xF << index * 4)) >> index * 4 );
+	return __builtin_popcountll((word | word >> 1 | word >> 2 | word >> 3) & SMALL_LOW_BITS);
 }
 
 /**
- * Returns the one-based index of the least significant set bit in `buffer`.
+ * Raises the base of a SMALL set to `base`. Registers below the new base are raised to it.
  */
-static uint8_t rho(size_t r, void *buffer)
+static void raiseSmallBase(void *data, uint64_t base)
 {
-	// pointer used to dereference `buffer` as different types
-	union
-	{
-		uint16_t *u16;
-		uint64_t *u64;
-	} ptr;
+	struct SmallHeader *header = data;
+	uint8_t *offsets = getSmallOffsets(data);
+	uint64_t *exceptions = getSmallExceptions(data);
+	size_t m = (size_t)1 << header->b;
+
+	if (base <= header->base)
+		return;
 
-	ptr.u16 = buffer;
+	uint64_t delta = base - header->base;
 
-	switch (r)
+	header->base = (uint8_t)base;
+	header->n_above = 0;
+
+	for (size_t i = 0; i < m; i++)
 	{
-		case SMALL:
-			*ptr.u16 |= (uint16_t)0xC000;
-			return (uint8_t)(TZCNT16(*ptr.u16) + 1);
+		uint8_t offset = getNibble(offsets, i);
 
-		case MEDIUM:
-			*ptr.u64 |= (uint64_t)0xC000000000000000;
-			return (uint8_t)(TZCNT64(*ptr.u64) + 1);
+		if (offset != SMALL_ESCAPE)
+		{
+			offset = (uint8_t)(offset > delta ? offset - delta : 0);
+			setNibble(offsets, i, offset);
+		}
 
-		case LARGE:
-			ptr.u64[3] |= (uint64_t)0xC000000000000000;
+		header->n_above += offset != 0;
+	}
 
-			uint64_t result = 0;
-			for (int i = 0; i < 4; i++)
-			{
-				if (ptr.u64[i])
-				{
-					result += TZCNT64(ptr.u64[i]);
-					break;
-				}
-				else
-				{
-					result += 64;
-				}
-			}
+	// exceptions that fit into an offset now
+	for (size_t i = 0; i < header->n_exceptions; i++)
+	{
+		uint64_t value = exceptions[i] & 0xFF;
 
-			return (uint8_t)(result + 1);
+		if (value < base + SMALL_ESCAPE)
+		{
+			uint8_t offset = (uint8_t)(value > base ? value - base : 0);
 
-		default:
-			return 0;
+			setNibble(offsets, exceptions[i] >> 8, offset);
+			header->n_above -= offset == 0;
+			exceptions[i--] = exceptions[--header->n_exceptions];
+		}
 	}
 }
 
 /**
- * Sets the `index`th 6 bit of `block` to `reg`.
+ * Raises the base of a SMALL set to the smallest register value, after all registers got greater than the base.
  */
-static inline void setMediumReg(uint32_t *block, uint8_t reg, unsigned char index)
+static void rebaseSmall(void *data)
 {
-	*block &= ~(0x3F << index * 6);
-	*block |= reg << index * 6;
+	struct SmallHeader *header = data;
+	uint8_t *offsets = getSmallOffsets(data);
+	size_t m = (size_t)1 << header->b;
+
+	while (header->n_above == m)
+	{
+		uint8_t min_offset = SMALL_ESCAPE;
+
+		for (size_t i = 0; i < m && min_offset > 1; i++)
+		{
+			if (getNibble(offsets, i) < min_offset)
+				min_offset = getNibble(offsets, i);
+		}
+
+		raiseSmallBase(data, header->base + min_offset);
+	}
 }
 
 /**
- * Sets the `index`th 4 bit of block to `reg`.
+ * Updates the register at `index` of a SMALL set, if `value` is greater than its current value.
  */
-static inline void setSmallReg(uint8_t *block, uint8_t reg, unsigned char index)
+static void updateSmallReg(void *data, size_t index, uint8_t value)
 {
-	*block &= ~(0xF << index * 4);
-	*block |= reg << index * 4;
+	struct SmallHeader *header = data;
+	uint8_t *offsets = getSmallOffsets(data);
+	uint8_t offset = getNibble(offsets, index);
+
+	if (offset == SMALL_ESCAPE)
+	{
+		uint64_t *exception = findSmallException(data, index);
+
+		if (value > (*exception & 0xFF))
+			*exception = (uint64_t)index << 8 | value;
+
+		return;
+	}
+
+	if (value <= header->base + offset)
+		return;
+
+	uint64_t new_offset = value - header->base;
+
+	if (new_offset >= SMALL_ESCAPE)
+	{
+		if (header->n_exceptions < getSmallCapacity((unsigned char)header->b))
+		{
+			getSmallExceptions(data)[header->n_exceptions++] = (uint64_t)index << 8 | value;
+			new_offset = SMALL_ESCAPE;
+		}
+		else
+		{
+			new_offset = SMALL_ESCAPE - 1;
+
+			if (new_offset <= offset)
+				return;
+		}
+	}
+
+	setNibble(offsets, index, (uint8_t)new_offset);
+
+	if (offset == 0 && ++header->n_above == (size_t)1 << header->b)
+		rebaseSmall(data);
 }
 
 /**
- * Updates the register at a given index, if the tailing zero count is greater than the old one.
+ * Merges the registers of a SMALL set into another one with the same `b`, if both have the same base and `other`
+ * has no exceptions. Otherwise nothing happens.
+ *
+ * @return 1 if the sets were merged, 0 otherwise
  */
-static void updateReg(void *blocks, unsigned char r, size_t index, uint8_t n_tailing_zeros)
+static int mergeSmallOffsets(void *data, const void *other)
 {
-	unsigned char reg_index;
-	size_t byte_index;
+	struct SmallHeader *header = data;
+	const struct SmallHeader *other_header = other;
 
-	uint8_t reg;
+	if (header->base != other_header->base || other_header->n_exceptions > 0)
+		return 0;
 
-	// get register
-	switch (r)
+	// escape offsets of `data` stay the greatest offsets, so its exceptions stay valid
+	uint64_t *words = (uint64_t *)getSmallOffsets(data);
+	const uint64_t *other_words = (const uint64_t *)getSmallOffsets(other);
+	size_t n_words = ((size_t)1 << header->b) / 2 / sizeof(uint64_t);
+
+	header->n_above = 0;
+
+	for (size_t i = 0; i < n_words; i++)
 	{
-		case SMALL:
-			byte_index = index / 2;
-			reg_index = (unsigned char)(index % 2);
+		words[i] = maxFields(words[i], other_words[i], SMALL_HIGH_BITS, 4);
+		header->n_above += (uint64_t)countNonZeroNibbles(words[i]);
+	}
 
-			uint8_t sblock = *(uint8_t*)(blocks + byte_index);
-			reg = getSmallReg(sblock, reg_index);
-			break;
-		case MEDIUM:
-			byte_index = index / 4 * 3;
-			reg_index = (unsigned char)(index % 4);
+	rebaseSmall(data);
 
-			uint32_t mblock = *(uint32_t*)(blocks + byte_index);
-			reg = getMediumReg(mblock, reg_index);
-			break;
-		case  LARGE:
-			byte_index = index;
-			reg_index = 0;
+	return 1;
+}
 
-			reg = *(uint8_t*)(blocks + byte_index);
-			break;
+/**
+ * Returns the content of the register at `index`.
+ */
+static inline uint8_t getReg(const void *data, unsigned char r, size_t index)
+{
+	switch (r)
+	{
+		case SMALL:
+			return getSmallReg(data, index);
+		case MEDIUM:
+			return (uint8_t)((((const uint64_t *)data)[index / MEDIUM_REGS_PER_WORD] >>
+				(index % MEDIUM_REGS_PER_WORD * 6)) & 0x3F);
+		case LARGE:
+			return ((const uint8_t *)data)[index];
 		default:
-			return;
+			return 0;
 	}
+}
 
-	reg = minb(maxb(reg, n_tailing_zeros), (uint8_t)((1 << r) - 1));
+/**
+ * Sets the register at `index` to `reg` (MEDIUM and LARGE only, see `updateSmallReg()`).
+ */
+static inline void setReg(void *data, unsigned char r, size_t index, uint8_t reg)
+{
+	unsigned shift;
 
-	// set register
 	switch (r)
 	{
-		case SMALL:
-			setSmallReg((uint8_t*)(blocks + byte_index), reg, reg_index);
-			break;
 		case MEDIUM:
-			setMediumReg((uint32_t*)(blocks + byte_index), reg, reg_index);
+			shift = index % MEDIUM_REGS_PER_WORD * 6;
+			((uint64_t *)data)[index / MEDIUM_REGS_PER_WORD] &= ~((uint64_t)0x3F << shift);
+			((uint64_t *)data)[index / MEDIUM_REGS_PER_WORD] |= (uint64_t)reg << shift;
 			break;
 		case LARGE:
-			*(uint8_t*)(blocks + byte_index) = reg;
+			((uint8_t *)data)[index] = reg;
 			break;
 	}
 }
 
+/**
+ * Raises the base of a SMALL set to the smallest register value it will have after merging `other` into it, so the
+ * registers of `other`, that are far above the current base, don't use up the exception list.
+ */
+static void prepareSmallMerge(struct HyperLogLog *this, const struct HyperLogLog *other)
+{
+	size_t m = (size_t)1 << this->b;
+	uint8_t min_value = getMaxReg(SMALL);
 
+	for (size_t i = 0; i < m && min_value > 0; i++)
+	{
+		uint8_t value = getReg(this->data, SMALL, i);
 
-int hllInit(struct HyperLogLog *this, unsigned char r, unsigned char b, void (*hash)(const void *, size_t, void *))
+		for (size_t j = i; j < (size_t)1 << other->b; j += m)
+			value = maxb(value, getReg(other->data, other->r, j));
+
+		if (value < min_value)
+			min_value = value;
+	}
+
+	raiseSmallBase(this->data, min_value);
+}
+
+/**
+ * Returns the one-based index of the least significant set bit in `buffer`.
+ */
+static uint8_t rho(size_t r, const void *buffer)
 {
-	if (this == NULL)
-		return 1;
+	uint64_t words[4] = {0};
 
-	if (r != SMALL && r != MEDIUM && r != LARGE)
-		return 2;
+	switch (r)
+	{
+		case SMALL:
+		case MEDIUM:
+			memcpy(words, buffer, sizeof(uint64_t));
+			words[0] |= (uint64_t)0xC000000000000000;
+			return (uint8_t)(bitTzcnt64(words[0]) + 1);
 
-	if (b < 4 || b >= sizeof(size_t) * CHAR_BIT)
-		return 3;
-	if (r == SMALL && b < 1)
-		return 3;
-	if (r == MEDIUM && b < 2)
-		return 3;
+		case LARGE:
+			memcpy(words, buffer, sizeof(words));
+			words[3] |= (uint64_t)0xC000000000000000;
+			return (uint8_t)(bitTzcntWords(words, 4) + 1);
 
-	if (hash == NULL)
-		return 4;
+		default:
+			return 0;
+	}
+}
 
-	this->r = r;
-	this->b = b;
-	this->hash = hash;
+/**
+ * Updates the register at a given index, if the tailing zero count is greater than the old one.
+ */
+static void updateReg(void *data, unsigned char r, size_t index, uint8_t n_tailing_zeros)
+{
+	uint8_t max_reg = getMaxReg(r);
 
-	this->data = calloc(getDataSize(r, b), sizeof(char));
-	if (this->data == NULL)
-		return -1;
+	if (n_tailing_zeros > max_reg)
+		n_tailing_zeros = max_reg;
 
-	return 0;
+	if (r == SMALL)
+		updateSmallReg(data, index, n_tailing_zeros);
+	else if (n_tailing_zeros > getReg(data, r, index))
+		setReg(data, r, index, n_tailing_zeros);
 }
 
-void hllFree(struct HyperLogLog *this)
+/**
+ * Returns the number of hash bytes, that `hllAdd()` needs for the register size `r`, or 0 if `r` is invalid.
+ */
+static inline size_t getHashSize(unsigned char r)
 {
-	if (this != NULL)
+	switch (r)
 	{
-		free(this->data);
+		case SMALL:
+		case MEDIUM: return sizeof(size_t) + sizeof(uint64_t);
+		case LARGE:  return MAX_HASH_SIZE;
+		default: return 0;
 	}
 }
 
-void hllAdd(struct HyperLogLog *this, const void *item)
+/**
+ * Updates the register, that is selected by the hash of an item.
+ *
+ * The register index comes first, so the bytes used for `rho()` are a prefix of the bytes used by larger register
+ * sizes (this makes `hllFold()` exact).
+ *
+ * @param buffer The hash of the item, `getHashSize(r)` bytes.
+ */
+static inline void addHashBuffer(void *data, unsigned char r, unsigned char b, const char *buffer)
 {
-	if (this == NULL)
-		return;
+	size_t reg_index;
+	memcpy(&reg_index, buffer, sizeof(size_t));
+
+	updateReg(data, r, getFirstBBits(reg_index, b), rho(r, buffer + sizeof(size_t)));
+}
 
-	// number of bytes that are used for the tailing zero count
-	size_t tzcnt_length;
+/**
+ * Builds a histogram of all register values.
+ *
+ * @param histogram Has to have 256 entries, that are all 0.
+ */
+static void countRegisters(const struct HyperLogLog *this, size_t *histogram)
+{
+	size_t m = (size_t)1 << this->b;
+	size_t n_bytes = hllDataSize(this->r, this->b);
+	const uint8_t *bytes = this->data;
+	const uint64_t *words = this->data;
 
 	switch (this->r)
 	{
-		case SMALL:  tzcnt_length = sizeof(uint16_t); break;
-		case MEDIUM: tzcnt_length = sizeof(uint64_t); break;
-		case LARGE:  tzcnt_length = 4 * sizeof(uint64_t); break;
-		default: return;
-	}
+		case SMALL:
+		{
+			const struct SmallHeader *header = this->data;
+			const uint8_t *offsets = getSmallOffsets(this->data);
+			const uint64_t *exceptions = getSmallExceptions(this->data);
+			size_t offset_counts[16] = {0};
+
+			for (size_t i = 0; i < m / 2; i++)
+			{
+				offset_counts[offsets[i] & 0xF]++;
+				offset_counts[offsets[i] >> 4]++;
+			}
 
-	char buffer[sizeof(size_t) + tzcnt_length];
-	void *hash = buffer;
+			for (size_t k = 0; k < SMALL_ESCAPE; k++)
+				histogram[header->base + k] += offset_counts[k];
 
-	this->hash(item, sizeof(buffer), hash);
+			for (size_t i = 0; i < header->n_exceptions; i++)
+				histogram[exceptions[i] & 0xFF]++;
+			break;
+		}
+		case MEDIUM:
+			for (size_t i = 0; i < m / MEDIUM_REGS_PER_WORD; i++)
+			{
+				uint64_t word = words[i];
 
-	size_t reg_index = *(size_t *)(hash + tzcnt_length);
-	reg_index = getFirstBBits(reg_index, this->b);
+				for (int j = 0; j < MEDIUM_REGS_PER_WORD; j++, word >>= 6)
+					histogram[word & 0x3F]++;
+			}
 
-	updateReg(this->data, this->r, reg_index, rho(this->r, hash));
+			for (size_t i = m - m % MEDIUM_REGS_PER_WORD; i < m; i++)
+				histogram[getReg(this->data, MEDIUM, i)]++;
+			break;
+		case LARGE:
+			for (size_t i = 0; i < n_bytes; i++)
+				histogram[bytes[i]]++;
+			break;
+	}
 }
 
-double hllCount(struct HyperLogLog *this)
+/**
+ * Calculates the cardinality estimate from a histogram of register values.
+ *
+ * @param histogram `histogram[k]` is the number of registers with value `k` (256 entries).
+ * @param b The number of index bits.
+ */
+static double estimate(const size_t *histogram, unsigned char b)
 {
-	if (this == NULL)
-		return NAN;
-
 	double sum = 0;
-	size_t n_empty_regs = 0;
-	size_t n_bytes = getDataSize(this->r, this->b);
-	size_t byte_index = 0;
+	size_t n_empty_regs = histogram[0];
 
-	inline void countRegister(uint8_t reg)
+	for (int reg = 0; reg < 256; reg++)
 	{
-		sum += pow(2, -reg);
-
-		if (reg == 0)
-			n_empty_regs++;
+		if (histogram[reg] > 0)
+			sum += ldexp((double)histogram[reg], -reg);
 	}
 
-	while (byte_index < n_bytes)
-	{
-		uint8_t sblock;
-		uint32_t mblock;
+	size_t m = (size_t)1 << b;
+	double alpha = getAlpha(b);
+	double raw = alpha * m * m / sum;
+
+	if (raw <= 5 / 2 * m)
+	{
+		raw = n_empty_regs > 0 ? m * log((double)m / n_empty_regs) : 0;
+	}
+
+	return raw;
+}
+
+/**
+ * Histograms of the register pairs of two sets A and B, that are needed for the joint estimation (see Ertl, "New
+ * cardinality estimation methods for HyperLogLog sketches", section 5).
+ *
+ * Each array is indexed by a register value.
+ */
+struct JointHistograms
+{
+	// registers with k_a < k_b, counted at k_a and at k_b
+	size_t a_less[256];
+	size_t b_greater[256];
 
-		switch (this->r)
+	// registers with k_a > k_b, counted at k_a and at k_b
+	size_t a_greater[256];
+	size_t b_less[256];
+
+	// registers with k_a == k_b
+	size_t equal[256];
+
+	// registers of A, B and of the union of A and B
+	size_t a[256];
+	size_t b[256];
+	size_t union_[256];
+};
+
+/**
+ * Counts a pair of registers in the joint histograms. Equal pairs are only counted in `equal`, they are added to the
+ * other histograms by `countJointRegisters()`.
+ */
+static inline void countJointPair(struct JointHistograms *h, uint8_t k_a, uint8_t k_b)
+{
+	if (k_a == k_b)
+	{
+		h->equal[k_a]++;
+		return;
+	}
+
+	h->a[k_a]++;
+	h->b[k_b]++;
+
+	if (k_a < k_b)
+	{
+		h->a_less[k_a]++;
+		h->b_greater[k_b]++;
+		h->union_[k_b]++;
+	}
+	else
+	{
+		h->a_greater[k_a]++;
+		h->b_less[k_b]++;
+		h->union_[k_a]++;
+	}
+}
+
+/**
+ * Scans the registers of two SMALL sets 16 offsets (one word) at a time. Equal words without escapes are only
+ * counted, if both sets have the same base. Only escaped registers are looked up in the exception lists.
+ */
+static void countJointSmall(const void *a, const void *b, size_t m, struct JointHistograms *h)
+{
+	const struct SmallHeader *header_a = a;
+	const struct SmallHeader *header_b = b;
+	const uint8_t *offsets_a = getSmallOffsets(a);
+	const uint8_t *offsets_b = getSmallOffsets(b);
+	const uint64_t *words_a = (const uint64_t *)offsets_a;
+	const uint64_t *words_b = (const uint64_t *)offsets_b;
+	size_t n_words = m / 2 / sizeof(uint64_t);
+
+	for (size_t i = 0; i < n_words; i++)
+	{
+		uint64_t word = words_a[i];
+		uint64_t escapes = word & word >> 1 & word >> 2 & word >> 3 & 0x1111111111111111;
+
+		if (word == words_b[i] && escapes == 0 && header_a->base == header_b->base)
+		{
+			for (int j = 0; j < 16; j++, word >>= 4)
+				h->equal[header_a->base + (word & 0xF)]++;
+
+			continue;
+		}
+
+		for (size_t j = i * sizeof(uint64_t); j < (i + 1) * sizeof(uint64_t); j++)
 		{
-			case SMALL:
-				sblock = *(uint8_t*)(this->data + byte_index);
-
-				for (unsigned char i = 0; i < 2; i++)
-					countRegister(getSmallReg(sblock, i));
-				break;
-			case MEDIUM:
-				mblock = *(uint32_t*)(this->data + byte_index);
-
-				for (unsigned char i = 0; i < 4; i++)
-					countRegister(getMediumReg(mblock, i));
-				break;
-			case LARGE:
-				countRegister(*(uint8_t*)(this->data + byte_index));
-				break;
-			default:
-				return NAN;
+			countJointPair(h, getSmallRegFromOffset(a, 2 * j, offsets_a[j] & 0xF),
+				getSmallRegFromOffset(b, 2 * j, offsets_b[j] & 0xF));
+			countJointPair(h, getSmallRegFromOffset(a, 2 * j + 1, offsets_a[j] >> 4),
+				getSmallRegFromOffset(b, 2 * j + 1, offsets_b[j] >> 4));
 		}
+	}
+}
+
+/**
+ * Scans the registers of two MEDIUM sets 10 registers (one word) at a time. Equal words are only counted.
+ */
+static void countJointMedium(const void *a, const void *b, size_t m, struct JointHistograms *h)
+{
+	const uint64_t *words_a = a;
+	const uint64_t *words_b = b;
 
-		if (this->r == MEDIUM)
+	for (size_t i = 0; i < m / MEDIUM_REGS_PER_WORD; i++)
+	{
+		uint64_t word_a = words_a[i];
+		uint64_t word_b = words_b[i];
+
+		if (word_a == word_b)
+		{
+			for (int j = 0; j < MEDIUM_REGS_PER_WORD; j++, word_a >>= 6)
+				h->equal[word_a & 0x3F]++;
+		}
+		else
 		{
-			byte_index += 3;
+			for (int j = 0; j < MEDIUM_REGS_PER_WORD; j++, word_a >>= 6, word_b >>= 6)
+				countJointPair(h, word_a & 0x3F, word_b & 0x3F);
+		}
+	}
+
+	for (size_t i = m - m % MEDIUM_REGS_PER_WORD; i < m; i++)
+		countJointPair(h, getReg(a, MEDIUM, i), getReg(b, MEDIUM, i));
+}
+
+/**
+ * Scans the registers of two LARGE sets 8 registers (one word) at a time. Equal words are only counted.
+ */
+static void countJointLarge(const void *a, const void *b, size_t m, struct JointHistograms *h)
+{
+	const uint8_t *bytes_a = a;
+	const uint8_t *bytes_b = b;
+	const uint64_t *words_a = a;
+	const uint64_t *words_b = b;
 
-			if (byte_index + 3 >= n_bytes)
-				break;
+	for (size_t i = 0; i < m / sizeof(uint64_t); i++)
+	{
+		size_t first = i * sizeof(uint64_t);
+
+		if (words_a[i] == words_b[i])
+		{
+			for (size_t j = first; j < first + sizeof(uint64_t); j++)
+				h->equal[bytes_a[j]]++;
 		}
 		else
 		{
-			byte_index++;
+			for (size_t j = first; j < first + sizeof(uint64_t); j++)
+				countJointPair(h, bytes_a[j], bytes_b[j]);
+		}
+	}
+}
+
+/**
+ * Scans the registers of two sets with the same layout and fills the joint histograms.
+ */
+static void countJointRegisters(const struct HyperLogLog *a, const struct HyperLogLog *b, struct JointHistograms *h)
+{
+	size_t m = (size_t)1 << a->b;
+
+	switch (a->r)
+	{
+		case SMALL:  countJointSmall(a->data, b->data, m, h); break;
+		case MEDIUM: countJointMedium(a->data, b->data, m, h); break;
+		case LARGE:  countJointLarge(a->data, b->data, m, h); break;
+	}
+
+	for (int k = 0; k < 256; k++)
+	{
+		h->a[k] += h->equal[k];
+		h->b[k] += h->equal[k];
+		h->union_[k] += h->equal[k];
+	}
+}
+
+/**
+ * Returns \f$-expm1(-x)\f$ = \f$1 - e^{-x}\f$.
+ */
+static inline double oneMinusExp(double x)
+{
+	return -expm1(-x);
+}
+
+/**
+ * Returns \f$2^{-k}\f$ for registers below the maximum register value `cap`, and \f$2^{-(cap - 1)}\f$ for `cap`
+ * itself. This is the factor \f$s\f$ in \f$P(K \le k - 1) = P(K \le k) \cdot e^{-\lambda s}\f$.
+ */
+static inline double getStep(int k, int cap)
+{
+	return ldexp(1, -(k < cap ? k : cap - 1));
+}
+
+/**
+ * Returns \f$log P(K \le k)\f$ for a register, whose items arrive as a Poisson process with rate `lambda`.
+ */
+static inline double logProbLessEqual(double lambda, int k, int cap)
+{
+	return k < cap ? -lambda * ldexp(1, -k) : 0;
+}
+
+/**
+ * Returns \f$log P(K = k)\f$ for a register, whose items arrive as a Poisson process with rate `lambda`.
+ */
+static inline double logProbEqual(double lambda, int k, int cap)
+{
+	if (k == 0)
+		return -lambda;
+
+	return logProbLessEqual(lambda, k, cap) + log(oneMinusExp(lambda * getStep(k, cap)));
+}
+
+/**
+ * Returns the negative log-likelihood of the joint histograms, given the cardinalities \f$|A \setminus B|\f$,
+ * \f$|B \setminus A|\f$ and \f$|A \cap B|\f$ (as natural logarithms in `x`).
+ */
+static double jointNegLogLikelihood(const struct JointHistograms *h, int cap, double m, const double *x)
+{
+	// rates per register
+	double a = exp(x[0]) / m;
+	double b = exp(x[1]) / m;
+	double both = exp(x[2]) / m;
+	double result = 0;
+
+	for (int k = 0; k <= cap; k++)
+	{
+		if (h->a_less[k])
+			result += h->a_less[k] * logProbEqual(a + both, k, cap);
+		if (h->b_greater[k])
+			result += h->b_greater[k] * logProbEqual(b, k, cap);
+		if (h->a_greater[k])
+			result += h->a_greater[k] * logProbEqual(a, k, cap);
+		if (h->b_less[k])
+			result += h->b_less[k] * logProbEqual(b + both, k, cap);
+
+		if (h->equal[k])
+		{
+			double log_p = logProbLessEqual(a + b + both, k, cap);
+
+			if (k > 0)
+			{
+				double step = getStep(k, cap);
+				double d_a = oneMinusExp(a * step);
+				double d_b = oneMinusExp(b * step);
+				double d_both = oneMinusExp(both * step);
+
+				log_p += log(d_both + (1 - d_both) * d_a * d_b);
+			}
+
+			result += h->equal[k] * log_p;
+		}
+	}
+
+	return -result;
+}
+
+/**
+ * Minimizes `jointNegLogLikelihood()` with the Nelder-Mead method.
+ *
+ * @param x The starting point. The minimum is stored here.
+ */
+static void jointMinimize(const struct JointHistograms *h, int cap, double m, double *x)
+{
+	// natural logarithms of the smallest and greatest cardinalities that are considered
+	const double x_min = -20;
+	const double x_max = 60;
+
+	double simplex[4][3];
+	double values[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			simplex[i][j] = x[j] + (i == j + 1 ? 0.5 : 0);
+
+		values[i] = jointNegLogLikelihood(h, cap, m, simplex[i]);
+	}
+
+	// Evaluates the point `centroid + t * (centroid - worst)`.
+	double tryPoint(const double *centroid, const double *worst, double t, double *point)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			point[j] = centroid[j] + t * (centroid[j] - worst[j]);
+			point[j] = point[j] < x_min ? x_min : (point[j] > x_max ? x_max : point[j]);
+		}
+
+		return jointNegLogLikelihood(h, cap, m, point);
+	}
+
+	for (int iteration = 0; iteration < 1000; iteration++)
+	{
+		// sort the simplex by value (insertion sort)
+		for (int i = 1; i < 4; i++)
+		{
+			for (int j = i; j > 0 && values[j] < values[j - 1]; j--)
+			{
+				double tmp_value = values[j];
+				values[j] = values[j - 1];
+				values[j - 1] = tmp_value;
+
+				for (int l = 0; l < 3; l++)
+				{
+					double tmp = simplex[j][l];
+					simplex[j][l] = simplex[j - 1][l];
+					simplex[j - 1][l] = tmp;
+				}
+			}
+		}
+
+		double size = 0;
+		for (int i = 1; i < 4; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				size = fmax(size, fabs(simplex[i][j] - simplex[0][j]));
+		}
+
+		if (size < 1e-6)
+			break;
+
+		double centroid[3] = {0, 0, 0};
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				centroid[j] += simplex[i][j] / 3;
+		}
+
+		double reflected[3], expanded[3], contracted[3];
+		double reflected_value = tryPoint(centroid, simplex[3], 1, reflected);
+
+		if (reflected_value < values[0])
+		{
+			double expanded_value = tryPoint(centroid, simplex[3], 2, expanded);
+
+			if (expanded_value < reflected_value)
+			{
+				memcpy(simplex[3], expanded, sizeof(expanded));
+				values[3] = expanded_value;
+			}
+			else
+			{
+				memcpy(simplex[3], reflected, sizeof(reflected));
+				values[3] = reflected_value;
+			}
+		}
+		else if (reflected_value < values[2])
+		{
+			memcpy(simplex[3], reflected, sizeof(reflected));
+			values[3] = reflected_value;
+		}
+		else
+		{
+			double contracted_value = tryPoint(centroid, simplex[3], -0.5, contracted);
+
+			if (contracted_value < values[3])
+			{
+				memcpy(simplex[3], contracted, sizeof(contracted));
+				values[3] = contracted_value;
+			}
+			else
+			{
+				// shrink towards the best point
+				for (int i = 1; i < 4; i++)
+				{
+					for (int j = 0; j < 3; j++)
+						simplex[i][j] = simplex[0][j] + 0.5 * (simplex[i][j] - simplex[0][j]);
+
+					values[i] = jointNegLogLikelihood(h, cap, m, simplex[i]);
+				}
+			}
+		}
+	}
+
+	memcpy(x, simplex[0], sizeof(simplex[0]));
+}
+
+size_t hllDataSize(unsigned char r, unsigned char b)
+{
+	if (b < 4 || b >= sizeof(size_t) * CHAR_BIT)
+		return 0;
+
+	// number of registers
+	size_t m = (size_t)1 << b;
+
+	switch (r)
+	{
+		case SMALL:
+			if (b > SMALL_MAX_B)
+				return 0;
+
+			return sizeof(struct SmallHeader) + m / 2 + getSmallCapacity(b) * sizeof(uint64_t);
+		case MEDIUM:
+			return (m + MEDIUM_REGS_PER_WORD - 1) / MEDIUM_REGS_PER_WORD * sizeof(uint64_t);
+		case LARGE:
+			return m;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Initializes the zeroed data of an empty set.
+ */
+static void initData(struct HyperLogLog *this)
+{
+	if (this->r == SMALL)
+		((struct SmallHeader *)this->data)->b = this->b;
+}
+
+int hllInit(struct HyperLogLog *this, unsigned char r, unsigned char b, void (*hash)(const void *, size_t, void *))
+{
+	return hllInitAllocator(this, r, b, hash, NULL);
+}
+
+int hllInitAllocator(struct HyperLogLog *this, unsigned char r, unsigned char b,
+	void (*hash)(const void *, size_t, void *), struct Allocator *allocator)
+{
+	if (this == NULL)
+		return 1;
+
+	if (r != SMALL && r != MEDIUM && r != LARGE)
+		return 2;
+
+	if (b < 4 || b >= sizeof(size_t) * CHAR_BIT)
+		return 3;
+	if (r == SMALL && b > SMALL_MAX_B)
+		return 3;
+	if (r == MEDIUM && b < 2)
+		return 3;
+
+	if (hash == NULL)
+		return 4;
+
+	this->r = r;
+	this->b = b;
+	this->hash = hash;
+	this->allocator = allocator;
+
+	this->data = allocatorCalloc(allocator, hllDataSize(r, b));
+	if (this->data == NULL)
+		return -1;
+
+	initData(this);
+
+	return 0;
+}
+
+void hllFree(struct HyperLogLog *this)
+{
+	if (this != NULL)
+	{
+		allocatorFree(this->allocator, this->data, hllDataSize(this->r, this->b));
+	}
+}
+
+size_t hllMemory(const struct HyperLogLog *this)
+{
+	if (this == NULL)
+		return 0;
+
+	return sizeof(struct HyperLogLog) + hllDataSize(this->r, this->b);
+}
+
+void hllClear(struct HyperLogLog *this)
+{
+	if (this != NULL)
+	{
+		memset(this->data, 0, hllDataSize(this->r, this->b));
+		initData(this);
+	}
+}
+
+void hllAdd(struct HyperLogLog *this, const void *item)
+{
+	if (this == NULL)
+		return;
+
+	size_t size = getHashSize(this->r);
+
+	if (size == 0)
+		return;
+
+	char buffer[size];
+
+	this->hash(item, size, buffer);
+	addHashBuffer(this->data, this->r, this->b, buffer);
+}
+
+void hllAddHash(struct HyperLogLog *this, uint64_t hash)
+{
+	if (this == NULL)
+		return;
+
+	size_t size = getHashSize(this->r);
+
+	if (size == 0)
+		return;
+
+	// the hash is expanded like by `hllAdd()` with `hashExpand()`, but without calling the hash function of the set
+	char buffer[MAX_HASH_SIZE];
+
+	hashExpand(&hash, size, buffer);
+	addHashBuffer(this->data, this->r, this->b, buffer);
+}
+
+void hllAddHashes(struct HyperLogLog *this, const uint64_t *hashes, size_t n)
+{
+	if (this == NULL || hashes == NULL)
+		return;
+
+	size_t size = getHashSize(this->r);
+
+	if (size == 0)
+		return;
+
+	char buffer[MAX_HASH_SIZE];
+	void *data = this->data;
+	unsigned char r = this->r;
+	unsigned char b = this->b;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		hashExpand(&hashes[i], size, buffer);
+		addHashBuffer(data, r, b, buffer);
+	}
+}
+
+double hllCount(struct HyperLogLog *this)
+{
+	if (this == NULL)
+		return NAN;
+
+	if (this->r != SMALL && this->r != MEDIUM && this->r != LARGE)
+		return NAN;
+
+	size_t histogram[256] = {0};
+	countRegisters(this, histogram);
+
+	return estimate(histogram, this->b);
+}
+
+int hllMerge(struct HyperLogLog *this, const struct HyperLogLog *other)
+{
+	if (this == NULL)
+		return 1;
+
+	if (other == NULL || other->r < this->r || other->b < this->b)
+		return 2;
+
+	// sets with a greater precision are folded on the fly, and SMALL sets with different bases are merged per register
+	if (other->r != this->r || other->b != this->b || (this->r == SMALL && !mergeSmallOffsets(this->data, other->data)))
+	{
+		size_t mask = ((size_t)1 << this->b) - 1;
+
+		if (this->r == SMALL)
+			prepareSmallMerge(this, other);
+
+		for (size_t i = 0; i < (size_t)1 << other->b; i++)
+			updateReg(this->data, this->r, i & mask, getReg(other->data, other->r, i));
+
+		return 0;
+	}
+
+	size_t n_bytes = hllDataSize(this->r, this->b);
+	uint8_t *bytes = this->data;
+	const uint8_t *other_bytes = other->data;
+	uint64_t *words = this->data;
+	const uint64_t *other_words = other->data;
+
+	switch (this->r)
+	{
+		case SMALL:
+			// already merged by `mergeSmallOffsets()`
+			break;
+		case MEDIUM:
+			for (size_t i = 0; i < n_bytes / sizeof(uint64_t); i++)
+				words[i] = maxFields(words[i], other_words[i], MEDIUM_HIGH_BITS, 6);
+			break;
+		case LARGE:
+			for (size_t i = 0; i < n_bytes; i++)
+				bytes[i] = maxb(bytes[i], other_bytes[i]);
+			break;
+	}
+
+	return 0;
+}
+
+int hllFold(struct HyperLogLog *this, unsigned char r, unsigned char b)
+{
+	if (this == NULL)
+		return 1;
+
+	if ((r != SMALL && r != MEDIUM && r != LARGE) || r > this->r)
+		return 2;
+
+	if (b < 4 || b > this->b || hllDataSize(r, b) == 0)
+		return 3;
+
+	if (r == this->r && b == this->b)
+		return 0;
+
+	struct HyperLogLog folded = {r, b, this->hash, NULL, this->allocator};
+
+	folded.data = allocatorCalloc(this->allocator, hllDataSize(r, b));
+	if (folded.data == NULL)
+		return -1;
+
+	initData(&folded);
+
+	hllMerge(&folded, this);
+	hllFree(this);
+	*this = folded;
+
+	return 0;
+}
+
+size_t hllSerialize(const struct HyperLogLog *this, void *buffer, size_t size)
+{
+	if (this == NULL)
+		return 0;
+
+	size_t data_size = hllDataSize(this->r, this->b);
+	if (data_size == 0)
+		return 0;
+
+	if (buffer != NULL && size >= SERIALIZED_HEADER_SIZE + data_size)
+	{
+		uint8_t header[SERIALIZED_HEADER_SIZE] = {'H', 'L', SERIALIZED_VERSION, this->r, this->b, 0, 0, 0};
+
+		memcpy(buffer, header, SERIALIZED_HEADER_SIZE);
+		memcpy((uint8_t *)buffer + SERIALIZED_HEADER_SIZE, this->data, data_size);
+	}
+
+	return SERIALIZED_HEADER_SIZE + data_size;
+}
+
+/**
+ * Checks the data of a SMALL set, that was read from an untrusted buffer, and recalculates `n_above`.
+ *
+ * Every exception has to belong to a distinct register with the escape offset, and every register with the escape
+ * offset has to have an exception. Otherwise `findSmallException()` could fail.
+ *
+ * @return 1 if the data is valid, 0 otherwise
+ */
+static int checkSmallData(void *data, unsigned char b)
+{
+	struct SmallHeader *header = data;
+	uint8_t *offsets = getSmallOffsets(data);
+	size_t m = (size_t)1 << b;
+
+	if (header->b != b || header->base > getMaxReg(SMALL) || header->n_exceptions > getSmallCapacity(b))
+		return 0;
+
+	uint64_t *exceptions = getSmallExceptions(data);
+	size_t n_escapes = 0;
+
+	for (size_t i = 0; i < m; i++)
+		n_escapes += getNibble(offsets, i) == SMALL_ESCAPE;
+
+	if (n_escapes != header->n_exceptions)
+		return 0;
+
+	// mark the register of every exception, so duplicates are detected (the marks are removed afterwards)
+	size_t n_checked;
+	int valid = 1;
+
+	for (n_checked = 0; n_checked < header->n_exceptions; n_checked++)
+	{
+		uint64_t index = exceptions[n_checked] >> 8;
+		uint64_t value = exceptions[n_checked] & 0xFF;
+
+		if (index >= m || value > getMaxReg(SMALL) || value < (uint64_t)header->base + SMALL_ESCAPE ||
+			getNibble(offsets, index) != SMALL_ESCAPE)
+		{
+			valid = 0;
+			break;
 		}
+
+		setNibble(offsets, index, 0);
+	}
+
+	for (size_t i = 0; i < n_checked; i++)
+		setNibble(offsets, exceptions[i] >> 8, SMALL_ESCAPE);
+
+	if (!valid)
+		return 0;
+
+	header->n_above = 0;
+
+	for (size_t i = 0; i < m / 2 / sizeof(uint64_t); i++)
+	{
+		uint64_t word;
+
+		memcpy(&word, offsets + i * sizeof(uint64_t), sizeof(uint64_t));
+		header->n_above += (uint64_t)countNonZeroNibbles(word);
 	}
 
+	rebaseSmall(data);
+
+	return 1;
+}
+
+int hllDeserialize(struct HyperLogLog *this, const void *buffer, size_t size,
+	void (*hash)(const void *, size_t, void *))
+{
+	if (this == NULL)
+		return 1;
+
+	const uint8_t *header = buffer;
+
+	if (buffer == NULL || size < SERIALIZED_HEADER_SIZE)
+		return 2;
+
+	if (header[0] != 'H' || header[1] != 'L' || header[2] != SERIALIZED_VERSION)
+		return 2;
+
+	unsigned char r = header[3];
+	unsigned char b = header[4];
+	size_t data_size = hllDataSize(r, b);
+
+	if (data_size == 0)
+		return 2;
+
+	if (size != SERIALIZED_HEADER_SIZE + data_size)
+		return 3;
+
+	if (hash == NULL)
+		return 4;
+
+	int status = hllInit(this, r, b, hash);
+	if (status != 0)
+		return status;
+
+	memcpy(this->data, header + SERIALIZED_HEADER_SIZE, data_size);
+
+	if (r == SMALL && !checkSmallData(this->data, b))
+	{
+		hllFree(this);
+		return 2;
+	}
+
+	// the unused bits of MEDIUM words must stay 0
+	if (r == MEDIUM)
+	{
+		uint64_t *words = this->data;
+		size_t n_regs = (size_t)1 << b;
+
+		for (size_t i = 0; i < data_size / sizeof(uint64_t); i++)
+		{
+			size_t n_word_regs = n_regs < MEDIUM_REGS_PER_WORD ? n_regs : MEDIUM_REGS_PER_WORD;
+
+			words[i] &= ((uint64_t)1 << (n_word_regs * 6)) - 1;
+			n_regs -= n_word_regs;
+		}
+	}
+
+	return 0;
+}
+
+int hllJointCount(struct HyperLogLog *this, struct HyperLogLog *other, struct HyperLogLogJoint *result)
+{
+	if (this == NULL)
+		return 1;
+
+	if (other == NULL || other->r != this->r || other->b != this->b)
+		return 2;
+
+	if (result == NULL)
+		return 3;
+
+	struct JointHistograms *h = calloc(1, sizeof(struct JointHistograms));
+	if (h == NULL)
+		return -1;
+
 	size_t m = (size_t)1 << this->b;
-	double alpha = getAlpha(this->b);
-	double raw = alpha * m * m / sum;
+	int cap = getMaxReg(this->r);
 
-	if (raw <= 5 / 2 * m)
+	countJointRegisters(this, other, h);
+
+	// start with the inclusion-exclusion estimates
+	double count_a = estimate(h->a, this->b);
+	double count_b = estimate(h->b, this->b);
+	double count_union = estimate(h->union_, this->b);
+	double both = fmax(count_a + count_b - count_union, 1);
+
+	double x[3] =
 	{
-		raw = n_empty_regs > 0 ? m * log((double)m / n_empty_regs) : 0;
+		log(fmax(count_a - both, 1)),
+		log(fmax(count_b - both, 1)),
+		log(both)
+	};
+
+	if (count_union > 0)
+		jointMinimize(h, cap, (double)m, x);
+
+	free(h);
+
+	if (count_union > 0)
+	{
+		result->only_a = exp(x[0]);
+		result->only_b = exp(x[1]);
+		result->intersection = exp(x[2]);
+		result->jaccard = result->intersection / (result->only_a + result->only_b + result->intersection);
+	}
+	else
+	{
+		memset(result, 0, sizeof(struct HyperLogLogJoint));
 	}
 
-	return raw;
-}
\ No newline at end of file
+	return 0;
+}
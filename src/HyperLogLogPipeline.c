@@ -0,0 +1,379 @@
+/**
+ * @file HyperLogLogPipeline.c
+ *
+ * Contains the implementations of the functions defined in HyperLogLogPipeline.h, as well as some static helper
+ * functions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLogPipeline.h"
+
+/**
+ * The number of polls without work, after which a waiting thread yields its core.
+ */
+#define SPIN_POLLS 64
+
+/**
+ * The number of polls without work, after which an idle worker sleeps between its polls.
+ */
+#define SLEEP_POLLS 4096
+
+/**
+ * How long an idle worker sleeps between its polls, in nanoseconds.
+ */
+#define SLEEP_NS 50000
+
+/**
+ * Backs off after `polls` unsuccessful polls: spins first, then yields, then sleeps (if `sleep` is non-zero).
+ */
+static void backOff(size_t polls, int sleep)
+{
+	if (polls < SPIN_POLLS)
+		return;
+
+	if (!sleep || polls < SLEEP_POLLS)
+	{
+		sched_yield();
+		return;
+	}
+
+	struct timespec time = {0, SLEEP_NS};
+	nanosleep(&time, NULL);
+}
+
+/**
+ * Pushes `n` hashes into a ring, if there is enough space.
+ *
+ * @return 1 on success, 0 if the ring is too full
+ */
+static int ringPush(struct HyperLogLogPipelineRing *ring, const uint64_t *hashes, size_t n)
+{
+	size_t tail = ring->tail;
+
+	if (tail + n - ring->head_cache > ring->mask + 1)
+	{
+		ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+		if (tail + n - ring->head_cache > ring->mask + 1)
+			return 0;
+	}
+
+	for (size_t i = 0; i < n; i++)
+		ring->slots[(tail + i) & ring->mask] = hashes[i];
+
+	__atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/**
+ * Pushes the buffered hashes of a reader for one worker, and waits if the ring is too full.
+ */
+static void flushBuffer(struct HyperLogLogPipeline *this, size_t reader, size_t worker)
+{
+	struct HyperLogLogPipelineReader *state = &this->readers[reader];
+	struct HyperLogLogPipelineRing *ring = &this->rings[reader * this->n_workers + worker];
+	size_t polls = 0;
+
+	if (state->lengths[worker] == 0)
+		return;
+
+	while (!ringPush(ring, state->buffers + worker * HLL_PIPELINE_BATCH, state->lengths[worker]))
+		backOff(++polls, 0);
+
+	state->lengths[worker] = 0;
+}
+
+/**
+ * Applies all hashes of a ring to the set.
+ *
+ * @return the number of applied hashes
+ */
+static size_t ringDrain(struct HyperLogLogPipelineRing *ring, struct HyperLogLog *set)
+{
+	size_t head = ring->head;
+
+	if (head == ring->tail_cache)
+	{
+		ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+		if (head == ring->tail_cache)
+			return 0;
+	}
+
+	size_t n = ring->tail_cache - head;
+	size_t first = head & ring->mask;
+
+	// the hashes may wrap around the end of the slots
+	if (first + n > ring->mask + 1)
+	{
+		hllAddHashes(set, ring->slots + first, ring->mask + 1 - first);
+		hllAddHashes(set, ring->slots, first + n - (ring->mask + 1));
+	}
+	else
+	{
+		hllAddHashes(set, ring->slots + first, n);
+	}
+
+	__atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+/**
+ * The main function of a worker thread: applies the hashes of its rings until the pipeline is stopped.
+ */
+static void *work(void *argument)
+{
+	struct HyperLogLogPipelineWorker *worker = argument;
+	struct HyperLogLogPipeline *this = worker->pipeline;
+	size_t polls = 0;
+
+	while (1)
+	{
+		// read the flag before the rings, so no hash, that was pushed before the flag was set, is missed
+		int stop = __atomic_load_n(&this->stop, __ATOMIC_ACQUIRE);
+		size_t applied = 0;
+
+		pthread_mutex_lock(&worker->lock);
+
+		for (size_t i = 0; i < this->n_readers; i++)
+			applied += ringDrain(&this->rings[i * this->n_workers + worker->index], this->set);
+
+		pthread_mutex_unlock(&worker->lock);
+
+		if (applied > 0)
+		{
+			polls = 0;
+			continue;
+		}
+
+		if (stop)
+			return NULL;
+
+		backOff(++polls, 1);
+	}
+}
+
+/**
+ * Stops the first `n` workers and frees the memory of a pipeline.
+ */
+static void stopWorkers(struct HyperLogLogPipeline *this, size_t n)
+{
+	__atomic_store_n(&this->stop, 1, __ATOMIC_RELEASE);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		pthread_join(this->workers[i].thread, NULL);
+		pthread_mutex_destroy(&this->workers[i].lock);
+	}
+
+	if (this->rings != NULL)
+	{
+		for (size_t i = 0; i < this->n_readers * this->n_workers; i++)
+			free(this->rings[i].slots);
+	}
+
+	if (this->readers != NULL)
+	{
+		for (size_t i = 0; i < this->n_readers; i++)
+		{
+			free(this->readers[i].buffers);
+			free(this->readers[i].lengths);
+		}
+	}
+
+	free(this->rings);
+	free(this->readers);
+	free(this->workers);
+
+	this->rings = NULL;
+	this->readers = NULL;
+	this->workers = NULL;
+}
+
+int hllPipelineInit(struct HyperLogLogPipeline *this, struct HyperLogLog *set, size_t n_readers, size_t n_workers,
+	size_t capacity)
+{
+	if (this == NULL)
+		return 1;
+
+	if (set == NULL || (set->r != MEDIUM && set->r != LARGE))
+		return 2;
+
+	if (n_readers == 0)
+		return 3;
+
+	if (n_workers == 0)
+		return 4;
+
+	if (capacity == 0)
+		capacity = HLL_PIPELINE_CAPACITY;
+
+	if (capacity < HLL_PIPELINE_BATCH || (capacity & (capacity - 1)) != 0)
+		return 5;
+
+	// a cache line holds 64 LARGE registers, or 80 MEDIUM registers (10 per 64-bit word), so the ranges of the
+	// workers neither split words nor share cache lines, if they are shifted to the cache line boundaries of the
+	// registers (malloc() only aligns to 16 bytes)
+	size_t line = set->r == LARGE ? HLL_PIPELINE_CACHE_LINE : HLL_PIPELINE_CACHE_LINE / sizeof(uint64_t) * 10;
+	size_t misalignment = (uintptr_t)set->data % HLL_PIPELINE_CACHE_LINE;
+	size_t shift = set->r == LARGE ? misalignment : misalignment / sizeof(uint64_t) * 10;
+	size_t m = (size_t)1 << set->b;
+	size_t n_lines = (m + shift + line - 1) / line;
+
+	this->set = set;
+	this->n_readers = n_readers;
+	this->n_workers = n_workers;
+	this->span = (n_lines + n_workers - 1) / n_workers * line;
+	this->shift = shift;
+	this->stop = 0;
+
+	this->rings = calloc(n_readers * n_workers, sizeof(struct HyperLogLogPipelineRing));
+	this->readers = calloc(n_readers, sizeof(struct HyperLogLogPipelineReader));
+	this->workers = calloc(n_workers, sizeof(struct HyperLogLogPipelineWorker));
+
+	if (this->rings == NULL || this->readers == NULL || this->workers == NULL)
+	{
+		stopWorkers(this, 0);
+		return -1;
+	}
+
+	for (size_t i = 0; i < n_readers * n_workers; i++)
+	{
+		this->rings[i].slots = malloc(capacity * sizeof(uint64_t));
+		this->rings[i].mask = capacity - 1;
+
+		if (this->rings[i].slots == NULL)
+		{
+			stopWorkers(this, 0);
+			return -1;
+		}
+	}
+
+	for (size_t i = 0; i < n_readers; i++)
+	{
+		this->readers[i].buffers = malloc(n_workers * HLL_PIPELINE_BATCH * sizeof(uint64_t));
+		this->readers[i].lengths = calloc(n_workers, sizeof(size_t));
+
+		if (this->readers[i].buffers == NULL || this->readers[i].lengths == NULL)
+		{
+			stopWorkers(this, 0);
+			return -1;
+		}
+	}
+
+	for (size_t i = 0; i < n_workers; i++)
+	{
+		struct HyperLogLogPipelineWorker *worker = &this->workers[i];
+
+		worker->pipeline = this;
+		worker->index = i;
+
+		if (pthread_mutex_init(&worker->lock, NULL) != 0)
+		{
+			stopWorkers(this, i);
+			return -1;
+		}
+
+		if (pthread_create(&worker->thread, NULL, &work, worker) != 0)
+		{
+			pthread_mutex_destroy(&worker->lock);
+			stopWorkers(this, i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void hllPipelineFree(struct HyperLogLogPipeline *this)
+{
+	if (this == NULL || this->workers == NULL)
+		return;
+
+	for (size_t i = 0; i < this->n_readers; i++)
+		hllPipelineFlush(this, i);
+
+	stopWorkers(this, this->n_workers);
+}
+
+void hllPipelineAddHash(struct HyperLogLogPipeline *this, size_t reader, uint64_t hash)
+{
+	if (this == NULL || reader >= this->n_readers)
+		return;
+
+	// the register index is taken from the first word of the expanded hash (see `hllAddHash()`)
+	uint64_t expanded;
+	hashExpand(&hash, sizeof(expanded), &expanded);
+
+	size_t index = expanded & (((size_t)1 << this->set->b) - 1);
+	size_t worker = (index + this->shift) / this->span;
+	struct HyperLogLogPipelineReader *state = &this->readers[reader];
+
+	state->buffers[worker * HLL_PIPELINE_BATCH + state->lengths[worker]++] = hash;
+
+	if (state->lengths[worker] == HLL_PIPELINE_BATCH)
+		flushBuffer(this, reader, worker);
+}
+
+void hllPipelineAdd(struct HyperLogLogPipeline *this, size_t reader, const void *item)
+{
+	if (this == NULL)
+		return;
+
+	uint64_t hash;
+
+	this->set->hash(item, sizeof(hash), &hash);
+	hllPipelineAddHash(this, reader, hash);
+}
+
+void hllPipelineFlush(struct HyperLogLogPipeline *this, size_t reader)
+{
+	if (this == NULL || reader >= this->n_readers)
+		return;
+
+	for (size_t i = 0; i < this->n_workers; i++)
+		flushBuffer(this, reader, i);
+}
+
+void hllPipelineWait(struct HyperLogLogPipeline *this)
+{
+	if (this == NULL)
+		return;
+
+	for (size_t i = 0; i < this->n_readers * this->n_workers; i++)
+	{
+		struct HyperLogLogPipelineRing *ring = &this->rings[i];
+		size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		size_t polls = 0;
+
+		// the indices only grow, so hashes pushed after the call don't delay it
+		while ((ptrdiff_t)(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail) < 0)
+			backOff(++polls, 0);
+	}
+}
+
+double hllPipelineCount(struct HyperLogLogPipeline *this)
+{
+	if (this == NULL)
+		return NAN;
+
+	hllPipelineWait(this);
+
+	for (size_t i = 0; i < this->n_workers; i++)
+		pthread_mutex_lock(&this->workers[i].lock);
+
+	double count = hllCount(this->set);
+
+	for (size_t i = 0; i < this->n_workers; i++)
+		pthread_mutex_unlock(&this->workers[i].lock);
+
+	return count;
+}
@@ -0,0 +1,719 @@
+/**
+ * @file HyperLogLogStore.c
+ *
+ * Contains the implementations of the functions defined in HyperLogLogStore.h, as well as some static helper
+ * functions.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../inc/HyperLogLogStore.h"
+
+/**
+ * The initial capacity of the hash table.
+ */
+#define MIN_CAPACITY 16
+
+/**
+ * The (maximum) size of a slab in bytes.
+ */
+#define SLAB_SIZE ((size_t)1 << 20)
+
+/**
+ * The number of bits of the key hash, that are used to partition a batch.
+ */
+#define PARTITION_BITS 8
+
+/**
+ * Batches with fewer pairs are not partitioned.
+ */
+#define PARTITION_MIN_BATCH 4096
+
+/**
+ * The home slot of the key that is this many pairs ahead in a batch is prefetched.
+ */
+#define PREFETCH_DISTANCE 8
+
+/**
+ * A (key, item) pair of a batch.
+ */
+struct KeyItem
+{
+	uint64_t key;
+	const void *item;
+};
+
+/**
+ * Mixes the bits of a key (the finalizer of splitmix64).
+ */
+static inline uint64_t hashKey(uint64_t key)
+{
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EB;
+	return key ^ (key >> 31);
+}
+
+/**
+ * A hash function for `struct HyperLogLog`, whose items are pointers to keys. The key is only mixed once, so at most
+ * 16 bytes are generated (that's enough for MEDIUM registers).
+ */
+static void hashKeyItem(const void *item, size_t h, void *buffer)
+{
+	uint64_t words[2];
+
+	// the second word is rotated, so the register index and the trailing zeros are taken from different bits
+	words[0] = hashKey(*(const uint64_t *)item);
+	words[1] = words[0] >> 32 | words[0] << 32;
+
+	memcpy(buffer, words, h < sizeof(words) ? h : sizeof(words));
+}
+
+/**
+ * Returns the home slot of a key hash. The most significant bits of the hash are used, so keys in the same partition
+ * of a batch (see `hllStoreAddBatch()`) have their home slots in the same region of the table.
+ */
+static inline size_t homeSlot(const struct HyperLogLogStore *this, uint64_t key_hash)
+{
+	return (size_t)(key_hash >> (64 - __builtin_ctzll(this->capacity)));
+}
+
+/**
+ * Returns the registers of a sketch.
+ */
+static inline uint8_t *getSketch(const struct HyperLogLogStore *this, uint32_t sketch)
+{
+	size_t mask = ((size_t)1 << this->slab_shift) - 1;
+
+	return this->slabs[sketch >> this->slab_shift] + (sketch & mask) * this->data_size;
+}
+
+/**
+ * Fills a `struct HyperLogLog`, that points to the registers of a sketch.
+ */
+static inline void makeView(const struct HyperLogLogStore *this, uint32_t sketch, struct HyperLogLog *view)
+{
+	view->r = this->r;
+	view->b = this->b;
+	view->hash = this->hash;
+	view->data = getSketch(this, sketch);
+	view->allocator = NULL;
+}
+
+/**
+ * Returns the slot of `key`, or the empty slot where it would be inserted.
+ */
+static size_t findSlot(const struct HyperLogLogStore *this, uint64_t key)
+{
+	size_t mask = this->capacity - 1;
+	size_t slot = homeSlot(this, hashKey(key));
+
+	while (this->entries[slot].used && this->entries[slot].key != key)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+/**
+ * Returns the slab shift for sketches with `data_size` bytes each, so that a slab is at most `SLAB_SIZE` bytes (but
+ * holds at least one sketch).
+ */
+static unsigned char getSlabShift(size_t data_size)
+{
+	unsigned char shift = 0;
+
+	while ((data_size << (shift + 1)) <= SLAB_SIZE)
+		shift++;
+
+	return shift;
+}
+
+/**
+ * Doubles the capacity of the hash table.
+ *
+ * @return 0 on success, -1 on malloc error
+ */
+static int grow(struct HyperLogLogStore *this)
+{
+	struct HyperLogLogStoreEntry *old_entries = this->entries;
+	size_t old_capacity = this->capacity;
+
+	this->entries = calloc(2 * old_capacity, sizeof(struct HyperLogLogStoreEntry));
+	if (this->entries == NULL)
+	{
+		this->entries = old_entries;
+		return -1;
+	}
+
+	this->capacity = 2 * old_capacity;
+	this->hand = 0;
+
+	for (size_t i = 0; i < old_capacity; i++)
+	{
+		if (old_entries[i].used)
+			this->entries[findSlot(this, old_entries[i].key)] = old_entries[i];
+	}
+
+	free(old_entries);
+
+	return 0;
+}
+
+/**
+ * Clears a slot and moves following entries back, so that no entry is separated from its home slot by an empty slot.
+ */
+static void removeSlot(struct HyperLogLogStore *this, size_t slot)
+{
+	size_t mask = this->capacity - 1;
+	size_t next = (slot + 1) & mask;
+
+	this->free_sketches[this->n_free++] = this->entries[slot].sketch;
+	this->count--;
+
+	while (this->entries[next].used)
+	{
+		size_t home = homeSlot(this, hashKey(this->entries[next].key));
+
+		// the entry at `next` can be moved to `slot`, if its home slot is not in (slot, next]
+		if (((next - home) & mask) >= ((next - slot) & mask))
+		{
+			this->entries[slot] = this->entries[next];
+			slot = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+
+	this->entries[slot].used = 0;
+}
+
+/**
+ * Evicts one sketch, that was not accessed since the clock hand passed it the last time.
+ */
+static void evictOne(struct HyperLogLogStore *this)
+{
+	size_t mask = this->capacity - 1;
+
+	while (1)
+	{
+		struct HyperLogLogStoreEntry *entry = &this->entries[this->hand];
+
+		if (entry->used && !entry->referenced)
+			break;
+
+		entry->referenced = 0;
+		this->hand = (this->hand + 1) & mask;
+	}
+
+	if (this->evict != NULL)
+	{
+		struct HyperLogLog view;
+
+		makeView(this, this->entries[this->hand].sketch, &view);
+		this->evict(this->entries[this->hand].key, &view, this->context);
+	}
+
+	// the hand stays, because `removeSlot()` might move another entry to this slot
+	removeSlot(this, this->hand);
+}
+
+/**
+ * Returns the memory usage of the store, if it contained `count` keys.
+ */
+static size_t getMemory(const struct HyperLogLogStore *this, size_t count)
+{
+	size_t capacity = this->capacity;
+
+	while (2 * count > capacity)
+		capacity *= 2;
+
+	return count * this->data_size + capacity * sizeof(struct HyperLogLogStoreEntry);
+}
+
+/**
+ * Clears all registers of a sketch.
+ */
+static void clearSketch(const struct HyperLogLogStore *this, uint32_t sketch)
+{
+	struct HyperLogLog view;
+
+	makeView(this, sketch, &view);
+	hllClear(&view);
+}
+
+/**
+ * Takes an unused sketch (with all registers cleared) from the free list or the slabs.
+ *
+ * @return 0 on success, -1 on malloc error or if there are too many sketches
+ */
+static int allocSketch(struct HyperLogLogStore *this, uint32_t *sketch)
+{
+	if (this->n_free > 0)
+	{
+		*sketch = this->free_sketches[--this->n_free];
+		clearSketch(this, *sketch);
+		return 0;
+	}
+
+	if (this->n_sketches >= UINT32_MAX)
+		return -1;
+
+	if (this->n_sketches == this->n_slabs << this->slab_shift)
+	{
+		uint8_t **slabs = realloc(this->slabs, (this->n_slabs + 1) * sizeof(uint8_t *));
+		if (slabs == NULL)
+			return -1;
+
+		this->slabs = slabs;
+
+		// the free list has to be able to hold all sketches, so `removeSlot()` can't fail
+		uint32_t *free_sketches = realloc(this->free_sketches, ((this->n_slabs + 1) << this->slab_shift) *
+			sizeof(uint32_t));
+		if (free_sketches == NULL)
+			return -1;
+
+		this->free_sketches = free_sketches;
+
+		this->slabs[this->n_slabs] = calloc((size_t)1 << this->slab_shift, this->data_size);
+		if (this->slabs[this->n_slabs] == NULL)
+			return -1;
+
+		this->n_slabs++;
+	}
+
+	*sketch = (uint32_t)this->n_sketches++;
+	clearSketch(this, *sketch);
+
+	return 0;
+}
+
+/**
+ * Returns the registers of the sketch of `key`. If there is no such sketch, it's created (and other sketches may be
+ * evicted).
+ *
+ * @return The registers, or `NULL` on malloc error.
+ */
+static uint8_t *findOrCreate(struct HyperLogLogStore *this, uint64_t key)
+{
+	size_t slot = findSlot(this, key);
+
+	if (!this->entries[slot].used)
+	{
+		if (this->max_bytes != 0)
+		{
+			while (this->count > 0 && getMemory(this, this->count + 1) > this->max_bytes)
+				evictOne(this);
+		}
+
+		if (2 * (this->count + 1) > this->capacity && grow(this) != 0)
+			return NULL;
+
+		uint32_t sketch;
+
+		if (allocSketch(this, &sketch) != 0)
+			return NULL;
+
+		// evicting and growing might have moved the slot
+		slot = findSlot(this, key);
+
+		this->entries[slot].key = key;
+		this->entries[slot].sketch = sketch;
+		this->entries[slot].used = 1;
+		this->count++;
+	}
+
+	this->entries[slot].referenced = 1;
+
+	return getSketch(this, this->entries[slot].sketch);
+}
+
+/**
+ * Grows the hash table, so that `n_new` more keys can be inserted without growing it again.
+ *
+ * @return 0 on success, 1 if the memory limit is too low for `n_new` more keys, -1 on malloc error
+ */
+static int reserve(struct HyperLogLogStore *this, size_t n_new)
+{
+	if (this->max_bytes != 0 && getMemory(this, this->count + n_new) > this->max_bytes)
+		return 1;
+
+	while (2 * (this->count + n_new) > this->capacity)
+	{
+		if (grow(this) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Prefetches the home slot of `key`.
+ */
+static inline void prefetchKey(const struct HyperLogLogStore *this, uint64_t key)
+{
+	__builtin_prefetch(&this->entries[homeSlot(this, hashKey(key))]);
+}
+
+/**
+ * Adds one pair of a batch. `view` and `last_key` are the sketch and key of the previous pair (`view->data` is `NULL`
+ * for the first pair), so consecutive pairs with the same key don't need another lookup.
+ *
+ * @return 0 on success, -1 on malloc error
+ */
+static inline int addPair(struct HyperLogLogStore *this, struct HyperLogLog *view, uint64_t *last_key, uint64_t key,
+	const void *item)
+{
+	if (view->data == NULL || key != *last_key)
+	{
+		view->data = findOrCreate(this, key);
+		*last_key = key;
+
+		if (view->data == NULL)
+			return -1;
+	}
+
+	hllAdd(view, item);
+
+	return 0;
+}
+
+int hllStoreInit(struct HyperLogLogStore *this, unsigned char r, unsigned char b,
+	void (*hash)(const void *, size_t, void *))
+{
+	if (this == NULL)
+		return 1;
+
+	struct HyperLogLog test;
+	int status = hllInit(&test, r, b, hash);
+
+	if (status != 0)
+		return status;
+
+	hllFree(&test);
+
+	memset(this, 0, sizeof(struct HyperLogLogStore));
+
+	this->r = r;
+	this->b = b;
+	this->hash = hash;
+	this->capacity = MIN_CAPACITY;
+	this->data_size = hllDataSize(r, b);
+	this->slab_shift = getSlabShift(this->data_size);
+
+	this->entries = calloc(MIN_CAPACITY, sizeof(struct HyperLogLogStoreEntry));
+	if (this->entries == NULL)
+		return -1;
+
+	return 0;
+}
+
+void hllStoreFree(struct HyperLogLogStore *this)
+{
+	if (this == NULL)
+		return;
+
+	for (size_t i = 0; i < this->n_slabs; i++)
+		free(this->slabs[i]);
+
+	free(this->slabs);
+	free(this->free_sketches);
+	free(this->entries);
+}
+
+int hllStoreLimit(struct HyperLogLogStore *this, size_t max_bytes,
+	void (*evict)(uint64_t key, const struct HyperLogLog *sketch, void *context), void *context)
+{
+	if (this == NULL)
+		return 1;
+
+	this->max_bytes = max_bytes;
+	this->evict = evict;
+	this->context = context;
+
+	if (max_bytes != 0)
+	{
+		while (this->count > 1 && getMemory(this, this->count) > max_bytes)
+			evictOne(this);
+	}
+
+	return 0;
+}
+
+size_t hllStoreMemory(const struct HyperLogLogStore *this)
+{
+	if (this == NULL)
+		return 0;
+
+	return getMemory(this, this->count);
+}
+
+int hllStoreAdd(struct HyperLogLogStore *this, uint64_t key, const void *item)
+{
+	if (this == NULL)
+		return 1;
+
+	struct HyperLogLog view = {this->r, this->b, this->hash, findOrCreate(this, key), NULL};
+
+	if (view.data == NULL)
+		return -1;
+
+	hllAdd(&view, item);
+
+	return 0;
+}
+
+int hllStoreAddBatch(struct HyperLogLogStore *this, const uint64_t *keys, const void *const *items, size_t n)
+{
+	if (this == NULL)
+		return 1;
+
+	if (keys == NULL)
+		return 2;
+
+	if (items == NULL)
+		return 3;
+
+	struct KeyItem *partitioned = NULL;
+
+	// small batches (or if there is not enough memory for all keys) are added in their original order
+	if (n >= PARTITION_MIN_BATCH)
+	{
+		// partitioning while the hash table is growing would pile up the keys of the first partitions in their
+		// region of the table, so the table is grown for the new keys first
+		struct HyperLogLog keys_hll;
+
+		if (hllInit(&keys_hll, MEDIUM, 10, &hashKeyItem) != 0)
+			return -1;
+
+		for (size_t i = 0; i < n; i++)
+			hllAdd(&keys_hll, &keys[i]);
+
+		size_t n_new = (size_t)(1.1 * hllCount(&keys_hll));
+		int status = reserve(this, n_new < n ? n_new : n);
+
+		hllFree(&keys_hll);
+
+		if (status < 0)
+			return -1;
+
+		if (status == 0)
+			partitioned = malloc(n * sizeof(struct KeyItem));
+	}
+
+	struct HyperLogLog view = {this->r, this->b, this->hash, NULL, NULL};
+	uint64_t last_key = 0;
+	int status = 0;
+
+	if (partitioned != NULL)
+	{
+		// the pairs themselves are moved, so the partitions can be read sequentially
+		size_t offsets[(1 << PARTITION_BITS) + 1] = {0};
+
+		for (size_t i = 0; i < n; i++)
+			offsets[(hashKey(keys[i]) >> (64 - PARTITION_BITS)) + 1]++;
+
+		for (size_t p = 1; p <= 1 << PARTITION_BITS; p++)
+			offsets[p] += offsets[p - 1];
+
+		for (size_t i = 0; i < n; i++)
+		{
+			struct KeyItem *pair = &partitioned[offsets[hashKey(keys[i]) >> (64 - PARTITION_BITS)]++];
+
+			pair->key = keys[i];
+			pair->item = items[i];
+		}
+
+		for (size_t i = 0; status == 0 && i < n; i++)
+		{
+			if (i + PREFETCH_DISTANCE < n)
+				prefetchKey(this, partitioned[i + PREFETCH_DISTANCE].key);
+
+			status = addPair(this, &view, &last_key, partitioned[i].key, partitioned[i].item);
+		}
+
+		free(partitioned);
+	}
+	else
+	{
+		for (size_t i = 0; status == 0 && i < n; i++)
+		{
+			if (i + PREFETCH_DISTANCE < n)
+				prefetchKey(this, keys[i + PREFETCH_DISTANCE]);
+
+			status = addPair(this, &view, &last_key, keys[i], items[i]);
+		}
+	}
+
+	return status;
+}
+
+int hllStoreGet(struct HyperLogLogStore *this, uint64_t key, struct HyperLogLog *sketch)
+{
+	if (this == NULL || sketch == NULL)
+		return 0;
+
+	size_t slot = findSlot(this, key);
+
+	if (!this->entries[slot].used)
+		return 0;
+
+	this->entries[slot].referenced = 1;
+	makeView(this, this->entries[slot].sketch, sketch);
+
+	return 1;
+}
+
+int hllStoreOpen(struct HyperLogLogStore *this, uint64_t key, struct HyperLogLog *sketch)
+{
+	if (this == NULL)
+		return 1;
+	if (sketch == NULL)
+		return 3;
+
+	struct HyperLogLog view = {this->r, this->b, this->hash, findOrCreate(this, key), NULL};
+
+	if (view.data == NULL)
+		return -1;
+
+	*sketch = view;
+
+	return 0;
+}
+
+int hllStoreRemove(struct HyperLogLogStore *this, uint64_t key)
+{
+	if (this == NULL)
+		return 0;
+
+	size_t slot = findSlot(this, key);
+
+	if (!this->entries[slot].used)
+		return 0;
+
+	removeSlot(this, slot);
+
+	return 1;
+}
+
+int hllStoreCount(struct HyperLogLogStore *this, const uint64_t *keys, size_t n, double *results)
+{
+	if (this == NULL)
+		return 1;
+
+	if (keys == NULL)
+		return 2;
+
+	if (results == NULL)
+		return 3;
+
+	struct HyperLogLog view;
+
+	for (size_t i = 0; i < n; i++)
+		results[i] = hllStoreGet(this, keys[i], &view) ? hllCount(&view) : 0;
+
+	return 0;
+}
+
+int hllStoreMerge(struct HyperLogLogStore *this, const uint64_t *keys, size_t n, struct HyperLogLog *result)
+{
+	if (this == NULL)
+		return 1;
+
+	if (keys == NULL)
+		return 2;
+
+	if (result == NULL || result->r > this->r || result->b > this->b)
+		return 3;
+
+	struct HyperLogLog view;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (hllStoreGet(this, keys[i], &view))
+			hllMerge(result, &view);
+	}
+
+	return 0;
+}
+
+int hllStoreFold(struct HyperLogLogStore *this, unsigned char r, unsigned char b)
+{
+	if (this == NULL)
+		return 1;
+
+	if ((r != SMALL && r != MEDIUM && r != LARGE) || r > this->r)
+		return 2;
+
+	if (b < 4 || b > this->b || hllDataSize(r, b) == 0)
+		return 3;
+
+	if (r == this->r && b == this->b)
+		return 0;
+
+	// the folded sketches are packed into new slabs, in the order of the hash table
+	struct HyperLogLogStore folded = *this;
+
+	folded.r = r;
+	folded.b = b;
+	folded.data_size = hllDataSize(r, b);
+	folded.slab_shift = getSlabShift(folded.data_size);
+	folded.n_slabs = (this->count + ((size_t)1 << folded.slab_shift) - 1) >> folded.slab_shift;
+	folded.n_sketches = this->count;
+	folded.n_free = 0;
+
+	folded.slabs = NULL;
+	folded.free_sketches = NULL;
+
+	if (folded.n_slabs > 0)
+	{
+		folded.slabs = calloc(folded.n_slabs, sizeof(uint8_t *));
+		folded.free_sketches = malloc((folded.n_slabs << folded.slab_shift) * sizeof(uint32_t));
+
+		int status = folded.slabs == NULL || folded.free_sketches == NULL ? -1 : 0;
+
+		for (size_t i = 0; status == 0 && i < folded.n_slabs; i++)
+		{
+			folded.slabs[i] = calloc((size_t)1 << folded.slab_shift, folded.data_size);
+
+			if (folded.slabs[i] == NULL)
+				status = -1;
+		}
+
+		if (status != 0)
+		{
+			for (size_t i = 0; folded.slabs != NULL && i < folded.n_slabs; i++)
+				free(folded.slabs[i]);
+
+			free(folded.slabs);
+			free(folded.free_sketches);
+
+			return -1;
+		}
+	}
+
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < this->capacity; i++)
+	{
+		if (!this->entries[i].used)
+			continue;
+
+		struct HyperLogLog old_view, new_view;
+
+		makeView(this, this->entries[i].sketch, &old_view);
+		makeView(&folded, next, &new_view);
+		hllClear(&new_view);
+		hllMerge(&new_view, &old_view);
+
+		this->entries[i].sketch = next++;
+	}
+
+	for (size_t i = 0; i < this->n_slabs; i++)
+		free(this->slabs[i]);
+
+	free(this->slabs);
+	free(this->free_sketches);
+
+	*this = folded;
+
+	return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file SlidingHyperLogLog.c
+ *
+ * Contains the implementations of the functions defined in SlidingHyperLogLog.h, as well as some static helper
+ * functions.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "../inc/SlidingHyperLogLog.h"
+
+/**
+ * Marks a node and all its ancestors as dirty.
+ */
+static void markDirty(struct SlidingHyperLogLog *this, size_t node)
+{
+	// if a node is dirty, all its ancestors are dirty too
+	while (node >= 1 && !this->dirty[node])
+	{
+		this->dirty[node] = 1;
+		node /= 2;
+	}
+}
+
+/**
+ * Recomputes a node from its children, if it's dirty.
+ */
+static void refresh(struct SlidingHyperLogLog *this, size_t node)
+{
+	if (node >= this->n_slots || !this->dirty[node])
+		return;
+
+	refresh(this, 2 * node);
+	refresh(this, 2 * node + 1);
+
+	hllClear(&this->nodes[node]);
+	hllMerge(&this->nodes[node], &this->nodes[2 * node]);
+	hllMerge(&this->nodes[node], &this->nodes[2 * node + 1]);
+
+	this->dirty[node] = 0;
+}
+
+/**
+ * Merges the slots at the ring positions `first` to `last` (inclusive) into `nodes[0]`.
+ */
+static void mergeRange(struct SlidingHyperLogLog *this, size_t first, size_t last)
+{
+	size_t left = first + this->n_slots;
+	size_t right = last + this->n_slots + 1;
+
+	while (left < right)
+	{
+		if (left & 1)
+		{
+			refresh(this, left);
+			hllMerge(&this->nodes[0], &this->nodes[left]);
+			left++;
+		}
+
+		if (right & 1)
+		{
+			right--;
+			refresh(this, right);
+			hllMerge(&this->nodes[0], &this->nodes[right]);
+		}
+
+		left /= 2;
+		right /= 2;
+	}
+}
+
+/**
+ * Moves the head to the slot `slot` and clears all slots in between.
+ */
+static void advance(struct SlidingHyperLogLog *this, uint64_t slot)
+{
+	if (slot <= this->head)
+		return;
+
+	uint64_t n_cleared = slot - this->head < this->n_slots ? slot - this->head : this->n_slots;
+
+	for (uint64_t i = 1; i <= n_cleared; i++)
+	{
+		size_t leaf = this->n_slots + (size_t)((this->head + i) % this->n_slots);
+
+		hllClear(&this->nodes[leaf]);
+		markDirty(this, leaf / 2);
+	}
+
+	this->head = slot;
+}
+
+int shllInit(struct SlidingHyperLogLog *this, unsigned char r, unsigned char b,
+	void (*hash)(const void *, size_t, void *), size_t n_slots, uint64_t slot_length)
+{
+	if (this == NULL)
+		return 1;
+
+	struct HyperLogLog test;
+	int status = hllInit(&test, r, b, hash);
+
+	if (status != 0)
+		return status;
+
+	hllFree(&test);
+
+	if (n_slots == 0 || n_slots > ((size_t)1 << (sizeof(size_t) * 8 - 2)))
+		return 5;
+
+	if (slot_length == 0)
+		return 6;
+
+	size_t n = 1;
+	while (n < n_slots)
+		n *= 2;
+
+	this->n_slots = n;
+	this->slot_length = slot_length;
+	this->head = 0;
+
+	this->nodes = calloc(2 * n, sizeof(struct HyperLogLog));
+	this->dirty = calloc(2 * n, sizeof(unsigned char));
+
+	if (this->nodes == NULL || this->dirty == NULL)
+	{
+		free(this->nodes);
+		free(this->dirty);
+		return -1;
+	}
+
+	for (size_t i = 0; i < 2 * n; i++)
+	{
+		if (hllInit(&this->nodes[i], r, b, hash) != 0)
+		{
+			while (i > 0)
+				hllFree(&this->nodes[--i]);
+
+			free(this->nodes);
+			free(this->dirty);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void shllFree(struct SlidingHyperLogLog *this)
+{
+	if (this == NULL)
+		return;
+
+	for (size_t i = 0; i < 2 * this->n_slots; i++)
+		hllFree(&this->nodes[i]);
+
+	free(this->nodes);
+	free(this->dirty);
+}
+
+void shllAdd(struct SlidingHyperLogLog *this, const void *item, uint64_t time)
+{
+	if (this == NULL)
+		return;
+
+	uint64_t slot = time / this->slot_length;
+
+	// too old
+	if (slot + this->n_slots <= this->head)
+		return;
+
+	advance(this, slot);
+
+	size_t leaf = this->n_slots + (size_t)(slot % this->n_slots);
+
+	hllAdd(&this->nodes[leaf], item);
+	markDirty(this, leaf / 2);
+}
+
+double shllCount(struct SlidingHyperLogLog *this, uint64_t now, uint64_t window)
+{
+	if (this == NULL)
+		return NAN;
+
+	uint64_t now_slot = now / this->slot_length;
+	uint64_t n_window_slots = window / this->slot_length + (window % this->slot_length != 0);
+
+	if (n_window_slots > this->n_slots)
+		n_window_slots = this->n_slots;
+
+	if (n_window_slots == 0)
+		return 0;
+
+	// the range of (absolute) slots that are inside the window and still in the ring
+	uint64_t first = now_slot + 1 >= n_window_slots ? now_slot + 1 - n_window_slots : 0;
+	uint64_t last = now_slot < this->head ? now_slot : this->head;
+
+	if (this->head + 1 > this->n_slots && first < this->head + 1 - this->n_slots)
+		first = this->head + 1 - this->n_slots;
+
+	if (first > last)
+		return 0;
+
+	hllClear(&this->nodes[0]);
+
+	if (last - first + 1 == this->n_slots)
+	{
+		refresh(this, 1);
+		hllMerge(&this->nodes[0], &this->nodes[1]);
+	}
+	else
+	{
+		size_t first_pos = (size_t)(first % this->n_slots);
+		size_t last_pos = (size_t)(last % this->n_slots);
+
+		if (first_pos <= last_pos)
+		{
+			mergeRange(this, first_pos, last_pos);
+		}
+		else
+		{
+			mergeRange(this, first_pos, this->n_slots - 1);
+			mergeRange(this, 0, last_pos);
+		}
+	}
+
+	return hllCount(&this->nodes[0]);
+}
@@ -0,0 +1,117 @@
+#include <catch.hpp>
+#include <random>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include "../inc/Allocator.h"
+}
+
+/**
+ * Always fails and counts its calls in the context (for testing custom allocators).
+ */
+static void *allocateFailing(void *context, size_t size)
+{
+	size_t *calls = (size_t *)context;
+
+	(*calls)++;
+	(void)size;
+
+	return NULL;
+}
+
+/**
+ * Allocates and frees blocks of different sizes.
+ */
+static void churn(struct Allocator *allocator, int seed)
+{
+	std::vector<std::pair<void *, size_t>> blocks;
+	std::minstd_rand random(seed);
+
+	for (int i = 0; i < 10000; i++)
+	{
+		if (blocks.empty() || random() % 2 == 0)
+		{
+			size_t size = random() % 100 + 1;
+			void *block = allocatorMalloc(allocator, size);
+
+			if (block != NULL)
+				blocks.emplace_back(block, size);
+		}
+		else
+		{
+			allocatorFree(allocator, blocks.back().first, blocks.back().second);
+			blocks.pop_back();
+		}
+	}
+
+	for (auto &block : blocks)
+		allocatorFree(allocator, block.first, block.second);
+}
+
+TEST_CASE("allocator", "[inc/Allocator.h/allocatorMalloc, inc/Allocator.h/allocatorFree]")
+{
+	struct Allocator allocator;
+
+	allocatorInit(NULL, 0);
+	allocatorInit(&allocator, 100);
+
+	REQUIRE(allocatorUsed(NULL) == 0);
+	REQUIRE(allocatorUsed(&allocator) == 0);
+
+	// without an allocator, the standard functions are used
+	void *block = allocatorCalloc(NULL, 10);
+	REQUIRE(block != NULL);
+	REQUIRE(((char *)block)[9] == 0);
+	allocatorFree(NULL, block, 10);
+	allocatorFree(&allocator, NULL, 10);
+
+	// the budget is enforced exactly
+	void *a = allocatorMalloc(&allocator, 60);
+	char *b = (char *)allocatorCalloc(&allocator, 40);
+
+	REQUIRE(a != NULL);
+	REQUIRE(b != NULL);
+	REQUIRE(b[0] == 0);
+	REQUIRE(b[39] == 0);
+	REQUIRE(allocator.used == 100);
+	REQUIRE(allocatorMalloc(&allocator, 1) == NULL);
+	REQUIRE(allocatorMalloc(&allocator, (size_t)-1) == NULL);
+	REQUIRE(allocator.failures == 2);
+
+	allocatorFree(&allocator, a, 60);
+	REQUIRE(allocatorUsed(&allocator) == 40);
+	REQUIRE(allocator.peak == 100);
+
+	a = allocatorMalloc(&allocator, 60);
+	REQUIRE(a != NULL);
+	allocatorFree(&allocator, a, 60);
+	allocatorFree(&allocator, b, 40);
+	REQUIRE(allocator.used == 0);
+
+	// failing allocations are not counted as used
+	size_t calls = 0;
+
+	allocator.allocate = &allocateFailing;
+	allocator.context = &calls;
+	REQUIRE(allocatorMalloc(&allocator, 10) == NULL);
+	REQUIRE(calls == 1);
+	REQUIRE(allocator.used == 0);
+	REQUIRE(allocator.failures == 3);
+
+	// several threads share a budget
+	std::vector<std::thread> threads;
+
+	allocatorInit(&allocator, 2000);
+
+	for (int i = 0; i < 4; i++)
+		threads.emplace_back(&churn, &allocator, i);
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	REQUIRE(allocator.used == 0);
+	REQUIRE(allocator.peak <= 2000);
+	REQUIRE(allocator.failures > 0);
+}
@@ -0,0 +1,340 @@
+#include <catch.hpp>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "../inc/AvlSet.hpp"
+
+/**
+ * Compares `std::string`s with each other and with C strings, without creating temporary strings.
+ */
+struct StringLess
+{
+	typedef void is_transparent;
+
+	bool operator()(const std::string &a, const std::string &b) const
+	{
+		return a < b;
+	}
+
+	bool operator()(const std::string &a, const char *b) const
+	{
+		return a.compare(b) < 0;
+	}
+
+	bool operator()(const char *a, const std::string &b) const
+	{
+		return b.compare(a) > 0;
+	}
+};
+
+/**
+ * Orders `std::unique_ptr<int>`s by the value they point to, and compares them with plain `int`s.
+ */
+struct PointeeLess
+{
+	typedef void is_transparent;
+
+	bool operator()(const std::unique_ptr<int> &a, const std::unique_ptr<int> &b) const
+	{
+		return *a < *b;
+	}
+
+	bool operator()(const std::unique_ptr<int> &a, int b) const
+	{
+		return *a < b;
+	}
+
+	bool operator()(int a, const std::unique_ptr<int> &b) const
+	{
+		return a < *b;
+	}
+};
+
+/**
+ * The bookkeeping of `CountingAllocator`, shared by all copies of an allocator.
+ */
+struct AllocatorStats
+{
+	size_t allocated;
+	size_t deallocated;
+};
+
+/**
+ * A stateful allocator, that counts its (de)allocations. Two allocators are only equal, if they share their stats, so
+ * the containers have to move items between them one by one.
+ */
+template <typename T>
+struct CountingAllocator
+{
+	typedef T value_type;
+
+	explicit CountingAllocator(AllocatorStats *stats) : stats(stats)
+	{
+	}
+
+	template <typename U>
+	CountingAllocator(const CountingAllocator<U> &other) : stats(other.stats)
+	{
+	}
+
+	T *allocate(size_t n)
+	{
+		stats->allocated += n;
+		return static_cast<T *>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T *p, size_t n)
+	{
+		stats->deallocated += n;
+		::operator delete(p);
+	}
+
+	AllocatorStats *stats;
+};
+
+template <typename T, typename U>
+static bool operator==(const CountingAllocator<T> &a, const CountingAllocator<U> &b)
+{
+	return a.stats == b.stats;
+}
+
+template <typename T, typename U>
+static bool operator!=(const CountingAllocator<T> &a, const CountingAllocator<U> &b)
+{
+	return a.stats != b.stats;
+}
+
+TEST_CASE("avl set insert, erase, find", "[inc/AvlSet.hpp/avl_set]")
+{
+	aud::avl_set<int> set;
+	std::set<int> expected;
+
+	REQUIRE(set.empty());
+	REQUIRE(set.begin() == set.end());
+	REQUIRE(set.find(1) == set.end());
+	REQUIRE(set.erase(1) == 0);
+
+	srand(7);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		int key = rand() % 2000;
+
+		if (rand() % 3 == 0)
+		{
+			REQUIRE(set.erase(key) == expected.erase(key));
+		}
+		else
+		{
+			std::pair<aud::avl_set<int>::iterator, bool> result = set.insert(key);
+
+			REQUIRE(result.second == expected.insert(key).second);
+			REQUIRE(*result.first == key);
+		}
+
+		REQUIRE(set.size() == expected.size());
+	}
+
+	REQUIRE(std::vector<int>(set.begin(), set.end()) == std::vector<int>(expected.begin(), expected.end()));
+	REQUIRE(std::vector<int>(set.rbegin(), set.rend()) == std::vector<int>(expected.rbegin(), expected.rend()));
+
+	for (int key = -1; key <= 2000; key++)
+	{
+		REQUIRE(set.count(key) == expected.count(key));
+		REQUIRE((set.find(key) == set.end()) == (expected.find(key) == expected.end()));
+
+		aud::avl_set<int>::iterator lower = set.lower_bound(key);
+		aud::avl_set<int>::iterator upper = set.upper_bound(key);
+
+		REQUIRE((lower == set.end() ? -1 : *lower) == (expected.lower_bound(key) == expected.end() ? -1 : *expected.lower_bound(key)));
+		REQUIRE((upper == set.end() ? -1 : *upper) == (expected.upper_bound(key) == expected.end() ? -1 : *expected.upper_bound(key)));
+	}
+
+	// erase ranges and single iterators
+	aud::avl_set<int>::iterator it = set.erase(set.lower_bound(100), set.lower_bound(200));
+	expected.erase(expected.lower_bound(100), expected.lower_bound(200));
+	REQUIRE(*it == *expected.lower_bound(200));
+
+	it = set.erase(set.begin());
+	expected.erase(expected.begin());
+	REQUIRE(*it == *expected.begin());
+	REQUIRE(*--set.end() == *expected.rbegin());
+	REQUIRE(std::vector<int>(set.begin(), set.end()) == std::vector<int>(expected.begin(), expected.end()));
+
+	set.clear();
+	REQUIRE(set.empty());
+	REQUIRE(set.begin() == set.end());
+
+	// initializer list and range constructors
+	aud::avl_set<int> list = {5, 3, 8, 3, 1};
+	std::vector<int> items = {1, 3, 5, 8};
+
+	REQUIRE(list.size() == 4);
+	REQUIRE(std::vector<int>(list.begin(), list.end()) == items);
+	REQUIRE(aud::avl_set<int>(items.rbegin(), items.rend()) == list);
+
+	aud::avl_set<int, std::greater<int>> descending(items.begin(), items.end());
+	REQUIRE(*descending.begin() == 8);
+}
+
+TEST_CASE("avl set copy, move, swap", "[inc/AvlSet.hpp/avl_set]")
+{
+	aud::avl_set<std::string> set = {"b", "a", "c", "d"};
+	aud::avl_set<std::string> copy(set);
+
+	REQUIRE(copy == set);
+	copy.erase("a");
+	REQUIRE(copy != set);
+	REQUIRE(set < copy);
+	REQUIRE(set.count("a") == 1);
+
+	aud::avl_set<std::string> moved(std::move(copy));
+	REQUIRE(moved.size() == 3);
+	REQUIRE(copy.empty());
+
+	copy = set;
+	REQUIRE(copy == set);
+	copy = std::move(moved);
+	REQUIRE(copy.size() == 3);
+	REQUIRE(*copy.begin() == "b");
+
+	swap(copy, set);
+	REQUIRE(set.size() == 3);
+	REQUIRE(copy.size() == 4);
+	REQUIRE(*--set.end() == "d");
+
+	copy = {"x", "y"};
+	REQUIRE(std::vector<std::string>(copy.begin(), copy.end()) == std::vector<std::string>({"x", "y"}));
+}
+
+TEST_CASE("avl set move-only and heterogeneous keys", "[inc/AvlSet.hpp/avl_set]")
+{
+	aud::avl_set<std::unique_ptr<int>, PointeeLess> pointers;
+
+	for (int i : {4, 2, 6, 2})
+		pointers.emplace(new int(i));
+
+	REQUIRE(pointers.size() == 3);
+	REQUIRE(pointers.contains(2));
+	REQUIRE_FALSE(pointers.contains(3));
+	REQUIRE(**pointers.find(6) == 6);
+	REQUIRE(**pointers.lower_bound(3) == 4);
+	REQUIRE(**pointers.upper_bound(4) == 6);
+	REQUIRE(pointers.count(4) == 1);
+
+	std::unique_ptr<int> five(new int(5));
+	REQUIRE(pointers.insert(std::move(five)).second);
+	REQUIRE(five == nullptr);
+
+	std::unique_ptr<int> other_five(new int(5));
+	REQUIRE_FALSE(pointers.insert(std::move(other_five)).second);
+	REQUIRE(other_five != nullptr);
+
+	aud::avl_set<std::unique_ptr<int>, PointeeLess> moved = std::move(pointers);
+	REQUIRE(moved.size() == 4);
+	REQUIRE(pointers.empty());
+
+	aud::avl_set<std::string, StringLess> strings = {"apple", "banana", "cherry"};
+	const char *banana = "banana";
+
+	REQUIRE(strings.find(banana) != strings.end());
+	REQUIRE(strings.find("durian") == strings.end());
+	REQUIRE(*strings.lower_bound("b") == "banana");
+	REQUIRE(strings.count("apple") == 1);
+	REQUIRE(std::distance(strings.equal_range("cherry").first, strings.equal_range("cherry").second) == 1);
+}
+
+TEST_CASE("avl map", "[inc/AvlSet.hpp/avl_map]")
+{
+	aud::avl_map<std::string, int> map;
+	std::map<std::string, int> expected;
+
+	srand(11);
+
+	for (int i = 0; i < 5000; i++)
+	{
+		std::string key = std::to_string(rand() % 500);
+
+		map[key] += i;
+		expected[key] += i;
+	}
+
+	REQUIRE(map.size() == expected.size());
+	REQUIRE(std::equal(map.begin(), map.end(), expected.begin()));
+
+	REQUIRE(map.at("42") == expected.at("42"));
+	REQUIRE_THROWS_AS(map.at("x"), std::out_of_range);
+
+	// try_emplace doesn't touch its arguments, if the key exists
+	aud::avl_map<int, std::unique_ptr<int>> owners;
+	std::unique_ptr<int> one(new int(1));
+	std::unique_ptr<int> two(new int(2));
+
+	REQUIRE(owners.try_emplace(1, std::move(one)).second);
+	REQUIRE(one == nullptr);
+	REQUIRE_FALSE(owners.try_emplace(1, std::move(two)).second);
+	REQUIRE(two != nullptr);
+	REQUIRE(*owners[1] == 1);
+
+	REQUIRE_FALSE(owners.insert_or_assign(1, std::move(two)).second);
+	REQUIRE(*owners.at(1) == 2);
+	REQUIRE(owners.insert_or_assign(3, std::unique_ptr<int>(new int(3))).second);
+
+	// items are mutable through iterators
+	for (aud::avl_map<int, std::unique_ptr<int>>::iterator it = owners.begin(); it != owners.end(); ++it)
+		*it->second *= 10;
+
+	REQUIRE(*owners[3] == 30);
+	REQUIRE(owners[4] == nullptr);
+	REQUIRE(owners.size() == 3);
+
+	aud::avl_map<int, std::unique_ptr<int>>::const_iterator found = owners.find(4);
+	owners.erase(found);
+	REQUIRE_FALSE(owners.contains(4));
+	REQUIRE(owners.value_comp()(*owners.begin(), *++owners.begin()));
+}
+
+TEST_CASE("avl set allocators", "[inc/AvlSet.hpp/avl_set]")
+{
+	typedef aud::avl_set<int, std::less<int>, CountingAllocator<int>> Set;
+	AllocatorStats a = {0, 0};
+	AllocatorStats b = {0, 0};
+
+	{
+		Set set{CountingAllocator<int>(&a)};
+
+		for (int i = 0; i < 100; i++)
+			set.insert(i);
+
+		set.emplace(5);
+		REQUIRE(a.allocated == 101);
+		REQUIRE(a.deallocated == 1);
+		REQUIRE(set.get_allocator() == CountingAllocator<int>(&a));
+
+		// copies keep the allocator
+		Set copy(set);
+		REQUIRE(a.allocated == 201);
+
+		// same allocator: the nodes are taken over
+		Set moved(std::move(copy), CountingAllocator<int>(&a));
+		REQUIRE(a.allocated == 201);
+		REQUIRE(moved.size() == 100);
+
+		// different allocator: the items are moved one by one
+		Set other(std::move(moved), CountingAllocator<int>(&b));
+		REQUIRE(b.allocated == 100);
+		REQUIRE(a.deallocated == 101);
+		REQUIRE(other == set);
+
+		Set assigned{CountingAllocator<int>(&b)};
+		assigned = set;
+		REQUIRE(assigned.get_allocator() == CountingAllocator<int>(&b));
+		REQUIRE(b.allocated == 200);
+	}
+
+	REQUIRE(a.allocated == a.deallocated);
+	REQUIRE(b.allocated == b.deallocated);
+}
@@ -0,0 +1,184 @@
+#include <catch.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C"
+{
+#include <stdint.h>
+#include "../inc/AvlSnapshot.h"
+}
+
+static int compareU64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int compareBytes(const void *a, const void *b)
+{
+	const struct AvlBytes *x = (const struct AvlBytes *)a;
+	const struct AvlBytes *y = (const struct AvlBytes *)b;
+
+	int comp = memcmp(x->data, y->data, x->length < y->length ? x->length : y->length);
+
+	if (comp != 0)
+		return comp;
+	else
+		return x->length < y->length ? -1 : x->length > y->length;
+}
+
+static struct AvlBytes *makeBytes(const char *string)
+{
+	size_t length = strlen(string);
+	struct AvlBytes *bytes = (struct AvlBytes *)malloc(sizeof(struct AvlBytes) + length);
+
+	bytes->length = (uint32_t)length;
+	memcpy(bytes->data, string, length);
+
+	return bytes;
+}
+
+TEST_CASE("avl snapshot", "[inc/AvlSnapshot.h]")
+{
+	const char *path = "avl_snapshot_test.bin";
+	struct AvlTree tree;
+	struct AvlTree loaded;
+	struct AvlSnapshot snapshot;
+
+	REQUIRE(avlSnapshotWrite(NULL, path, 8) == 1);
+	REQUIRE(avlSnapshotOpen(NULL, path) == 1);
+	REQUIRE(avlSnapshotOpen(&snapshot, "does/not/exist") == 2);
+	REQUIRE(avlSnapshotLoad(NULL, &tree) == 1);
+	REQUIRE_NOTHROW(avlSnapshotClose(NULL));
+
+	SECTION("fixed size keys")
+	{
+		uint64_t keys[1000];
+
+		avlInit(&tree, &compareU64);
+		for (int i = 0; i < 1000; i++)
+		{
+			keys[i] = (uint64_t)i * 7919 % 1000 * 3;
+			REQUIRE(avlInsert(&tree, &keys[i]));
+		}
+
+		REQUIRE(avlSnapshotWrite(&tree, NULL, 8) == 2);
+		REQUIRE(avlSnapshotWrite(&tree, path, 8) == 0);
+		avlFree(&tree);
+
+		REQUIRE(avlSnapshotOpen(&snapshot, path) == 0);
+		REQUIRE(snapshot.count == 1000);
+		REQUIRE(snapshot.key_size == 8);
+
+		avlInit(&loaded, &compareU64);
+		REQUIRE(avlSnapshotLoad(&snapshot, &loaded) == 0);
+		REQUIRE(avlSnapshotLoad(&snapshot, &loaded) == 2);
+		REQUIRE(loaded.count == 1000);
+
+		for (uint64_t i = 0; i < 3000; i++)
+		{
+			REQUIRE(avlContains(&loaded, &i) == (i % 3 == 0));
+			REQUIRE(avlSnapshotContains(&snapshot, &i, &compareU64) == (i % 3 == 0));
+		}
+
+		avlFree(&loaded);
+		avlSnapshotClose(&snapshot);
+	}
+
+	SECTION("length-prefixed keys")
+	{
+		const char *strings[] = {"banana", "apple", "", "cherry", "a", "apples", "kiwi"};
+		struct AvlBytes *keys[7];
+
+		avlInit(&tree, &compareBytes);
+		for (int i = 0; i < 7; i++)
+		{
+			keys[i] = makeBytes(strings[i]);
+			REQUIRE(avlInsert(&tree, keys[i]));
+		}
+
+		REQUIRE(avlSnapshotWrite(&tree, path, 0) == 0);
+		avlFree(&tree);
+
+		REQUIRE(avlSnapshotOpen(&snapshot, path) == 0);
+		REQUIRE(snapshot.count == 7);
+
+		avlInit(&loaded, &compareBytes);
+		REQUIRE(avlSnapshotLoad(&snapshot, &loaded) == 0);
+
+		for (int i = 0; i < 7; i++)
+		{
+			REQUIRE(avlContains(&loaded, keys[i]));
+			REQUIRE(avlSnapshotContains(&snapshot, keys[i], &compareBytes));
+			free(keys[i]);
+		}
+
+		struct AvlBytes *missing = makeBytes("appl");
+		REQUIRE_FALSE(avlContains(&loaded, missing));
+		REQUIRE_FALSE(avlSnapshotContains(&snapshot, missing, &compareBytes));
+		free(missing);
+
+		avlFree(&loaded);
+		avlSnapshotClose(&snapshot);
+	}
+
+	SECTION("corrupted file")
+	{
+		uint64_t keys[10];
+
+		avlInit(&tree, &compareU64);
+		for (int i = 0; i < 10; i++)
+		{
+			keys[i] = i;
+			avlInsert(&tree, &keys[i]);
+		}
+
+		REQUIRE(avlSnapshotWrite(&tree, path, 8) == 0);
+		avlFree(&tree);
+
+		// flip a bit in the payload
+		FILE *file = fopen(path, "r+b");
+		fseek(file, 64 + 17, SEEK_SET);
+		int c = fgetc(file);
+		fseek(file, 64 + 17, SEEK_SET);
+		fputc(c ^ 4, file);
+		fclose(file);
+
+		REQUIRE(avlSnapshotOpen(&snapshot, path) == 4);
+		REQUIRE(snapshot.map == NULL);
+
+		// truncate the file
+		file = fopen(path, "wb");
+		fputs("AUDAVLS", file);
+		fclose(file);
+
+		REQUIRE(avlSnapshotOpen(&snapshot, path) == 3);
+
+		// a payload of length-prefixed keys, that isn't padded to a multiple of 8 bytes
+		struct AvlBytes *key = makeBytes("key");
+		uint64_t payload_size;
+
+		avlInit(&tree, &compareBytes);
+		avlInsert(&tree, key);
+		REQUIRE(avlSnapshotWrite(&tree, path, 0) == 0);
+		avlFree(&tree);
+		free(key);
+
+		file = fopen(path, "r+b");
+		fseek(file, 24, SEEK_SET);
+		REQUIRE(fread(&payload_size, sizeof(payload_size), 1, file) == 1);
+		payload_size += 4;
+		fseek(file, 24, SEEK_SET);
+		fwrite(&payload_size, sizeof(payload_size), 1, file);
+		fseek(file, 0, SEEK_END);
+		fwrite("\0\0\0\0", 1, 4, file);
+		fclose(file);
+
+		REQUIRE(avlSnapshotOpen(&snapshot, path) == 3);
+	}
+
+	remove(path);
+}
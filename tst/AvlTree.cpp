@@ -1,4 +1,9 @@
 #include <catch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <vector>
 
 extern "C"
 {
@@ -47,3 +52,858 @@ TEST_CASE("avl tree contains, delete, insert, is empty", "[inc/AvlTree.h/avlCont
 
 	avlFree(&tree);
 }
+
+TEST_CASE("avl build", "[inc/AvlTree.h/avlBuild]")
+{
+	struct AvlTree tree;
+	void *items[100];
+
+	for (int i = 0; i < 100; i++)
+		items[i] = (void*)(ptrdiff_t)(2 * i);
+
+	REQUIRE_FALSE(avlBuild(NULL, items, 100));
+
+	avlInit(&tree, &compare);
+	REQUIRE_FALSE(avlBuild(&tree, NULL, 100));
+	REQUIRE(avlBuild(&tree, items, 100));
+	REQUIRE(tree.count == 100);
+	REQUIRE_FALSE(avlBuild(&tree, items, 100));
+
+	for (int i = 0; i < 200; i++)
+		REQUIRE(avlContains(&tree, (void*)(ptrdiff_t)i) == (i % 2 == 0));
+
+	// the tree has to stay balanced after inserting more items
+	for (int i = 0; i < 100; i++)
+		REQUIRE(avlInsert(&tree, (void*)(ptrdiff_t)(2 * i + 1)));
+
+	for (int i = 0; i < 200; i++)
+		REQUIRE(avlContains(&tree, (void*)(ptrdiff_t)i));
+
+	avlFree(&tree);
+}
+
+TEST_CASE("avl stats", "[inc/AvlTree.h/avlStats]")
+{
+	struct AvlTree tree;
+	struct AvlStats stats;
+
+	REQUIRE_FALSE(avlStats(NULL, &stats));
+
+	avlInit(&tree, &compare);
+	REQUIRE_FALSE(avlStats(&tree, NULL));
+
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.count == 0);
+	REQUIRE(stats.height == 0);
+	REQUIRE(stats.average_depth == 0);
+
+	// inserting 2^k - 1 sorted items results in a perfect tree
+	for (int i = 0; i < 127; i++)
+		avlInsert(&tree, (void*)(ptrdiff_t)i);
+
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.count == 127);
+	REQUIRE(stats.height == 7);
+	REQUIRE(stats.average_depth == Approx((0 * 1 + 1 * 2 + 2 * 4 + 3 * 8 + 4 * 16 + 5 * 32 + 6 * 64) / 127.0));
+	REQUIRE(stats.memory >= 127 * sizeof(struct AvlNode));
+
+	// the counters are either disabled, or they have recorded something
+	REQUIRE((stats.counters.allocations == 0 || stats.counters.allocations == 127));
+	REQUIRE(stats.counters.rotations_left <= 127);
+	REQUIRE(stats.counters.rotations_right == 0);
+
+	avlFree(&tree);
+}
+
+/**
+ * Checks the links, the order and the balance factors of a subtree.
+ *
+ * @return The height of the subtree.
+ */
+static int checkSubtree(const struct AvlTree *tree, const struct AvlNode *node)
+{
+	if (node == NULL)
+		return 0;
+
+	if (node->left != NULL)
+	{
+		REQUIRE(node->left->parent == node);
+		REQUIRE(tree->compare(node->left->value, node->value) < 0);
+	}
+
+	if (node->right != NULL)
+	{
+		REQUIRE(node->right->parent == node);
+		REQUIRE(tree->compare(node->right->value, node->value) > 0);
+	}
+
+	int left_height = checkSubtree(tree, node->left);
+	int right_height = checkSubtree(tree, node->right);
+
+	REQUIRE(node->balance == right_height - left_height);
+	REQUIRE(abs(node->balance) <= 1);
+
+	return 1 + std::max(left_height, right_height);
+}
+
+TEST_CASE("avl rotations", "[inc/AvlTree.h/avlInsert]")
+{
+	struct AvlTree tree;
+	struct AvlStats stats;
+	const size_t n = 100000;
+
+	// random insertions need all four rotation cases, that used to leave wrong balance factors behind
+	avlInit(&tree, &compare);
+	srand(7);
+
+	while (tree.count < n)
+		avlInsert(&tree, (void*)(ptrdiff_t)(((size_t)rand() << 16) ^ (size_t)rand()));
+
+	int height = checkSubtree(&tree, tree.root);
+
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.height == (size_t)height);
+	REQUIRE(height <= 1.45 * std::log2(n + 2));
+
+	avlFree(&tree);
+}
+
+TEST_CASE("avl delete", "[inc/AvlTree.h/avlDelete]")
+{
+	struct AvlTree tree;
+	std::set<ptrdiff_t> reference;
+
+	REQUIRE_FALSE(avlDelete(NULL, (void*)1));
+
+	avlInit(&tree, &compare);
+	REQUIRE_FALSE(avlDelete(&tree, (void*)1));
+
+	srand(42);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		ptrdiff_t item = rand() % 1000;
+
+		if (rand() % 2)
+			REQUIRE(avlInsert(&tree, (void*)item) == reference.insert(item).second);
+		else
+			REQUIRE(avlDelete(&tree, (void*)item) == (int)reference.erase(item));
+
+		if (i % 1000 == 0)
+			checkSubtree(&tree, tree.root);
+	}
+
+	checkSubtree(&tree, tree.root);
+	REQUIRE(tree.count == reference.size());
+
+	for (ptrdiff_t item = 0; item < 1000; item++)
+		REQUIRE(avlContains(&tree, (void*)item) == (int)reference.count(item));
+
+	for (ptrdiff_t item : reference)
+		REQUIRE(avlDelete(&tree, (void*)item));
+
+	REQUIRE(avlIsEmpty(&tree));
+	REQUIRE(tree.count == 0);
+
+	avlFree(&tree);
+}
+
+struct Interval
+{
+	long low;
+	long high;
+};
+
+static const void *intervalLow(const void *item)
+{
+	return &((const struct Interval *)item)->low;
+}
+
+static const void *intervalHigh(const void *item)
+{
+	return &((const struct Interval *)item)->high;
+}
+
+static int compareEndpoints(const void *a, const void *b)
+{
+	long x = *(const long *)a;
+	long y = *(const long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int compareIntervals(const void *a, const void *b)
+{
+	const struct Interval *x = (const struct Interval *)a;
+	const struct Interval *y = (const struct Interval *)b;
+
+	if (x->low != y->low)
+		return x->low < y->low ? -1 : 1;
+	if (x->high != y->high)
+		return x->high < y->high ? -1 : 1;
+
+	return x < y ? -1 : x > y;
+}
+
+static const struct AvlIntervalType INTERVAL_TYPE = {&intervalLow, &intervalHigh, &compareEndpoints};
+
+static void collectInterval(void *item, void *context)
+{
+	((std::vector<struct Interval *> *)context)->push_back((struct Interval *)item);
+}
+
+/**
+ * Checks `avlOverlap()` against a linear scan of `intervals`.
+ */
+static void checkOverlap(struct AvlTree *tree, const std::vector<struct Interval *> &intervals, long low, long high)
+{
+	std::vector<struct Interval *> found, expected;
+
+	for (struct Interval *interval : intervals)
+	{
+		if (interval->low <= high && interval->high >= low)
+			expected.push_back(interval);
+	}
+
+	std::sort(expected.begin(), expected.end(), [](struct Interval *a, struct Interval *b)
+	{
+		return compareIntervals(a, b) < 0;
+	});
+
+	REQUIRE(avlOverlap(tree, &low, &high, &collectInterval, &found) == expected.size());
+	REQUIRE(found == expected);
+}
+
+TEST_CASE("avl interval", "[inc/AvlTree.h/avlInitInterval, inc/AvlTree.h/avlStab, inc/AvlTree.h/avlOverlap]")
+{
+	struct AvlTree tree;
+	std::vector<struct Interval> storage(3000);
+	std::vector<struct Interval *> intervals;
+	long point = 5;
+
+	REQUIRE_NOTHROW(avlInitInterval(NULL, &compareIntervals, &INTERVAL_TYPE));
+	REQUIRE(avlStab(NULL, &point, NULL, NULL) == 0);
+
+	// not in interval mode
+	avlInit(&tree, &compareIntervals);
+	REQUIRE(avlStab(&tree, &point, NULL, NULL) == 0);
+	avlFree(&tree);
+
+	avlInitInterval(&tree, &compareIntervals, &INTERVAL_TYPE);
+	REQUIRE(avlStab(&tree, &point, NULL, NULL) == 0);
+
+	srand(7);
+
+	for (struct Interval &interval : storage)
+	{
+		interval.low = rand() % 10000;
+		interval.high = interval.low + (rand() % 8 == 0 ? rand() % 5000 : rand() % 50);
+
+		REQUIRE(avlInsert(&tree, &interval));
+		intervals.push_back(&interval);
+	}
+
+	checkSubtree(&tree, tree.root);
+
+	for (int i = 0; i < 200; i++)
+	{
+		long low = rand() % 11000 - 500;
+		checkOverlap(&tree, intervals, low, low + (i % 2 ? 0 : rand() % 300));
+	}
+
+	// deleting intervals keeps the cached endpoints correct
+	std::random_shuffle(intervals.begin(), intervals.end());
+
+	while (intervals.size() > 1000)
+	{
+		REQUIRE(avlDelete(&tree, intervals.back()));
+		intervals.pop_back();
+	}
+
+	checkSubtree(&tree, tree.root);
+
+	for (int i = 0; i < 200; i++)
+	{
+		long low = rand() % 11000 - 500;
+		checkOverlap(&tree, intervals, low, low + (i % 2 ? 0 : rand() % 300));
+	}
+
+	// stabbing is overlapping with a single point
+	std::vector<struct Interval *> found;
+	point = intervals[0]->low;
+
+	REQUIRE(avlStab(&tree, &point, &collectInterval, &found) == avlOverlap(&tree, &point, &point, NULL, NULL));
+	REQUIRE(std::find(found.begin(), found.end(), intervals[0]) != found.end());
+
+	avlFree(&tree);
+
+	// trees built in linear time support queries, too
+	std::sort(intervals.begin(), intervals.end(), [](struct Interval *a, struct Interval *b)
+	{
+		return compareIntervals(a, b) < 0;
+	});
+
+	avlInitInterval(&tree, &compareIntervals, &INTERVAL_TYPE);
+	REQUIRE(avlBuild(&tree, (void **)intervals.data(), intervals.size()));
+
+	for (int i = 0; i < 50; i++)
+	{
+		long low = rand() % 11000 - 500;
+		checkOverlap(&tree, intervals, low, low + rand() % 300);
+	}
+
+	avlFree(&tree);
+}
+
+TEST_CASE("avl relaxed", "[inc/AvlTree.h/avlRelax, inc/AvlTree.h/avlRebalance]")
+{
+	struct AvlTree tree, intervals;
+	struct AvlStats stats;
+	std::set<ptrdiff_t> reference;
+	const int n = 20000;
+
+	REQUIRE_FALSE(avlRelax(NULL, 0));
+	REQUIRE_FALSE(avlRebalance(NULL));
+
+	avlInitInterval(&intervals, &compare, &INTERVAL_TYPE);
+	REQUIRE_FALSE(avlRelax(&intervals, 0));
+	avlFree(&intervals);
+
+	// sorted items become a list, until the tree is rebalanced
+	avlInit(&tree, &compare);
+	REQUIRE(avlRebalance(&tree));
+	REQUIRE(avlRelax(&tree, 0));
+
+	for (ptrdiff_t item = 0; item < n; item++)
+		REQUIRE(avlInsert(&tree, (void*)item));
+
+	REQUIRE_FALSE(avlInsert(&tree, (void*)(ptrdiff_t)(n / 2)));
+	REQUIRE(avlContains(&tree, (void*)(ptrdiff_t)(n - 1)));
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.height == n);
+
+	REQUIRE(avlRebalance(&tree));
+	REQUIRE_FALSE(tree.relaxed);
+	REQUIRE(checkSubtree(&tree, tree.root) <= 1.44 * log2(n));
+	REQUIRE(tree.count == n);
+
+	for (ptrdiff_t item = 0; item < n; item++)
+		REQUIRE(avlContains(&tree, (void*)item));
+
+	// unbalanced trees are freed without recursion
+	avlFree(&tree);
+	avlInit(&tree, &compare);
+	REQUIRE(avlRelax(&tree, 0));
+
+	for (ptrdiff_t item = n; item > 0; item--)
+		REQUIRE(avlInsert(&tree, (void*)item));
+
+	avlFree(&tree);
+
+	// bursts of random items into a balanced tree, with deletions in between
+	avlInit(&tree, &compare);
+	srand(7);
+
+	for (int burst = 0; burst < 10; burst++)
+	{
+		REQUIRE(avlRelax(&tree, 0));
+
+		for (int i = 0; i < 2000; i++)
+		{
+			ptrdiff_t item = rand() % 10000;
+			REQUIRE(avlInsert(&tree, (void*)item) == reference.insert(item).second);
+		}
+
+		// deleting rebalances the tree first, and keeps it in relaxed mode
+		ptrdiff_t item = *reference.lower_bound(rand() % 5000);
+		REQUIRE(avlDelete(&tree, (void*)item));
+		reference.erase(item);
+		REQUIRE(tree.relaxed);
+		checkSubtree(&tree, tree.root);
+
+		for (int i = 0; i < 100; i++)
+		{
+			item = rand() % 10000;
+			REQUIRE(avlInsert(&tree, (void*)item) == reference.insert(item).second);
+		}
+
+		REQUIRE(avlRebalance(&tree));
+		checkSubtree(&tree, tree.root);
+		REQUIRE(tree.count == reference.size());
+	}
+
+	for (ptrdiff_t item = 0; item < 10000; item++)
+		REQUIRE(avlContains(&tree, (void*)item) == (int)reference.count(item));
+
+	avlFree(&tree);
+
+	// the height bound triggers a rebalance
+	avlInit(&tree, &compare);
+	REQUIRE(avlRelax(&tree, 40));
+
+	for (ptrdiff_t item = 0; item < n; item++)
+	{
+		REQUIRE(avlInsert(&tree, (void*)item));
+
+		if (item % 1000 == 0)
+		{
+			REQUIRE(avlStats(&tree, &stats));
+			REQUIRE(stats.height <= 40);
+		}
+	}
+
+	REQUIRE(tree.relaxed);
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.height <= 40);
+
+	REQUIRE(avlRebalance(&tree));
+	checkSubtree(&tree, tree.root);
+
+	avlFree(&tree);
+}
+
+TEST_CASE("avl min max", "[inc/AvlTree.h/avlMin, inc/AvlTree.h/avlMax, inc/AvlTree.h/avlPopMin, inc/AvlTree.h/avlPopMax]")
+{
+	struct AvlTree tree;
+	std::set<ptrdiff_t> reference;
+	std::vector<void*> items;
+
+	REQUIRE(avlMin(NULL) == NULL);
+	REQUIRE(avlMax(NULL) == NULL);
+	REQUIRE(avlPopMin(NULL) == NULL);
+	REQUIRE(avlPopMax(NULL) == NULL);
+
+	avlInit(&tree, &compare);
+	REQUIRE(avlMin(&tree) == NULL);
+	REQUIRE(avlMax(&tree) == NULL);
+	REQUIRE(avlPopMin(&tree) == NULL);
+	REQUIRE(avlPopMax(&tree) == NULL);
+
+	// random insertions and deletions
+	srand(11);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		ptrdiff_t item = rand() % 2000 + 1;
+
+		if (rand() % 3 == 0)
+			REQUIRE(avlDelete(&tree, (void*)item) == (int)reference.erase(item));
+		else
+			REQUIRE(avlInsert(&tree, (void*)item) == reference.insert(item).second);
+
+		if (reference.empty())
+		{
+			REQUIRE(tree.min == NULL);
+			REQUIRE(tree.max == NULL);
+		}
+		else
+		{
+			REQUIRE(avlMin(&tree) == (void*)*reference.begin());
+			REQUIRE(avlMax(&tree) == (void*)*reference.rbegin());
+		}
+	}
+
+	// popping from both ends
+	while (!reference.empty())
+	{
+		ptrdiff_t item = rand() % 2 ? *reference.begin() : *reference.rbegin();
+
+		REQUIRE((item == *reference.begin() ? avlPopMin(&tree) : avlPopMax(&tree)) == (void*)item);
+		reference.erase(item);
+		REQUIRE(tree.count == reference.size());
+	}
+
+	REQUIRE(avlIsEmpty(&tree));
+	REQUIRE(tree.root == NULL);
+	REQUIRE(tree.min == NULL);
+	REQUIRE(tree.max == NULL);
+
+	// a priority queue with reinsertions, that stays balanced (the items are `deadline * 1024 + id`)
+	for (ptrdiff_t item = 1; item <= 1000; item++)
+		REQUIRE(avlInsert(&tree, (void*)item));
+
+	for (int i = 0; i < 10000; i++)
+	{
+		ptrdiff_t item = (ptrdiff_t)avlPopMin(&tree);
+
+		REQUIRE(item < (ptrdiff_t)avlMin(&tree));
+		REQUIRE(avlInsert(&tree, (void*)(item + (1 + rand() % 50) * 1024)));
+	}
+
+	REQUIRE(tree.count == 1000);
+	checkSubtree(&tree, tree.root);
+	avlFree(&tree);
+
+	// built trees
+	for (ptrdiff_t item = 1; item <= 100; item++)
+		items.push_back((void*)item);
+
+	avlInit(&tree, &compare);
+	REQUIRE(avlBuild(&tree, items.data(), items.size()));
+	REQUIRE(avlMin(&tree) == (void*)1);
+	REQUIRE(avlMax(&tree) == (void*)100);
+	REQUIRE(avlPopMax(&tree) == (void*)100);
+	REQUIRE(avlMax(&tree) == (void*)99);
+	avlFree(&tree);
+
+	// relaxed mode
+	avlInit(&tree, &compare);
+	REQUIRE(avlRelax(&tree, 0));
+
+	for (ptrdiff_t item = 500; item > 0; item--)
+		REQUIRE(avlInsert(&tree, (void*)item));
+
+	REQUIRE(avlMin(&tree) == (void*)1);
+	REQUIRE(avlMax(&tree) == (void*)500);
+	REQUIRE(avlPopMin(&tree) == (void*)1);
+	REQUIRE(avlMin(&tree) == (void*)2);
+	REQUIRE(avlInsert(&tree, (void*)(ptrdiff_t)501));
+	REQUIRE(avlMax(&tree) == (void*)501);
+	REQUIRE(avlRebalance(&tree));
+	REQUIRE(avlMin(&tree) == (void*)2);
+	REQUIRE(avlMax(&tree) == (void*)501);
+	checkSubtree(&tree, tree.root);
+
+	avlFree(&tree);
+}
+
+static size_t hashItem(const void *item)
+{
+	size_t x = (size_t)item;
+
+	x ^= x >> 16;
+	x *= 0x45D9F3B;
+	return x ^ (x >> 16);
+}
+
+static size_t hashConstant(const void *)
+{
+	return 0;
+}
+
+TEST_CASE("avl cache", "[inc/AvlTree.h/avlCache]")
+{
+	struct AvlTree tree;
+	struct AvlStats stats, cached_stats;
+	std::set<ptrdiff_t> reference;
+
+	REQUIRE_FALSE(avlCache(NULL, 16, &hashItem));
+
+	avlInit(&tree, &compare);
+	REQUIRE_FALSE(avlCache(&tree, 12, &hashItem));
+	REQUIRE_FALSE(avlCache(&tree, 16, NULL));
+	REQUIRE(tree.cache == NULL);
+
+	for (ptrdiff_t item = 0; item < 1000; item++)
+		avlInsert(&tree, (void*)item);
+
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(avlCache(&tree, 64, &hashItem));
+	REQUIRE(avlStats(&tree, &cached_stats));
+	REQUIRE(cached_stats.memory == stats.memory + 64 * sizeof(struct AvlCacheSlot));
+
+	// repeated lookups are cached, and removed items are not found anymore
+	REQUIRE(avlContains(&tree, (void*)7));
+	REQUIRE(avlContains(&tree, (void*)7));
+	REQUIRE(tree.cache[hashItem((void*)7) & tree.cache_mask].value == (void*)7);
+	REQUIRE(avlDelete(&tree, (void*)7));
+	REQUIRE_FALSE(avlContains(&tree, (void*)7));
+	REQUIRE_FALSE(avlContains(&tree, (void*)1000));
+
+	REQUIRE(avlContains(&tree, (void*)0));
+	REQUIRE(avlPopMin(&tree) == (void*)0);
+	REQUIRE_FALSE(avlContains(&tree, (void*)0));
+
+	REQUIRE(avlCache(&tree, 0, NULL));
+	REQUIRE(tree.cache == NULL);
+	REQUIRE_FALSE(avlContains(&tree, (void*)7));
+	REQUIRE(avlContains(&tree, (void*)8));
+	avlFree(&tree);
+
+	// random operations with a tiny cache, and with a cache where all items collide
+	for (size_t (*hash)(const void *) : {&hashItem, &hashConstant})
+	{
+		avlInit(&tree, &compare);
+		REQUIRE(avlCache(&tree, 8, hash));
+		size_t lookups = 0;
+
+		reference.clear();
+		srand(13);
+
+		for (int i = 0; i < 50000; i++)
+		{
+			ptrdiff_t item = rand() % 100;
+
+			switch (rand() % 4)
+			{
+				case 0:
+					REQUIRE(avlInsert(&tree, (void*)item) == reference.insert(item).second);
+					break;
+				case 1:
+					REQUIRE(avlDelete(&tree, (void*)item) == (int)reference.erase(item));
+					break;
+				default:
+					// skewed lookups
+					item = item % 10;
+					lookups++;
+					REQUIRE(avlContains(&tree, (void*)item) == (int)reference.count(item));
+			}
+		}
+
+		// the counters are either disabled, or they have counted every lookup
+		REQUIRE(avlStats(&tree, &stats));
+		REQUIRE((stats.counters.cache_hits + stats.counters.cache_misses == 0 ||
+			stats.counters.cache_hits + stats.counters.cache_misses == lookups));
+		REQUIRE((stats.counters.cache_misses == 0 || stats.counters.cache_hits > 0));
+
+		avlFree(&tree);
+	}
+}
+
+TEST_CASE("avl allocator", "[inc/AvlTree.h/avlSetAllocator, inc/AvlTree.h/avlMemory]")
+{
+	struct AvlTree tree;
+	struct AvlStats stats;
+	struct Allocator allocator;
+	const size_t node_size = sizeof(struct AvlNode);
+
+	REQUIRE_FALSE(avlSetAllocator(NULL, NULL));
+	REQUIRE(avlMemory(NULL) == 0);
+
+	avlInit(&tree, &compare);
+	allocatorInit(&allocator, 100 * node_size);
+	REQUIRE(avlSetAllocator(&tree, &allocator));
+	REQUIRE(avlMemory(&tree) == sizeof(struct AvlTree));
+
+	// the budget suffices for exactly 100 nodes, and a refused insert leaves the tree unchanged
+	for (ptrdiff_t item = 0; item < 100; item++)
+		REQUIRE(avlInsert(&tree, (void*)item));
+
+	REQUIRE_FALSE(avlInsert(&tree, (void*)100));
+	REQUIRE_FALSE(avlContains(&tree, (void*)100));
+	REQUIRE(allocator.failures == 1);
+	REQUIRE(allocator.used == 100 * node_size);
+	REQUIRE(avlMemory(&tree) == sizeof(struct AvlTree) + 100 * node_size);
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.memory == avlMemory(&tree));
+	REQUIRE((stats.counters.allocations == 0 || stats.counters.allocations == 100));
+	REQUIRE(checkSubtree(&tree, tree.root) >= 0);
+
+	// the allocator can't be replaced anymore
+	REQUIRE_FALSE(avlSetAllocator(&tree, NULL));
+
+	// neither does a cache, that doesn't fit into the budget, but freed nodes make room again
+	REQUIRE_FALSE(avlCache(&tree, 16, &hashItem));
+	REQUIRE(tree.cache == NULL);
+	REQUIRE(avlDelete(&tree, (void*)5));
+	REQUIRE(avlPopMin(&tree) == (void*)0);
+	REQUIRE(avlPopMax(&tree) == (void*)99);
+	REQUIRE(avlInsert(&tree, (void*)100));
+
+	allocator.limit = 0;
+	REQUIRE(avlCache(&tree, 16, &hashItem));
+	REQUIRE(allocator.used == 98 * node_size + 16 * sizeof(struct AvlCacheSlot));
+	REQUIRE(avlMemory(&tree) == sizeof(struct AvlTree) + allocator.used);
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.memory == avlMemory(&tree));
+
+	avlFree(&tree);
+	REQUIRE(allocator.used == 0);
+	REQUIRE(allocator.peak == 98 * node_size + 16 * sizeof(struct AvlCacheSlot));
+
+	// several trees share an allocator
+	struct AvlTree trees[3];
+
+	for (struct AvlTree &t : trees)
+	{
+		avlInit(&t, &compare);
+		REQUIRE(avlSetAllocator(&t, &allocator));
+
+		for (ptrdiff_t item = 0; item < 50; item++)
+			avlInsert(&t, (void*)item);
+	}
+
+	REQUIRE(allocator.used == 150 * node_size);
+
+	for (struct AvlTree &t : trees)
+		avlFree(&t);
+
+	REQUIRE(allocator.used == 0);
+
+	// nodes owned by the caller aren't counted
+	struct AvlNode node;
+
+	avlInit(&tree, &compare);
+	node.value = (void*)1;
+	REQUIRE(avlLinkNode(&tree, &node, NULL, 0));
+	REQUIRE(avlStats(&tree, &stats));
+	REQUIRE(stats.count == 1);
+	REQUIRE(stats.memory == sizeof(struct AvlTree));
+	REQUIRE(avlMemory(&tree) == stats.memory);
+	REQUIRE(avlUnlinkNode(&tree, &node));
+}
+
+/**
+ * Checks, that a tree is balanced and contains exactly the items of a reference set.
+ */
+static void checkBatch(struct AvlTree *tree, const std::set<ptrdiff_t> &reference)
+{
+	REQUIRE(checkSubtree(tree, tree->root) >= 0);
+	REQUIRE(tree->count == reference.size());
+	REQUIRE(avlMemory(tree) == sizeof(struct AvlTree) + tree->count * sizeof(struct AvlNode));
+
+	if (reference.empty())
+		return;
+
+	REQUIRE(avlMin(tree) == (void*)*reference.begin());
+	REQUIRE(avlMax(tree) == (void*)*reference.rbegin());
+
+	for (ptrdiff_t item : reference)
+		REQUIRE(avlContains(tree, (void*)item));
+}
+
+TEST_CASE("avl insert batch", "[inc/AvlTree.h/avlInsertBatch]")
+{
+	struct AvlTree tree;
+	std::set<ptrdiff_t> reference;
+	std::vector<void *> batch;
+
+	REQUIRE_FALSE(avlInsertBatch(NULL, NULL, 0, 1));
+
+	avlInit(&tree, &compare);
+	REQUIRE_FALSE(avlInsertBatch(&tree, NULL, 1, 1));
+	REQUIRE(avlInsertBatch(&tree, NULL, 0, 1));
+	REQUIRE(tree.root == NULL);
+
+	// batches with duplicates, that partially overlap the tree, with different sizes and numbers of threads
+	for (size_t n_threads : {0, 1, 2, 3, 8})
+	{
+		avlInit(&tree, &compare);
+		reference.clear();
+		srand((unsigned)n_threads);
+
+		for (size_t n : {1, 10, 1000, 20000, 100000, 5})
+		{
+			batch.clear();
+
+			for (size_t i = 0; i < n; i++)
+			{
+				ptrdiff_t item = rand() % 200000;
+
+				batch.push_back((void*)item);
+				reference.insert(item);
+			}
+
+			std::vector<void *> copy = batch;
+
+			REQUIRE(avlInsertBatch(&tree, batch.data(), batch.size(), n_threads));
+			REQUIRE(batch == copy);
+			checkBatch(&tree, reference);
+		}
+
+		avlFree(&tree);
+	}
+
+	// sorted, reverse sorted and equal batches into an empty tree
+	for (int order = 0; order < 3; order++)
+	{
+		avlInit(&tree, &compare);
+		reference.clear();
+		batch.clear();
+
+		for (ptrdiff_t i = 0; i < 50000; i++)
+		{
+			ptrdiff_t item = order == 0 ? i : order == 1 ? 50000 - i : 7;
+
+			batch.push_back((void*)item);
+			reference.insert(item);
+		}
+
+		REQUIRE(avlInsertBatch(&tree, batch.data(), batch.size(), 4));
+		checkBatch(&tree, reference);
+		avlFree(&tree);
+	}
+
+	// a tree in relaxed mode is rebalanced first, and stays in relaxed mode
+	avlInit(&tree, &compare);
+	REQUIRE(avlRelax(&tree, 0));
+	reference.clear();
+	batch.clear();
+
+	for (ptrdiff_t item = 0; item < 10000; item++)
+	{
+		avlInsert(&tree, (void*)(2 * item));
+		batch.push_back((void*)(2 * item + 1));
+		reference.insert(2 * item);
+		reference.insert(2 * item + 1);
+	}
+
+	REQUIRE(avlInsertBatch(&tree, batch.data(), batch.size(), 2));
+	REQUIRE(tree.relaxed);
+	checkBatch(&tree, reference);
+	avlFree(&tree);
+
+	// on an exceeded budget, some items are missing, but the tree stays valid
+	struct Allocator allocator;
+
+	allocatorInit(&allocator, 25000 * sizeof(struct AvlNode));
+	avlInit(&tree, &compare);
+	REQUIRE(avlSetAllocator(&tree, &allocator));
+	batch.clear();
+
+	for (ptrdiff_t item = 0; item < 10000; item++)
+		REQUIRE(avlInsert(&tree, (void*)(3 * item)));
+
+	for (ptrdiff_t item = 0; item < 30000; item++)
+		batch.push_back((void*)item);
+
+	REQUIRE_FALSE(avlInsertBatch(&tree, batch.data(), batch.size(), 4));
+	REQUIRE(allocator.failures > 0);
+	REQUIRE(tree.count <= 25000);
+	REQUIRE(allocator.used == tree.count * sizeof(struct AvlNode));
+
+	reference.clear();
+
+	for (ptrdiff_t item = 0; item < 30000; item++)
+	{
+		if (avlContains(&tree, (void*)item))
+			reference.insert(item);
+	}
+
+	checkBatch(&tree, reference);
+
+	for (ptrdiff_t item = 0; item < 10000; item++)
+		REQUIRE(avlContains(&tree, (void*)(3 * item)));
+
+	avlFree(&tree);
+	REQUIRE(allocator.used == 0);
+
+	// interval trees insert the sorted batch one by one
+	std::vector<struct Interval> intervals(1000);
+	struct AvlTree interval_tree;
+
+	avlInitInterval(&interval_tree, &compareIntervals, &INTERVAL_TYPE);
+	batch.clear();
+
+	for (size_t i = 0; i < intervals.size(); i++)
+	{
+		intervals[i].low = (long)(i * 7 % intervals.size());
+		intervals[i].high = intervals[i].low + 5;
+		batch.push_back(&intervals[i]);
+	}
+
+	REQUIRE(avlInsertBatch(&interval_tree, batch.data(), batch.size(), 4));
+	REQUIRE(interval_tree.count == intervals.size());
+	std::vector<struct Interval *> found;
+	long point = 500;
+
+	REQUIRE(avlStab(&interval_tree, &point, &collectInterval, &found) == 6);
+
+	std::vector<struct Interval *> pointers;
+
+	for (struct Interval &interval : intervals)
+		pointers.push_back(&interval);
+
+	checkOverlap(&interval_tree, pointers, 300, 320);
+	avlFree(&interval_tree);
+}
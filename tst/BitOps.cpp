@@ -0,0 +1,43 @@
+#include <catch.hpp>
+
+extern "C"
+{
+#include "../inc/BitOps.h"
+}
+
+TEST_CASE("bit ops", "[inc/BitOps.h]")
+{
+	REQUIRE(bitOpsSelect((enum BitOpsImpl)42) == 1);
+
+	for (enum BitOpsImpl impl : {BITOPS_AUTO, BITOPS_BMI, BITOPS_BUILTIN, BITOPS_DEBRUIJN})
+	{
+		if (bitOpsSelect(impl) != 0)
+		{
+			// BMI is not available on every CPU
+			REQUIRE(impl == BITOPS_BMI);
+			continue;
+		}
+
+		REQUIRE(bitTzcnt64(0) == 64);
+
+		for (uint64_t i = 0; i < 64; i++)
+		{
+			REQUIRE(bitTzcnt64((uint64_t)1 << i) == i);
+			REQUIRE(bitTzcnt64(~(uint64_t)0 << i) == i);
+			REQUIRE(bitTzcnt64((uint64_t)0x8000000000000001 << i) == i);
+		}
+
+		uint64_t words[4] = {0, 0, 0, 0};
+		REQUIRE(bitTzcntWords(words, 4) == 256);
+		REQUIRE(bitTzcntWords(words, 0) == 0);
+
+		words[3] = 0x8000000000000000;
+		REQUIRE(bitTzcntWords(words, 4) == 255);
+
+		words[1] = 0x10;
+		REQUIRE(bitTzcntWords(words, 4) == 68);
+		REQUIRE(bitTzcntWords(words, 1) == 64);
+	}
+
+	bitOpsSelect(BITOPS_AUTO);
+}
@@ -0,0 +1,71 @@
+#include <catch.hpp>
+#include <cstring>
+#include <string>
+
+extern "C"
+{
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLog.h"
+}
+
+TEST_CASE("hash bytes", "[src/Hash.h/hashBytes]")
+{
+	const char *text = "The quick brown fox jumps over the lazy dog";
+
+	// deterministic, but depends on the seed, the length and every byte
+	REQUIRE(hashBytes(text, strlen(text), 0) == hashBytes(text, strlen(text), 0));
+	REQUIRE(hashBytes(text, strlen(text), 0) != hashBytes(text, strlen(text), 1));
+	REQUIRE(hashBytes(text, 0, 0) != hashBytes(text, 0, 1));
+
+	for (size_t length = 1; length <= strlen(text); length++)
+	{
+		REQUIRE(hashBytes(text, length, 0) != hashBytes(text, length - 1, 0));
+
+		std::string changed(text, length);
+		changed[length - 1] ^= 1;
+		REQUIRE(hashBytes(text, length, 0) != hashBytes(changed.data(), length, 0));
+	}
+
+	// flipping one input bit flips about half of the output bits
+	uint64_t key = 0;
+	uint64_t hash = hashBytes(&key, sizeof(key), 0);
+	int total = 0;
+
+	for (int i = 0; i < 64; i++)
+	{
+		uint64_t flipped = key ^ ((uint64_t)1 << i);
+		total += __builtin_popcountll(hash ^ hashBytes(&flipped, sizeof(flipped), 0));
+	}
+
+	REQUIRE(total / 64 >= 24);
+	REQUIRE(total / 64 <= 40);
+}
+
+TEST_CASE("hash expand", "[src/Hash.h/hashExpand]")
+{
+	uint64_t hash = hashBytes("abc", 3, 0);
+	unsigned char short_buffer[13], long_buffer[40];
+
+	hashExpand(&hash, sizeof(short_buffer), short_buffer);
+	hashExpand(&hash, sizeof(long_buffer), long_buffer);
+
+	// shorter outputs are prefixes of longer ones
+	REQUIRE(memcmp(short_buffer, long_buffer, sizeof(short_buffer)) == 0);
+
+	// counting strings with a HyperLogLog
+	struct HyperLogLog set;
+	REQUIRE(hllInit(&set, MEDIUM, 12, &hashExpand) == 0);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		std::string item = "item" + std::to_string(i % 10000);
+		uint64_t item_hash = hashBytes(item.data(), item.size(), 0);
+
+		hllAdd(&set, &item_hash);
+	}
+
+	REQUIRE(hllCount(&set) >= 9500);
+	REQUIRE(hllCount(&set) <= 10500);
+
+	hllFree(&set);
+}
@@ -0,0 +1,146 @@
+#include <catch.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern "C"
+{
+#include "../inc/Hash.h"
+#include "../inc/HllClient.h"
+}
+
+/**
+ * Queues a response, so the client can read it after sending its request (the test plays the server).
+ */
+static void respond(int fd, int32_t status, double count)
+{
+	struct HllResponse response = {status, 0, count};
+
+	REQUIRE(write(fd, &response, sizeof(response)) == (ssize_t)sizeof(response));
+}
+
+/**
+ * Reads a request, that was sent by the client, and checks its framing.
+ *
+ * @return the body of the request
+ */
+static std::vector<uint8_t> receive(int fd, uint8_t type, const std::string &name)
+{
+	struct HllRequestHeader header;
+
+	REQUIRE(read(fd, &header, sizeof(header)) == (ssize_t)sizeof(header));
+	REQUIRE(header.type == type);
+	REQUIRE(header.name_length == name.size());
+	REQUIRE(header.length >= name.size());
+
+	std::vector<uint8_t> payload(header.length);
+	size_t received = 0;
+
+	while (received < payload.size())
+	{
+		ssize_t n = read(fd, payload.data() + received, payload.size() - received);
+		REQUIRE(n > 0);
+		received += (size_t)n;
+	}
+
+	REQUIRE(std::string(payload.begin(), payload.begin() + name.size()) == name);
+
+	return std::vector<uint8_t>(payload.begin() + name.size(), payload.end());
+}
+
+TEST_CASE("HyperLogLog client", "[src/HllClient.h]")
+{
+	struct HllClient client;
+	std::string path = "/tmp/aud-test-" + std::to_string(getpid()) + ".sock";
+	std::string long_path(200, 'x');
+
+	REQUIRE(hllClientConnect(NULL, path.c_str()) == 1);
+	REQUIRE(hllClientConnect(&client, NULL) == 2);
+	REQUIRE(hllClientConnect(&client, long_path.c_str()) == 2);
+	REQUIRE(hllClientConnect(&client, path.c_str()) == -1);
+	REQUIRE(client.fd == -1);
+
+	// a listening socket accepts the connection without calling accept()
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	struct sockaddr_un address;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path.c_str());
+
+	REQUIRE(server >= 0);
+	REQUIRE(bind(server, (struct sockaddr *)&address, sizeof(address)) == 0);
+	REQUIRE(listen(server, 1) == 0);
+	REQUIRE(hllClientConnect(&client, path.c_str()) == 0);
+	REQUIRE(client.fd >= 0);
+
+	hllClientClose(&client);
+	hllClientClose(&client);
+	hllClientClose(NULL);
+	close(server);
+	unlink(path.c_str());
+
+	// the rest of the test uses a socket pair instead
+	int fds[2];
+	double count;
+	uint64_t hashes[3] = {1, 2, 3};
+	std::string long_name(HLL_MAX_NAME_LENGTH + 1, 'n');
+
+	REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	client.fd = fds[0];
+	client.buffer = NULL;
+	client.capacity = 0;
+
+	REQUIRE(hllClientCount(NULL, "a", &count) == 1);
+	REQUIRE(hllClientCount(&client, NULL, &count) == 2);
+	REQUIRE(hllClientCount(&client, long_name.c_str(), &count) == 2);
+	REQUIRE(hllClientCount(&client, "a", NULL) == 3);
+	REQUIRE(hllClientAdd(&client, "a", NULL, 1) == 3);
+	REQUIRE(hllClientMerge(&client, "a", NULL) == 3);
+
+	respond(fds[1], HLL_STATUS_OK, 42);
+	REQUIRE(hllClientCount(&client, "count", &count) == 0);
+	REQUIRE(count == 42);
+	REQUIRE(receive(fds[1], HLL_REQUEST_COUNT, "count").empty());
+
+	respond(fds[1], HLL_STATUS_OK, 0);
+	REQUIRE(hllClientAdd(&client, "add", hashes, 3) == 0);
+	std::vector<uint8_t> body = receive(fds[1], HLL_REQUEST_ADD, "add");
+	REQUIRE(body.size() == sizeof(hashes));
+	REQUIRE(memcmp(body.data(), hashes, sizeof(hashes)) == 0);
+
+	// a merge sends the serialized set
+	struct HyperLogLog set, copy;
+
+	REQUIRE(hllInit(&set, SMALL, 6, &hashExpand) == 0);
+	for (uint64_t item = 0; item < 100; item++)
+		hllAdd(&set, &item);
+
+	respond(fds[1], HLL_STATUS_OK, 0);
+	REQUIRE(hllClientMerge(&client, "merge", &set) == 0);
+	body = receive(fds[1], HLL_REQUEST_MERGE, "merge");
+	REQUIRE(hllDeserialize(&copy, body.data(), body.size(), &hashExpand) == 0);
+	REQUIRE(hllCount(&copy) == hllCount(&set));
+
+	// rejected requests
+	respond(fds[1], HLL_STATUS_INCOMPATIBLE, 0);
+	REQUIRE(hllClientMerge(&client, "merge", &set) == -2);
+	receive(fds[1], HLL_REQUEST_MERGE, "merge");
+
+	count = 1;
+	respond(fds[1], HLL_STATUS_BAD_REQUEST, 0);
+	REQUIRE(hllClientCount(&client, "", &count) == -2);
+	REQUIRE(count == 1);
+	receive(fds[1], HLL_REQUEST_COUNT, "");
+
+	// a closed server is a socket error
+	close(fds[1]);
+	REQUIRE(hllClientCount(&client, "count", &count) == -1);
+
+	hllFree(&copy);
+	hllFree(&set);
+	hllClientClose(&client);
+}
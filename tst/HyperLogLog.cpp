@@ -1,7 +1,11 @@
 #include <catch.hpp>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 extern "C"
 {
+#include "../inc/Hash.h"
 #include "../inc/HyperLogLog.h"
 }
 
@@ -9,7 +13,7 @@ void hash(const void *item, size_t h, void *buffer)
 {
 	char *char_ptr = (char*)buffer;
 
-	srand((unsigned)item);
+	srand((unsigned)(size_t)item);
 
 	for (size_t i = 0; i < h; i++)
 	{
@@ -72,4 +76,477 @@ TEST_CASE("HyperLogLog", "[src/HyperLogLog.h]")
 	REQUIRE(hllCount(&set) <= 10300);
 
 	hllFree(&set);
-}
\ No newline at end of file
+}
+
+TEST_CASE("HyperLogLog merge", "[src/HyperLogLog.h/hllMerge]")
+{
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		struct HyperLogLog a, b, all;
+
+		REQUIRE(hllInit(&a, r, 7, &hash) == 0);
+		REQUIRE(hllInit(&b, r, 7, &hash) == 0);
+		REQUIRE(hllInit(&all, r, 7, &hash) == 0);
+
+		REQUIRE(hllMerge(NULL, &b) == 1);
+		REQUIRE(hllMerge(&a, NULL) == 2);
+
+		struct HyperLogLog other;
+		REQUIRE(hllInit(&other, r, 6, &hash) == 0);
+		REQUIRE(hllMerge(&a, &other) == 2);
+		hllFree(&other);
+
+		for (size_t i = 1; i <= 3000; i++)
+		{
+			hllAdd(i % 3 ? &a : &b, (void*)i);
+			hllAdd(&all, (void*)i);
+		}
+
+		REQUIRE(hllMerge(&a, &b) == 0);
+		REQUIRE(hllCount(&a) == hllCount(&all));
+
+		// merging is idempotent
+		REQUIRE(hllMerge(&a, &all) == 0);
+		REQUIRE(hllCount(&a) == hllCount(&all));
+
+		hllFree(&a);
+		hllFree(&b);
+		hllFree(&all);
+	}
+}
+
+TEST_CASE("HyperLogLog fold", "[src/HyperLogLog.h/hllFold]")
+{
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		struct HyperLogLog set;
+
+		REQUIRE(hllInit(&set, r, 10, &hash) == 0);
+
+		REQUIRE(hllFold(NULL, r, 8) == 1);
+		REQUIRE(hllFold(&set, 5, 8) == 2);
+		REQUIRE(hllFold(&set, r + 1, 8) == 2);
+		REQUIRE(hllFold(&set, r, 3) == 3);
+		REQUIRE(hllFold(&set, r, 11) == 3);
+
+		for (size_t i = 1; i <= 20000; i++)
+			hllAdd(&set, (void*)i);
+
+		for (unsigned char new_r : {SMALL, MEDIUM, LARGE})
+		{
+			if (new_r > r)
+				continue;
+
+			for (unsigned char new_b : {4, 7, 10})
+			{
+				struct HyperLogLog folded, merged, direct;
+
+				REQUIRE(hllInit(&folded, r, 10, &hash) == 0);
+				REQUIRE(hllInit(&merged, new_r, new_b, &hash) == 0);
+				REQUIRE(hllInit(&direct, new_r, new_b, &hash) == 0);
+
+				for (size_t i = 1; i <= 20000; i++)
+					hllAdd(&direct, (void*)i);
+
+				// folding gives the same registers as adding the items to a set with the lower precision directly
+				REQUIRE(hllMerge(&folded, &set) == 0);
+				REQUIRE(hllFold(&folded, new_r, new_b) == 0);
+				REQUIRE(folded.r == new_r);
+				REQUIRE(folded.b == new_b);
+				REQUIRE(hllCount(&folded) == hllCount(&direct));
+
+				// so does merging a set with a higher precision
+				REQUIRE(hllMerge(&merged, &set) == 0);
+				REQUIRE(hllCount(&merged) == hllCount(&direct));
+
+				hllFree(&folded);
+				hllFree(&merged);
+				hllFree(&direct);
+			}
+		}
+
+		hllFree(&set);
+	}
+}
+
+TEST_CASE("HyperLogLog joint count", "[src/HyperLogLog.h/hllJointCount]")
+{
+	struct HyperLogLog a, b;
+	struct HyperLogLogJoint joint;
+
+	REQUIRE(hllInit(&a, MEDIUM, 12, &hash) == 0);
+	REQUIRE(hllInit(&b, MEDIUM, 12, &hash) == 0);
+
+	REQUIRE(hllJointCount(NULL, &b, &joint) == 1);
+	REQUIRE(hllJointCount(&a, NULL, &joint) == 2);
+	REQUIRE(hllJointCount(&a, &b, NULL) == 3);
+
+	REQUIRE(hllJointCount(&a, &b, &joint) == 0);
+	REQUIRE(joint.intersection == 0);
+	REQUIRE(joint.jaccard == 0);
+
+	// A = [1, 30000], B = [27001, 57000]
+	for (size_t i = 1; i <= 30000; i++)
+		hllAdd(&a, (void*)i);
+	for (size_t i = 27001; i <= 57000; i++)
+		hllAdd(&b, (void*)i);
+
+	REQUIRE(hllJointCount(&a, &b, &joint) == 0);
+	REQUIRE(isClose(joint.only_a, 27000, 0.05));
+	REQUIRE(isClose(joint.only_b, 27000, 0.05));
+	REQUIRE(isClose(joint.intersection, 3000, 0.25));
+	REQUIRE(isClose(joint.jaccard, 3000.0 / 57000, 0.25));
+
+	// a set and itself overlap completely
+	REQUIRE(hllJointCount(&a, &a, &joint) == 0);
+	REQUIRE(joint.jaccard > 0.99);
+
+	hllFree(&a);
+	hllFree(&b);
+}
+
+/**
+ * Sets the register `item >> 8` to the value `item & 0xFF` (for SMALL and MEDIUM sets).
+ */
+static void registerHash(const void *item, size_t h, void *buffer)
+{
+	size_t index = (size_t)item >> 8;
+	uint64_t value = (size_t)item & 0xFF;
+	uint64_t word = (uint64_t)1 << (value - 1);
+
+	memset(buffer, 0, h);
+	memcpy(buffer, &index, sizeof(index));
+	memcpy((char *)buffer + sizeof(size_t), &word, sizeof(word));
+}
+
+static void setRegister(struct HyperLogLog *small, struct HyperLogLog *medium, size_t index, size_t value)
+{
+	hllAdd(small, (void*)(index << 8 | value));
+	hllAdd(medium, (void*)(index << 8 | value));
+}
+
+TEST_CASE("HyperLogLog small registers", "[src/HyperLogLog.h]")
+{
+	// SMALL sets count as far as MEDIUM sets
+	for (unsigned char b : {6, 10})
+	{
+		struct HyperLogLog small, medium;
+
+		REQUIRE(hllInit(&small, SMALL, b, &hash) == 0);
+		REQUIRE(hllInit(&medium, MEDIUM, b, &hash) == 0);
+
+		for (size_t i = 1; i <= 1000000; i++)
+		{
+			hllAdd(&small, (void*)i);
+			hllAdd(&medium, (void*)i);
+		}
+
+		REQUIRE(hllCount(&small) == hllCount(&medium));
+		REQUIRE(isClose(hllCount(&small), 1000000, b == 6 ? 0.4 : 0.1));
+
+		hllFree(&small);
+		hllFree(&medium);
+	}
+
+	// 2048 registers have room for 4 exceptions
+	struct HyperLogLog small, medium, merged;
+	const unsigned char b = 11;
+	const size_t m = (size_t)1 << b;
+
+	REQUIRE(hllInit(&small, SMALL, b, &registerHash) == 0);
+	REQUIRE(hllInit(&medium, MEDIUM, b, &registerHash) == 0);
+
+	// registers that don't fit into 4 bits above the base
+	for (size_t i = 0; i < 4; i++)
+		setRegister(&small, &medium, i, 20 + i);
+
+	REQUIRE(hllCount(&small) == hllCount(&medium));
+
+	// the base is raised after all registers are above it
+	for (size_t i = 4; i < m; i++)
+		setRegister(&small, &medium, i, 10);
+
+	REQUIRE(hllCount(&small) == hllCount(&medium));
+
+	setRegister(&small, &medium, m - 1, 40);
+	setRegister(&small, &medium, m - 2, 63);
+	REQUIRE(hllCount(&small) == hllCount(&medium));
+
+	for (size_t i = 4; i < m - 2; i++)
+		setRegister(&small, &medium, i, 24);
+
+	REQUIRE(hllCount(&small) == hllCount(&medium));
+
+	// merging a set with a different base, and folding
+	REQUIRE(hllInit(&merged, SMALL, b, &registerHash) == 0);
+	setRegister(&merged, &medium, 0, 50);
+
+	REQUIRE(hllMerge(&merged, &small) == 0);
+	REQUIRE(hllCount(&merged) == hllCount(&medium));
+
+	REQUIRE(hllFold(&medium, SMALL, b) == 0);
+	REQUIRE(hllCount(&merged) == hllCount(&medium));
+
+	// clearing resets the base
+	hllClear(&merged);
+	REQUIRE(hllCount(&merged) == 0);
+	hllAdd(&merged, (void*)(3 << 8 | 1));
+	REQUIRE(isClose(hllCount(&merged), m * log((double)m / (m - 1)), 1e-9));
+
+	// if the exception list is full, registers are clamped to the greatest offset
+	hllClear(&small);
+	hllFree(&medium);
+	REQUIRE(hllInit(&medium, MEDIUM, b, &registerHash) == 0);
+
+	for (size_t i = 0; i < 5; i++)
+		setRegister(&small, &medium, i, 30);
+	for (size_t i = 5; i < m; i++)
+		setRegister(&small, &medium, i, 20);
+
+	REQUIRE(hllCount(&small) < hllCount(&medium));
+
+	hllFree(&small);
+	hllFree(&medium);
+	hllFree(&merged);
+
+	// sets with fewer than 512 registers have no exception list, and are as small as MEDIUM or LARGE sets
+	REQUIRE(hllInit(&small, SMALL, 4, &registerHash) == 0);
+	REQUIRE(hllInit(&medium, MEDIUM, 4, &registerHash) == 0);
+
+	setRegister(&small, &medium, 0, 30);
+	for (size_t i = 1; i < 16; i++)
+		setRegister(&small, &medium, i, 10);
+
+	REQUIRE(hllCount(&small) < hllCount(&medium));
+	REQUIRE(hllCount(&small) > 0.99 * hllCount(&medium));
+
+	hllFree(&small);
+	hllFree(&medium);
+
+	for (unsigned char size_b = 4; size_b <= 20; size_b++)
+	{
+		REQUIRE(hllDataSize(SMALL, size_b) <= hllDataSize(MEDIUM, size_b));
+		REQUIRE(hllDataSize(SMALL, size_b) <= hllDataSize(LARGE, size_b));
+	}
+
+	REQUIRE(hllDataSize(SMALL, 4) == 16);
+	REQUIRE(hllDataSize(SMALL, 31) > 0);
+	REQUIRE(hllDataSize(SMALL, 32) == 0);
+	REQUIRE(hllInit(&small, SMALL, 32, &registerHash) == 3);
+	REQUIRE(hllInit(&medium, MEDIUM, 32, &registerHash) == 0);
+	REQUIRE(hllFold(&medium, SMALL, 32) == 3);
+	hllFree(&medium);
+}
+
+TEST_CASE("HyperLogLog serialize", "[src/HyperLogLog.h/hllSerialize]")
+{
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		struct HyperLogLog set, copy;
+
+		REQUIRE(hllInit(&set, r, 7, &hash) == 0);
+
+		for (size_t i = 1; i <= 5000; i++)
+			hllAdd(&set, (void*)i);
+
+		REQUIRE(hllSerialize(NULL, NULL, 0) == 0);
+
+		size_t size = hllSerialize(&set, NULL, 0);
+		REQUIRE(size == 8 + hllDataSize(r, 7));
+
+		std::vector<uint8_t> buffer(size);
+
+		// a buffer that is too small is not written
+		REQUIRE(hllSerialize(&set, buffer.data(), size - 1) == size);
+		REQUIRE(buffer[0] == 0);
+
+		REQUIRE(hllSerialize(&set, buffer.data(), size) == size);
+
+		REQUIRE(hllDeserialize(NULL, buffer.data(), size, &hash) == 1);
+		REQUIRE(hllDeserialize(&copy, NULL, size, &hash) == 2);
+		REQUIRE(hllDeserialize(&copy, buffer.data(), size - 1, &hash) == 3);
+		REQUIRE(hllDeserialize(&copy, buffer.data(), size, NULL) == 4);
+		REQUIRE(hllDeserialize(&copy, buffer.data(), size, &hash) == 0);
+
+		REQUIRE(copy.r == r);
+		REQUIRE(copy.b == 7);
+		REQUIRE(memcmp(copy.data, set.data, hllDataSize(r, 7)) == 0);
+		REQUIRE(hllCount(&copy) == hllCount(&set));
+
+		// the copy can be used like the original
+		for (size_t i = 5001; i <= 6000; i++)
+		{
+			hllAdd(&set, (void*)i);
+			hllAdd(&copy, (void*)i);
+		}
+		REQUIRE(hllCount(&copy) == hllCount(&set));
+
+		std::vector<uint8_t> corrupted = buffer;
+		corrupted[0] = 'X';
+		REQUIRE(hllDeserialize(&copy, corrupted.data(), size, &hash) == 2);
+
+		corrupted = buffer;
+		corrupted[4] = 8;
+		REQUIRE(hllDeserialize(&copy, corrupted.data(), size, &hash) == 3);
+
+		hllFree(&copy);
+		hllFree(&set);
+	}
+
+	// a SMALL set with an exception, that doesn't belong to an escaped register
+	struct HyperLogLog set, copy;
+
+	REQUIRE(hllInit(&set, SMALL, 9, &registerHash) == 0);
+	hllAdd(&set, (void*)(3 << 8 | 30));
+
+	size_t size = hllSerialize(&set, NULL, 0);
+	std::vector<uint8_t> buffer(size);
+	REQUIRE(hllSerialize(&set, buffer.data(), size) == size);
+
+	REQUIRE(hllDeserialize(&copy, buffer.data(), size, &registerHash) == 0);
+	REQUIRE(hllCount(&copy) == hllCount(&set));
+	hllFree(&copy);
+
+	// the exception list follows the 8 byte header, the 8 byte SMALL header and 256 bytes of offsets
+	uint64_t exception;
+	memcpy(&exception, buffer.data() + 272, sizeof(exception));
+	REQUIRE(exception == (3 << 8 | 30));
+
+	exception = 4 << 8 | 30;
+	memcpy(buffer.data() + 272, &exception, sizeof(exception));
+	REQUIRE(hllDeserialize(&copy, buffer.data(), size, &registerHash) == 2);
+
+	// other format versions are rejected
+	exception = 3 << 8 | 30;
+	memcpy(buffer.data() + 272, &exception, sizeof(exception));
+	REQUIRE(hllDeserialize(&copy, buffer.data(), size, &registerHash) == 0);
+	hllFree(&copy);
+
+	buffer[2] = 0;
+	REQUIRE(hllDeserialize(&copy, buffer.data(), size, &registerHash) == 2);
+	buffer[2] = 2;
+	REQUIRE(hllDeserialize(&copy, buffer.data(), size, &registerHash) == 2);
+
+	hllFree(&set);
+}
+
+static uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+	return x ^ (x >> 31);
+}
+
+TEST_CASE("HyperLogLog add hash", "[src/HyperLogLog.h/hllAddHash]")
+{
+	std::vector<uint64_t> hashes;
+
+	for (uint64_t i = 0; i < 200000; i++)
+		hashes.push_back(splitmix64(i));
+
+	hllAddHash(NULL, 1);
+	hllAddHashes(NULL, hashes.data(), hashes.size());
+
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		struct HyperLogLog single, batched, folded;
+
+		REQUIRE(hllInit(&single, r, 12, &hash) == 0);
+		REQUIRE(hllInit(&batched, r, 12, &hash) == 0);
+		REQUIRE(hllInit(&folded, SMALL, 11, &hash) == 0);
+
+		hllAddHashes(&batched, NULL, 1);
+		REQUIRE(hllCount(&batched) == 0);
+
+		for (uint64_t h : hashes)
+			hllAddHash(&single, h);
+
+		hllAddHashes(&batched, hashes.data(), hashes.size());
+
+		REQUIRE(memcmp(single.data, batched.data, hllDataSize(r, 12)) == 0);
+		REQUIRE(isClose(hllCount(&single), (double)hashes.size(), 0.05));
+
+		// adding the same hashes again doesn't count
+		hllAddHashes(&batched, hashes.data(), 1000);
+		REQUIRE(hllCount(&batched) == hllCount(&single));
+
+		// folding is exact (as long as the exception list of the SMALL set doesn't overflow)
+		hllAddHashes(&folded, hashes.data(), hashes.size());
+		REQUIRE(hllFold(&single, SMALL, 11) == 0);
+		REQUIRE(hllCount(&single) == hllCount(&folded));
+
+		hllFree(&single);
+		hllFree(&batched);
+		hllFree(&folded);
+	}
+
+	// the registers are the same as with `hllAdd()` and `hashExpand()`, so both kinds of sets can be merged
+	for (unsigned char r : {SMALL, MEDIUM, LARGE})
+	{
+		struct HyperLogLog set, expected;
+
+		REQUIRE(hllInit(&set, r, 12, &hash) == 0);
+		REQUIRE(hllInit(&expected, r, 12, &hashExpand) == 0);
+
+		hllAddHashes(&set, hashes.data(), 100000);
+
+		for (size_t i = 0; i < 100000; i++)
+			hllAdd(&expected, &hashes[i]);
+
+		REQUIRE(memcmp(set.data, expected.data, hllDataSize(r, 12)) == 0);
+
+		double count = hllCount(&set);
+
+		REQUIRE(hllMerge(&set, &expected) == 0);
+		REQUIRE(hllCount(&set) == count);
+
+		hllFree(&set);
+		hllFree(&expected);
+	}
+}
+
+TEST_CASE("HyperLogLog allocator", "[src/HyperLogLog.h/hllInitAllocator, src/HyperLogLog.h/hllMemory]")
+{
+	struct HyperLogLog set, other;
+	struct Allocator allocator;
+
+	REQUIRE(hllMemory(NULL) == 0);
+
+	allocatorInit(&allocator, hllDataSize(LARGE, 10) + hllDataSize(MEDIUM, 8));
+
+	REQUIRE(hllInitAllocator(NULL, LARGE, 10, &hash, &allocator) == 1);
+	REQUIRE(hllInitAllocator(&set, LARGE, 3, &hash, &allocator) == 3);
+	REQUIRE(allocator.used == 0);
+
+	REQUIRE(hllInitAllocator(&set, LARGE, 10, &hash, &allocator) == 0);
+	REQUIRE(allocator.used == hllDataSize(LARGE, 10));
+	REQUIRE(hllMemory(&set) == sizeof(struct HyperLogLog) + hllDataSize(LARGE, 10));
+
+	// a second set with the same size exceeds the budget
+	REQUIRE(hllInitAllocator(&other, LARGE, 10, &hash, &allocator) == -1);
+	REQUIRE(allocator.failures == 1);
+
+	for (size_t i = 1; i <= 1000; i++)
+		hllAdd(&set, (void*)i);
+
+	// folding needs room for both register arrays at the same time
+	double count = hllCount(&set);
+
+	REQUIRE(hllFold(&set, LARGE, 9) == -1);
+	REQUIRE(set.b == 10);
+	REQUIRE(hllCount(&set) == count);
+	REQUIRE(hllFold(&set, MEDIUM, 8) == 0);
+	REQUIRE(allocator.used == hllDataSize(MEDIUM, 8));
+	REQUIRE(hllMemory(&set) == sizeof(struct HyperLogLog) + hllDataSize(MEDIUM, 8));
+
+	hllFree(&set);
+	REQUIRE(allocator.used == 0);
+	REQUIRE(allocator.peak == hllDataSize(LARGE, 10) + hllDataSize(MEDIUM, 8));
+
+	// without an allocator, sets use malloc()
+	REQUIRE(hllInitAllocator(&set, SMALL, 12, &hash, NULL) == 0);
+	REQUIRE(set.allocator == NULL);
+	REQUIRE(hllMemory(&set) == sizeof(struct HyperLogLog) + hllDataSize(SMALL, 12));
+	hllFree(&set);
+}
@@ -0,0 +1,155 @@
+#include <catch.hpp>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+#include "../inc/Hash.h"
+#include "../inc/HyperLogLogPipeline.h"
+}
+
+/**
+ * Adds the items `[first, first + n)` to a pipeline as reader `reader`.
+ */
+static void addItems(struct HyperLogLogPipeline *pipeline, size_t reader, uint64_t first, uint64_t n)
+{
+	for (uint64_t item = first; item < first + n; item++)
+		hllPipelineAdd(pipeline, reader, &item);
+
+	hllPipelineFlush(pipeline, reader);
+}
+
+/**
+ * Builds the set, that a pipeline should build for the items `[0, n)`.
+ */
+static void addDirectly(struct HyperLogLog *set, uint64_t n)
+{
+	for (uint64_t item = 0; item < n; item++)
+	{
+		uint64_t hash;
+
+		hashExpand(&item, sizeof(hash), &hash);
+		hllAddHash(set, hash);
+	}
+}
+
+TEST_CASE("HyperLogLog pipeline init", "[src/HyperLogLogPipeline.h/hllPipelineInit]")
+{
+	struct HyperLogLogPipeline pipeline;
+	struct HyperLogLog small, large;
+
+	REQUIRE(hllInit(&small, SMALL, 10, &hashExpand) == 0);
+	REQUIRE(hllInit(&large, LARGE, 10, &hashExpand) == 0);
+
+	REQUIRE(hllPipelineInit(NULL, &large, 1, 1, 0) == 1);
+	REQUIRE(hllPipelineInit(&pipeline, NULL, 1, 1, 0) == 2);
+	REQUIRE(hllPipelineInit(&pipeline, &small, 1, 1, 0) == 2);
+	REQUIRE(hllPipelineInit(&pipeline, &large, 0, 1, 0) == 3);
+	REQUIRE(hllPipelineInit(&pipeline, &large, 1, 0, 0) == 4);
+	REQUIRE(hllPipelineInit(&pipeline, &large, 1, 1, 1000) == 5);
+	REQUIRE(hllPipelineInit(&pipeline, &large, 1, 1, HLL_PIPELINE_BATCH / 2) == 5);
+
+	REQUIRE(std::isnan(hllPipelineCount(NULL)));
+	hllPipelineAdd(NULL, 0, &pipeline);
+	hllPipelineAddHash(NULL, 0, 1);
+	hllPipelineFlush(NULL, 0);
+	hllPipelineWait(NULL);
+	hllPipelineFree(NULL);
+
+	// an empty pipeline
+	REQUIRE(hllPipelineInit(&pipeline, &large, 2, 2, HLL_PIPELINE_BATCH) == 0);
+	REQUIRE(hllPipelineCount(&pipeline) == 0);
+	hllPipelineFree(&pipeline);
+
+	hllFree(&small);
+	hllFree(&large);
+}
+
+TEST_CASE("HyperLogLog pipeline add", "[src/HyperLogLogPipeline.h/hllPipelineAdd]")
+{
+	const uint64_t n = 200000;
+
+	// MEDIUM ranges must not split the words of 10 registers, and small sets have fewer ranges than workers
+	for (unsigned char r : {MEDIUM, LARGE})
+	{
+		for (unsigned char b : {4, 9, 14})
+		{
+			for (size_t n_workers : {1, 3, 8})
+			{
+				struct HyperLogLog set, expected;
+				struct HyperLogLogPipeline pipeline;
+				const size_t n_readers = 3;
+
+				REQUIRE(hllInit(&set, r, b, &hashExpand) == 0);
+				REQUIRE(hllInit(&expected, r, b, &hashExpand) == 0);
+				REQUIRE(hllPipelineInit(&pipeline, &set, n_readers, n_workers, HLL_PIPELINE_BATCH * 2) == 0);
+
+				// the ranges start at cache line boundaries, wherever the registers were allocated
+				for (size_t i = 1; i * pipeline.span - pipeline.shift < ((size_t)1 << b); i++)
+				{
+					size_t first = i * pipeline.span - pipeline.shift;
+					size_t offset = r == LARGE ? first : first / 10 * sizeof(uint64_t);
+
+					REQUIRE(first % (r == LARGE ? 1 : 10) == 0);
+					REQUIRE(((uintptr_t)set.data + offset) % HLL_PIPELINE_CACHE_LINE == 0);
+				}
+
+				addDirectly(&expected, n);
+
+				std::vector<std::thread> readers;
+
+				for (size_t i = 0; i < n_readers; i++)
+					readers.emplace_back(&addItems, &pipeline, i, i * n / n_readers, n / n_readers + (i + 1 == n_readers));
+
+				for (std::thread &reader : readers)
+					reader.join();
+
+				// all items were flushed, so they are counted
+				REQUIRE(hllPipelineCount(&pipeline) == hllCount(&expected));
+
+				hllPipelineWait(&pipeline);
+				REQUIRE(memcmp(set.data, expected.data, hllDataSize(r, b)) == 0);
+
+				hllPipelineFree(&pipeline);
+				hllFree(&set);
+				hllFree(&expected);
+			}
+		}
+	}
+}
+
+TEST_CASE("HyperLogLog pipeline flush", "[src/HyperLogLogPipeline.h/hllPipelineFlush, src/HyperLogLogPipeline.h/hllPipelineFree]")
+{
+	struct HyperLogLog set, expected;
+	struct HyperLogLogPipeline pipeline;
+
+	REQUIRE(hllInit(&set, LARGE, 12, &hashExpand) == 0);
+	REQUIRE(hllInit(&expected, LARGE, 12, &hashExpand) == 0);
+	REQUIRE(hllPipelineInit(&pipeline, &set, 1, 2, 0) == 0);
+
+	// buffered items are not pushed yet
+	uint64_t item = 0;
+	hllPipelineAdd(&pipeline, 0, &item);
+	REQUIRE(hllPipelineCount(&pipeline) == 0);
+
+	hllPipelineFlush(&pipeline, 0);
+	addDirectly(&expected, 1);
+	REQUIRE(hllPipelineCount(&pipeline) == hllCount(&expected));
+
+	// invalid readers are ignored
+	hllPipelineAdd(&pipeline, 1, &item);
+	hllPipelineFlush(&pipeline, 1);
+
+	// freeing the pipeline applies the buffered items
+	for (item = 1; item < 1000; item++)
+		hllPipelineAdd(&pipeline, 0, &item);
+
+	hllPipelineFree(&pipeline);
+	addDirectly(&expected, 1000);
+	REQUIRE(memcmp(set.data, expected.data, hllDataSize(LARGE, 12)) == 0);
+
+	hllFree(&set);
+	hllFree(&expected);
+}
@@ -0,0 +1,265 @@
+#include <catch.hpp>
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+#include "../inc/HyperLogLogStore.h"
+}
+
+static void splitmixHash(const void *item, size_t h, void *buffer)
+{
+	uint64_t state = (uintptr_t)item;
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		z ^= z >> 31;
+
+		memcpy((char *)buffer + i, &z, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+/**
+ * Counts the items `[first, first + n)` with a plain HyperLogLog.
+ */
+static double countDirectly(unsigned char r, unsigned char b, size_t first, size_t n)
+{
+	struct HyperLogLog hll;
+	hllInit(&hll, r, b, &splitmixHash);
+
+	for (size_t i = first; i < first + n; i++)
+		hllAdd(&hll, (void*)i);
+
+	double result = hllCount(&hll);
+	hllFree(&hll);
+
+	return result;
+}
+
+/**
+ * Remembers the keys of evicted sketches.
+ */
+static void rememberEvicted(uint64_t key, const struct HyperLogLog *sketch, void *context)
+{
+	REQUIRE(sketch != NULL);
+	((std::vector<uint64_t> *)context)->push_back(key);
+}
+
+TEST_CASE("HyperLogLog store", "[src/HyperLogLogStore.h]")
+{
+	struct HyperLogLogStore store;
+	struct HyperLogLog sketch;
+
+	REQUIRE(hllStoreInit(NULL, MEDIUM, 8, &splitmixHash) == 1);
+	REQUIRE(hllStoreInit(&store, 5, 8, &splitmixHash) == 2);
+	REQUIRE(hllStoreInit(&store, MEDIUM, 3, &splitmixHash) == 3);
+	REQUIRE(hllStoreInit(&store, MEDIUM, 8, NULL) == 4);
+	REQUIRE(hllStoreInit(&store, MEDIUM, 8, &splitmixHash) == 0);
+
+	REQUIRE(hllStoreAdd(NULL, 1, (void*)1) == 1);
+	REQUIRE(hllStoreGet(&store, 1, &sketch) == 0);
+
+	// key k gets the items [1000 * k, 1000 * k + k)
+	const uint64_t n_keys = 300;
+
+	for (uint64_t k = 0; k < n_keys; k++)
+	{
+		for (size_t i = 0; i < k; i++)
+			REQUIRE(hllStoreAdd(&store, k, (void*)(1000 * k + i)) == 0);
+	}
+
+	REQUIRE(store.count == n_keys - 1);
+
+	for (uint64_t k = 1; k < n_keys; k++)
+	{
+		REQUIRE(hllStoreGet(&store, k, &sketch) == 1);
+		REQUIRE(hllCount(&sketch) == countDirectly(MEDIUM, 8, 1000 * k, k));
+	}
+
+	std::vector<uint64_t> keys;
+	std::vector<double> results(n_keys + 1);
+
+	for (uint64_t k = 0; k <= n_keys; k++)
+		keys.push_back(k);
+
+	REQUIRE(hllStoreCount(NULL, keys.data(), keys.size(), results.data()) == 1);
+	REQUIRE(hllStoreCount(&store, NULL, keys.size(), results.data()) == 2);
+	REQUIRE(hllStoreCount(&store, keys.data(), keys.size(), NULL) == 3);
+	REQUIRE(hllStoreCount(&store, keys.data(), keys.size(), results.data()) == 0);
+
+	REQUIRE(results[0] == 0);
+	REQUIRE(results[n_keys] == 0);
+	for (uint64_t k = 1; k < n_keys; k++)
+		REQUIRE(results[k] == countDirectly(MEDIUM, 8, 1000 * k, k));
+
+	// removing keys keeps the other keys reachable
+	for (uint64_t k = 1; k < n_keys; k += 2)
+		REQUIRE(hllStoreRemove(&store, k) == 1);
+
+	REQUIRE(hllStoreRemove(&store, 1) == 0);
+	REQUIRE(store.count == n_keys / 2 - 1);
+
+	for (uint64_t k = 2; k < n_keys; k += 2)
+	{
+		REQUIRE(hllStoreGet(&store, k, &sketch) == 1);
+		REQUIRE(hllCount(&sketch) == countDirectly(MEDIUM, 8, 1000 * k, k));
+	}
+
+	// removed sketches are reused empty
+	REQUIRE(hllStoreAdd(&store, 1, (void*)1) == 0);
+	REQUIRE(hllStoreGet(&store, 1, &sketch) == 1);
+	REQUIRE(hllCount(&sketch) == countDirectly(MEDIUM, 8, 1, 1));
+
+	hllStoreFree(&store);
+}
+
+TEST_CASE("HyperLogLog store batch", "[src/HyperLogLogStore.h/hllStoreAddBatch]")
+{
+	struct HyperLogLogStore batched, single;
+
+	REQUIRE(hllStoreInit(&batched, SMALL, 6, &splitmixHash) == 0);
+	REQUIRE(hllStoreInit(&single, SMALL, 6, &splitmixHash) == 0);
+
+	std::vector<uint64_t> keys;
+	std::vector<const void *> items;
+
+	for (size_t i = 0; i < 50000; i++)
+	{
+		keys.push_back(i % 7 == 0 ? 42 : i * 7919 % 1013);
+		items.push_back((void*)(i % 3000));
+	}
+
+	REQUIRE(hllStoreAddBatch(NULL, keys.data(), items.data(), keys.size()) == 1);
+	REQUIRE(hllStoreAddBatch(&batched, NULL, items.data(), keys.size()) == 2);
+	REQUIRE(hllStoreAddBatch(&batched, keys.data(), NULL, keys.size()) == 3);
+
+	REQUIRE(hllStoreAddBatch(&batched, keys.data(), items.data(), keys.size()) == 0);
+	REQUIRE(hllStoreAddBatch(&batched, keys.data(), items.data(), 100) == 0);
+
+	for (size_t i = 0; i < keys.size(); i++)
+		REQUIRE(hllStoreAdd(&single, keys[i], items[i]) == 0);
+
+	REQUIRE(batched.count == single.count);
+
+	std::vector<double> batched_results(1013), single_results(1013);
+	std::vector<uint64_t> all_keys;
+
+	for (uint64_t k = 0; k < 1013; k++)
+		all_keys.push_back(k);
+
+	REQUIRE(hllStoreCount(&batched, all_keys.data(), all_keys.size(), batched_results.data()) == 0);
+	REQUIRE(hllStoreCount(&single, all_keys.data(), all_keys.size(), single_results.data()) == 0);
+	REQUIRE(batched_results == single_results);
+
+	// the union of all keys has all items
+	struct HyperLogLog all, folded;
+
+	REQUIRE(hllInit(&all, SMALL, 6, &splitmixHash) == 0);
+	REQUIRE(hllInit(&folded, SMALL, 5, &splitmixHash) == 0);
+
+	REQUIRE(hllStoreMerge(NULL, all_keys.data(), all_keys.size(), &all) == 1);
+	REQUIRE(hllStoreMerge(&batched, NULL, all_keys.size(), &all) == 2);
+	REQUIRE(hllStoreMerge(&batched, all_keys.data(), all_keys.size(), NULL) == 3);
+
+	REQUIRE(hllStoreMerge(&batched, all_keys.data(), all_keys.size(), &all) == 0);
+	REQUIRE(hllStoreMerge(&batched, all_keys.data(), all_keys.size(), &folded) == 0);
+	REQUIRE(hllCount(&all) == countDirectly(SMALL, 6, 0, 3000));
+	REQUIRE(hllCount(&folded) == countDirectly(SMALL, 5, 0, 3000));
+
+	hllFree(&all);
+	hllFree(&folded);
+	hllStoreFree(&batched);
+	hllStoreFree(&single);
+}
+
+TEST_CASE("HyperLogLog store limit", "[src/HyperLogLogStore.h/hllStoreLimit]")
+{
+	struct HyperLogLogStore store;
+	struct HyperLogLog sketch;
+	std::vector<uint64_t> evicted;
+
+	REQUIRE(hllStoreInit(&store, LARGE, 8, &splitmixHash) == 0);
+	REQUIRE(hllStoreLimit(NULL, 0, NULL, NULL) == 1);
+
+	for (uint64_t k = 0; k < 100; k++)
+		REQUIRE(hllStoreAdd(&store, k, (void*)k) == 0);
+
+	// room for 10 sketches with 256 bytes each
+	size_t max_bytes = hllStoreMemory(&store) - 90 * 256;
+
+	REQUIRE(hllStoreLimit(&store, max_bytes, &rememberEvicted, &evicted) == 0);
+	REQUIRE(hllStoreMemory(&store) <= max_bytes);
+	REQUIRE(store.count == 10);
+	REQUIRE(evicted.size() == 90);
+
+	for (uint64_t k = 100; k < 1000; k++)
+	{
+		// key 0 is accessed before every new key, so it's never evicted
+		REQUIRE(hllStoreAdd(&store, 0, (void*)k) == 0);
+		REQUIRE(hllStoreAdd(&store, k, (void*)k) == 0);
+		REQUIRE(hllStoreMemory(&store) <= max_bytes);
+	}
+
+	REQUIRE(hllStoreGet(&store, 0, &sketch) == 1);
+	REQUIRE(hllStoreGet(&store, 999, &sketch) == 1);
+
+	for (size_t i = 90; i < evicted.size(); i++)
+	{
+		REQUIRE(evicted[i] != 0);
+		REQUIRE(hllStoreGet(&store, evicted[i], &sketch) == 0);
+	}
+
+	// folding all sketches keeps their estimates in line with the lower precision
+	REQUIRE(hllStoreFold(NULL, SMALL, 6) == 1);
+	REQUIRE(hllStoreFold(&store, 5, 6) == 2);
+	REQUIRE(hllStoreFold(&store, SMALL, 9) == 3);
+	REQUIRE(hllStoreFold(&store, SMALL, 6) == 0);
+
+	REQUIRE(hllStoreGet(&store, 999, &sketch) == 1);
+	REQUIRE(sketch.r == SMALL);
+	REQUIRE(sketch.b == 6);
+	REQUIRE(hllCount(&sketch) == countDirectly(SMALL, 6, 999, 1));
+
+	REQUIRE(hllStoreAdd(&store, 2000, (void*)1) == 0);
+	REQUIRE(hllStoreMemory(&store) <= max_bytes);
+
+	hllStoreFree(&store);
+}
+
+TEST_CASE("HyperLogLog store open", "[src/HyperLogLogStore.h/hllStoreOpen]")
+{
+	struct HyperLogLogStore store;
+	struct HyperLogLog sketch, other, set;
+
+	REQUIRE(hllStoreInit(&store, MEDIUM, 8, &splitmixHash) == 0);
+
+	REQUIRE(hllStoreOpen(NULL, 1, &sketch) == 1);
+	REQUIRE(hllStoreOpen(&store, 1, NULL) == 3);
+
+	// a new sketch is empty
+	REQUIRE(hllStoreOpen(&store, 1, &sketch) == 0);
+	REQUIRE(store.count == 1);
+	REQUIRE(hllCount(&sketch) == 0);
+
+	REQUIRE(hllInit(&set, MEDIUM, 8, &splitmixHash) == 0);
+	for (size_t i = 0; i < 500; i++)
+		hllAdd(&set, (void*)i);
+
+	// merging into the sketch changes the sketch of the store
+	REQUIRE(hllMerge(&sketch, &set) == 0);
+	REQUIRE(hllStoreGet(&store, 1, &other) == 1);
+	REQUIRE(other.data == sketch.data);
+	REQUIRE(hllCount(&other) == countDirectly(MEDIUM, 8, 0, 500));
+
+	// an existing sketch is opened as it is
+	REQUIRE(hllStoreAdd(&store, 1, (void*)500) == 0);
+	REQUIRE(hllStoreOpen(&store, 1, &sketch) == 0);
+	REQUIRE(store.count == 1);
+	REQUIRE(hllCount(&sketch) == countDirectly(MEDIUM, 8, 0, 501));
+
+	hllFree(&set);
+	hllStoreFree(&store);
+}
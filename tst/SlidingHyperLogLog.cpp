@@ -0,0 +1,98 @@
+#include <catch.hpp>
+#include <cstring>
+
+extern "C"
+{
+#include "../inc/SlidingHyperLogLog.h"
+}
+
+static void splitmixHash(const void *item, size_t h, void *buffer)
+{
+	uint64_t state = (uintptr_t)item;
+
+	for (size_t i = 0; i < h; i += sizeof(uint64_t))
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		z ^= z >> 31;
+
+		memcpy((char *)buffer + i, &z, h - i < sizeof(uint64_t) ? h - i : sizeof(uint64_t));
+	}
+}
+
+/**
+ * Counts the items `[first, last]` with a plain HyperLogLog.
+ */
+static double countDirectly(size_t first, size_t last)
+{
+	struct HyperLogLog hll;
+	hllInit(&hll, MEDIUM, 10, &splitmixHash);
+
+	for (size_t i = first; i <= last; i++)
+		hllAdd(&hll, (void*)i);
+
+	double result = hllCount(&hll);
+	hllFree(&hll);
+
+	return result;
+}
+
+TEST_CASE("sliding HyperLogLog", "[inc/SlidingHyperLogLog.h]")
+{
+	struct SlidingHyperLogLog window;
+
+	REQUIRE(shllInit(NULL, MEDIUM, 10, &splitmixHash, 8, 10) == 1);
+	REQUIRE(shllInit(&window, 5, 10, &splitmixHash, 8, 10) == 2);
+	REQUIRE(shllInit(&window, MEDIUM, 2, &splitmixHash, 8, 10) == 3);
+	REQUIRE(shllInit(&window, MEDIUM, 10, NULL, 8, 10) == 4);
+	REQUIRE(shllInit(&window, MEDIUM, 10, &splitmixHash, 0, 10) == 5);
+	REQUIRE(shllInit(&window, MEDIUM, 10, &splitmixHash, 8, 0) == 6);
+	REQUIRE(std::isnan(shllCount(NULL, 0, 10)));
+	REQUIRE_NOTHROW(shllFree(NULL));
+
+	// 6 slots are rounded up to 8, every slot is 10 time units long
+	REQUIRE(shllInit(&window, MEDIUM, 10, &splitmixHash, 6, 10) == 0);
+	REQUIRE(window.n_slots == 8);
+	REQUIRE(shllCount(&window, 0, 10) == 0);
+
+	// item i occurs at time i / 10, so every slot gets 100 new items
+	for (size_t i = 0; i < 2000; i++)
+	{
+		shllAdd(&window, (void*)i, i / 10);
+
+		// check some windows after each completed slot
+		if (i % 100 == 99)
+		{
+			uint64_t now = i / 10;
+			uint64_t slot = now / 10;
+
+			for (uint64_t n_slots = 1; n_slots <= 8; n_slots++)
+			{
+				uint64_t first_slot = slot + 1 >= n_slots ? slot + 1 - n_slots : 0;
+				REQUIRE(shllCount(&window, now, n_slots * 10) == countDirectly(first_slot * 100, i));
+			}
+
+			// windows that are not a multiple of the slot length are rounded up
+			REQUIRE(shllCount(&window, now, 15) == shllCount(&window, now, 20));
+
+			// too long windows are shortened
+			REQUIRE(shllCount(&window, now, 1000) == shllCount(&window, now, 80));
+		}
+	}
+
+	// windows in the future only contain the slots that are still in the window
+	REQUIRE(shllCount(&window, 199 + 30, 50) == countDirectly(1800, 1999));
+	REQUIRE(shllCount(&window, 199 + 100, 50) == 0);
+	REQUIRE(shllCount(&window, 199, 0) == 0);
+
+	// items that are too old are ignored
+	shllAdd(&window, (void*)(size_t)123456, 0);
+	REQUIRE(shllCount(&window, 199, 80) == countDirectly(1200, 1999));
+
+	// jumping far ahead clears all slots
+	shllAdd(&window, (void*)(size_t)5000, 100000);
+	REQUIRE(shllCount(&window, 100000, 80) == countDirectly(5000, 5000));
+
+	shllFree(&window);
+}